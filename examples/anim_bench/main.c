@@ -0,0 +1,586 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fluent/fluent.h>
+
+#include "frame_stats.h"
+#include "job_system.h"
+#include "animation_set.h"
+#include "model_animation.h"
+
+#define DEFAULT_NODES  4096
+#define DEFAULT_KEYS   120
+#define DEFAULT_FRAMES 600
+
+// synthetic keys are this far apart, nodes are split into clips of
+// NODES_PER_CLIP that run at different speeds
+#define KEY_RATE       30.0f
+#define NODES_PER_CLIP 64
+#define FRAME_TIME     ( 1.0f / 60.0f )
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static void
+print_usage( void )
+{
+	printf( "usage: anim-bench [model.gltf] [options]\n"
+	        "  --nodes <n>         animated nodes (default %u)\n"
+	        "  --keys <n>          keys per synthetic channel (default %u)\n"
+	        "  --frames <n>        frames played, 1/60 s apart (default %u)\n"
+	        "  --threads <n>       worker thread count, 0 = all cores\n"
+	        "without a model every node gets random translation, rotation "
+	        "and scale\nchannels, with one the model is copied until it "
+	        "has enough animated nodes\n",
+	        DEFAULT_NODES,
+	        DEFAULT_KEYS,
+	        DEFAULT_FRAMES );
+}
+
+static float
+random_float( uint32_t* state )
+{
+	// xorshift32
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return ( float ) ( *state >> 8 ) / ( float ) ( 1u << 24 );
+}
+
+static double
+elapsed_ms( uint64_t begin )
+{
+	return ( double ) ( frame_clock_ns() - begin ) / 1e6;
+}
+
+// the keys of a channel the way a straightforward evaluator keeps them,
+// time and value side by side
+struct reference_key
+{
+	float time;
+	float value[ 4 ];
+};
+
+struct reference_channel
+{
+	uint32_t              target;
+	enum animation_path   path;
+	float                 duration;
+	uint32_t              key_count;
+	struct reference_key* keys;
+};
+
+struct reference_pose
+{
+	float translation[ 3 ];
+	float rotation[ 4 ];
+	float scale[ 3 ];
+};
+
+// what the animation set is measured against: every channel searches its
+// keys from scratch, rotations use a real slerp and everything runs on
+// one thread, the way the main pass evaluated animations before
+static void
+reference_slerp( const float* a, const float* b, float t, float* out )
+{
+	float dot  = a[ 0 ] * b[ 0 ] + a[ 1 ] * b[ 1 ] + a[ 2 ] * b[ 2 ] +
+	            a[ 3 ] * b[ 3 ];
+	float sign = dot < 0.0f ? -1.0f : 1.0f;
+	dot *= sign;
+
+	float wa = 1.0f - t;
+	float wb = t;
+	if ( dot < 0.9995f )
+	{
+		float angle = acosf( dot );
+		float s     = sinf( angle );
+		wa          = sinf( ( 1.0f - t ) * angle ) / s;
+		wb          = sinf( t * angle ) / s;
+	}
+
+	float length = 0.0f;
+	for ( uint32_t c = 0; c < 4; ++c )
+	{
+		out[ c ] = a[ c ] * wa + b[ c ] * wb * sign;
+		length += out[ c ] * out[ c ];
+	}
+
+	length = sqrtf( length );
+	for ( uint32_t c = 0; c < 4; ++c )
+	{
+		out[ c ] /= length;
+	}
+}
+
+static void
+reference_sample( const struct reference_channel* channel,
+                  float                           time,
+                  float*                          out )
+{
+	const struct reference_key* keys  = channel->keys;
+	uint32_t                    count = channel->key_count;
+	uint32_t components = channel->path == ANIMATION_PATH_ROTATION ? 4 : 3;
+
+	time = fmodf( time, channel->duration );
+
+	if ( count == 1 || time <= keys[ 0 ].time )
+	{
+		memcpy( out, keys[ 0 ].value, components * sizeof( float ) );
+		return;
+	}
+	if ( time >= keys[ count - 1 ].time )
+	{
+		memcpy( out, keys[ count - 1 ].value, components * sizeof( float ) );
+		return;
+	}
+
+	uint32_t low  = 0;
+	uint32_t high = count - 1;
+	while ( high - low > 1 )
+	{
+		uint32_t middle = low + ( high - low ) / 2;
+		if ( keys[ middle ].time <= time )
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	const struct reference_key* a = &keys[ low ];
+	const struct reference_key* b = &keys[ low + 1 ];
+	float t = ( time - a->time ) / ( b->time - a->time );
+
+	if ( channel->path == ANIMATION_PATH_ROTATION )
+	{
+		reference_slerp( a->value, b->value, t, out );
+		return;
+	}
+
+	for ( uint32_t c = 0; c < 3; ++c )
+	{
+		out[ c ] = a->value[ c ] + ( b->value[ c ] - a->value[ c ] ) * t;
+	}
+}
+
+static void
+reference_evaluate( const struct reference_channel* channels,
+                    uint32_t                        channel_count,
+                    struct reference_pose*          poses,
+                    uint32_t                        pose_count,
+                    float                           time,
+                    float ( *transforms )[ 4 ][ 4 ] )
+{
+	for ( uint32_t i = 0; i < channel_count; ++i )
+	{
+		const struct reference_channel* channel = &channels[ i ];
+		struct reference_pose*          pose    = &poses[ channel->target ];
+
+		switch ( channel->path )
+		{
+		case ANIMATION_PATH_TRANSLATION:
+		{
+			reference_sample( channel, time, pose->translation );
+			break;
+		}
+		case ANIMATION_PATH_ROTATION:
+		{
+			reference_sample( channel, time, pose->rotation );
+			break;
+		}
+		default:
+		{
+			reference_sample( channel, time, pose->scale );
+			break;
+		}
+		}
+	}
+
+	for ( uint32_t i = 0; i < pose_count; ++i )
+	{
+		const struct reference_pose* pose = &poses[ i ];
+		const float*                 q    = pose->rotation;
+		float( *m )[ 4 ]                  = transforms[ i ];
+
+		float x = q[ 0 ], y = q[ 1 ], z = q[ 2 ], w = q[ 3 ];
+
+		m[ 0 ][ 0 ] = ( 1.0f - 2.0f * ( y * y + z * z ) ) * pose->scale[ 0 ];
+		m[ 0 ][ 1 ] = 2.0f * ( x * y + w * z ) * pose->scale[ 0 ];
+		m[ 0 ][ 2 ] = 2.0f * ( x * z - w * y ) * pose->scale[ 0 ];
+		m[ 1 ][ 0 ] = 2.0f * ( x * y - w * z ) * pose->scale[ 1 ];
+		m[ 1 ][ 1 ] = ( 1.0f - 2.0f * ( x * x + z * z ) ) * pose->scale[ 1 ];
+		m[ 1 ][ 2 ] = 2.0f * ( y * z + w * x ) * pose->scale[ 1 ];
+		m[ 2 ][ 0 ] = 2.0f * ( x * z + w * y ) * pose->scale[ 2 ];
+		m[ 2 ][ 1 ] = 2.0f * ( y * z - w * x ) * pose->scale[ 2 ];
+		m[ 2 ][ 2 ] = ( 1.0f - 2.0f * ( x * x + y * y ) ) * pose->scale[ 2 ];
+		m[ 0 ][ 3 ] = m[ 1 ][ 3 ] = m[ 2 ][ 3 ] = 0.0f;
+		m[ 3 ][ 0 ] = pose->translation[ 0 ];
+		m[ 3 ][ 1 ] = pose->translation[ 1 ];
+		m[ 3 ][ 2 ] = pose->translation[ 2 ];
+		m[ 3 ][ 3 ] = 1.0f;
+	}
+}
+
+static void
+random_key_value( uint32_t*           state,
+                  enum animation_path path,
+                  float*              value )
+{
+	switch ( path )
+	{
+	case ANIMATION_PATH_TRANSLATION:
+	{
+		for ( uint32_t c = 0; c < 3; ++c )
+		{
+			value[ c ] = ( random_float( state ) * 2.0f - 1.0f ) * 10.0f;
+		}
+		break;
+	}
+	case ANIMATION_PATH_ROTATION:
+	{
+		// a random axis turned by up to half a turn
+		float angle = random_float( state ) * ( float ) M_PI;
+		float axis[ 3 ];
+		float length = 0.0f;
+		for ( uint32_t c = 0; c < 3; ++c )
+		{
+			axis[ c ] = random_float( state ) * 2.0f - 1.0f;
+			length += axis[ c ] * axis[ c ];
+		}
+		length = sqrtf( length ) + 1e-6f;
+		for ( uint32_t c = 0; c < 3; ++c )
+		{
+			value[ c ] = axis[ c ] / length * sinf( angle * 0.5f );
+		}
+		value[ 3 ] = cosf( angle * 0.5f );
+		break;
+	}
+	default:
+	{
+		for ( uint32_t c = 0; c < 3; ++c )
+		{
+			value[ c ] = 0.5f + random_float( state );
+		}
+		break;
+	}
+	}
+}
+
+// node_count nodes with a channel per path each, the same keys go into
+// the reference channels and the set
+static struct reference_channel*
+build_synthetic( uint32_t              node_count,
+                 uint32_t              key_count,
+                 struct animation_set* set )
+{
+	static const float identity[ 4 ][ 4 ] = {
+	    { 1.0f, 0.0f, 0.0f, 0.0f },
+	    { 0.0f, 1.0f, 0.0f, 0.0f },
+	    { 0.0f, 0.0f, 1.0f, 0.0f },
+	    { 0.0f, 0.0f, 0.0f, 1.0f },
+	};
+
+	uint32_t                  channel_count = node_count * ANIMATION_PATH_COUNT;
+	struct reference_channel* channels =
+	    malloc( channel_count * sizeof( struct reference_channel ) );
+	float*   times  = malloc( key_count * sizeof( float ) );
+	float*   values = malloc( key_count * 4 * sizeof( float ) );
+	uint32_t state  = 0x9E3779B9u;
+	uint32_t clip   = 0;
+
+	for ( uint32_t n = 0; n < node_count; ++n )
+	{
+		if ( n % NODES_PER_CLIP == 0 )
+		{
+			clip = animation_set_add_clip( set );
+		}
+
+		// clips run at 0.5x to 1.5x the key rate
+		float    rate = KEY_RATE * ( 0.5f + ( float ) ( clip % 11 ) * 0.1f );
+		uint32_t target = animation_set_add_target( set, n, identity, NULL );
+
+		for ( uint32_t k = 0; k < key_count; ++k )
+		{
+			times[ k ] = ( float ) k / rate;
+		}
+
+		for ( uint32_t p = 0; p < ANIMATION_PATH_COUNT; ++p )
+		{
+			uint32_t components = p == ANIMATION_PATH_ROTATION ? 4 : 3;
+			struct reference_channel* channel =
+			    &channels[ n * ANIMATION_PATH_COUNT + p ];
+
+			channel->target    = n;
+			channel->path      = p;
+			channel->duration  = times[ key_count - 1 ];
+			channel->key_count = key_count;
+			channel->keys =
+			    malloc( key_count * sizeof( struct reference_key ) );
+
+			for ( uint32_t k = 0; k < key_count; ++k )
+			{
+				float* value = &values[ k * components ];
+				random_key_value( &state, p, value );
+
+				channel->keys[ k ].time = times[ k ];
+				memcpy( channel->keys[ k ].value,
+				        value,
+				        components * sizeof( float ) );
+			}
+
+			animation_set_add_channel( set,
+			                           clip,
+			                           target,
+			                           p,
+			                           times,
+			                           values,
+			                           key_count );
+		}
+	}
+
+	free( times );
+	free( values );
+
+	return channels;
+}
+
+static float
+max_difference( float ( *a )[ 4 ][ 4 ],
+                float ( *b )[ 4 ][ 4 ],
+                uint32_t count )
+{
+	float difference = 0.0f;
+
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		const float* lhs = &a[ i ][ 0 ][ 0 ];
+		const float* rhs = &b[ i ][ 0 ][ 0 ];
+		for ( uint32_t e = 0; e < 16; ++e )
+		{
+			float d    = fabsf( lhs[ e ] - rhs[ e ] );
+			difference = d > difference ? d : difference;
+		}
+	}
+
+	return difference;
+}
+
+static double
+run_set( struct animation_set* set,
+         uint32_t              frames,
+         float ( *transforms )[ 4 ][ 4 ],
+         bool                  parallel )
+{
+	uint64_t begin = frame_clock_ns();
+
+	for ( uint32_t f = 0; f < frames; ++f )
+	{
+		animation_set_evaluate( set,
+		                        ( float ) f * FRAME_TIME,
+		                        transforms,
+		                        parallel );
+	}
+
+	return elapsed_ms( begin ) / frames;
+}
+
+static void
+report( const char* name, double ms, double baseline )
+{
+	printf( "%-22s %9.3f ms/frame %8.1fx\n", name, ms, baseline / ms );
+}
+
+static int
+run_synthetic( uint32_t node_count, uint32_t key_count, uint32_t frames )
+{
+	struct animation_set set;
+	animation_set_init( &set );
+
+	struct reference_channel* channels =
+	    build_synthetic( node_count, key_count, &set );
+	uint32_t channel_count = node_count * ANIMATION_PATH_COUNT;
+
+	struct reference_pose* poses =
+	    malloc( node_count * sizeof( struct reference_pose ) );
+	float( *expected )[ 4 ][ 4 ] = malloc( node_count * sizeof( *expected ) );
+	float( *transforms )[ 4 ][ 4 ] =
+	    malloc( node_count * sizeof( *transforms ) );
+
+	printf( "%u nodes, %u channels of %u keys, %u frames, %u threads\n",
+	        node_count,
+	        channel_count,
+	        key_count,
+	        frames,
+	        job_system_get_thread_count() );
+
+	uint64_t begin = frame_clock_ns();
+	for ( uint32_t f = 0; f < frames; ++f )
+	{
+		reference_evaluate( channels,
+		                    channel_count,
+		                    poses,
+		                    node_count,
+		                    ( float ) f * FRAME_TIME,
+		                    expected );
+	}
+	double reference = elapsed_ms( begin ) / frames;
+
+	double serial   = run_set( &set, frames, transforms, false );
+	double parallel = run_set( &set, frames, transforms, true );
+
+	report( "search + slerp (old)", reference, reference );
+	report( "soa serial", serial, reference );
+	report( "soa parallel", parallel, reference );
+
+	// both ended on the last frame
+	float difference = max_difference( expected, transforms, node_count );
+	printf( "largest difference from the old path %.6f\n", difference );
+
+	for ( uint32_t i = 0; i < channel_count; ++i )
+	{
+		free( channels[ i ].keys );
+	}
+	free( channels );
+	free( poses );
+	free( expected );
+	free( transforms );
+	animation_set_shutdown( &set );
+
+	return difference < 1e-2f ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// copies of a gltf until it has node_count animated meshes, evaluated
+// with apply_animation per copy the way the main pass used to and with
+// the animation set
+static int
+run_model( const char* path, uint32_t node_count, uint32_t frames )
+{
+	struct ft_model model = ft_load_gltf( path, 0 );
+
+	if ( model.animation_count == 0 || model.mesh_count == 0 )
+	{
+		printf( "%s has no animations\n", path );
+		ft_free_gltf( &model );
+		return EXIT_FAILURE;
+	}
+
+	struct animation_set set;
+	animation_set_init( &set );
+
+	uint32_t animated = model_animation_add( &set, &model, 0, NULL );
+	uint32_t copies   = ( node_count + animated - 1 ) / animated;
+	uint32_t count    = copies * model.mesh_count;
+
+	for ( uint32_t c = 1; c < copies; ++c )
+	{
+		model_animation_add( &set, &model, c * model.mesh_count, NULL );
+	}
+
+	float( *expected )[ 4 ][ 4 ] = malloc( count * sizeof( *expected ) );
+	float( *transforms )[ 4 ][ 4 ] = malloc( count * sizeof( *transforms ) );
+
+	printf( "%s: %u animated of %u meshes, %u animations, %u copies, "
+	        "%u frames, %u threads\n",
+	        path,
+	        animated,
+	        model.mesh_count,
+	        model.animation_count,
+	        copies,
+	        frames,
+	        job_system_get_thread_count() );
+
+	uint64_t begin = frame_clock_ns();
+	for ( uint32_t f = 0; f < frames; ++f )
+	{
+		for ( uint32_t c = 0; c < copies; ++c )
+		{
+			float( *copy )[ 4 ][ 4 ] = &expected[ c * model.mesh_count ];
+
+			for ( uint32_t m = 0; m < model.mesh_count; ++m )
+			{
+				memcpy( copy[ m ],
+				        model.meshes[ m ].world,
+				        sizeof( copy[ m ] ) );
+			}
+			for ( uint32_t a = 0; a < model.animation_count; ++a )
+			{
+				apply_animation( copy,
+				                 ( float ) f * FRAME_TIME,
+				                 &model.animations[ a ] );
+			}
+		}
+	}
+	double reference = elapsed_ms( begin ) / frames;
+
+	double serial   = run_set( &set, frames, transforms, false );
+	double parallel = run_set( &set, frames, transforms, true );
+
+	report( "apply_animation (old)", reference, reference );
+	report( "soa serial", serial, reference );
+	report( "soa parallel", parallel, reference );
+
+	free( expected );
+	free( transforms );
+	animation_set_shutdown( &set );
+	ft_free_gltf( &model );
+
+	return EXIT_SUCCESS;
+}
+
+int
+main( int argc, char** argv )
+{
+	const char* input        = NULL;
+	uint32_t    node_count   = DEFAULT_NODES;
+	uint32_t    key_count    = DEFAULT_KEYS;
+	uint32_t    frames       = DEFAULT_FRAMES;
+	uint32_t    thread_count = 0;
+
+	for ( int i = 1; i < argc; ++i )
+	{
+		if ( strcmp( argv[ i ], "--nodes" ) == 0 && i + 1 < argc )
+		{
+			node_count = ( uint32_t ) atoi( argv[ ++i ] );
+		}
+		else if ( strcmp( argv[ i ], "--keys" ) == 0 && i + 1 < argc )
+		{
+			key_count = ( uint32_t ) atoi( argv[ ++i ] );
+		}
+		else if ( strcmp( argv[ i ], "--frames" ) == 0 && i + 1 < argc )
+		{
+			frames = ( uint32_t ) atoi( argv[ ++i ] );
+		}
+		else if ( strcmp( argv[ i ], "--threads" ) == 0 && i + 1 < argc )
+		{
+			thread_count = ( uint32_t ) atoi( argv[ ++i ] );
+		}
+		else if ( argv[ i ][ 0 ] != '-' && input == NULL )
+		{
+			input = argv[ i ];
+		}
+		else
+		{
+			print_usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if ( node_count == 0 || key_count < 2 || frames == 0 )
+	{
+		print_usage();
+		return EXIT_FAILURE;
+	}
+
+	job_system_init( thread_count );
+
+	int result = input ? run_model( input, node_count, frames )
+	                   : run_synthetic( node_count, key_count, frames );
+
+	job_system_shutdown();
+
+	return result;
+}
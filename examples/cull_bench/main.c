@@ -0,0 +1,379 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frame_stats.h"
+#include "scene_bvh.h"
+
+#define DEFAULT_OBJECTS    100000
+#define DEFAULT_ITERATIONS 50
+#define VIEW_COUNT         16
+
+// objects are scattered through a cube sized for this many per unit cube,
+// the camera sits in the middle and looks out
+#define OBJECT_DENSITY 0.05f
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static void
+print_usage( void )
+{
+	printf( "usage: cull-bench [options]\n"
+	        "  --objects <n>       objects in the scene (default %u)\n"
+	        "  --iterations <n>    culls per view, the best one is reported "
+	        "(default %u)\n"
+	        "a random scene is culled from %u views with the bvh and with a "
+	        "test of every\nobject, then refit after every object moved\n",
+	        DEFAULT_OBJECTS,
+	        DEFAULT_ITERATIONS,
+	        VIEW_COUNT );
+}
+
+static float
+random_float( uint32_t* state )
+{
+	// xorshift32
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return ( float ) ( *state >> 8 ) / ( float ) ( 1u << 24 );
+}
+
+static void
+random_sphere( uint32_t* state, float half_size, float* sphere )
+{
+	for ( uint32_t a = 0; a < 3; ++a )
+	{
+		sphere[ a ] = ( random_float( state ) * 2.0f - 1.0f ) * half_size;
+	}
+	sphere[ 3 ] = 0.25f + random_float( state ) * 1.75f;
+}
+
+// column major perspective with a zero to one depth range and a look at
+// view, the way the engine camera builds them
+static void
+make_view( uint32_t view_index,
+           float    projection[ 4 ][ 4 ],
+           float    view[ 4 ][ 4 ] )
+{
+	float fov    = 45.0f * ( float ) M_PI / 180.0f;
+	float aspect = 16.0f / 9.0f;
+	float n      = 0.1f;
+	float f      = 1000.0f;
+	float t      = 1.0f / tanf( fov * 0.5f );
+
+	memset( projection, 0, sizeof( float ) * 16 );
+	projection[ 0 ][ 0 ] = t / aspect;
+	projection[ 1 ][ 1 ] = -t;
+	projection[ 2 ][ 2 ] = f / ( n - f );
+	projection[ 2 ][ 3 ] = -1.0f;
+	projection[ 3 ][ 2 ] = f * n / ( n - f );
+
+	// directions spread around the horizon and tilted up and down
+	float yaw   = ( float ) view_index * 2.0f * ( float ) M_PI / VIEW_COUNT;
+	float pitch = ( ( float ) ( view_index % 3 ) - 1.0f ) * 0.4f;
+
+	float forward[ 3 ] = { cosf( pitch ) * sinf( yaw ),
+	                       sinf( pitch ),
+	                       -cosf( pitch ) * cosf( yaw ) };
+	float right[ 3 ]   = { -forward[ 2 ], 0.0f, forward[ 0 ] };
+	float length =
+	    sqrtf( right[ 0 ] * right[ 0 ] + right[ 2 ] * right[ 2 ] );
+	right[ 0 ] /= length;
+	right[ 2 ] /= length;
+
+	float up[ 3 ] = { right[ 1 ] * forward[ 2 ] - right[ 2 ] * forward[ 1 ],
+	                  right[ 2 ] * forward[ 0 ] - right[ 0 ] * forward[ 2 ],
+	                  right[ 0 ] * forward[ 1 ] - right[ 1 ] * forward[ 0 ] };
+
+	// the camera is at the origin, so the translation column is zero
+	memset( view, 0, sizeof( float ) * 16 );
+	for ( uint32_t a = 0; a < 3; ++a )
+	{
+		view[ a ][ 0 ] = right[ a ];
+		view[ a ][ 1 ] = up[ a ];
+		view[ a ][ 2 ] = -forward[ a ];
+	}
+	view[ 3 ][ 3 ] = 1.0f;
+}
+
+static bool
+aabb_outside( const struct scene_bvh_aabb* aabb, const float planes[ 6 ][ 4 ] )
+{
+	for ( uint32_t p = 0; p < 6; ++p )
+	{
+		float d = planes[ p ][ 3 ];
+		float r = 0.0f;
+
+		for ( uint32_t a = 0; a < 3; ++a )
+		{
+			float center = ( aabb->min[ a ] + aabb->max[ a ] ) * 0.5f;
+			float extent = ( aabb->max[ a ] - aabb->min[ a ] ) * 0.5f;
+
+			d += planes[ p ][ a ] * center;
+			r += fabsf( planes[ p ][ a ] ) * extent;
+		}
+
+		if ( d + r < 0.0f )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// what the bvh is measured against, every object against every plane
+static uint32_t
+cull_linear( const struct scene_bvh_aabb* objects,
+             uint32_t                     object_count,
+             const float                  planes[ 6 ][ 4 ],
+             uint32_t*                    visible )
+{
+	uint32_t count = 0;
+
+	for ( uint32_t i = 0; i < object_count; ++i )
+	{
+		if ( !aabb_outside( &objects[ i ], planes ) )
+		{
+			visible[ count++ ] = i;
+		}
+	}
+
+	return count;
+}
+
+static int
+compare_indices( const void* a, const void* b )
+{
+	uint32_t lhs = *( const uint32_t* ) a;
+	uint32_t rhs = *( const uint32_t* ) b;
+	return ( lhs > rhs ) - ( lhs < rhs );
+}
+
+// sorts the bvh result, the linear one is in order already
+static bool
+same_visible( uint32_t*       visible,
+              uint32_t        visible_count,
+              const uint32_t* linear_visible,
+              uint32_t        linear_count )
+{
+	qsort( visible, visible_count, sizeof( uint32_t ), compare_indices );
+
+	return visible_count == linear_count &&
+	       memcmp( visible,
+	               linear_visible,
+	               visible_count * sizeof( uint32_t ) ) == 0;
+}
+
+static double
+elapsed_ms( uint64_t begin )
+{
+	return ( double ) ( frame_clock_ns() - begin ) / 1e6;
+}
+
+static void
+make_objects( const float*           spheres,
+              uint32_t               count,
+              float                  time,
+              struct scene_bvh_aabb* objects )
+{
+	static const float identity[ 4 ][ 4 ] = {
+	    { 1.0f, 0.0f, 0.0f, 0.0f },
+	    { 0.0f, 1.0f, 0.0f, 0.0f },
+	    { 0.0f, 0.0f, 1.0f, 0.0f },
+	    { 0.0f, 0.0f, 0.0f, 1.0f },
+	};
+
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		float sphere[ 4 ];
+		memcpy( sphere, &spheres[ i * 4 ], sizeof( sphere ) );
+
+		// a small bob per object stands in for animation
+		sphere[ 1 ] += sinf( time + ( float ) i ) * 0.5f;
+
+		scene_bvh_sphere_aabb( identity, sphere, &objects[ i ] );
+	}
+}
+
+int
+main( int argc, char** argv )
+{
+	uint32_t object_count = DEFAULT_OBJECTS;
+	uint32_t iterations   = DEFAULT_ITERATIONS;
+
+	for ( int i = 1; i < argc; ++i )
+	{
+		if ( strcmp( argv[ i ], "--objects" ) == 0 && i + 1 < argc )
+		{
+			object_count = ( uint32_t ) atoi( argv[ ++i ] );
+		}
+		else if ( strcmp( argv[ i ], "--iterations" ) == 0 && i + 1 < argc )
+		{
+			iterations = ( uint32_t ) atoi( argv[ ++i ] );
+		}
+		else
+		{
+			print_usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if ( object_count == 0 || iterations == 0 )
+	{
+		print_usage();
+		return EXIT_FAILURE;
+	}
+
+	float volume    = ( float ) object_count / OBJECT_DENSITY;
+	float half_size = 0.5f * cbrtf( volume );
+
+	uint32_t state = 0x9E3779B9u;
+
+	float* spheres = malloc( object_count * 4 * sizeof( float ) );
+	for ( uint32_t i = 0; i < object_count; ++i )
+	{
+		random_sphere( &state, half_size, &spheres[ i * 4 ] );
+	}
+
+	struct scene_bvh_aabb* objects =
+	    malloc( object_count * sizeof( struct scene_bvh_aabb ) );
+	uint32_t* visible        = malloc( object_count * sizeof( uint32_t ) );
+	uint32_t* linear_visible = malloc( object_count * sizeof( uint32_t ) );
+
+	make_objects( spheres, object_count, 0.0f, objects );
+
+	struct scene_bvh bvh;
+	scene_bvh_init( &bvh );
+
+	uint64_t begin = frame_clock_ns();
+	scene_bvh_build( &bvh, objects, object_count );
+	double build_ms = elapsed_ms( begin );
+
+	printf( "%u objects in a %.0f unit cube, %u nodes of %u lanes\n"
+	        "build %.2f ms\n\n",
+	        object_count,
+	        half_size * 2.0f,
+	        bvh.node_count,
+	        SCENE_BVH_WIDTH,
+	        build_ms );
+
+	printf( "%-6s %9s %9s %9s %12s %12s %9s\n",
+	        "view",
+	        "visible",
+	        "bvh ms",
+	        "linear ms",
+	        "nodes/ms",
+	        "objects/ms",
+	        "speedup" );
+
+	bool   ok           = true;
+	double total_bvh    = 0.0;
+	double total_linear = 0.0;
+
+	for ( uint32_t v = 0; v < VIEW_COUNT; ++v )
+	{
+		float projection[ 4 ][ 4 ], view[ 4 ][ 4 ], planes[ 6 ][ 4 ];
+		make_view( v, projection, view );
+		scene_bvh_frustum_planes( projection, view, planes );
+
+		struct scene_bvh_cull_stats stats;
+		uint32_t                    visible_count = 0;
+		uint32_t                    linear_count  = 0;
+		double                      bvh_ms        = 0.0;
+		double                      linear_ms     = 0.0;
+
+		for ( uint32_t i = 0; i < iterations; ++i )
+		{
+			begin         = frame_clock_ns();
+			visible_count = scene_bvh_cull( &bvh, planes, visible, &stats );
+			double ms     = elapsed_ms( begin );
+			bvh_ms        = ( i == 0 || ms < bvh_ms ) ? ms : bvh_ms;
+
+			begin = frame_clock_ns();
+			linear_count =
+			    cull_linear( objects, object_count, planes, linear_visible );
+			ms        = elapsed_ms( begin );
+			linear_ms = ( i == 0 || ms < linear_ms ) ? ms : linear_ms;
+		}
+
+		if ( !same_visible( visible,
+		                    visible_count,
+		                    linear_visible,
+		                    linear_count ) )
+		{
+			printf( "view %u: bvh found %u visible, the linear test %u\n",
+			        v,
+			        visible_count,
+			        linear_count );
+			ok = false;
+		}
+
+		bvh_ms    = fmax( bvh_ms, 1e-6 );
+		linear_ms = fmax( linear_ms, 1e-6 );
+
+		printf( "%-6u %9u %9.3f %9.3f %12.0f %12.0f %8.1fx\n",
+		        v,
+		        visible_count,
+		        bvh_ms,
+		        linear_ms,
+		        stats.nodes_visited / bvh_ms,
+		        object_count / bvh_ms,
+		        linear_ms / bvh_ms );
+
+		total_bvh += bvh_ms;
+		total_linear += linear_ms;
+	}
+
+	printf( "\naverage bvh %.3f ms, linear %.3f ms\n",
+	        total_bvh / VIEW_COUNT,
+	        total_linear / VIEW_COUNT );
+
+	// every object moves a little, then the tree is refit or rebuilt
+	make_objects( spheres, object_count, 1.0f, objects );
+
+	double refit_ms = 0.0;
+	for ( uint32_t i = 0; i < iterations; ++i )
+	{
+		begin     = frame_clock_ns();
+		scene_bvh_refit( &bvh, objects );
+		double ms = elapsed_ms( begin );
+		refit_ms  = ( i == 0 || ms < refit_ms ) ? ms : refit_ms;
+	}
+
+	// the refit tree has to find what the moved objects show
+	float projection[ 4 ][ 4 ], view[ 4 ][ 4 ], planes[ 6 ][ 4 ];
+	make_view( 0, projection, view );
+	scene_bvh_frustum_planes( projection, view, planes );
+
+	uint32_t visible_count = scene_bvh_cull( &bvh, planes, visible, NULL );
+	uint32_t linear_count =
+	    cull_linear( objects, object_count, planes, linear_visible );
+
+	if ( !same_visible( visible, visible_count, linear_visible, linear_count ) )
+	{
+		printf( "refit: bvh found %u visible, the linear test %u\n",
+		        visible_count,
+		        linear_count );
+		ok = false;
+	}
+
+	begin = frame_clock_ns();
+	scene_bvh_build( &bvh, objects, object_count );
+	build_ms = elapsed_ms( begin );
+
+	printf( "refit %.3f ms, rebuild %.2f ms\n", refit_ms, build_ms );
+
+	scene_bvh_shutdown( &bvh );
+	free( linear_visible );
+	free( visible );
+	free( objects );
+	free( spheres );
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
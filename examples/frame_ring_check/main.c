@@ -0,0 +1,227 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frame_ring.h"
+
+#define DEFAULT_FRAMES  10000
+#define MAX_IN_FLIGHT   4
+#define MAX_ALLOCATIONS 16
+#define REGION_SIZE     ( 64 * 1024 )
+#define ALIGNMENT       256
+
+// what a frame wrote, checked when the pretend gpu is done with the frame
+struct frame_record
+{
+	uint64_t frame;
+	uint32_t allocation_count;
+	uint64_t offsets[ MAX_ALLOCATIONS ];
+	uint64_t sizes[ MAX_ALLOCATIONS ];
+};
+
+static void
+print_usage( void )
+{
+	printf( "usage: frame-ring-check [options]\n"
+	        "  --frames <n>    frames per run (default %u)\n"
+	        "frames are written to a ring while up to %u earlier frames are "
+	        "in flight on a\npretend gpu, which checks that nothing it reads "
+	        "was overwritten by a later\nframe before the frame retired\n",
+	        DEFAULT_FRAMES,
+	        MAX_IN_FLIGHT );
+}
+
+static uint32_t
+random_u32( uint32_t* state )
+{
+	// xorshift32
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static uint32_t
+stamp( uint64_t frame, uint32_t allocation )
+{
+	return ( uint32_t ) ( frame * 2654435761u ) ^ ( allocation << 24 );
+}
+
+static bool
+frame_intact( const uint8_t* memory, const struct frame_record* record )
+{
+	for ( uint32_t a = 0; a < record->allocation_count; ++a )
+	{
+		const uint32_t* words =
+		    ( const uint32_t* ) ( memory + record->offsets[ a ] );
+		uint32_t expected = stamp( record->frame, a );
+
+		for ( uint64_t w = 0; w < record->sizes[ a ] / 4; ++w )
+		{
+			if ( words[ w ] != expected )
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// runs frame_count frames with up to in_flight of them queued on the gpu.
+// a frame retires right before the frame in_flight after it is written,
+// the way the fence wait at the start of a frame works, and its data is
+// checked then. returns how many frames found their data overwritten
+static uint32_t
+run( uint32_t  region_count,
+     uint32_t  in_flight,
+     uint32_t  frame_count,
+     uint32_t* state,
+     bool*     layout_ok )
+{
+	uint8_t* memory =
+	    malloc( frame_ring_size( REGION_SIZE, region_count, ALIGNMENT ) );
+
+	struct frame_ring ring;
+	frame_ring_init( &ring, memory, REGION_SIZE, region_count, ALIGNMENT );
+
+	struct frame_record queue[ MAX_IN_FLIGHT ];
+	uint32_t            head        = 0;
+	uint32_t            queued      = 0;
+	uint32_t            overwritten = 0;
+
+	for ( uint64_t frame = 1; frame <= frame_count; ++frame )
+	{
+		if ( queued == in_flight )
+		{
+			overwritten += frame_intact( memory, &queue[ head ] ) ? 0 : 1;
+			head = ( head + 1 ) % in_flight;
+			queued--;
+		}
+
+		frame_ring_begin_frame( &ring, frame );
+
+		uint32_t region       = ( uint32_t ) ( frame % region_count );
+		uint64_t region_start = frame_ring_region_offset( &ring, region );
+
+		struct frame_record* record =
+		    &queue[ ( head + queued++ ) % in_flight ];
+		record->frame            = frame;
+		record->allocation_count = 1 + random_u32( state ) % MAX_ALLOCATIONS;
+
+		for ( uint32_t a = 0; a < record->allocation_count; ++a )
+		{
+			// a whole number of words, small enough that every allocation
+			// of a frame fits with its alignment padding
+			uint64_t size =
+			    4 + random_u32( state ) % ( REGION_SIZE / MAX_ALLOCATIONS / 2 );
+			size &= ~( uint64_t ) 3;
+
+			uint64_t  offset;
+			uint32_t* words = frame_ring_alloc( &ring, size, &offset );
+
+			// the sets of a region point at its first allocation
+			if ( words == NULL || offset % ALIGNMENT != 0 ||
+			     offset < region_start ||
+			     offset + size > region_start + ring.region_size ||
+			     ( a == 0 && offset != region_start ) )
+			{
+				*layout_ok = false;
+				record->allocation_count = a;
+				break;
+			}
+
+			for ( uint64_t w = 0; w < size / 4; ++w )
+			{
+				words[ w ] = stamp( frame, a );
+			}
+
+			record->offsets[ a ] = offset;
+			record->sizes[ a ]   = size;
+		}
+	}
+
+	free( memory );
+
+	return overwritten;
+}
+
+int
+main( int argc, char** argv )
+{
+	uint32_t frame_count = DEFAULT_FRAMES;
+
+	for ( int i = 1; i < argc; ++i )
+	{
+		if ( strcmp( argv[ i ], "--frames" ) == 0 && i + 1 < argc )
+		{
+			frame_count = ( uint32_t ) atoi( argv[ ++i ] );
+		}
+		else
+		{
+			print_usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if ( frame_count == 0 )
+	{
+		print_usage();
+		return EXIT_FAILURE;
+	}
+
+	bool     ok    = true;
+	uint32_t state = 0x9E3779B9u;
+
+	// a ring with a region per frame in flight is enough, one region less
+	// has to be caught, which shows the check can fail
+	printf( "in flight  regions  overwritten  expected\n" );
+
+	for ( uint32_t in_flight = 1; in_flight <= MAX_IN_FLIGHT; ++in_flight )
+	{
+		uint32_t region_counts[ 2 ] = { in_flight, in_flight - 1 };
+
+		for ( uint32_t r = 0; r < 2; ++r )
+		{
+			uint32_t regions = region_counts[ r ];
+
+			if ( regions == 0 )
+			{
+				continue;
+			}
+
+			bool     layout_ok = true;
+			uint32_t overwritten =
+			    run( regions, in_flight, frame_count, &state, &layout_ok );
+			bool safe = regions >= in_flight;
+
+			printf( "%-10u %-8u %-12u %s\n",
+			        in_flight,
+			        regions,
+			        overwritten,
+			        safe ? "none" : "some" );
+
+			if ( !layout_ok || ( safe ? overwritten != 0 : overwritten == 0 ) )
+			{
+				ok = false;
+			}
+		}
+	}
+
+	// too big for a region
+	struct frame_ring ring;
+	uint8_t           memory[ ALIGNMENT ];
+	frame_ring_init( &ring, memory, ALIGNMENT, 1, ALIGNMENT );
+	frame_ring_begin_frame( &ring, 0 );
+
+	if ( frame_ring_alloc( &ring, ALIGNMENT + 1, NULL ) != NULL )
+	{
+		printf( "an allocation larger than a region succeeded\n" );
+		ok = false;
+	}
+
+	printf( "%s\n", ok ? "ok" : "failed" );
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
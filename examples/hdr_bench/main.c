@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <fluent/fluent.h>
+
+#include "file_map.h"
+#include "job_system.h"
+#include "hdr_decode.h"
+
+#define DEFAULT_WIDTH      8192
+#define DEFAULT_HEIGHT     4096
+#define DEFAULT_ITERATIONS 5
+
+static void
+print_usage( void )
+{
+	printf( "usage: hdr-bench [environment.hdr] [options]\n"
+	        "  --threads <n>       worker thread count, 0 = all cores\n"
+	        "  --iterations <n>    runs per decoder, the best one is reported "
+	        "(default %u)\n"
+	        "without a file a %ux%u rle panorama is synthesized\n",
+	        DEFAULT_ITERATIONS,
+	        DEFAULT_WIDTH,
+	        DEFAULT_HEIGHT );
+}
+
+// appends one channel plane in the rle scheme, runs of 4 or more bytes are
+// stored as runs, everything else as literals
+static uint8_t*
+encode_channel( const uint8_t* src, uint32_t width, uint8_t* dst )
+{
+	uint32_t x = 0;
+
+	while ( x < width )
+	{
+		uint32_t run = 1;
+		while ( x + run < width && run < 127 &&
+		        src[ ( x + run ) * 4 ] == src[ x * 4 ] )
+		{
+			run++;
+		}
+
+		if ( run >= 4 )
+		{
+			*dst++ = ( uint8_t ) ( 128 + run );
+			*dst++ = src[ x * 4 ];
+			x += run;
+			continue;
+		}
+
+		uint32_t count = 0;
+		while ( x + count < width && count < 128 )
+		{
+			if ( x + count + 3 < width &&
+			     src[ ( x + count ) * 4 ] == src[ ( x + count + 1 ) * 4 ] &&
+			     src[ ( x + count ) * 4 ] == src[ ( x + count + 2 ) * 4 ] &&
+			     src[ ( x + count ) * 4 ] == src[ ( x + count + 3 ) * 4 ] )
+			{
+				break;
+			}
+			count++;
+		}
+
+		*dst++ = ( uint8_t ) count;
+		for ( uint32_t i = 0; i < count; ++i )
+		{
+			*dst++ = src[ ( x + i ) * 4 ];
+		}
+		x += count;
+	}
+
+	return dst;
+}
+
+// sky gradient with a bright sun and some noise, so scanlines mix runs and
+// literals the way real captures do
+static uint8_t*
+synthesize_panorama( uint32_t width, uint32_t height, size_t* size )
+{
+	char header[ 128 ];
+	int  header_size = snprintf( header,
+                                sizeof( header ),
+                                "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n"
+                                "-Y %u +X %u\n",
+                                height,
+                                width );
+
+	// worst case every byte is a literal, one code per 128 bytes
+	size_t   capacity = ( size_t ) header_size +
+	                  ( size_t ) height * ( 4 + width * 4 + width / 32 + 4 );
+	uint8_t* data     = malloc( capacity );
+	uint8_t* row      = malloc( ( size_t ) width * 4 );
+	uint8_t* p        = data + header_size;
+	uint32_t seed     = 1;
+
+	memcpy( data, header, ( size_t ) header_size );
+
+	for ( uint32_t y = 0; y < height; ++y )
+	{
+		for ( uint32_t x = 0; x < width; ++x )
+		{
+			seed          = seed * 1664525u + 1013904223u;
+			uint8_t* rgbe = row + x * 4;
+			bool     sun  = ( x - width / 3 ) < width / 64 &&
+			           ( y - height / 4 ) < height / 32;
+
+			if ( sun )
+			{
+				rgbe[ 0 ] = 250;
+				rgbe[ 1 ] = 240;
+				rgbe[ 2 ] = 200;
+				rgbe[ 3 ] = 128 + 14;
+			}
+			else if ( y < height / 2 )
+			{
+				rgbe[ 0 ] = ( uint8_t ) ( 100 + y * 100 / height );
+				rgbe[ 1 ] = ( uint8_t ) ( 140 + y * 60 / height );
+				rgbe[ 2 ] = 220;
+				rgbe[ 3 ] = 128;
+			}
+			else
+			{
+				rgbe[ 0 ] = ( uint8_t ) ( 128 + ( seed >> 28 ) );
+				rgbe[ 1 ] = ( uint8_t ) ( 110 + ( seed >> 27 & 15 ) );
+				rgbe[ 2 ] = ( uint8_t ) ( 90 + ( seed >> 26 & 15 ) );
+				rgbe[ 3 ] = 127;
+			}
+		}
+
+		*p++ = 2;
+		*p++ = 2;
+		*p++ = ( uint8_t ) ( width >> 8 );
+		*p++ = ( uint8_t ) ( width & 0xff );
+
+		for ( uint32_t channel = 0; channel < 4; ++channel )
+		{
+			p = encode_channel( row + channel, width, p );
+		}
+	}
+
+	free( row );
+
+	*size = ( size_t ) ( p - data );
+	return data;
+}
+
+// best of iterations, in milliseconds
+static double
+run_decoder( const struct hdr_image* image,
+             uint16_t*               dst,
+             bool                    parallel,
+             uint32_t                iterations )
+{
+	double best = 0.0;
+
+	for ( uint32_t i = 0; i < iterations; ++i )
+	{
+		struct ft_timer timer;
+		ft_timer_reset( &timer );
+
+		if ( !hdr_decode_rgba16f( image, dst, parallel ) )
+		{
+			return -1.0;
+		}
+
+		double ms = ( double ) ft_timer_get_ticks( &timer );
+		best      = ( i == 0 || ms < best ) ? ms : best;
+	}
+
+	return best;
+}
+
+static void
+report( const char* name, double ms, size_t input_size, size_t output_size )
+{
+	double seconds = FT_MAX( ms, 0.001 ) / 1000.0;
+
+	printf( "%-18s %9.2f ms %9.1f MB/s in %9.1f MB/s out\n",
+	        name,
+	        ms,
+	        ( double ) input_size / ( 1024.0 * 1024.0 ) / seconds,
+	        ( double ) output_size / ( 1024.0 * 1024.0 ) / seconds );
+}
+
+int
+main( int argc, char** argv )
+{
+	const char* input        = NULL;
+	uint32_t    thread_count = 0;
+	uint32_t    iterations   = DEFAULT_ITERATIONS;
+
+	for ( int i = 1; i < argc; ++i )
+	{
+		if ( strcmp( argv[ i ], "--threads" ) == 0 && i + 1 < argc )
+		{
+			thread_count = ( uint32_t ) atoi( argv[ ++i ] );
+		}
+		else if ( strcmp( argv[ i ], "--iterations" ) == 0 && i + 1 < argc )
+		{
+			iterations = ( uint32_t ) atoi( argv[ ++i ] );
+			iterations = FT_MAX( iterations, 1u );
+		}
+		else if ( argv[ i ][ 0 ] != '-' && input == NULL )
+		{
+			input = argv[ i ];
+		}
+		else
+		{
+			print_usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	struct file_map file;
+	uint8_t*        synthetic = NULL;
+	const void*     data;
+	size_t          size;
+
+	if ( input )
+	{
+		if ( !file_map_open( input, &file ) )
+		{
+			printf( "failed to open %s\n", input );
+			return EXIT_FAILURE;
+		}
+		data = file.data;
+		size = file.size;
+	}
+	else
+	{
+		synthetic = synthesize_panorama( DEFAULT_WIDTH, DEFAULT_HEIGHT, &size );
+		data      = synthetic;
+	}
+
+	struct hdr_image image;
+	if ( !hdr_open( data, size, &image ) )
+	{
+		printf( "unsupported hdr file\n" );
+		return EXIT_FAILURE;
+	}
+
+	size_t    output_size = ( size_t ) image.width * image.height * 4 * 2;
+	uint16_t* dst         = malloc( output_size );
+
+	job_system_init( thread_count );
+
+	printf( "%ux%u %s, %.1f MB in, %.1f MB rgba16f out, %u threads\n",
+	        image.width,
+	        image.height,
+	        image.rle ? "rle" : "flat",
+	        ( double ) size / ( 1024.0 * 1024.0 ),
+	        ( double ) output_size / ( 1024.0 * 1024.0 ),
+	        job_system_get_thread_count() );
+
+	double serial   = run_decoder( &image, dst, false, iterations );
+	double parallel = run_decoder( &image, dst, true, iterations );
+	bool   ok       = serial >= 0.0 && parallel >= 0.0;
+
+	if ( ok )
+	{
+		report( "serial", serial, size, output_size );
+		report( "parallel", parallel, size, output_size );
+
+		// the existing path, decodes to 32 bit floats on one thread
+		if ( input )
+		{
+			double best = 0.0;
+			for ( uint32_t i = 0; i < iterations; ++i )
+			{
+				struct ft_timer timer;
+				ft_timer_reset( &timer );
+
+				uint32_t width, height;
+				void*    pixels =
+				    ft_read_image_from_file( input, &width, &height );
+				double ms = ( double ) ft_timer_get_ticks( &timer );
+				ft_free_image_data( pixels );
+
+				best = ( i == 0 || ms < best ) ? ms : best;
+			}
+			report( "read_image (f32)", best, size, output_size * 2 );
+		}
+	}
+	else
+	{
+		printf( "failed to decode\n" );
+	}
+
+	job_system_shutdown();
+	free( dst );
+
+	if ( input )
+	{
+		file_map_close( &file );
+	}
+	free( synthetic );
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <fluent/fluent.h>
+
+#include "file_map.h"
+#include "job_system.h"
+#include "ibl_cache.h"
+#include "ibl_cpu.h"
+
+// keep in sync with the light example
+#define SKYBOX_SIZE     2048
+#define IRRADIANCE_SIZE 32
+#define SPECULAR_SIZE   128
+#define BRDF_LUT_SIZE   512
+
+#define DEFAULT_CUBE_FORMAT FT_FORMAT_R16G16B16A16_SFLOAT
+#define DEFAULT_LUT_FORMAT  FT_FORMAT_R16G16_UNORM
+
+#define DEFAULT_TOLERANCE 0.02
+
+static void
+print_usage( void )
+{
+	printf( "usage: ibl-baker <environment.hdr> <output.bin> [options]\n"
+	        "  --threads <n>       worker thread count, 0 = all cores\n"
+	        "  --compare <file>    compare against a cache baked on the gpu\n"
+	        "  --tolerance <t>     max relative rmse for --compare "
+	        "(default %.2f)\n"
+	        "  --irradiance <m>    cubemap (default) or sh\n"
+	        "  --cube-format <f>   rgba32f, rgba16f (default) or r11g11b10f\n"
+	        "  --lut-format <f>    rg32f, rg16 (default) or rg16f\n"
+	        "  --quality           error of the storage formats against the "
+	        "32 bit bake\n",
+	        DEFAULT_TOLERANCE );
+}
+
+// rmse relative to the reference rms, printed per map
+static bool
+report_error( enum ibl_map map,
+              const float* result,
+              const float* reference,
+              size_t       count,
+              double       tolerance )
+{
+	double error_sum     = 0.0;
+	double reference_sum = 0.0;
+	double max_error     = 0.0;
+
+	for ( size_t v = 0; v < count; ++v )
+	{
+		double diff = ( double ) result[ v ] - ( double ) reference[ v ];
+		error_sum += diff * diff;
+		reference_sum += ( double ) reference[ v ] * reference[ v ];
+		max_error = FT_MAX( max_error, fabs( diff ) );
+	}
+
+	double rmse     = sqrt( error_sum / ( double ) count );
+	double rms      = sqrt( reference_sum / ( double ) count );
+	double relative = rms > 0.0 ? rmse / rms : rmse;
+	bool   ok       = relative <= tolerance;
+
+	printf( "%-12s rmse %.6f relative %.4f max %.6f %s\n",
+	        ibl_map_name( map ),
+	        rmse,
+	        relative,
+	        max_error,
+	        ok ? "ok" : "FAILED" );
+
+	return ok;
+}
+
+// number of floats an image takes in the 32 bit bake layout
+static size_t
+float_count( const struct ibl_cpu_maps* maps, enum ibl_map map )
+{
+	return maps->layout.images[ map ].size / sizeof( float );
+}
+
+// relative rmse of every map against a gpu baked cache, a missing or
+// mismatched file counts as a failure
+static bool
+compare_with_cache( const struct ibl_cpu_maps* maps,
+                    const char*                filename,
+                    double                     tolerance )
+{
+	struct file_map map;
+
+	if ( !file_map_open( filename, &map ) )
+	{
+		printf( "failed to open %s\n", filename );
+		return false;
+	}
+
+	if ( !ibl_cache_validate( map.data, map.size, &maps->header ) )
+	{
+		printf( "%s was baked from a different source or with different "
+		        "parameters\n",
+		        filename );
+		file_map_close( &map );
+		return false;
+	}
+
+	bool passed = true;
+
+	for ( uint32_t i = 0; i < IBL_MAP_COUNT; ++i )
+	{
+		const struct ibl_cache_image* image = &maps->header.images[ i ];
+
+		float* reference = malloc( float_count( maps, i ) * sizeof( float ) );
+		ibl_format_decode( image->format,
+		                   ( const uint8_t* ) map.data + image->offset,
+		                   image->size / image->texel_size,
+		                   reference );
+
+		passed = report_error( i,
+		                       maps->images[ i ],
+		                       reference,
+		                       float_count( maps, i ),
+		                       tolerance ) &&
+		         passed;
+
+		free( reference );
+	}
+
+	file_map_close( &map );
+
+	return passed;
+}
+
+// what the storage formats cost against the 32 bit bake they are
+// encoded from
+static bool
+check_quality( const struct ibl_cpu_maps* maps, double tolerance )
+{
+	bool passed = true;
+
+	for ( uint32_t i = 0; i < IBL_MAP_COUNT; ++i )
+	{
+		const struct ibl_cache_image* image = &maps->header.images[ i ];
+		size_t texel_count = image->size / image->texel_size;
+
+		void*  encoded = malloc( image->size );
+		float* decoded = malloc( float_count( maps, i ) * sizeof( float ) );
+
+		ibl_format_encode( image->format,
+		                   maps->images[ i ],
+		                   texel_count,
+		                   encoded );
+		ibl_format_decode( image->format, encoded, texel_count, decoded );
+
+		passed = report_error( i,
+		                       decoded,
+		                       maps->images[ i ],
+		                       float_count( maps, i ),
+		                       tolerance ) &&
+		         passed;
+
+		free( decoded );
+		free( encoded );
+	}
+
+	return passed;
+}
+
+int
+main( int argc, char** argv )
+{
+	if ( argc < 3 )
+	{
+		print_usage();
+		return EXIT_FAILURE;
+	}
+
+	const char* input        = argv[ 1 ];
+	const char* output       = argv[ 2 ];
+	const char* compare      = NULL;
+	uint32_t    thread_count = 0;
+	double      tolerance    = DEFAULT_TOLERANCE;
+	uint32_t    irradiance   = IBL_IRRADIANCE_CUBEMAP;
+	uint32_t    cube_format  = DEFAULT_CUBE_FORMAT;
+	uint32_t    lut_format   = DEFAULT_LUT_FORMAT;
+	bool        quality      = false;
+
+	for ( int i = 3; i < argc; ++i )
+	{
+		if ( strcmp( argv[ i ], "--threads" ) == 0 && i + 1 < argc )
+		{
+			thread_count = ( uint32_t ) atoi( argv[ ++i ] );
+		}
+		else if ( strcmp( argv[ i ], "--compare" ) == 0 && i + 1 < argc )
+		{
+			compare = argv[ ++i ];
+		}
+		else if ( strcmp( argv[ i ], "--tolerance" ) == 0 && i + 1 < argc )
+		{
+			tolerance = atof( argv[ ++i ] );
+		}
+		else if ( strcmp( argv[ i ], "--irradiance" ) == 0 && i + 1 < argc )
+		{
+			irradiance = strcmp( argv[ ++i ], "sh" ) == 0
+			                 ? IBL_IRRADIANCE_SH
+			                 : IBL_IRRADIANCE_CUBEMAP;
+		}
+		else if ( strcmp( argv[ i ], "--cube-format" ) == 0 && i + 1 < argc &&
+		          ibl_format_parse( argv[ i + 1 ], &cube_format ) &&
+		          ibl_format_channel_count( cube_format ) == 4 )
+		{
+			++i;
+		}
+		else if ( strcmp( argv[ i ], "--lut-format" ) == 0 && i + 1 < argc &&
+		          ibl_format_parse( argv[ i + 1 ], &lut_format ) &&
+		          ibl_format_channel_count( lut_format ) == 2 )
+		{
+			++i;
+		}
+		else if ( strcmp( argv[ i ], "--quality" ) == 0 )
+		{
+			quality = true;
+		}
+		else
+		{
+			print_usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	struct ibl_bake_params params = {
+	    .skybox_size             = SKYBOX_SIZE,
+	    .irradiance_size         = IRRADIANCE_SIZE,
+	    .specular_size           = SPECULAR_SIZE,
+	    .brdf_lut_size           = BRDF_LUT_SIZE,
+	    .importance_sample_count = IBL_IMPORTANCE_SAMPLE_COUNT,
+	    .irradiance_sample_delta = IBL_IRRADIANCE_SAMPLE_DELTA,
+	    .irradiance_mode         = irradiance,
+	    .cube_format             = cube_format,
+	    .lut_format              = lut_format,
+	};
+
+	struct file_map source;
+	if ( !file_map_open( input, &source ) )
+	{
+		printf( "failed to open %s\n", input );
+		return EXIT_FAILURE;
+	}
+	uint64_t key = ibl_cache_key( source.data, source.size, &params );
+	file_map_close( &source );
+
+	uint32_t width, height;
+	float*   equirect = ft_read_image_from_file( input, &width, &height );
+
+	if ( equirect == NULL )
+	{
+		printf( "failed to decode %s\n", input );
+		return EXIT_FAILURE;
+	}
+
+	job_system_init( thread_count );
+
+	struct ft_timer timer;
+	ft_timer_reset( &timer );
+
+	struct ibl_cpu_maps maps;
+	ibl_cpu_bake( equirect, width, height, key, &params, &maps );
+
+	printf( "baked %s on %u threads in %.2f ms\n",
+	        input,
+	        job_system_get_thread_count(),
+	        ( double ) ft_timer_get_ticks( &timer ) );
+
+	ft_free_image_data( equirect );
+
+	ibl_cache_report( &maps.header );
+
+	bool ok = ibl_cpu_write_cache( &maps, output );
+	if ( !ok )
+	{
+		printf( "failed to write %s\n", output );
+	}
+
+	if ( ok && quality )
+	{
+		ok = check_quality( &maps, tolerance );
+	}
+
+	if ( ok && compare )
+	{
+		ok = compare_with_cache( &maps, compare, tolerance );
+	}
+
+	ibl_cpu_free( &maps );
+	job_system_shutdown();
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,782 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simd.h"
+#include "job_system.h"
+#include "animation_set.h"
+
+#define NO_CHANNEL UINT32_MAX
+
+// channels and targets a job batch takes
+#define CHANNELS_PER_BATCH 256
+#define TARGETS_PER_BATCH  256
+
+// keys stepped over one at a time before the cursor gives up and searches,
+// a frame usually moves a channel by none or one key
+#define CURSOR_STEP_LIMIT 4
+
+static const uint32_t path_components[ ANIMATION_PATH_COUNT ] = {
+	[ANIMATION_PATH_TRANSLATION] = 3,
+	[ANIMATION_PATH_ROTATION]    = 4,
+	[ANIMATION_PATH_SCALE]       = 3,
+};
+
+static const uint32_t path_pose_components[ ANIMATION_PATH_COUNT ] = {
+	[ANIMATION_PATH_TRANSLATION] = ANIMATION_POSE_TX,
+	[ANIMATION_PATH_ROTATION]    = ANIMATION_POSE_RX,
+	[ANIMATION_PATH_SCALE]       = ANIMATION_POSE_SX,
+};
+
+struct evaluate_job
+{
+	struct animation_set* set;
+	float ( *transforms )[ 4 ][ 4 ];
+	uint32_t batch_counts[ ANIMATION_PATH_COUNT ];
+};
+
+static inline uint32_t
+grown_capacity( uint32_t capacity, uint32_t count )
+{
+	uint32_t grown = capacity < 64 ? 64 : capacity * 2;
+	return grown < count ? count : grown;
+}
+
+static void
+reserve_clips( struct animation_set* set, uint32_t count )
+{
+	if ( count <= set->clip_capacity )
+	{
+		return;
+	}
+
+	set->clip_capacity = grown_capacity( set->clip_capacity, count );
+	set->clip_durations =
+	    realloc( set->clip_durations, set->clip_capacity * sizeof( float ) );
+	set->clip_times =
+	    realloc( set->clip_times, set->clip_capacity * sizeof( float ) );
+}
+
+static void
+reserve_targets( struct animation_set* set, uint32_t count )
+{
+	if ( count <= set->target_capacity )
+	{
+		return;
+	}
+
+	uint32_t capacity    = grown_capacity( set->target_capacity, count );
+	set->target_capacity = capacity;
+	set->target_ids =
+	    realloc( set->target_ids, capacity * sizeof( uint32_t ) );
+
+	for ( uint32_t p = 0; p < ANIMATION_PATH_COUNT; ++p )
+	{
+		set->target_channels[ p ] =
+		    realloc( set->target_channels[ p ], capacity * sizeof( uint32_t ) );
+	}
+
+	for ( uint32_t c = 0; c < 3; ++c )
+	{
+		set->offset[ c ] =
+		    realloc( set->offset[ c ], capacity * sizeof( float ) );
+	}
+
+	for ( uint32_t c = 0; c < ANIMATION_POSE_COMPONENT_COUNT; ++c )
+	{
+		set->rest[ c ] = realloc( set->rest[ c ], capacity * sizeof( float ) );
+		set->pose[ c ] = realloc( set->pose[ c ], capacity * sizeof( float ) );
+	}
+}
+
+static void
+reserve_channels( struct animation_channels* channels, uint32_t count )
+{
+	if ( count <= channels->capacity )
+	{
+		return;
+	}
+
+	uint32_t capacity  = grown_capacity( channels->capacity, count );
+	size_t   size      = capacity * sizeof( uint32_t );
+	channels->capacity = capacity;
+	channels->target    = realloc( channels->target, size );
+	channels->clip      = realloc( channels->clip, size );
+	channels->first_key = realloc( channels->first_key, size );
+	channels->key_count = realloc( channels->key_count, size );
+	channels->cursor    = realloc( channels->cursor, size );
+}
+
+static void
+reserve_keys( struct animation_channels* channels, uint32_t count )
+{
+	if ( count <= channels->key_capacity )
+	{
+		return;
+	}
+
+	uint32_t capacity      = grown_capacity( channels->key_capacity, count );
+	channels->key_capacity = capacity;
+	channels->times =
+	    realloc( channels->times, capacity * sizeof( float ) );
+
+	for ( uint32_t c = 0; c < 4; ++c )
+	{
+		channels->values[ c ] =
+		    realloc( channels->values[ c ], capacity * sizeof( float ) );
+	}
+}
+
+// translation, rotation and scale of a column major transform. a
+// mirroring transform gets a negative x scale
+static void
+decompose_transform( const float m[ 4 ][ 4 ],
+                     float       pose[ ANIMATION_POSE_COMPONENT_COUNT ] )
+{
+	pose[ ANIMATION_POSE_TX ] = m[ 3 ][ 0 ];
+	pose[ ANIMATION_POSE_TY ] = m[ 3 ][ 1 ];
+	pose[ ANIMATION_POSE_TZ ] = m[ 3 ][ 2 ];
+
+	float s[ 3 ];
+	for ( uint32_t c = 0; c < 3; ++c )
+	{
+		s[ c ] = sqrtf( m[ c ][ 0 ] * m[ c ][ 0 ] + m[ c ][ 1 ] * m[ c ][ 1 ] +
+		                m[ c ][ 2 ] * m[ c ][ 2 ] );
+	}
+
+	float det = m[ 0 ][ 0 ] * ( m[ 1 ][ 1 ] * m[ 2 ][ 2 ] -
+	                            m[ 2 ][ 1 ] * m[ 1 ][ 2 ] ) -
+	            m[ 1 ][ 0 ] * ( m[ 0 ][ 1 ] * m[ 2 ][ 2 ] -
+	                            m[ 2 ][ 1 ] * m[ 0 ][ 2 ] ) +
+	            m[ 2 ][ 0 ] * ( m[ 0 ][ 1 ] * m[ 1 ][ 2 ] -
+	                            m[ 1 ][ 1 ] * m[ 0 ][ 2 ] );
+	if ( det < 0.0f )
+	{
+		s[ 0 ] = -s[ 0 ];
+	}
+
+	// r[ row ][ column ] of the rotation left once the scale is divided out
+	float r[ 3 ][ 3 ];
+	for ( uint32_t c = 0; c < 3; ++c )
+	{
+		float inverse = s[ c ] != 0.0f ? 1.0f / s[ c ] : 0.0f;
+		for ( uint32_t row = 0; row < 3; ++row )
+		{
+			r[ row ][ c ] = m[ c ][ row ] * inverse;
+		}
+	}
+
+	float x, y, z, w;
+	float trace = r[ 0 ][ 0 ] + r[ 1 ][ 1 ] + r[ 2 ][ 2 ];
+	if ( trace > 0.0f )
+	{
+		float k = 0.5f / sqrtf( trace + 1.0f );
+		w       = 0.25f / k;
+		x       = ( r[ 2 ][ 1 ] - r[ 1 ][ 2 ] ) * k;
+		y       = ( r[ 0 ][ 2 ] - r[ 2 ][ 0 ] ) * k;
+		z       = ( r[ 1 ][ 0 ] - r[ 0 ][ 1 ] ) * k;
+	}
+	else if ( r[ 0 ][ 0 ] > r[ 1 ][ 1 ] && r[ 0 ][ 0 ] > r[ 2 ][ 2 ] )
+	{
+		float k =
+		    2.0f * sqrtf( 1.0f + r[ 0 ][ 0 ] - r[ 1 ][ 1 ] - r[ 2 ][ 2 ] );
+		w       = ( r[ 2 ][ 1 ] - r[ 1 ][ 2 ] ) / k;
+		x       = 0.25f * k;
+		y       = ( r[ 0 ][ 1 ] + r[ 1 ][ 0 ] ) / k;
+		z       = ( r[ 0 ][ 2 ] + r[ 2 ][ 0 ] ) / k;
+	}
+	else if ( r[ 1 ][ 1 ] > r[ 2 ][ 2 ] )
+	{
+		float k =
+		    2.0f * sqrtf( 1.0f + r[ 1 ][ 1 ] - r[ 0 ][ 0 ] - r[ 2 ][ 2 ] );
+		w       = ( r[ 0 ][ 2 ] - r[ 2 ][ 0 ] ) / k;
+		x       = ( r[ 0 ][ 1 ] + r[ 1 ][ 0 ] ) / k;
+		y       = 0.25f * k;
+		z       = ( r[ 1 ][ 2 ] + r[ 2 ][ 1 ] ) / k;
+	}
+	else
+	{
+		float k =
+		    2.0f * sqrtf( 1.0f + r[ 2 ][ 2 ] - r[ 0 ][ 0 ] - r[ 1 ][ 1 ] );
+		w       = ( r[ 1 ][ 0 ] - r[ 0 ][ 1 ] ) / k;
+		x       = ( r[ 0 ][ 2 ] + r[ 2 ][ 0 ] ) / k;
+		y       = ( r[ 1 ][ 2 ] + r[ 2 ][ 1 ] ) / k;
+		z       = 0.25f * k;
+	}
+
+	pose[ ANIMATION_POSE_RX ] = x;
+	pose[ ANIMATION_POSE_RY ] = y;
+	pose[ ANIMATION_POSE_RZ ] = z;
+	pose[ ANIMATION_POSE_RW ] = w;
+	pose[ ANIMATION_POSE_SX ] = s[ 0 ];
+	pose[ ANIMATION_POSE_SY ] = s[ 1 ];
+	pose[ ANIMATION_POSE_SZ ] = s[ 2 ];
+}
+
+void
+animation_set_init( struct animation_set* set )
+{
+	memset( set, 0, sizeof( *set ) );
+}
+
+void
+animation_set_shutdown( struct animation_set* set )
+{
+	free( set->clip_durations );
+	free( set->clip_times );
+	free( set->target_ids );
+
+	for ( uint32_t p = 0; p < ANIMATION_PATH_COUNT; ++p )
+	{
+		struct animation_channels* channels = &set->channels[ p ];
+
+		free( set->target_channels[ p ] );
+		free( channels->target );
+		free( channels->clip );
+		free( channels->first_key );
+		free( channels->key_count );
+		free( channels->cursor );
+		free( channels->times );
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			free( channels->values[ c ] );
+		}
+	}
+
+	for ( uint32_t c = 0; c < 3; ++c )
+	{
+		free( set->offset[ c ] );
+	}
+
+	for ( uint32_t c = 0; c < ANIMATION_POSE_COMPONENT_COUNT; ++c )
+	{
+		free( set->rest[ c ] );
+		free( set->pose[ c ] );
+	}
+
+	memset( set, 0, sizeof( *set ) );
+}
+
+void
+animation_set_clear( struct animation_set* set )
+{
+	set->clip_count   = 0;
+	set->target_count = 0;
+
+	for ( uint32_t p = 0; p < ANIMATION_PATH_COUNT; ++p )
+	{
+		set->channels[ p ].count      = 0;
+		set->channels[ p ].total_keys = 0;
+	}
+}
+
+uint32_t
+animation_set_add_clip( struct animation_set* set )
+{
+	reserve_clips( set, set->clip_count + 1 );
+
+	uint32_t clip               = set->clip_count++;
+	set->clip_durations[ clip ] = 0.0f;
+	set->clip_times[ clip ]     = 0.0f;
+
+	return clip;
+}
+
+uint32_t
+animation_set_add_target( struct animation_set* set,
+                          uint32_t              id,
+                          const float           rest[ 4 ][ 4 ],
+                          const float*          offset )
+{
+	reserve_targets( set, set->target_count + 1 );
+
+	uint32_t target           = set->target_count++;
+	set->target_ids[ target ] = id;
+
+	for ( uint32_t p = 0; p < ANIMATION_PATH_COUNT; ++p )
+	{
+		set->target_channels[ p ][ target ] = NO_CHANNEL;
+	}
+
+	for ( uint32_t c = 0; c < 3; ++c )
+	{
+		set->offset[ c ][ target ] = offset ? offset[ c ] : 0.0f;
+	}
+
+	float pose[ ANIMATION_POSE_COMPONENT_COUNT ];
+	decompose_transform( rest, pose );
+
+	for ( uint32_t c = 0; c < ANIMATION_POSE_COMPONENT_COUNT; ++c )
+	{
+		set->rest[ c ][ target ] = pose[ c ];
+	}
+
+	return target;
+}
+
+void
+animation_set_add_channel( struct animation_set* set,
+                           uint32_t              clip,
+                           uint32_t              target,
+                           enum animation_path   path,
+                           const float*          times,
+                           const float*          values,
+                           uint32_t              key_count )
+{
+	if ( key_count == 0 )
+	{
+		return;
+	}
+
+	struct animation_channels* channels = &set->channels[ path ];
+	uint32_t                   components = path_components[ path ];
+
+	// a replaced channel leaves its keys behind until the set is cleared
+	uint32_t channel = set->target_channels[ path ][ target ];
+	if ( channel == NO_CHANNEL )
+	{
+		reserve_channels( channels, channels->count + 1 );
+		channel                             = channels->count++;
+		set->target_channels[ path ][ target ] = channel;
+	}
+
+	reserve_keys( channels, channels->total_keys + key_count );
+
+	uint32_t first_key = channels->total_keys;
+	channels->total_keys += key_count;
+
+	channels->target[ channel ]    = target;
+	channels->clip[ channel ]      = clip;
+	channels->first_key[ channel ] = first_key;
+	channels->key_count[ channel ] = key_count;
+	channels->cursor[ channel ]    = 0;
+
+	memcpy( &channels->times[ first_key ], times, key_count * sizeof( float ) );
+
+	for ( uint32_t k = 0; k < key_count; ++k )
+	{
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			channels->values[ c ][ first_key + k ] =
+			    c < components ? values[ k * components + c ] : 0.0f;
+		}
+	}
+
+	float end = times[ key_count - 1 ];
+	if ( end > set->clip_durations[ clip ] )
+	{
+		set->clip_durations[ clip ] = end;
+	}
+}
+
+// the two keys around time and how far between them it is. the search
+// starts at the cursor and only falls back to a binary search when time
+// went backwards or skipped several keys
+static inline void
+find_keys( struct animation_channels* channels,
+           uint32_t                   channel,
+           float                      time,
+           uint32_t*                  a,
+           uint32_t*                  b,
+           float*                     alpha )
+{
+	uint32_t     first = channels->first_key[ channel ];
+	uint32_t     count = channels->key_count[ channel ];
+	const float* times = &channels->times[ first ];
+
+	*alpha = 0.0f;
+
+	if ( count == 1 || time <= times[ 0 ] )
+	{
+		*a = first;
+		*b = first;
+		return;
+	}
+
+	if ( time >= times[ count - 1 ] )
+	{
+		*a = first + count - 1;
+		*b = first + count - 1;
+		return;
+	}
+
+	// times[ key ] <= time < times[ key + 1 ] from here on
+	uint32_t key   = channels->cursor[ channel ];
+	bool     found = false;
+
+	if ( key + 1 < count && times[ key ] <= time )
+	{
+		for ( uint32_t step = 0; step < CURSOR_STEP_LIMIT; ++step )
+		{
+			if ( time < times[ key + 1 ] )
+			{
+				found = true;
+				break;
+			}
+			++key;
+		}
+	}
+
+	if ( !found )
+	{
+		uint32_t low  = 0;
+		uint32_t high = count - 1;
+		while ( high - low > 1 )
+		{
+			uint32_t middle = low + ( high - low ) / 2;
+			if ( times[ middle ] <= time )
+			{
+				low = middle;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+		key = low;
+	}
+
+	channels->cursor[ channel ] = key;
+
+	*a     = first + key;
+	*b     = first + key + 1;
+	*alpha = ( time - times[ key ] ) / ( times[ key + 1 ] - times[ key ] );
+}
+
+// slerp approximated by a normalized lerp whose t is bent by a polynomial
+// fit in the angle between the quaternions, after David Eberly and Arseny
+// Kapoulkine. b is flipped onto a's hemisphere for the short way round
+static inline void
+slerp_lanes( const float a[ 4 ][ SIMD_WIDTH ],
+             const float b[ 4 ][ SIMD_WIDTH ],
+             const float alpha[ SIMD_WIDTH ],
+             float       out[ 4 ][ SIMD_WIDTH ] )
+{
+	simd_float zero = simd_set1( 0.0f );
+	simd_float va[ 4 ], vb[ 4 ];
+	simd_float dot = zero;
+
+	for ( uint32_t c = 0; c < 4; ++c )
+	{
+		va[ c ] = simd_load( a[ c ] );
+		vb[ c ] = simd_load( b[ c ] );
+		dot     = simd_madd( va[ c ], vb[ c ], dot );
+	}
+
+	simd_float flip = simd_cmpgt( zero, dot );
+	simd_float d    = simd_abs( dot );
+
+	simd_float fit_a = simd_madd(
+	    d,
+	    simd_madd( d,
+	               simd_sub( simd_set1( 3.55645f ),
+	                         simd_mul( d, simd_set1( 1.43519f ) ) ),
+	               simd_set1( -3.2452f ) ),
+	    simd_set1( 1.0904f ) );
+	simd_float fit_b = simd_madd(
+	    d,
+	    simd_madd( d, simd_set1( 0.215638f ), simd_set1( -1.06021f ) ),
+	    simd_set1( 0.848013f ) );
+
+	simd_float t    = simd_load( alpha );
+	simd_float half = simd_sub( t, simd_set1( 0.5f ) );
+	simd_float k    = simd_madd( simd_mul( fit_a, half ), half, fit_b );
+	simd_float bent = simd_madd(
+	    simd_mul( simd_mul( t, half ), simd_sub( t, simd_set1( 1.0f ) ) ),
+	    k,
+	    t );
+
+	simd_float length = zero;
+	simd_float r[ 4 ];
+	for ( uint32_t c = 0; c < 4; ++c )
+	{
+		simd_float bc = simd_select( flip, simd_sub( zero, vb[ c ] ), vb[ c ] );
+		r[ c ]        = simd_madd( simd_sub( bc, va[ c ] ), bent, va[ c ] );
+		length        = simd_madd( r[ c ], r[ c ], length );
+	}
+
+	length = simd_sqrt( length );
+	for ( uint32_t c = 0; c < 4; ++c )
+	{
+		simd_store( out[ c ], simd_div( r[ c ], length ) );
+	}
+}
+
+static inline void
+lerp_lanes( const float a[ 4 ][ SIMD_WIDTH ],
+            const float b[ 4 ][ SIMD_WIDTH ],
+            const float alpha[ SIMD_WIDTH ],
+            float       out[ 4 ][ SIMD_WIDTH ] )
+{
+	simd_float t = simd_load( alpha );
+
+	for ( uint32_t c = 0; c < 3; ++c )
+	{
+		simd_float va = simd_load( a[ c ] );
+		simd_float vb = simd_load( b[ c ] );
+		simd_store( out[ c ], simd_madd( simd_sub( vb, va ), t, va ) );
+	}
+}
+
+// the keys of SIMD_WIDTH channels are gathered into lanes, blended
+// together and scattered to the pose of their targets. unused lanes blend
+// identity quaternions so they stay finite
+static void
+evaluate_channels( struct animation_set* set,
+                   enum animation_path   path,
+                   uint32_t              begin,
+                   uint32_t              end )
+{
+	struct animation_channels* channels   = &set->channels[ path ];
+	uint32_t                   components = path_components[ path ];
+	float** pose = &set->pose[ path_pose_components[ path ] ];
+
+	float a[ 4 ][ SIMD_WIDTH ];
+	float b[ 4 ][ SIMD_WIDTH ];
+	float alpha[ SIMD_WIDTH ];
+	float out[ 4 ][ SIMD_WIDTH ];
+
+	for ( uint32_t base = begin; base < end; base += SIMD_WIDTH )
+	{
+		uint32_t lanes = end - base < SIMD_WIDTH ? end - base : SIMD_WIDTH;
+
+		for ( uint32_t lane = 0; lane < SIMD_WIDTH; ++lane )
+		{
+			if ( lane >= lanes )
+			{
+				for ( uint32_t c = 0; c < 4; ++c )
+				{
+					a[ c ][ lane ] = c == 3 ? 1.0f : 0.0f;
+					b[ c ][ lane ] = c == 3 ? 1.0f : 0.0f;
+				}
+				alpha[ lane ] = 0.0f;
+				continue;
+			}
+
+			uint32_t channel = base + lane;
+			float    time    = set->clip_times[ channels->clip[ channel ] ];
+			uint32_t key_a, key_b;
+			find_keys( channels,
+			           channel,
+			           time,
+			           &key_a,
+			           &key_b,
+			           &alpha[ lane ] );
+
+			for ( uint32_t c = 0; c < 4; ++c )
+			{
+				a[ c ][ lane ] = channels->values[ c ][ key_a ];
+				b[ c ][ lane ] = channels->values[ c ][ key_b ];
+			}
+		}
+
+		if ( path == ANIMATION_PATH_ROTATION )
+		{
+			slerp_lanes( a, b, alpha, out );
+		}
+		else
+		{
+			lerp_lanes( a, b, alpha, out );
+		}
+
+		for ( uint32_t lane = 0; lane < lanes; ++lane )
+		{
+			uint32_t target = channels->target[ base + lane ];
+			for ( uint32_t c = 0; c < components; ++c )
+			{
+				pose[ c ][ target ] = out[ c ][ lane ];
+			}
+		}
+	}
+}
+
+// pose to column major transforms, SIMD_WIDTH targets at a time
+static void
+compose_targets( struct animation_set* set,
+                 float ( *transforms )[ 4 ][ 4 ],
+                 uint32_t begin,
+                 uint32_t end )
+{
+	float lanes_in[ ANIMATION_POSE_COMPONENT_COUNT ][ SIMD_WIDTH ];
+	float offset[ 3 ][ SIMD_WIDTH ];
+	float m[ 3 ][ 3 ][ SIMD_WIDTH ];
+
+	memset( lanes_in, 0, sizeof( lanes_in ) );
+	memset( offset, 0, sizeof( offset ) );
+
+	for ( uint32_t base = begin; base < end; base += SIMD_WIDTH )
+	{
+		uint32_t lanes = end - base < SIMD_WIDTH ? end - base : SIMD_WIDTH;
+
+		for ( uint32_t c = 0; c < ANIMATION_POSE_COMPONENT_COUNT; ++c )
+		{
+			memcpy( lanes_in[ c ],
+			        &set->pose[ c ][ base ],
+			        lanes * sizeof( float ) );
+		}
+
+		for ( uint32_t c = 0; c < 3; ++c )
+		{
+			memcpy( offset[ c ],
+			        &set->offset[ c ][ base ],
+			        lanes * sizeof( float ) );
+
+			simd_float t = simd_add(
+			    simd_load( lanes_in[ ANIMATION_POSE_TX + c ] ),
+			    simd_load( offset[ c ] ) );
+			simd_store( lanes_in[ ANIMATION_POSE_TX + c ], t );
+		}
+
+		simd_float x  = simd_load( lanes_in[ ANIMATION_POSE_RX ] );
+		simd_float y  = simd_load( lanes_in[ ANIMATION_POSE_RY ] );
+		simd_float z  = simd_load( lanes_in[ ANIMATION_POSE_RZ ] );
+		simd_float w  = simd_load( lanes_in[ ANIMATION_POSE_RW ] );
+		simd_float sx = simd_load( lanes_in[ ANIMATION_POSE_SX ] );
+		simd_float sy = simd_load( lanes_in[ ANIMATION_POSE_SY ] );
+		simd_float sz = simd_load( lanes_in[ ANIMATION_POSE_SZ ] );
+
+		simd_float one = simd_set1( 1.0f );
+		simd_float two = simd_set1( 2.0f );
+		simd_float xx  = simd_mul( x, x );
+		simd_float yy  = simd_mul( y, y );
+		simd_float zz  = simd_mul( z, z );
+		simd_float xy  = simd_mul( x, y );
+		simd_float xz  = simd_mul( x, z );
+		simd_float yz  = simd_mul( y, z );
+		simd_float wx  = simd_mul( w, x );
+		simd_float wy  = simd_mul( w, y );
+		simd_float wz  = simd_mul( w, z );
+
+		simd_float columns[ 3 ][ 3 ] = {
+			{ simd_sub( one, simd_mul( two, simd_add( yy, zz ) ) ),
+			  simd_mul( two, simd_add( xy, wz ) ),
+			  simd_mul( two, simd_sub( xz, wy ) ) },
+			{ simd_mul( two, simd_sub( xy, wz ) ),
+			  simd_sub( one, simd_mul( two, simd_add( xx, zz ) ) ),
+			  simd_mul( two, simd_add( yz, wx ) ) },
+			{ simd_mul( two, simd_add( xz, wy ) ),
+			  simd_mul( two, simd_sub( yz, wx ) ),
+			  simd_sub( one, simd_mul( two, simd_add( xx, yy ) ) ) },
+		};
+		simd_float scale[ 3 ] = { sx, sy, sz };
+
+		for ( uint32_t c = 0; c < 3; ++c )
+		{
+			for ( uint32_t row = 0; row < 3; ++row )
+			{
+				simd_store( m[ c ][ row ],
+				            simd_mul( columns[ c ][ row ], scale[ c ] ) );
+			}
+		}
+
+		for ( uint32_t lane = 0; lane < lanes; ++lane )
+		{
+			uint32_t id  = set->target_ids[ base + lane ];
+			float*   dst = &transforms[ id ][ 0 ][ 0 ];
+
+			for ( uint32_t c = 0; c < 3; ++c )
+			{
+				dst[ c * 4 + 0 ] = m[ c ][ 0 ][ lane ];
+				dst[ c * 4 + 1 ] = m[ c ][ 1 ][ lane ];
+				dst[ c * 4 + 2 ] = m[ c ][ 2 ][ lane ];
+				dst[ c * 4 + 3 ] = 0.0f;
+			}
+			dst[ 12 ] = lanes_in[ ANIMATION_POSE_TX ][ lane ];
+			dst[ 13 ] = lanes_in[ ANIMATION_POSE_TY ][ lane ];
+			dst[ 14 ] = lanes_in[ ANIMATION_POSE_TZ ][ lane ];
+			dst[ 15 ] = 1.0f;
+		}
+	}
+}
+
+static void
+evaluate_channel_batches( void* user_data, uint32_t begin, uint32_t end )
+{
+	struct evaluate_job* job = user_data;
+
+	for ( uint32_t batch = begin; batch < end; ++batch )
+	{
+		// batches are numbered through the paths one after another
+		uint32_t path  = 0;
+		uint32_t local = batch;
+		while ( local >= job->batch_counts[ path ] )
+		{
+			local -= job->batch_counts[ path ];
+			++path;
+		}
+
+		uint32_t count = job->set->channels[ path ].count;
+		uint32_t first = local * CHANNELS_PER_BATCH;
+		uint32_t last  = first + CHANNELS_PER_BATCH;
+
+		evaluate_channels( job->set, path, first, last < count ? last : count );
+	}
+}
+
+static void
+compose_target_range( void* user_data, uint32_t begin, uint32_t end )
+{
+	struct evaluate_job* job = user_data;
+
+	compose_targets( job->set, job->transforms, begin, end );
+}
+
+void
+animation_set_evaluate( struct animation_set* set,
+                        float                 time,
+                        float ( *transforms )[ 4 ][ 4 ],
+                        bool                  parallel )
+{
+	for ( uint32_t clip = 0; clip < set->clip_count; ++clip )
+	{
+		float duration = set->clip_durations[ clip ];
+		set->clip_times[ clip ] =
+		    duration > 0.0f ? fmodf( time, duration ) : 0.0f;
+	}
+
+	for ( uint32_t c = 0; c < ANIMATION_POSE_COMPONENT_COUNT; ++c )
+	{
+		memcpy( set->pose[ c ],
+		        set->rest[ c ],
+		        set->target_count * sizeof( float ) );
+	}
+
+	struct evaluate_job job = {
+		.set        = set,
+		.transforms = transforms,
+	};
+
+	uint32_t batch_count = 0;
+	for ( uint32_t p = 0; p < ANIMATION_PATH_COUNT; ++p )
+	{
+		uint32_t count = set->channels[ p ].count;
+		job.batch_counts[ p ] =
+		    ( count + CHANNELS_PER_BATCH - 1 ) / CHANNELS_PER_BATCH;
+		batch_count += job.batch_counts[ p ];
+	}
+
+	// every target and path has at most one channel, so no two batches
+	// write the same pose component of a target
+	if ( parallel )
+	{
+		if ( batch_count != 0 )
+		{
+			job_system_parallel_for( batch_count,
+			                         1,
+			                         evaluate_channel_batches,
+			                         &job );
+		}
+		if ( set->target_count != 0 )
+		{
+			job_system_parallel_for( set->target_count,
+			                         TARGETS_PER_BATCH,
+			                         compose_target_range,
+			                         &job );
+		}
+	}
+	else
+	{
+		evaluate_channel_batches( &job, 0, batch_count );
+		compose_targets( set, transforms, 0, set->target_count );
+	}
+}
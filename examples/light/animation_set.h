@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// translation and scale keys hold 3 floats, rotation keys a quaternion as
+// x y z w
+enum animation_path
+{
+	ANIMATION_PATH_TRANSLATION,
+	ANIMATION_PATH_ROTATION,
+	ANIMATION_PATH_SCALE,
+	ANIMATION_PATH_COUNT,
+};
+
+// components of a pose, one array each over the targets
+enum animation_pose_component
+{
+	ANIMATION_POSE_TX,
+	ANIMATION_POSE_TY,
+	ANIMATION_POSE_TZ,
+	ANIMATION_POSE_RX,
+	ANIMATION_POSE_RY,
+	ANIMATION_POSE_RZ,
+	ANIMATION_POSE_RW,
+	ANIMATION_POSE_SX,
+	ANIMATION_POSE_SY,
+	ANIMATION_POSE_SZ,
+	ANIMATION_POSE_COMPONENT_COUNT,
+};
+
+// the channels of one path. every array is over the channels except
+// times and values, which are over the keys and hold the keys of a channel
+// from first_key on. cursor is the key the last evaluation stopped at,
+// time mostly moves forward so the next one starts looking there
+struct animation_channels
+{
+	uint32_t  count;
+	uint32_t  capacity;
+	uint32_t* target;
+	uint32_t* clip;
+	uint32_t* first_key;
+	uint32_t* key_count;
+	uint32_t* cursor;
+
+	uint32_t total_keys;
+	uint32_t key_capacity;
+	float*   times;
+	float*   values[ 4 ];
+};
+
+// every animated target of a scene with the channels that move it. a
+// target starts each evaluation from its rest pose, the channels write
+// over the parts they animate and the pose is turned into the target's
+// transform, moved by its offset. clips loop over the last key time of
+// their channels
+struct animation_set
+{
+	uint32_t clip_count;
+	uint32_t clip_capacity;
+	float*   clip_durations;
+	float*   clip_times;
+
+	uint32_t  target_count;
+	uint32_t  target_capacity;
+	uint32_t* target_ids;
+	uint32_t* target_channels[ ANIMATION_PATH_COUNT ];
+	float*    offset[ 3 ];
+	float*    rest[ ANIMATION_POSE_COMPONENT_COUNT ];
+	float*    pose[ ANIMATION_POSE_COMPONENT_COUNT ];
+
+	struct animation_channels channels[ ANIMATION_PATH_COUNT ];
+};
+
+void
+animation_set_init( struct animation_set* set );
+
+void
+animation_set_shutdown( struct animation_set* set );
+
+// drops every clip, target and channel but keeps the memory
+void
+animation_set_clear( struct animation_set* set );
+
+uint32_t
+animation_set_add_clip( struct animation_set* set );
+
+// id is where evaluate writes the target's transform, rest is the column
+// major transform it has when nothing animates it. offset is added to the
+// translation after the channels, for copies of a model placed somewhere
+// else, NULL for none
+uint32_t
+animation_set_add_target( struct animation_set* set,
+                          uint32_t              id,
+                          const float           rest[ 4 ][ 4 ],
+                          const float*          offset );
+
+// times are ascending seconds, values are packed as the path describes.
+// a channel on a target and path that already has one replaces it, the
+// way the last of several animations applied in a row would win
+void
+animation_set_add_channel( struct animation_set* set,
+                           uint32_t              clip,
+                           uint32_t              target,
+                           enum animation_path   path,
+                           const float*          times,
+                           const float*          values,
+                           uint32_t              key_count );
+
+// samples every channel at time and writes the transform of each target
+// to transforms[ id ]. rotations use a corrected normalized lerp, which
+// stays within a thousandth of a radian of slerp. runs on the job system
+// when parallel is set
+void
+animation_set_evaluate( struct animation_set* set,
+                        float                 time,
+                        float ( *transforms )[ 4 ][ 4 ],
+                        bool                  parallel );
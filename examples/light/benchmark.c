@@ -0,0 +1,295 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchmark.h"
+
+#define BENCHMARK_PI 3.14159265358979f
+
+static const char* metric_names[ BENCHMARK_METRIC_COUNT ] = {
+    [BENCHMARK_METRIC_CPU]    = "cpu",
+    [BENCHMARK_METRIC_RECORD] = "record",
+    [BENCHMARK_METRIC_GPU]    = "gpu",
+};
+
+void
+benchmark_init( struct benchmark* bench,
+                uint32_t          frame_count,
+                uint32_t          warmup_count )
+{
+	bench->frame_count  = frame_count;
+	bench->warmup_count = warmup_count;
+	bench->frame        = 0;
+	bench->frames = calloc( frame_count, sizeof( struct benchmark_frame ) );
+}
+
+void
+benchmark_shutdown( struct benchmark* bench )
+{
+	free( bench->frames );
+	memset( bench, 0, sizeof( *bench ) );
+}
+
+bool
+benchmark_running( const struct benchmark* bench )
+{
+	return bench->frame < bench->warmup_count + bench->frame_count;
+}
+
+void
+benchmark_add_frame( struct benchmark*             bench,
+                     const struct benchmark_frame* frame )
+{
+	if ( !benchmark_running( bench ) )
+	{
+		return;
+	}
+
+	if ( bench->frame >= bench->warmup_count )
+	{
+		bench->frames[ bench->frame - bench->warmup_count ] = *frame;
+	}
+
+	bench->frame++;
+}
+
+void
+benchmark_camera( const struct benchmark* bench,
+                  const float             bounds_min[ 3 ],
+                  const float             bounds_max[ 3 ],
+                  float                   position[ 3 ],
+                  float                   direction[ 3 ] )
+{
+	float center[ 3 ];
+	float extent = 0.0f;
+
+	for ( uint32_t a = 0; a < 3; ++a )
+	{
+		float half  = ( bounds_max[ a ] - bounds_min[ a ] ) * 0.5f;
+		center[ a ] = bounds_min[ a ] + half;
+		extent += half * half;
+	}
+
+	// warmup frames fly the start of the path again
+	uint32_t total = bench->warmup_count + bench->frame_count;
+	float    t     = total > 1 ? ( float ) bench->frame / ( total - 1 ) : 0.0f;
+	float    angle = 2.0f * BENCHMARK_PI * t;
+	float    radius =
+	    ( sqrtf( extent ) * 1.1f + 1.0f ) *
+	    ( 1.0f - 0.35f * sinf( 4.0f * BENCHMARK_PI * t ) );
+
+	position[ 0 ] = center[ 0 ] + sinf( angle ) * radius;
+	position[ 1 ] = center[ 1 ] + radius * 0.25f;
+	position[ 2 ] = center[ 2 ] + cosf( angle ) * radius;
+
+	float length = 0.0f;
+
+	for ( uint32_t a = 0; a < 3; ++a )
+	{
+		direction[ a ] = center[ a ] - position[ a ];
+		length += direction[ a ] * direction[ a ];
+	}
+
+	length = sqrtf( length );
+
+	for ( uint32_t a = 0; a < 3; ++a )
+	{
+		direction[ a ] /= length;
+	}
+}
+
+static int
+compare_ns( const void* a, const void* b )
+{
+	uint64_t lhs = *( const uint64_t* ) a;
+	uint64_t rhs = *( const uint64_t* ) b;
+
+	return ( lhs > rhs ) - ( lhs < rhs );
+}
+
+static double
+percentile_ms( const uint64_t* sorted, uint32_t count, uint32_t percent )
+{
+	uint32_t rank = ( count * percent + 99 ) / 100;
+	return ( double ) sorted[ rank != 0 ? rank - 1 : 0 ] / 1e6;
+}
+
+void
+benchmark_summarize( const struct benchmark*   bench,
+                     enum benchmark_metric     metric,
+                     struct benchmark_summary* summary )
+{
+	memset( summary, 0, sizeof( *summary ) );
+
+	uint32_t count = bench->frame > bench->warmup_count
+	                     ? bench->frame - bench->warmup_count
+	                     : 0;
+
+	if ( count == 0 )
+	{
+		return;
+	}
+
+	uint64_t* sorted = malloc( count * sizeof( uint64_t ) );
+	uint64_t  total  = 0;
+
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		sorted[ i ] = bench->frames[ i ].ns[ metric ];
+		total += sorted[ i ];
+	}
+
+	qsort( sorted, count, sizeof( uint64_t ), compare_ns );
+
+	summary->average_ms = ( double ) total / count / 1e6;
+	summary->p50_ms     = percentile_ms( sorted, count, 50 );
+	summary->p95_ms     = percentile_ms( sorted, count, 95 );
+	summary->p99_ms     = percentile_ms( sorted, count, 99 );
+	summary->max_ms     = ( double ) sorted[ count - 1 ] / 1e6;
+
+	free( sorted );
+}
+
+static bool
+has_extension( const char* path, const char* extension )
+{
+	size_t length           = strlen( path );
+	size_t extension_length = strlen( extension );
+
+	return length >= extension_length &&
+	       strcmp( path + length - extension_length, extension ) == 0;
+}
+
+static void
+write_json( FILE*                         file,
+            const struct benchmark*       bench,
+            const struct benchmark_scene* scene,
+            uint32_t                      count )
+{
+	fprintf( file,
+	         "{\n  \"scene\": {\"models\": %u, \"draws\": %u, "
+	         "\"instances\": %u, \"grid\": [%u, %u], \"culling\": \"%s\", "
+	         "\"submit\": \"%s\"},\n",
+	         scene->model_count,
+	         scene->draw_count,
+	         scene->instance_count,
+	         scene->grid_columns,
+	         scene->grid_rows,
+	         scene->culling,
+	         scene->submit );
+	fprintf( file,
+	         "  \"warmup_frames\": %u,\n  \"frame_count\": %u,\n"
+	         "  \"gpu_timing\": \"%s\",\n",
+	         bench->warmup_count,
+	         count,
+	         scene->gpu_timing );
+
+	fprintf( file, "  \"summary\": {" );
+	for ( uint32_t m = 0; m < BENCHMARK_METRIC_COUNT; ++m )
+	{
+		struct benchmark_summary summary;
+		benchmark_summarize( bench, m, &summary );
+
+		fprintf( file,
+		         "%s\n    \"%s_ms\": {\"average\": %.4f, \"p50\": %.4f, "
+		         "\"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+		         m == 0 ? "" : ",",
+		         metric_names[ m ],
+		         summary.average_ms,
+		         summary.p50_ms,
+		         summary.p95_ms,
+		         summary.p99_ms,
+		         summary.max_ms );
+	}
+	fprintf( file, "\n  },\n" );
+
+	fprintf( file, "  \"frames\": [" );
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		const uint64_t* ns = bench->frames[ i ].ns;
+
+		fprintf( file,
+		         "%s\n    [%.4f, %.4f, %.4f]",
+		         i == 0 ? "" : ",",
+		         ( double ) ns[ BENCHMARK_METRIC_CPU ] / 1e6,
+		         ( double ) ns[ BENCHMARK_METRIC_RECORD ] / 1e6,
+		         ( double ) ns[ BENCHMARK_METRIC_GPU ] / 1e6 );
+	}
+	fprintf( file, "\n  ],\n  \"frame_columns\": " );
+	fprintf( file, "[\"cpu_ms\", \"record_ms\", \"gpu_ms\"]\n}\n" );
+}
+
+static void
+write_csv( FILE* file, const struct benchmark* bench, uint32_t count )
+{
+	fprintf( file, "frame,cpu_ms,record_ms,gpu_ms\n" );
+
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		const uint64_t* ns = bench->frames[ i ].ns;
+
+		fprintf( file,
+		         "%u,%.4f,%.4f,%.4f\n",
+		         i,
+		         ( double ) ns[ BENCHMARK_METRIC_CPU ] / 1e6,
+		         ( double ) ns[ BENCHMARK_METRIC_RECORD ] / 1e6,
+		         ( double ) ns[ BENCHMARK_METRIC_GPU ] / 1e6 );
+	}
+
+	struct benchmark_summary summaries[ BENCHMARK_METRIC_COUNT ];
+	for ( uint32_t m = 0; m < BENCHMARK_METRIC_COUNT; ++m )
+	{
+		benchmark_summarize( bench, m, &summaries[ m ] );
+	}
+
+	// the percentile rows keep the columns, with the name in place of the
+	// frame index
+	static const char* rows[] = { "p50", "p95", "p99" };
+
+	for ( uint32_t r = 0; r < 3; ++r )
+	{
+		double values[ BENCHMARK_METRIC_COUNT ];
+
+		for ( uint32_t m = 0; m < BENCHMARK_METRIC_COUNT; ++m )
+		{
+			const struct benchmark_summary* s = &summaries[ m ];
+			values[ m ] = r == 0 ? s->p50_ms : r == 1 ? s->p95_ms : s->p99_ms;
+		}
+
+		fprintf( file,
+		         "%s,%.4f,%.4f,%.4f\n",
+		         rows[ r ],
+		         values[ BENCHMARK_METRIC_CPU ],
+		         values[ BENCHMARK_METRIC_RECORD ],
+		         values[ BENCHMARK_METRIC_GPU ] );
+	}
+}
+
+bool
+benchmark_write( const struct benchmark*       bench,
+                 const struct benchmark_scene* scene,
+                 const char*                   path )
+{
+	FILE* file = fopen( path, "w" );
+
+	if ( file == NULL )
+	{
+		return false;
+	}
+
+	uint32_t count = bench->frame > bench->warmup_count
+	                     ? bench->frame - bench->warmup_count
+	                     : 0;
+
+	if ( has_extension( path, ".json" ) )
+	{
+		write_json( file, bench, scene, count );
+	}
+	else
+	{
+		write_csv( file, bench, count );
+	}
+
+	return fclose( file ) == 0;
+}
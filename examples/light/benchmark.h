@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// what is timed per frame. cpu is the frame, record is the part of it
+// spent recording the command buffer and gpu is between the first and the
+// last timestamp of a frame, read back as many frames later as are in
+// flight
+enum benchmark_metric
+{
+	BENCHMARK_METRIC_CPU,
+	BENCHMARK_METRIC_RECORD,
+	BENCHMARK_METRIC_GPU,
+	BENCHMARK_METRIC_COUNT,
+};
+
+struct benchmark_frame
+{
+	uint64_t ns[ BENCHMARK_METRIC_COUNT ];
+};
+
+// warmup frames run the same path but are not recorded
+struct benchmark
+{
+	uint32_t                frame_count;
+	uint32_t                warmup_count;
+	uint32_t                frame;
+	struct benchmark_frame* frames;
+};
+
+struct benchmark_summary
+{
+	double average_ms;
+	double p50_ms;
+	double p95_ms;
+	double p99_ms;
+	double max_ms;
+};
+
+// the scene the frames were measured on, written with them. gpu_timing
+// names how the gpu metric was measured, none when it was not and the gpu
+// times are 0
+struct benchmark_scene
+{
+	uint32_t    model_count;
+	uint32_t    draw_count;
+	uint32_t    instance_count;
+	uint32_t    grid_columns;
+	uint32_t    grid_rows;
+	const char* culling;
+	const char* submit;
+	const char* gpu_timing;
+};
+
+void
+benchmark_init( struct benchmark* bench,
+                uint32_t          frame_count,
+                uint32_t          warmup_count );
+
+void
+benchmark_shutdown( struct benchmark* bench );
+
+// true until every warmup and recorded frame has been added
+bool
+benchmark_running( const struct benchmark* bench );
+
+void
+benchmark_add_frame( struct benchmark*             bench,
+                     const struct benchmark_frame* frame );
+
+// the camera of the frame about to run. the path circles the scene bounds
+// once over the whole run, looking at their center, while it moves in and
+// out so culling has something to do. it only depends on the frame index
+void
+benchmark_camera( const struct benchmark* bench,
+                  const float             bounds_min[ 3 ],
+                  const float             bounds_max[ 3 ],
+                  float                   position[ 3 ],
+                  float                   direction[ 3 ] );
+
+// nearest rank percentiles over the recorded frames
+void
+benchmark_summarize( const struct benchmark*   bench,
+                     enum benchmark_metric     metric,
+                     struct benchmark_summary* summary );
+
+// a .json path gets the scene, the summaries and every frame, anything
+// else a csv of the frames followed by one row per percentile
+bool
+benchmark_write( const struct benchmark*       bench,
+                 const struct benchmark_scene* scene,
+                 const char*                   path );
@@ -0,0 +1,129 @@
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "file_map.h"
+
+#ifdef _WIN32
+
+bool
+file_map_open( const char* filename, struct file_map* map )
+{
+	memset( map, 0, sizeof( *map ) );
+
+	HANDLE file = CreateFileA( filename,
+	                           GENERIC_READ,
+	                           FILE_SHARE_READ,
+	                           NULL,
+	                           OPEN_EXISTING,
+	                           FILE_ATTRIBUTE_NORMAL,
+	                           NULL );
+
+	if ( file == INVALID_HANDLE_VALUE )
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if ( !GetFileSizeEx( file, &size ) || size.QuadPart == 0 )
+	{
+		CloseHandle( file );
+		return false;
+	}
+
+	HANDLE mapping =
+	    CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+
+	if ( mapping == NULL )
+	{
+		CloseHandle( file );
+		return false;
+	}
+
+	void* data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+
+	if ( data == NULL )
+	{
+		CloseHandle( mapping );
+		CloseHandle( file );
+		return false;
+	}
+
+	map->data        = data;
+	map->size        = ( size_t ) size.QuadPart;
+	map->file_handle = file;
+	map->map_handle  = mapping;
+
+	return true;
+}
+
+void
+file_map_close( struct file_map* map )
+{
+	if ( map->data )
+	{
+		UnmapViewOfFile( map->data );
+		CloseHandle( map->map_handle );
+		CloseHandle( map->file_handle );
+	}
+
+	memset( map, 0, sizeof( *map ) );
+}
+
+#else
+
+bool
+file_map_open( const char* filename, struct file_map* map )
+{
+	memset( map, 0, sizeof( *map ) );
+
+	int fd = open( filename, O_RDONLY );
+
+	if ( fd < 0 )
+	{
+		return false;
+	}
+
+	struct stat st;
+	if ( fstat( fd, &st ) != 0 || st.st_size == 0 )
+	{
+		close( fd );
+		return false;
+	}
+
+	void* data =
+	    mmap( NULL, ( size_t ) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+
+	close( fd );
+
+	if ( data == MAP_FAILED )
+	{
+		return false;
+	}
+
+	map->data = data;
+	map->size = ( size_t ) st.st_size;
+
+	return true;
+}
+
+void
+file_map_close( struct file_map* map )
+{
+	if ( map->data )
+	{
+		munmap( map->data, map->size );
+	}
+
+	memset( map, 0, sizeof( *map ) );
+}
+
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct file_map
+{
+	void*  data;
+	size_t size;
+	void*  file_handle;
+	void*  map_handle;
+};
+
+bool
+file_map_open( const char* filename, struct file_map* map );
+
+void
+file_map_close( struct file_map* map );
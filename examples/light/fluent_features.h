@@ -0,0 +1,59 @@
+#pragma once
+
+// fluent api newer than the revision premake clones. each part is built
+// only when the fluent the example links has it, named in premake's
+// --fluent_features=<a,b,...> option, and the example falls back to what
+// the cloned revision has otherwise
+
+// ft_query_pool and its commands, timestamps around the gpu work.
+// --fluent_features=queries
+#ifndef LIGHT_FLUENT_QUERIES
+#define LIGHT_FLUENT_QUERIES 0
+#endif
+
+// ft_get_fence_status, a fence checked without waiting on it.
+// --fluent_features=fence_status
+#ifndef LIGHT_FLUENT_FENCE_STATUS
+#define LIGHT_FLUENT_FENCE_STATUS 0
+#endif
+
+// multiDrawIndirect and drawIndirectFirstInstance enabled on the devices
+// fluent creates, for the indirect submit and the gpu culling feeding it.
+// --fluent_features=multi_draw_indirect
+#ifndef LIGHT_FLUENT_MULTI_DRAW_INDIRECT
+#define LIGHT_FLUENT_MULTI_DRAW_INDIRECT 0
+#endif
+
+// ft_swapchain_info.present_mode in place of vsync, for mailbox.
+// --fluent_features=present_mode
+#ifndef LIGHT_FLUENT_PRESENT_MODE
+#define LIGHT_FLUENT_PRESENT_MODE 0
+#endif
+
+// shaderSampledImageArrayNonUniformIndexing enabled and a per stage limit
+// on sampled images above the scene texture array, for the bindless
+// textures the indirect submit and progressive streaming need.
+// --fluent_features=descriptor_indexing
+#ifndef LIGHT_FLUENT_DESCRIPTOR_INDEXING
+#define LIGHT_FLUENT_DESCRIPTOR_INDEXING 0
+#endif
+
+// fragmentStoresAndAtomics enabled, for the texture feedback progressive
+// streaming reads back. --fluent_features=fragment_atomics
+#ifndef LIGHT_FLUENT_FRAGMENT_ATOMICS
+#define LIGHT_FLUENT_FRAGMENT_ATOMICS 0
+#endif
+
+// ft_cmd_copy_buffer_to_image and ft_cmd_copy_image, so streamed levels
+// are copied in the frame's command buffer instead of going through the
+// resource loader. --fluent_features=image_copy
+#ifndef LIGHT_FLUENT_IMAGE_COPY
+#define LIGHT_FLUENT_IMAGE_COPY 0
+#endif
+
+// ft_pipeline_cache and ft_pipeline_info.pipeline_cache, so pipelines are
+// compiled once and loaded from a file on later runs.
+// --fluent_features=pipeline_cache
+#ifndef LIGHT_FLUENT_PIPELINE_CACHE
+#define LIGHT_FLUENT_PIPELINE_CACHE 0
+#endif
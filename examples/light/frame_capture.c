@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <fluent/fluent.h>
+
+#include "frame_readback.comp.h"
+#include "pipeline_timer.h"
+#include "frame_capture.h"
+
+// local size of frame_readback.comp.glsl
+#define READBACK_GROUP_SIZE 16
+
+struct readback_push_constants
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t srgb;
+};
+
+void
+frame_capture_init( struct frame_capture*   capture,
+                    const struct ft_device* device,
+                    uint32_t                width,
+                    uint32_t                height,
+                    bool                    srgb )
+{
+	capture->width  = width;
+	capture->height = height;
+	capture->srgb   = srgb;
+
+	enum ft_renderer_api  api         = ft_get_device_api( device );
+	struct ft_shader_info shader_info = {
+	    .compute = get_frame_readback_comp_shader( api ),
+	};
+	ft_create_shader( device, &shader_info, &capture->shader );
+	ft_create_descriptor_set_layout( device, capture->shader, &capture->dsl );
+
+	struct ft_pipeline_info pipeline_info = {
+	    .type                  = FT_PIPELINE_TYPE_COMPUTE,
+	    .shader                = capture->shader,
+	    .descriptor_set_layout = capture->dsl,
+	};
+	create_timed_pipeline( device,
+	                       "frame readback",
+	                       &pipeline_info,
+	                       &capture->pipeline );
+
+	struct ft_descriptor_set_info set_info = {
+	    .descriptor_set_layout = capture->dsl,
+	    .set                   = 0,
+	};
+	ft_create_descriptor_set( device, &set_info, &capture->set );
+
+	struct ft_sampler_info sampler_info = {
+	    .mag_filter     = FT_FILTER_NEAREST,
+	    .min_filter     = FT_FILTER_NEAREST,
+	    .mipmap_mode    = FT_SAMPLER_MIPMAP_MODE_NEAREST,
+	    .address_mode_u = FT_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+	    .address_mode_v = FT_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+	    .address_mode_w = FT_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+	    .compare_op     = FT_COMPARE_OP_ALWAYS,
+	    .max_lod        = 1,
+	};
+	ft_create_sampler( device, &sampler_info, &capture->sampler );
+
+	struct ft_buffer_info buffer_info = {
+	    .size            = ( uint64_t ) width * height * sizeof( uint32_t ),
+	    .descriptor_type = FT_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+	    .memory_usage    = FT_MEMORY_USAGE_GPU_TO_CPU,
+	};
+	ft_create_buffer( device, &buffer_info, &capture->staging );
+}
+
+void
+frame_capture_shutdown( struct frame_capture*   capture,
+                        const struct ft_device* device )
+{
+	ft_destroy_buffer( device, capture->staging );
+	ft_destroy_sampler( device, capture->sampler );
+	ft_destroy_descriptor_set( device, capture->set );
+	ft_destroy_pipeline( device, capture->pipeline );
+	ft_destroy_descriptor_set_layout( device, capture->dsl );
+	ft_destroy_shader( device, capture->shader );
+}
+
+void
+frame_capture_record( struct frame_capture*     capture,
+                      const struct ft_device*   device,
+                      struct ft_command_buffer* cmd,
+                      struct ft_image*          image )
+{
+	struct ft_sampler_descriptor sampler_descriptor = {
+	    .sampler = capture->sampler,
+	};
+
+	struct ft_image_descriptor image_descriptor = {
+	    .image          = image,
+	    .resource_state = FT_RESOURCE_STATE_SHADER_READ_ONLY,
+	};
+
+	struct ft_buffer_descriptor buffer_descriptor = {
+	    .buffer = capture->staging,
+	    .offset = 0,
+	    .range  = ( uint64_t ) capture->width * capture->height *
+	             sizeof( uint32_t ),
+	};
+
+	struct ft_descriptor_write writes[ 3 ] = {
+	    [0] =
+	        {
+	            .descriptor_count    = 1,
+	            .descriptor_name     = "u_sampler",
+	            .sampler_descriptors = &sampler_descriptor,
+	        },
+	    [1] =
+	        {
+	            .descriptor_count  = 1,
+	            .descriptor_name   = "u_frame",
+	            .image_descriptors = &image_descriptor,
+	        },
+	    [2] =
+	        {
+	            .descriptor_count   = 1,
+	            .descriptor_name    = "u_dst",
+	            .buffer_descriptors = &buffer_descriptor,
+	        },
+	};
+
+	ft_update_descriptor_set( device,
+	                          capture->set,
+	                          FT_COUNTOF( writes ),
+	                          writes );
+
+	struct readback_push_constants pc = {
+	    .width  = capture->width,
+	    .height = capture->height,
+	    .srgb   = capture->srgb,
+	};
+
+	// the graph ends with its backbuffer ready to present
+	struct ft_image_barrier barrier = {
+	    .image     = image,
+	    .old_state = FT_RESOURCE_STATE_PRESENT,
+	    .new_state = FT_RESOURCE_STATE_SHADER_READ_ONLY,
+	};
+
+	ft_cmd_barrier( cmd, 0, NULL, 0, NULL, 1, &barrier );
+	ft_cmd_bind_pipeline( cmd, capture->pipeline );
+	ft_cmd_bind_descriptor_set( cmd, 0, capture->set, capture->pipeline );
+	ft_cmd_push_constants( cmd, capture->pipeline, 0, sizeof( pc ), &pc );
+	ft_cmd_dispatch(
+	    cmd,
+	    ( capture->width + READBACK_GROUP_SIZE - 1 ) / READBACK_GROUP_SIZE,
+	    ( capture->height + READBACK_GROUP_SIZE - 1 ) / READBACK_GROUP_SIZE,
+	    1 );
+
+	barrier.old_state = FT_RESOURCE_STATE_SHADER_READ_ONLY;
+	barrier.new_state = FT_RESOURCE_STATE_PRESENT;
+	ft_cmd_barrier( cmd, 0, NULL, 0, NULL, 1, &barrier );
+}
+
+bool
+frame_capture_write_ppm( const struct frame_capture* capture,
+                         const struct ft_device*     device,
+                         const char*                 path )
+{
+	FILE* file = fopen( path, "wb" );
+
+	if ( file == NULL )
+	{
+		return false;
+	}
+
+	fprintf( file, "P6\n%u %u\n255\n", capture->width, capture->height );
+
+	const uint8_t* pixels = ft_map_memory( device, capture->staging );
+	uint8_t*       row    = malloc( ( size_t ) capture->width * 3 );
+	bool           ok     = true;
+
+	for ( uint32_t y = 0; y < capture->height && ok; ++y )
+	{
+		const uint8_t* src = pixels + ( size_t ) y * capture->width * 4;
+
+		for ( uint32_t x = 0; x < capture->width; ++x )
+		{
+			row[ x * 3 + 0 ] = src[ x * 4 + 0 ];
+			row[ x * 3 + 1 ] = src[ x * 4 + 1 ];
+			row[ x * 3 + 2 ] = src[ x * 4 + 2 ];
+		}
+
+		ok = fwrite( row, 3, capture->width, file ) == capture->width;
+	}
+
+	free( row );
+	ft_unmap_memory( device, capture->staging );
+
+	return fclose( file ) == 0 && ok;
+}
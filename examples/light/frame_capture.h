@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct ft_device;
+struct ft_command_buffer;
+struct ft_image;
+struct ft_buffer;
+struct ft_sampler;
+struct ft_shader;
+struct ft_pipeline;
+struct ft_descriptor_set_layout;
+struct ft_descriptor_set;
+
+// reads rendered frames back to the cpu. a compute pass recorded after the
+// graph copies the frame into a staging buffer as srgb rgba8, srgb is set
+// for targets with an srgb format, whose texels read back linear
+struct frame_capture
+{
+	uint32_t                         width;
+	uint32_t                         height;
+	bool                             srgb;
+	struct ft_shader*                shader;
+	struct ft_descriptor_set_layout* dsl;
+	struct ft_pipeline*              pipeline;
+	struct ft_descriptor_set*        set;
+	struct ft_sampler*               sampler;
+	struct ft_buffer*                staging;
+};
+
+void
+frame_capture_init( struct frame_capture*   capture,
+                    const struct ft_device* device,
+                    uint32_t                width,
+                    uint32_t                height,
+                    bool                    srgb );
+
+void
+frame_capture_shutdown( struct frame_capture*   capture,
+                        const struct ft_device* device );
+
+// records the copy of image, as the render graph leaves its backbuffer,
+// and hands the image back in the same state. the pixels are in the
+// staging buffer once cmd has completed, the gpu must be done with the
+// previous copy
+void
+frame_capture_record( struct frame_capture*     capture,
+                      const struct ft_device*   device,
+                      struct ft_command_buffer* cmd,
+                      struct ft_image*          image );
+
+// writes the last copy as a binary ppm
+bool
+frame_capture_write_ppm( const struct frame_capture* capture,
+                         const struct ft_device*     device,
+                         const char*                 path );
@@ -0,0 +1,68 @@
+#include <stddef.h>
+
+#include "frame_ring.h"
+
+static inline uint64_t
+align_up( uint64_t value, uint64_t alignment )
+{
+	return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+uint64_t
+frame_ring_size( uint64_t region_size,
+                 uint32_t region_count,
+                 uint64_t alignment )
+{
+	return align_up( region_size, alignment ) * region_count;
+}
+
+void
+frame_ring_init( struct frame_ring* ring,
+                 void*              memory,
+                 uint64_t           region_size,
+                 uint32_t           region_count,
+                 uint64_t           alignment )
+{
+	ring->memory       = memory;
+	ring->region_size  = align_up( region_size, alignment );
+	ring->region_count = region_count;
+	ring->alignment    = alignment;
+	ring->region       = 0;
+	ring->used         = 0;
+}
+
+void
+frame_ring_begin_frame( struct frame_ring* ring, uint64_t frame )
+{
+	ring->region = ( uint32_t ) ( frame % ring->region_count );
+	ring->used   = 0;
+}
+
+void*
+frame_ring_alloc( struct frame_ring* ring, uint64_t size, uint64_t* offset )
+{
+	uint64_t start = align_up( ring->used, ring->alignment );
+
+	if ( start + size > ring->region_size )
+	{
+		return NULL;
+	}
+
+	ring->used = start + size;
+
+	uint64_t block_offset = frame_ring_region_offset( ring, ring->region ) +
+	                        start;
+
+	if ( offset )
+	{
+		*offset = block_offset;
+	}
+
+	return ring->memory + block_offset;
+}
+
+uint64_t
+frame_ring_region_offset( const struct frame_ring* ring, uint32_t region )
+{
+	return ( uint64_t ) region * ring->region_size;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+// bump allocator over a block split into one region per frame. a frame
+// only allocates from its own region, so what was written for it stays
+// put until the same region comes around again region_count frames later.
+// the block is meant to be a persistently mapped buffer and offsets are
+// from its start, ready for descriptors and indirect draws
+struct frame_ring
+{
+	uint8_t* memory;
+	uint64_t region_size;
+	uint32_t region_count;
+	uint64_t alignment;
+	uint32_t region;
+	uint64_t used;
+};
+
+// bytes the block needs, region_size is rounded up to alignment
+uint64_t
+frame_ring_size( uint64_t region_size,
+                 uint32_t region_count,
+                 uint64_t alignment );
+
+void
+frame_ring_init( struct frame_ring* ring,
+                 void*              memory,
+                 uint64_t           region_size,
+                 uint32_t           region_count,
+                 uint64_t           alignment );
+
+// empties the region of frame and allocates from it until the next call
+void
+frame_ring_begin_frame( struct frame_ring* ring, uint64_t frame );
+
+// NULL when the region is full. allocations start on alignment, the
+// first one of a frame at the start of its region
+void*
+frame_ring_alloc( struct frame_ring* ring, uint64_t size, uint64_t* offset );
+
+uint64_t
+frame_ring_region_offset( const struct frame_ring* ring, uint32_t region );
@@ -0,0 +1,51 @@
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "frame_stats.h"
+
+uint64_t
+frame_clock_ns( void )
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency( &frequency );
+	QueryPerformanceCounter( &counter );
+	return ( uint64_t ) ( ( double ) counter.QuadPart * 1e9 /
+	                      ( double ) frequency.QuadPart );
+#else
+	struct timespec time;
+	clock_gettime( CLOCK_MONOTONIC, &time );
+	return ( uint64_t ) time.tv_sec * 1000000000ull +
+	       ( uint64_t ) time.tv_nsec;
+#endif
+}
+
+void
+frame_stats_reset( struct frame_stats* stats )
+{
+	memset( stats, 0, sizeof( *stats ) );
+	stats->min_ns = UINT64_MAX;
+}
+
+void
+frame_stats_add( struct frame_stats* stats, uint64_t ns )
+{
+	stats->count++;
+	stats->total_ns += ns;
+	stats->min_ns = ns < stats->min_ns ? ns : stats->min_ns;
+	stats->max_ns = ns > stats->max_ns ? ns : stats->max_ns;
+}
+
+double
+frame_stats_average_ms( const struct frame_stats* stats )
+{
+	return stats->count != 0
+	           ? ( double ) stats->total_ns / stats->count / 1e6
+	           : 0.0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// cpu time per frame. ft_timer only counts milliseconds, which is too
+// coarse for the recording cost of a frame
+struct frame_stats
+{
+	uint32_t count;
+	uint64_t total_ns;
+	uint64_t min_ns;
+	uint64_t max_ns;
+};
+
+// monotonic, only differences between two calls mean anything
+uint64_t
+frame_clock_ns( void );
+
+void
+frame_stats_reset( struct frame_stats* stats );
+
+void
+frame_stats_add( struct frame_stats* stats, uint64_t ns );
+
+double
+frame_stats_average_ms( const struct frame_stats* stats );
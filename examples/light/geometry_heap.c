@@ -0,0 +1,523 @@
+#include <fluent/fluent.h>
+
+#include "geometry_heap.h"
+
+struct geometry_copy
+{
+	uint64_t src_offset;
+	uint64_t dst_offset;
+	uint64_t size;
+};
+
+static const uint32_t arena_descriptor_types[ GEOMETRY_ARENA_COUNT ] = {
+    [GEOMETRY_ARENA_VERTEX]   = FT_DESCRIPTOR_TYPE_VERTEX_BUFFER,
+    [GEOMETRY_ARENA_INDEX_16] = FT_DESCRIPTOR_TYPE_INDEX_BUFFER,
+    [GEOMETRY_ARENA_INDEX_32] = FT_DESCRIPTOR_TYPE_INDEX_BUFFER,
+};
+
+static uint64_t
+align_to( uint64_t value, uint64_t alignment )
+{
+	return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+static void
+insert_range( struct range_allocator* allocator,
+              uint32_t                index,
+              uint64_t                offset,
+              uint64_t                size )
+{
+	if ( allocator->free_count == allocator->free_capacity )
+	{
+		allocator->free_capacity =
+		    FT_MAX( allocator->free_capacity * 2, 16u );
+		allocator->free_ranges =
+		    realloc( allocator->free_ranges,
+		             allocator->free_capacity *
+		                 sizeof( struct geometry_range ) );
+	}
+
+	memmove( &allocator->free_ranges[ index + 1 ],
+	         &allocator->free_ranges[ index ],
+	         ( allocator->free_count - index ) *
+	             sizeof( struct geometry_range ) );
+
+	allocator->free_ranges[ index ].offset = offset;
+	allocator->free_ranges[ index ].size   = size;
+	allocator->free_count++;
+}
+
+static void
+remove_range( struct range_allocator* allocator, uint32_t index )
+{
+	memmove( &allocator->free_ranges[ index ],
+	         &allocator->free_ranges[ index + 1 ],
+	         ( allocator->free_count - index - 1 ) *
+	             sizeof( struct geometry_range ) );
+	allocator->free_count--;
+}
+
+void
+range_allocator_init( struct range_allocator* allocator, uint64_t capacity )
+{
+	memset( allocator, 0, sizeof( *allocator ) );
+	range_allocator_grow( allocator, capacity );
+}
+
+void
+range_allocator_shutdown( struct range_allocator* allocator )
+{
+	free( allocator->free_ranges );
+	memset( allocator, 0, sizeof( *allocator ) );
+}
+
+bool
+range_allocator_alloc( struct range_allocator* allocator,
+                       uint64_t                size,
+                       uint64_t                alignment,
+                       uint64_t*               offset )
+{
+	alignment = FT_MAX( alignment, 1ull );
+
+	for ( uint32_t i = 0; i < allocator->free_count; ++i )
+	{
+		struct geometry_range* range = &allocator->free_ranges[ i ];
+
+		uint64_t start = align_to( range->offset, alignment );
+		uint64_t end   = range->offset + range->size;
+
+		if ( start + size > end )
+		{
+			continue;
+		}
+
+		uint64_t head = start - range->offset;
+		uint64_t tail = end - start - size;
+
+		*offset = start;
+
+		if ( head == 0 && tail == 0 )
+		{
+			remove_range( allocator, i );
+		}
+		else if ( head == 0 )
+		{
+			range->offset = start + size;
+			range->size   = tail;
+		}
+		else
+		{
+			// the alignment padding stays free, the tail becomes a range
+			// of its own
+			range->size = head;
+
+			if ( tail != 0 )
+			{
+				insert_range( allocator, i + 1, start + size, tail );
+			}
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+void
+range_allocator_free( struct range_allocator* allocator,
+                      uint64_t                offset,
+                      uint64_t                size )
+{
+	struct geometry_range* ranges = allocator->free_ranges;
+
+	uint32_t index = 0;
+	while ( index < allocator->free_count && ranges[ index ].offset < offset )
+	{
+		index++;
+	}
+
+	bool merge_prev = index > 0 && ranges[ index - 1 ].offset +
+	                                       ranges[ index - 1 ].size ==
+	                                   offset;
+	bool merge_next = index < allocator->free_count &&
+	                  offset + size == ranges[ index ].offset;
+
+	if ( merge_prev && merge_next )
+	{
+		ranges[ index - 1 ].size += size + ranges[ index ].size;
+		remove_range( allocator, index );
+	}
+	else if ( merge_prev )
+	{
+		ranges[ index - 1 ].size += size;
+	}
+	else if ( merge_next )
+	{
+		ranges[ index ].offset = offset;
+		ranges[ index ].size += size;
+	}
+	else
+	{
+		insert_range( allocator, index, offset, size );
+	}
+}
+
+void
+range_allocator_grow( struct range_allocator* allocator, uint64_t capacity )
+{
+	if ( capacity > allocator->capacity )
+	{
+		uint64_t old_capacity = allocator->capacity;
+		allocator->capacity   = capacity;
+		range_allocator_free( allocator,
+		                      old_capacity,
+		                      capacity - old_capacity );
+	}
+}
+
+void
+geometry_heap_init( struct geometry_heap*   heap,
+                    const struct ft_device* device,
+                    struct ft_queue*        queue )
+{
+	memset( heap, 0, sizeof( *heap ) );
+	heap->device = device;
+	heap->queue  = queue;
+
+	struct ft_command_pool_info pool_info = {
+	    .queue = queue,
+	};
+
+	ft_create_command_pool( device, &pool_info, &heap->cmd_pool );
+	ft_create_command_buffers( device, heap->cmd_pool, 1, &heap->cmd );
+
+	for ( uint32_t i = 0; i < GEOMETRY_ARENA_COUNT; ++i )
+	{
+		range_allocator_init( &heap->arenas[ i ].allocator, 0 );
+	}
+}
+
+void
+geometry_heap_shutdown( struct geometry_heap* heap )
+{
+	if ( heap->device == NULL )
+	{
+		return;
+	}
+
+	for ( uint32_t i = 0; i < GEOMETRY_ARENA_COUNT; ++i )
+	{
+		struct geometry_heap_arena* arena = &heap->arenas[ i ];
+
+		if ( arena->buffer )
+		{
+			ft_destroy_buffer( heap->device, arena->buffer );
+		}
+
+		range_allocator_shutdown( &arena->allocator );
+	}
+
+	free( heap->allocations );
+	ft_destroy_command_buffers( heap->device, heap->cmd_pool, 1, &heap->cmd );
+	ft_destroy_command_pool( heap->device, heap->cmd_pool );
+
+	memset( heap, 0, sizeof( *heap ) );
+}
+
+// swaps the arena buffer for one of capacity bytes, copying the given
+// ranges over. the old buffer may still be read by frames in flight, so
+// the queue is drained before it goes
+static void
+replace_arena_buffer( struct geometry_heap*       heap,
+                      enum geometry_arena         arena,
+                      uint64_t                    capacity,
+                      const struct geometry_copy* copies,
+                      uint32_t                    copy_count )
+{
+	struct geometry_heap_arena* a      = &heap->arenas[ arena ];
+	struct ft_buffer*           buffer = NULL;
+
+	if ( capacity != 0 )
+	{
+		struct ft_buffer_info info = {
+		    .size            = capacity,
+		    .descriptor_type = arena_descriptor_types[ arena ],
+		    .memory_usage    = FT_MEMORY_USAGE_GPU_ONLY,
+		};
+
+		ft_create_buffer( heap->device, &info, &buffer );
+	}
+
+	if ( a->buffer && buffer && copy_count != 0 )
+	{
+		// queued uploads have to land in the old buffer before it is read
+		ft_resource_loader_wait_idle();
+
+		ft_begin_command_buffer( heap->cmd );
+		for ( uint32_t i = 0; i < copy_count; ++i )
+		{
+			ft_cmd_copy_buffer( heap->cmd,
+			                    a->buffer,
+			                    copies[ i ].src_offset,
+			                    buffer,
+			                    copies[ i ].dst_offset,
+			                    copies[ i ].size );
+		}
+		ft_end_command_buffer( heap->cmd );
+		ft_immediate_submit( heap->queue, heap->cmd );
+	}
+
+	if ( a->buffer )
+	{
+		ft_queue_wait_idle( heap->queue );
+		ft_destroy_buffer( heap->device, a->buffer );
+	}
+
+	a->buffer = buffer;
+	heap->generation++;
+}
+
+static uint32_t
+acquire_allocation_slot( struct geometry_heap* heap )
+{
+	for ( uint32_t i = 0; i < heap->allocation_capacity; ++i )
+	{
+		if ( !heap->allocations[ i ].live )
+		{
+			return i;
+		}
+	}
+
+	uint32_t slot             = heap->allocation_capacity;
+	heap->allocation_capacity = FT_MAX( heap->allocation_capacity * 2, 16u );
+	heap->allocations =
+	    realloc( heap->allocations,
+	             heap->allocation_capacity *
+	                 sizeof( struct geometry_allocation ) );
+	memset( &heap->allocations[ slot ],
+	        0,
+	        ( heap->allocation_capacity - slot ) *
+	            sizeof( struct geometry_allocation ) );
+
+	return slot;
+}
+
+uint32_t
+geometry_heap_alloc( struct geometry_heap* heap,
+                     enum geometry_arena   arena,
+                     uint64_t              size,
+                     uint64_t              alignment )
+{
+	if ( size == 0 )
+	{
+		return GEOMETRY_HEAP_INVALID;
+	}
+
+	struct geometry_heap_arena* a = &heap->arenas[ arena ];
+
+	alignment       = FT_MAX( alignment, 1ull );
+	uint64_t offset = 0;
+
+	if ( !range_allocator_alloc( &a->allocator, size, alignment, &offset ) )
+	{
+		uint64_t old_capacity = a->allocator.capacity;
+		uint64_t capacity     = FT_MAX( old_capacity + old_capacity / 2,
+                                    old_capacity + size + alignment - 1 );
+
+		struct geometry_copy copy = {
+		    .src_offset = 0,
+		    .dst_offset = 0,
+		    .size       = old_capacity,
+		};
+
+		replace_arena_buffer( heap,
+		                      arena,
+		                      capacity,
+		                      &copy,
+		                      old_capacity != 0 ? 1 : 0 );
+		range_allocator_grow( &a->allocator, capacity );
+
+		if ( !range_allocator_alloc( &a->allocator, size, alignment, &offset ) )
+		{
+			return GEOMETRY_HEAP_INVALID;
+		}
+	}
+
+	uint32_t                    slot       = acquire_allocation_slot( heap );
+	struct geometry_allocation* allocation = &heap->allocations[ slot ];
+
+	allocation->live      = true;
+	allocation->arena     = arena;
+	allocation->offset    = offset;
+	allocation->size      = size;
+	allocation->alignment = alignment;
+
+	a->used += size;
+	heap->allocation_count++;
+
+	return slot;
+}
+
+void
+geometry_heap_free( struct geometry_heap* heap, uint32_t allocation )
+{
+	if ( allocation == GEOMETRY_HEAP_INVALID )
+	{
+		return;
+	}
+
+	struct geometry_allocation* a     = &heap->allocations[ allocation ];
+	struct geometry_heap_arena* arena = &heap->arenas[ a->arena ];
+
+	range_allocator_free( &arena->allocator, a->offset, a->size );
+	arena->used -= a->size;
+	a->live = false;
+	heap->allocation_count--;
+}
+
+uint64_t
+geometry_heap_offset( const struct geometry_heap* heap, uint32_t allocation )
+{
+	return allocation != GEOMETRY_HEAP_INVALID
+	           ? heap->allocations[ allocation ].offset
+	           : 0;
+}
+
+struct ft_buffer*
+geometry_heap_buffer( const struct geometry_heap* heap,
+                      enum geometry_arena         arena )
+{
+	return heap->arenas[ arena ].buffer;
+}
+
+void
+geometry_heap_upload( struct geometry_heap* heap,
+                      uint32_t              allocation,
+                      const void*           data )
+{
+	if ( allocation == GEOMETRY_HEAP_INVALID )
+	{
+		return;
+	}
+
+	const struct geometry_allocation* a = &heap->allocations[ allocation ];
+
+	struct ft_buffer_upload_job job = {
+	    .buffer = heap->arenas[ a->arena ].buffer,
+	    .offset = a->offset,
+	    .size   = a->size,
+	    .data   = ( void* ) data,
+	};
+
+	ft_upload_buffer( &job );
+}
+
+static int
+compare_allocation_offsets( const void* a, const void* b )
+{
+	const struct geometry_allocation* lhs =
+	    *( const struct geometry_allocation* const* ) a;
+	const struct geometry_allocation* rhs =
+	    *( const struct geometry_allocation* const* ) b;
+
+	return ( lhs->offset > rhs->offset ) - ( lhs->offset < rhs->offset );
+}
+
+void
+geometry_heap_compact( struct geometry_heap* heap )
+{
+	struct geometry_allocation** live =
+	    malloc( FT_MAX( heap->allocation_capacity, 1u ) *
+	            sizeof( struct geometry_allocation* ) );
+	struct geometry_copy* copies =
+	    malloc( FT_MAX( heap->allocation_capacity, 1u ) *
+	            sizeof( struct geometry_copy ) );
+
+	for ( uint32_t arena = 0; arena < GEOMETRY_ARENA_COUNT; ++arena )
+	{
+		struct geometry_heap_arena* a = &heap->arenas[ arena ];
+
+		uint32_t live_count = 0;
+		for ( uint32_t i = 0; i < heap->allocation_capacity; ++i )
+		{
+			if ( heap->allocations[ i ].live &&
+			     heap->allocations[ i ].arena == arena )
+			{
+				live[ live_count++ ] = &heap->allocations[ i ];
+			}
+		}
+
+		// ranges keep their relative order so the copies stay sequential
+		qsort( live,
+		       live_count,
+		       sizeof( struct geometry_allocation* ),
+		       compare_allocation_offsets );
+
+		uint64_t offset = 0;
+		for ( uint32_t i = 0; i < live_count; ++i )
+		{
+			offset                  = align_to( offset, live[ i ]->alignment );
+			copies[ i ].src_offset = live[ i ]->offset;
+			copies[ i ].dst_offset = offset;
+			copies[ i ].size       = live[ i ]->size;
+			offset += live[ i ]->size;
+		}
+
+		if ( offset == a->allocator.capacity )
+		{
+			continue;
+		}
+
+		replace_arena_buffer( heap,
+		                      arena,
+		                      offset,
+		                      copies,
+		                      live_count );
+
+		range_allocator_shutdown( &a->allocator );
+		a->allocator.capacity = offset;
+
+		// alignment padding between ranges stays allocatable
+		uint64_t end = 0;
+		for ( uint32_t i = 0; i < live_count; ++i )
+		{
+			if ( copies[ i ].dst_offset > end )
+			{
+				range_allocator_free( &a->allocator,
+				                      end,
+				                      copies[ i ].dst_offset - end );
+			}
+
+			live[ i ]->offset = copies[ i ].dst_offset;
+			end               = copies[ i ].dst_offset + copies[ i ].size;
+		}
+	}
+
+	free( copies );
+	free( live );
+}
+
+void
+geometry_heap_get_stats( const struct geometry_heap* heap,
+                         struct geometry_heap_stats* stats )
+{
+	memset( stats, 0, sizeof( *stats ) );
+
+	for ( uint32_t i = 0; i < GEOMETRY_ARENA_COUNT; ++i )
+	{
+		const struct geometry_heap_arena* arena = &heap->arenas[ i ];
+
+		stats->capacity[ i ]    = arena->allocator.capacity;
+		stats->used[ i ]        = arena->used;
+		stats->free_ranges[ i ] = arena->allocator.free_count;
+
+		for ( uint32_t r = 0; r < arena->allocator.free_count; ++r )
+		{
+			stats->largest_free[ i ] =
+			    FT_MAX( stats->largest_free[ i ],
+			            arena->allocator.free_ranges[ r ].size );
+		}
+	}
+
+	stats->allocation_count = heap->allocation_count;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct ft_device;
+struct ft_queue;
+struct ft_buffer;
+struct ft_command_pool;
+struct ft_command_buffer;
+
+#define GEOMETRY_HEAP_INVALID UINT32_MAX
+
+enum geometry_arena
+{
+	GEOMETRY_ARENA_VERTEX,
+	GEOMETRY_ARENA_INDEX_16,
+	GEOMETRY_ARENA_INDEX_32,
+	GEOMETRY_ARENA_COUNT,
+};
+
+struct geometry_range
+{
+	uint64_t offset;
+	uint64_t size;
+};
+
+// first fit offset allocator over one buffer, free ranges are kept sorted
+// by offset and merged with their neighbours on free
+struct range_allocator
+{
+	uint64_t               capacity;
+	uint32_t               free_count;
+	uint32_t               free_capacity;
+	struct geometry_range* free_ranges;
+};
+
+struct geometry_allocation
+{
+	bool     live;
+	uint32_t arena;
+	uint64_t offset;
+	uint64_t size;
+	uint64_t alignment;
+};
+
+// one gpu buffer per arena, sized from what is allocated rather than
+// reserved up front. the buffer grows by half when an allocation does not
+// fit, live ranges are copied over on the gpu
+struct geometry_heap_arena
+{
+	struct ft_buffer*      buffer;
+	struct range_allocator allocator;
+	uint64_t               used;
+};
+
+struct geometry_heap
+{
+	const struct ft_device*     device;
+	struct ft_queue*            queue;
+	struct ft_command_pool*     cmd_pool;
+	struct ft_command_buffer*   cmd;
+	struct geometry_heap_arena  arenas[ GEOMETRY_ARENA_COUNT ];
+	uint32_t                    allocation_count;
+	uint32_t                    allocation_capacity;
+	struct geometry_allocation* allocations;
+	// bumped whenever offsets move, users holding offsets refresh them
+	uint32_t generation;
+};
+
+struct geometry_heap_stats
+{
+	uint64_t capacity[ GEOMETRY_ARENA_COUNT ];
+	uint64_t used[ GEOMETRY_ARENA_COUNT ];
+	uint32_t free_ranges[ GEOMETRY_ARENA_COUNT ];
+	uint64_t largest_free[ GEOMETRY_ARENA_COUNT ];
+	uint32_t allocation_count;
+};
+
+void
+range_allocator_init( struct range_allocator* allocator, uint64_t capacity );
+
+void
+range_allocator_shutdown( struct range_allocator* allocator );
+
+// alignment does not need to be a power of two, vertex ranges are aligned
+// to the vertex stride
+bool
+range_allocator_alloc( struct range_allocator* allocator,
+                       uint64_t                size,
+                       uint64_t                alignment,
+                       uint64_t*               offset );
+
+void
+range_allocator_free( struct range_allocator* allocator,
+                      uint64_t                offset,
+                      uint64_t                size );
+
+void
+range_allocator_grow( struct range_allocator* allocator, uint64_t capacity );
+
+// copies and buffer retirement go through queue, which is waited on before
+// an old buffer is destroyed
+void
+geometry_heap_init( struct geometry_heap*   heap,
+                    const struct ft_device* device,
+                    struct ft_queue*        queue );
+
+void
+geometry_heap_shutdown( struct geometry_heap* heap );
+
+uint32_t
+geometry_heap_alloc( struct geometry_heap* heap,
+                     enum geometry_arena   arena,
+                     uint64_t              size,
+                     uint64_t              alignment );
+
+void
+geometry_heap_free( struct geometry_heap* heap, uint32_t allocation );
+
+uint64_t
+geometry_heap_offset( const struct geometry_heap* heap, uint32_t allocation );
+
+// NULL while nothing has been allocated from the arena
+struct ft_buffer*
+geometry_heap_buffer( const struct geometry_heap* heap,
+                      enum geometry_arena         arena );
+
+// queues an upload of the whole allocation through the resource loader
+void
+geometry_heap_upload( struct geometry_heap* heap,
+                      uint32_t              allocation,
+                      const void*           data );
+
+// moves every live range to the front of a buffer sized to fit exactly,
+// which also gives back whatever growth and unloading left unused
+void
+geometry_heap_compact( struct geometry_heap* heap );
+
+void
+geometry_heap_get_stats( const struct geometry_heap* heap,
+                         struct geometry_heap_stats* stats );
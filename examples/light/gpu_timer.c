@@ -0,0 +1,305 @@
+#include <string.h>
+#include <fluent/fluent.h>
+
+#include "fluent_features.h"
+#include "frame_stats.h"
+#include "profiler.h"
+#include "gpu_timer.h"
+
+#if LIGHT_FLUENT_QUERIES
+
+#define GPU_TIMER_NO_SLOT  UINT32_MAX
+#define GPU_TIMER_NO_SCOPE UINT32_MAX
+
+// two queries per scope, begin and end
+#define GPU_TIMER_QUERY_COUNT ( 2 * GPU_TIMER_MAX_SCOPES )
+
+struct gpu_timer_scope
+{
+	const char* name;
+};
+
+struct gpu_timer_slot
+{
+	struct ft_query_pool*  pool;
+	bool                   pending;
+	uint64_t               end_ns;
+	uint32_t               scope_count;
+	struct gpu_timer_scope scopes[ GPU_TIMER_MAX_SCOPES ];
+};
+
+struct gpu_timer_data
+{
+	bool                  enabled;
+	double                tick_ns;
+	uint32_t              slot_count;
+	uint32_t              current;
+	uint32_t              stack[ GPU_TIMER_MAX_SCOPES ];
+	uint32_t              stack_depth;
+	uint64_t              frame_ns;
+	struct gpu_timer_slot slots[ GPU_TIMER_MAX_SLOTS ];
+};
+
+static struct gpu_timer_data gpu_timer_data = {
+    .current = GPU_TIMER_NO_SLOT,
+};
+
+void
+gpu_timer_init( const struct ft_device* device, uint32_t slot_count )
+{
+	struct gpu_timer_data* data = &gpu_timer_data;
+
+	FT_ASSERT( slot_count <= GPU_TIMER_MAX_SLOTS );
+
+	data->enabled    = true;
+	data->tick_ns    = ( double ) ft_get_timestamp_period( device );
+	data->slot_count = slot_count;
+	data->current    = GPU_TIMER_NO_SLOT;
+
+	struct ft_query_pool_info pool_info = {
+	    .type  = FT_QUERY_TYPE_TIMESTAMP,
+	    .count = GPU_TIMER_QUERY_COUNT,
+	};
+
+	for ( uint32_t i = 0; i < slot_count; ++i )
+	{
+		ft_create_query_pool( device, &pool_info, &data->slots[ i ].pool );
+		data->slots[ i ].pending = false;
+	}
+}
+
+void
+gpu_timer_shutdown( const struct ft_device* device )
+{
+	struct gpu_timer_data* data = &gpu_timer_data;
+
+	if ( !data->enabled )
+	{
+		return;
+	}
+
+	for ( uint32_t i = 0; i < data->slot_count; ++i )
+	{
+		ft_destroy_query_pool( device, data->slots[ i ].pool );
+	}
+
+	memset( data, 0, sizeof( *data ) );
+	data->current = GPU_TIMER_NO_SLOT;
+}
+
+// the frame ends at end_ns on the cpu clock, its scopes are placed back
+// from there by their distance to the frame's last timestamp
+static void
+read_slot( const struct ft_device* device, struct gpu_timer_slot* slot )
+{
+	struct gpu_timer_data* data = &gpu_timer_data;
+
+	if ( !slot->pending )
+	{
+		return;
+	}
+
+	slot->pending = false;
+
+	uint64_t ticks[ GPU_TIMER_QUERY_COUNT ];
+	uint32_t query_count = 2 * slot->scope_count;
+
+	// the frame's fence was waited for, anything not there is an error in
+	// the recording and the frame is dropped rather than waited for
+	if ( !ft_get_query_pool_results( device,
+	                                 slot->pool,
+	                                 0,
+	                                 query_count,
+	                                 ticks ) )
+	{
+		return;
+	}
+
+	uint64_t last = ticks[ 1 ];
+
+	for ( uint32_t s = 0; s < slot->scope_count; ++s )
+	{
+		double begin = ( double ) ( last - ticks[ 2 * s ] ) * data->tick_ns;
+		double end = ( double ) ( last - ticks[ 2 * s + 1 ] ) * data->tick_ns;
+
+		profiler_gpu_span( slot->scopes[ s ].name,
+		                   slot->end_ns - ( uint64_t ) begin,
+		                   slot->end_ns - ( uint64_t ) end );
+	}
+
+	data->frame_ns = ( uint64_t ) ( ( double ) ( last - ticks[ 0 ] ) *
+	                                data->tick_ns );
+}
+
+void
+gpu_timer_begin_frame( const struct ft_device*   device,
+                       struct ft_command_buffer* cmd,
+                       uint32_t                  slot,
+                       const char*               name )
+{
+	struct gpu_timer_data* data = &gpu_timer_data;
+
+	if ( !data->enabled )
+	{
+		return;
+	}
+
+	FT_ASSERT( slot < data->slot_count );
+
+	struct gpu_timer_slot* current = &data->slots[ slot ];
+	read_slot( device, current );
+
+	ft_cmd_reset_query_pool( cmd, current->pool, 0, GPU_TIMER_QUERY_COUNT );
+
+	data->current        = slot;
+	data->stack_depth    = 0;
+	current->scope_count = 0;
+
+	gpu_timer_begin( cmd, name );
+}
+
+void
+gpu_timer_end_frame( struct ft_command_buffer* cmd )
+{
+	struct gpu_timer_data* data = &gpu_timer_data;
+
+	if ( !data->enabled || data->current == GPU_TIMER_NO_SLOT )
+	{
+		return;
+	}
+
+	// scopes left open end with the frame
+	while ( data->stack_depth != 0 )
+	{
+		gpu_timer_end( cmd );
+	}
+
+	struct gpu_timer_slot* slot = &data->slots[ data->current ];
+	slot->pending               = true;
+	slot->end_ns                = frame_clock_ns();
+	data->current               = GPU_TIMER_NO_SLOT;
+}
+
+void
+gpu_timer_begin( struct ft_command_buffer* cmd, const char* name )
+{
+	struct gpu_timer_data* data = &gpu_timer_data;
+
+	if ( !data->enabled || data->current == GPU_TIMER_NO_SLOT ||
+	     data->stack_depth == GPU_TIMER_MAX_SCOPES )
+	{
+		return;
+	}
+
+	struct gpu_timer_slot* slot  = &data->slots[ data->current ];
+	uint32_t               index = GPU_TIMER_NO_SCOPE;
+
+	if ( slot->scope_count < GPU_TIMER_MAX_SCOPES )
+	{
+		index                      = slot->scope_count++;
+		slot->scopes[ index ].name = name;
+		ft_cmd_write_timestamp( cmd, slot->pool, 2 * index );
+	}
+
+	data->stack[ data->stack_depth++ ] = index;
+}
+
+void
+gpu_timer_end( struct ft_command_buffer* cmd )
+{
+	struct gpu_timer_data* data = &gpu_timer_data;
+
+	if ( !data->enabled || data->current == GPU_TIMER_NO_SLOT ||
+	     data->stack_depth == 0 )
+	{
+		return;
+	}
+
+	uint32_t index = data->stack[ --data->stack_depth ];
+
+	if ( index != GPU_TIMER_NO_SCOPE )
+	{
+		struct gpu_timer_slot* slot = &data->slots[ data->current ];
+		ft_cmd_write_timestamp( cmd, slot->pool, 2 * index + 1 );
+	}
+}
+
+void
+gpu_timer_read( const struct ft_device* device )
+{
+	struct gpu_timer_data* data = &gpu_timer_data;
+
+	for ( uint32_t i = 0; data->enabled && i < data->slot_count; ++i )
+	{
+		read_slot( device, &data->slots[ i ] );
+	}
+}
+
+uint64_t
+gpu_timer_frame_ns( void )
+{
+	return gpu_timer_data.frame_ns;
+}
+
+#else
+
+// without query pools there is nothing to time with, every call does
+// nothing and the gpu track stays empty
+
+void
+gpu_timer_init( const struct ft_device* device, uint32_t slot_count )
+{
+	FT_UNUSED( device );
+	FT_UNUSED( slot_count );
+}
+
+void
+gpu_timer_shutdown( const struct ft_device* device )
+{
+	FT_UNUSED( device );
+}
+
+void
+gpu_timer_begin_frame( const struct ft_device*   device,
+                       struct ft_command_buffer* cmd,
+                       uint32_t                  slot,
+                       const char*               name )
+{
+	FT_UNUSED( device );
+	FT_UNUSED( cmd );
+	FT_UNUSED( slot );
+	FT_UNUSED( name );
+}
+
+void
+gpu_timer_end_frame( struct ft_command_buffer* cmd )
+{
+	FT_UNUSED( cmd );
+}
+
+void
+gpu_timer_begin( struct ft_command_buffer* cmd, const char* name )
+{
+	FT_UNUSED( cmd );
+	FT_UNUSED( name );
+}
+
+void
+gpu_timer_end( struct ft_command_buffer* cmd )
+{
+	FT_UNUSED( cmd );
+}
+
+void
+gpu_timer_read( const struct ft_device* device )
+{
+	FT_UNUSED( device );
+}
+
+uint64_t
+gpu_timer_frame_ns( void )
+{
+	return 0;
+}
+
+#endif
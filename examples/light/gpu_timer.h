@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct ft_device;
+struct ft_command_buffer;
+
+#define GPU_TIMER_MAX_SLOTS  8
+#define GPU_TIMER_MAX_SCOPES 16
+
+// timestamp queries around the gpu work of a frame. every frame in flight
+// records into a query pool of its own, read back when the frame comes
+// around again and its fence has been waited for, so reading never holds
+// the cpu up. the spans land on the profiler's gpu track, placed on the
+// cpu clock from the time the frame was closed. nothing is written until
+// gpu_timer_init, every other call does nothing before it. without
+// LIGHT_FLUENT_QUERIES, see fluent_features.h, nothing is ever written and
+// gpu_timer_frame_ns stays 0
+void
+gpu_timer_init( const struct ft_device* device, uint32_t slot_count );
+
+void
+gpu_timer_shutdown( const struct ft_device* device );
+
+// reads back what slot recorded last and starts recording into it, with
+// a scope called name around everything up to gpu_timer_end_frame. the
+// gpu must be done with the previous frame of the slot
+void
+gpu_timer_begin_frame( const struct ft_device*   device,
+                       struct ft_command_buffer* cmd,
+                       uint32_t                  slot,
+                       const char*               name );
+
+// call right before cmd is ended and submitted
+void
+gpu_timer_end_frame( struct ft_command_buffer* cmd );
+
+// name must outlive the timer, string literals in practice. scopes nest
+void
+gpu_timer_begin( struct ft_command_buffer* cmd, const char* name );
+
+void
+gpu_timer_end( struct ft_command_buffer* cmd );
+
+// reads back every frame recorded so far, for a submit that was waited for
+void
+gpu_timer_read( const struct ft_device* device );
+
+// gpu time of the frame read back last, between its first and its last
+// timestamp. with frames in flight it is that many frames behind the one
+// being recorded
+uint64_t
+gpu_timer_frame_ns( void );
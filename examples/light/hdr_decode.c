@@ -0,0 +1,443 @@
+#include <stdlib.h>
+#include <string.h>
+
+#if defined( __SSE2__ ) || defined( _M_X64 )
+#include <emmintrin.h>
+#define HDR_SSE2
+#if defined( __F16C__ ) || defined( __AVX2__ )
+#include <immintrin.h>
+#define HDR_F16C
+#endif
+#endif
+
+#include "job_system.h"
+#include "hdr_decode.h"
+
+#define HDR_MIN_RLE_WIDTH 8
+#define HDR_MAX_RLE_WIDTH 0x7fff
+#define HDR_ROW_BATCH     16
+
+// largest finite half, brighter texels would turn into inf and poison the
+// convolutions downstream
+#define HDR_HALF_MAX 65504.0f
+
+static const char*
+hdr_read_line( const char* p, const char* end )
+{
+	while ( p < end && *p != '\n' )
+	{
+		p++;
+	}
+	return p < end ? p + 1 : NULL;
+}
+
+static bool
+hdr_parse_uint( const char** p, const char* end, uint32_t* value )
+{
+	const char* s = *p;
+	uint32_t    v = 0;
+
+	while ( s < end && *s >= '0' && *s <= '9' && v < 0x1000000 )
+	{
+		v = v * 10 + ( uint32_t ) ( *s - '0' );
+		s++;
+	}
+
+	if ( s == *p )
+	{
+		return false;
+	}
+
+	*p     = s;
+	*value = v;
+	return true;
+}
+
+static bool
+hdr_match( const char** p, const char* end, const char* token )
+{
+	size_t length = strlen( token );
+
+	if ( ( size_t ) ( end - *p ) < length || memcmp( *p, token, length ) != 0 )
+	{
+		return false;
+	}
+
+	*p += length;
+	return true;
+}
+
+bool
+hdr_open( const void* data, size_t size, struct hdr_image* image )
+{
+	memset( image, 0, sizeof( *image ) );
+
+	const char* p   = data;
+	const char* end = p + size;
+
+	if ( !hdr_match( &p, end, "#?RADIANCE\n" ) &&
+	     !hdr_match( &p, end, "#?RGBE\n" ) )
+	{
+		return false;
+	}
+
+	bool rgbe = false;
+
+	// header lines until the first empty one, only FORMAT matters
+	while ( p < end && *p != '\n' )
+	{
+		const char* line = p;
+		if ( hdr_match( &line, end, "FORMAT=" ) )
+		{
+			rgbe = hdr_match( &line, end, "32-bit_rle_rgbe" );
+		}
+
+		p = hdr_read_line( p, end );
+		if ( p == NULL )
+		{
+			return false;
+		}
+	}
+
+	if ( !rgbe || p == end )
+	{
+		return false;
+	}
+	p++;
+
+	if ( !hdr_match( &p, end, "-Y " ) ||
+	     !hdr_parse_uint( &p, end, &image->height ) ||
+	     !hdr_match( &p, end, " +X " ) ||
+	     !hdr_parse_uint( &p, end, &image->width ) ||
+	     !hdr_match( &p, end, "\n" ) )
+	{
+		return false;
+	}
+
+	if ( image->width == 0 || image->height == 0 )
+	{
+		return false;
+	}
+
+	image->pixels = ( const uint8_t* ) p;
+	image->end    = ( const uint8_t* ) end;
+
+	// like every other reader the first scanline decides whether the file
+	// uses the new rle scheme, flat files are plain rgbe quadruplets
+	const uint8_t* pixels = image->pixels;
+	image->rle = image->width >= HDR_MIN_RLE_WIDTH &&
+	             image->width <= HDR_MAX_RLE_WIDTH &&
+	             image->end - pixels >= 4 && pixels[ 0 ] == 2 &&
+	             pixels[ 1 ] == 2 && ( pixels[ 2 ] & 0x80 ) == 0;
+
+	return true;
+}
+
+// walks the run headers of one rle scanline without writing anything,
+// returns the start of the next scanline or NULL on malformed data
+static const uint8_t*
+hdr_skip_scanline( const uint8_t* p, const uint8_t* end, uint32_t width )
+{
+	if ( end - p < 4 || p[ 0 ] != 2 || p[ 1 ] != 2 ||
+	     ( ( uint32_t ) p[ 2 ] << 8 | p[ 3 ] ) != width )
+	{
+		return NULL;
+	}
+	p += 4;
+
+	for ( uint32_t channel = 0; channel < 4; ++channel )
+	{
+		uint32_t x = 0;
+		while ( x < width )
+		{
+			if ( p >= end )
+			{
+				return NULL;
+			}
+
+			uint32_t code = *p++;
+			uint32_t count;
+
+			if ( code > 128 )
+			{
+				count = code - 128;
+				p += 1;
+			}
+			else
+			{
+				count = code;
+				p += code;
+			}
+
+			if ( count == 0 || x + count > width || p > end )
+			{
+				return NULL;
+			}
+			x += count;
+		}
+	}
+
+	return p;
+}
+
+// expands the four channel planes of a validated scanline into rgbe
+// quadruplets
+static void
+hdr_expand_scanline( const uint8_t* p, uint32_t width, uint8_t* rgbe )
+{
+	p += 4;
+
+	for ( uint32_t channel = 0; channel < 4; ++channel )
+	{
+		uint8_t* dst = rgbe + channel;
+		uint32_t x   = 0;
+
+		while ( x < width )
+		{
+			uint32_t code = *p++;
+
+			if ( code > 128 )
+			{
+				uint8_t value = *p++;
+				for ( uint32_t i = 0; i < code - 128; ++i, dst += 4 )
+				{
+					*dst = value;
+				}
+				x += code - 128;
+			}
+			else
+			{
+				for ( uint32_t i = 0; i < code; ++i, dst += 4 )
+				{
+					*dst = *p++;
+				}
+				x += code;
+			}
+		}
+	}
+}
+
+// non negative input only, rounds to nearest even
+static uint16_t
+hdr_float_to_half( float value )
+{
+	uint32_t bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+
+	if ( bits > 0x387fffff )
+	{
+		// rebias the exponent from 127 to 15 and round the mantissa
+		return ( uint16_t ) ( ( bits + 0xc8000fff + ( ( bits >> 13 ) & 1 ) ) >>
+		                      13 );
+	}
+
+	// denormal, adding 0.5 lets the fpu align and round the mantissa
+	value += 0.5f;
+	memcpy( &bits, &value, sizeof( bits ) );
+	return ( uint16_t ) ( bits - 0x3f000000 );
+}
+
+static void
+hdr_rgbe_to_rgba16f_scalar( const uint8_t* src, uint16_t* dst, uint32_t count )
+{
+	for ( uint32_t i = 0; i < count; ++i, src += 4, dst += 4 )
+	{
+		// 2^(e - 128 - 8), exponents below 10 are far below the half range
+		uint32_t exponent   = src[ 3 ];
+		uint32_t scale_bits = exponent >= 10 ? ( exponent - 9 ) << 23 : 0;
+		float    scale;
+		memcpy( &scale, &scale_bits, sizeof( scale ) );
+
+		for ( uint32_t c = 0; c < 3; ++c )
+		{
+			float value = ( float ) src[ c ] * scale;
+			value       = value < HDR_HALF_MAX ? value : HDR_HALF_MAX;
+			dst[ c ]    = hdr_float_to_half( value );
+		}
+		dst[ 3 ] = 0x3c00;
+	}
+}
+
+#ifdef HDR_SSE2
+
+static __m128
+hdr_rgbe_to_float( __m128i rgbe )
+{
+	__m128i nine       = _mm_set1_epi32( 9 );
+	__m128i e          = _mm_shuffle_epi32( rgbe, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+	__m128i scale_bits = _mm_slli_epi32( _mm_sub_epi32( e, nine ), 23 );
+	__m128i valid      = _mm_cmpgt_epi32( e, nine );
+	__m128  scale      = _mm_castsi128_ps( _mm_and_si128( scale_bits, valid ) );
+	__m128  rgb_mask   = _mm_castsi128_ps( _mm_set_epi32( 0, -1, -1, -1 ) );
+	__m128  alpha      = _mm_set_ps( 1.0f, 0.0f, 0.0f, 0.0f );
+
+	__m128 value = _mm_mul_ps( _mm_cvtepi32_ps( rgbe ), scale );
+	value        = _mm_min_ps( value, _mm_set1_ps( HDR_HALF_MAX ) );
+	return _mm_or_ps( _mm_and_ps( value, rgb_mask ), alpha );
+}
+
+#ifdef HDR_F16C
+
+static __m128i
+hdr_pack_halves( __m128 a, __m128 b )
+{
+	return _mm_unpacklo_epi64( _mm_cvtps_ph( a, _MM_FROUND_TO_NEAREST_INT ),
+	                           _mm_cvtps_ph( b, _MM_FROUND_TO_NEAREST_INT ) );
+}
+
+#else
+
+// sse2 version of hdr_float_to_half, four lanes at a time
+static __m128i
+hdr_float_to_half4( __m128 value )
+{
+	__m128i bits = _mm_castps_si128( value );
+	__m128i odd  = _mm_and_si128( _mm_srli_epi32( bits, 13 ),
+	                              _mm_set1_epi32( 1 ) );
+	__m128i bias = _mm_set1_epi32( ( int ) 0xc8000fff );
+
+	__m128i normal = _mm_add_epi32( _mm_add_epi32( bits, bias ), odd );
+	normal         = _mm_srli_epi32( normal, 13 );
+
+	__m128i denormal = _mm_sub_epi32(
+	    _mm_castps_si128( _mm_add_ps( value, _mm_set1_ps( 0.5f ) ) ),
+	    _mm_set1_epi32( 0x3f000000 ) );
+
+	__m128i is_normal = _mm_cmpgt_epi32( bits, _mm_set1_epi32( 0x387fffff ) );
+	return _mm_or_si128( _mm_and_si128( is_normal, normal ),
+	                     _mm_andnot_si128( is_normal, denormal ) );
+}
+
+static __m128i
+hdr_pack_halves( __m128 a, __m128 b )
+{
+	// halves of clamped non negative values fit the signed saturation
+	return _mm_packs_epi32( hdr_float_to_half4( a ), hdr_float_to_half4( b ) );
+}
+
+#endif
+
+void
+hdr_rgbe_to_rgba16f( const uint8_t* src, uint16_t* dst, uint32_t count )
+{
+	__m128i  zero = _mm_setzero_si128();
+	uint32_t i    = 0;
+
+	for ( ; i + 4 <= count; i += 4, src += 16, dst += 16 )
+	{
+		__m128i texels = _mm_loadu_si128( ( const __m128i* ) src );
+		__m128i lo     = _mm_unpacklo_epi8( texels, zero );
+		__m128i hi     = _mm_unpackhi_epi8( texels, zero );
+
+		__m128 t0 = hdr_rgbe_to_float( _mm_unpacklo_epi16( lo, zero ) );
+		__m128 t1 = hdr_rgbe_to_float( _mm_unpackhi_epi16( lo, zero ) );
+		__m128 t2 = hdr_rgbe_to_float( _mm_unpacklo_epi16( hi, zero ) );
+		__m128 t3 = hdr_rgbe_to_float( _mm_unpackhi_epi16( hi, zero ) );
+
+		_mm_storeu_si128( ( __m128i* ) dst, hdr_pack_halves( t0, t1 ) );
+		_mm_storeu_si128( ( __m128i* ) ( dst + 8 ), hdr_pack_halves( t2, t3 ) );
+	}
+
+	hdr_rgbe_to_rgba16f_scalar( src, dst, count - i );
+}
+
+#else
+
+void
+hdr_rgbe_to_rgba16f( const uint8_t* src, uint16_t* dst, uint32_t count )
+{
+	hdr_rgbe_to_rgba16f_scalar( src, dst, count );
+}
+
+#endif
+
+struct hdr_decode_job
+{
+	const struct hdr_image* image;
+	const uint8_t**         scanlines;
+	uint16_t*               dst;
+};
+
+static void
+hdr_decode_rows( void* user_data, uint32_t begin, uint32_t end )
+{
+	struct hdr_decode_job*  job   = user_data;
+	const struct hdr_image* image = job->image;
+	uint32_t                width = image->width;
+	uint8_t*                rgbe  = NULL;
+
+	if ( image->rle )
+	{
+		rgbe = malloc( ( size_t ) width * 4 );
+	}
+
+	for ( uint32_t y = begin; y < end; ++y )
+	{
+		uint16_t* dst = job->dst + ( size_t ) y * width * 4;
+
+		if ( image->rle )
+		{
+			hdr_expand_scanline( job->scanlines[ y ], width, rgbe );
+			hdr_rgbe_to_rgba16f( rgbe, dst, width );
+		}
+		else
+		{
+			hdr_rgbe_to_rgba16f( image->pixels + ( size_t ) y * width * 4,
+			                     dst,
+			                     width );
+		}
+	}
+
+	free( rgbe );
+}
+
+bool
+hdr_decode_rgba16f( const struct hdr_image* image,
+                    uint16_t*               dst,
+                    bool                    parallel )
+{
+	struct hdr_decode_job job = {
+	    .image = image,
+	    .dst   = dst,
+	};
+
+	if ( image->rle )
+	{
+		// rle scanlines have no length prefix, so find where each one
+		// starts before handing them out
+		job.scanlines = malloc( image->height * sizeof( *job.scanlines ) );
+
+		const uint8_t* p = image->pixels;
+		for ( uint32_t y = 0; y < image->height; ++y )
+		{
+			job.scanlines[ y ] = p;
+			p = hdr_skip_scanline( p, image->end, image->width );
+			if ( p == NULL )
+			{
+				free( job.scanlines );
+				return false;
+			}
+		}
+	}
+	else if ( ( size_t ) ( image->end - image->pixels ) / 4 / image->width <
+	          image->height )
+	{
+		return false;
+	}
+
+	if ( parallel )
+	{
+		job_system_parallel_for( image->height,
+		                         HDR_ROW_BATCH,
+		                         hdr_decode_rows,
+		                         &job );
+	}
+	else
+	{
+		hdr_decode_rows( &job, 0, image->height );
+	}
+
+	free( job.scanlines );
+
+	return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// radiance rgbe (.hdr) decoder writing rgba16f texels directly. the file is
+// expected to be memory mapped, hdr_open only parses the text header
+struct hdr_image
+{
+	uint32_t       width;
+	uint32_t       height;
+	bool           rle;
+	const uint8_t* pixels;
+	const uint8_t* end;
+};
+
+// accepts 32-bit_rle_rgbe images in the standard -Y h +X w orientation,
+// anything else is left to ft_read_image_from_file
+bool
+hdr_open( const void* data, size_t size, struct hdr_image* image );
+
+// dst receives width * height * 4 halves. scanline offsets are found with a
+// serial pass over the rle run headers, the scanlines are then decoded and
+// converted on the job system when parallel is set
+bool
+hdr_decode_rgba16f( const struct hdr_image* image,
+                    uint16_t*               dst,
+                    bool                    parallel );
+
+// rgbe to rgba16f for count texels, alpha is set to one and values are
+// clamped to the largest finite half
+void
+hdr_rgbe_to_rgba16f( const uint8_t* src, uint16_t* dst, uint32_t count );
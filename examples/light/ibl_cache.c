@@ -0,0 +1,584 @@
+#include <fluent/fluent.h>
+
+#include "ibl_cache.h"
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME        0x100000001b3ull
+
+static uint64_t
+fnv1a( uint64_t hash, const void* data, size_t size )
+{
+	const uint8_t* bytes = data;
+
+	for ( size_t i = 0; i < size; ++i )
+	{
+		hash ^= bytes[ i ];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+static uint64_t
+align_up( uint64_t value, uint64_t alignment )
+{
+	return ( value + alignment - 1 ) & ~( alignment - 1 );
+}
+
+static const char* map_names[ IBL_MAP_COUNT ] = {
+    [IBL_MAP_ENVIRONMENT] = "environment",
+    [IBL_MAP_IRRADIANCE]  = "irradiance",
+    [IBL_MAP_SPECULAR]    = "specular",
+    [IBL_MAP_BRDF_LUT]    = "brdf_lut",
+};
+
+static const struct
+{
+	uint32_t    format;
+	const char* name;
+	uint32_t    texel_size;
+	uint32_t    channel_count;
+} formats[] = {
+    { FT_FORMAT_R32G32B32A32_SFLOAT, "rgba32f", 16, 4 },
+    { FT_FORMAT_R16G16B16A16_SFLOAT, "rgba16f", 8, 4 },
+    { FT_FORMAT_B10G11R11_UFLOAT_PACK32, "r11g11b10f", 4, 4 },
+    { FT_FORMAT_R32G32_SFLOAT, "rg32f", 8, 2 },
+    { FT_FORMAT_R16G16_UNORM, "rg16", 4, 2 },
+    { FT_FORMAT_R16G16_SFLOAT, "rg16f", 4, 2 },
+};
+
+// unsigned float with a 5 bit exponent, covers half floats (without the
+// sign) and the r11g11b10 channels. rounds to nearest even and clamps to
+// the largest finite value
+static uint32_t
+float_to_ufloat( float value, uint32_t mantissa_bits )
+{
+	if ( !( value > 0.0f ) )
+	{
+		return 0;
+	}
+
+	uint32_t bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+
+	uint32_t max_finite = ( 30u << mantissa_bits ) |
+	                      ( ( 1u << mantissa_bits ) - 1 );
+	int32_t  exponent   = ( int32_t ) ( ( bits >> 23 ) & 0xFF ) - 127 + 15;
+	uint32_t mantissa   = bits & 0x7FFFFF;
+	uint32_t shift      = 23 - mantissa_bits;
+
+	if ( exponent >= 31 )
+	{
+		return max_finite;
+	}
+
+	if ( exponent <= 0 )
+	{
+		if ( exponent < -( int32_t ) mantissa_bits )
+		{
+			return 0;
+		}
+
+		mantissa |= 0x800000;
+		shift += ( uint32_t ) ( 1 - exponent );
+		exponent = 0;
+	}
+
+	uint32_t result = ( ( uint32_t ) exponent << mantissa_bits ) |
+	                  ( mantissa >> shift );
+	uint32_t rest    = mantissa & ( ( 1u << shift ) - 1 );
+	uint32_t halfway = 1u << ( shift - 1 );
+
+	if ( rest > halfway || ( rest == halfway && ( result & 1 ) ) )
+	{
+		result++;
+	}
+
+	return FT_MIN( result, max_finite );
+}
+
+static float
+ufloat_to_float( uint32_t value, uint32_t mantissa_bits )
+{
+	uint32_t exponent = value >> mantissa_bits;
+	float    mantissa =
+	    ( float ) ( value & ( ( 1u << mantissa_bits ) - 1 ) ) /
+	    ( float ) ( 1u << mantissa_bits );
+
+	if ( exponent == 0 )
+	{
+		return ldexpf( mantissa, -14 );
+	}
+
+	if ( exponent == 31 )
+	{
+		return INFINITY;
+	}
+
+	return ldexpf( 1.0f + mantissa, ( int32_t ) exponent - 15 );
+}
+
+static uint16_t
+float_to_half( float value )
+{
+	uint16_t sign = value < 0.0f ? 0x8000 : 0;
+	return sign | ( uint16_t ) float_to_ufloat( fabsf( value ), 10 );
+}
+
+static float
+half_to_float( uint16_t value )
+{
+	float result = ufloat_to_float( value & 0x7FFF, 10 );
+	return ( value & 0x8000 ) ? -result : result;
+}
+
+static uint16_t
+float_to_unorm16( float value )
+{
+	value = value < 0.0f ? 0.0f : ( value > 1.0f ? 1.0f : value );
+	return ( uint16_t ) ( value * 65535.0f + 0.5f );
+}
+
+const char*
+ibl_map_name( enum ibl_map map )
+{
+	return map_names[ map ];
+}
+
+uint32_t
+ibl_format_texel_size( uint32_t format )
+{
+	for ( uint32_t i = 0; i < FT_COUNTOF( formats ); ++i )
+	{
+		if ( formats[ i ].format == format )
+		{
+			return formats[ i ].texel_size;
+		}
+	}
+
+	return 0;
+}
+
+uint32_t
+ibl_format_channel_count( uint32_t format )
+{
+	for ( uint32_t i = 0; i < FT_COUNTOF( formats ); ++i )
+	{
+		if ( formats[ i ].format == format )
+		{
+			return formats[ i ].channel_count;
+		}
+	}
+
+	return 0;
+}
+
+const char*
+ibl_format_name( uint32_t format )
+{
+	for ( uint32_t i = 0; i < FT_COUNTOF( formats ); ++i )
+	{
+		if ( formats[ i ].format == format )
+		{
+			return formats[ i ].name;
+		}
+	}
+
+	return "unknown";
+}
+
+bool
+ibl_format_parse( const char* name, uint32_t* format )
+{
+	for ( uint32_t i = 0; i < FT_COUNTOF( formats ); ++i )
+	{
+		if ( strcmp( formats[ i ].name, name ) == 0 )
+		{
+			*format = formats[ i ].format;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void
+ibl_format_encode( uint32_t     format,
+                   const float* src,
+                   size_t       texel_count,
+                   void*        dst )
+{
+	uint16_t* dst16 = dst;
+	uint32_t* dst32 = dst;
+
+	switch ( format )
+	{
+	case FT_FORMAT_R16G16B16A16_SFLOAT:
+	{
+		for ( size_t i = 0; i < texel_count * 4; ++i )
+		{
+			dst16[ i ] = float_to_half( src[ i ] );
+		}
+		break;
+	}
+	case FT_FORMAT_B10G11R11_UFLOAT_PACK32:
+	{
+		for ( size_t i = 0; i < texel_count; ++i )
+		{
+			const float* c = &src[ i * 4 ];
+			dst32[ i ]     = float_to_ufloat( c[ 0 ], 6 ) |
+			             ( float_to_ufloat( c[ 1 ], 6 ) << 11 ) |
+			             ( float_to_ufloat( c[ 2 ], 5 ) << 22 );
+		}
+		break;
+	}
+	case FT_FORMAT_R16G16_UNORM:
+	{
+		for ( size_t i = 0; i < texel_count * 2; ++i )
+		{
+			dst16[ i ] = float_to_unorm16( src[ i ] );
+		}
+		break;
+	}
+	case FT_FORMAT_R16G16_SFLOAT:
+	{
+		for ( size_t i = 0; i < texel_count * 2; ++i )
+		{
+			dst16[ i ] = float_to_half( src[ i ] );
+		}
+		break;
+	}
+	default:
+	{
+		memcpy( dst, src, texel_count * ibl_format_texel_size( format ) );
+		break;
+	}
+	}
+}
+
+void
+ibl_format_decode( uint32_t    format,
+                   const void* src,
+                   size_t      texel_count,
+                   float*      dst )
+{
+	const uint16_t* src16 = src;
+	const uint32_t* src32 = src;
+
+	switch ( format )
+	{
+	case FT_FORMAT_R16G16B16A16_SFLOAT:
+	{
+		for ( size_t i = 0; i < texel_count * 4; ++i )
+		{
+			dst[ i ] = half_to_float( src16[ i ] );
+		}
+		break;
+	}
+	case FT_FORMAT_B10G11R11_UFLOAT_PACK32:
+	{
+		for ( size_t i = 0; i < texel_count; ++i )
+		{
+			float* c = &dst[ i * 4 ];
+			c[ 0 ]   = ufloat_to_float( src32[ i ] & 0x7FF, 6 );
+			c[ 1 ]   = ufloat_to_float( ( src32[ i ] >> 11 ) & 0x7FF, 6 );
+			c[ 2 ]   = ufloat_to_float( src32[ i ] >> 22, 5 );
+			c[ 3 ]   = 1.0f;
+		}
+		break;
+	}
+	case FT_FORMAT_R16G16_UNORM:
+	{
+		for ( size_t i = 0; i < texel_count * 2; ++i )
+		{
+			dst[ i ] = ( float ) src16[ i ] / 65535.0f;
+		}
+		break;
+	}
+	case FT_FORMAT_R16G16_SFLOAT:
+	{
+		for ( size_t i = 0; i < texel_count * 2; ++i )
+		{
+			dst[ i ] = half_to_float( src16[ i ] );
+		}
+		break;
+	}
+	default:
+	{
+		memcpy( dst, src, texel_count * ibl_format_texel_size( format ) );
+		break;
+	}
+	}
+}
+
+uint64_t
+ibl_cache_key( const void*                   source,
+               size_t                        source_size,
+               const struct ibl_bake_params* params )
+{
+	uint32_t version = IBL_CACHE_VERSION;
+
+	uint64_t hash = FNV_OFFSET_BASIS;
+	hash          = fnv1a( hash, &version, sizeof( version ) );
+	hash          = fnv1a( hash, source, source_size );
+	hash = fnv1a( hash, &params->skybox_size, sizeof( params->skybox_size ) );
+	hash = fnv1a( hash,
+	              &params->irradiance_size,
+	              sizeof( params->irradiance_size ) );
+	hash = fnv1a( hash,
+	              &params->specular_size,
+	              sizeof( params->specular_size ) );
+	hash = fnv1a( hash,
+	              &params->brdf_lut_size,
+	              sizeof( params->brdf_lut_size ) );
+	hash = fnv1a( hash,
+	              &params->importance_sample_count,
+	              sizeof( params->importance_sample_count ) );
+	hash = fnv1a( hash,
+	              &params->irradiance_sample_delta,
+	              sizeof( params->irradiance_sample_delta ) );
+	hash = fnv1a( hash,
+	              &params->irradiance_mode,
+	              sizeof( params->irradiance_mode ) );
+	hash = fnv1a( hash, &params->cube_format, sizeof( params->cube_format ) );
+	hash = fnv1a( hash, &params->lut_format, sizeof( params->lut_format ) );
+
+	return hash;
+}
+
+static uint32_t
+mip_count( uint32_t size )
+{
+	return ( uint32_t ) log2( size ) + 1;
+}
+
+void
+ibl_cache_init_header( struct ibl_cache_header*      header,
+                       uint64_t                      key,
+                       const struct ibl_bake_params* params )
+{
+	memset( header, 0, sizeof( *header ) );
+	header->magic   = IBL_CACHE_MAGIC;
+	header->version = IBL_CACHE_VERSION;
+	header->key     = key;
+
+	struct ibl_cache_image* images = header->images;
+
+	uint32_t cube_texel_size = ibl_format_texel_size( params->cube_format );
+
+	images[ IBL_MAP_ENVIRONMENT ] = ( struct ibl_cache_image ) {
+	    .format      = params->cube_format,
+	    .width       = params->skybox_size,
+	    .height      = params->skybox_size,
+	    .layer_count = 6,
+	    .mip_levels  = mip_count( params->skybox_size ),
+	    .texel_size  = cube_texel_size,
+	};
+
+	images[ IBL_MAP_IRRADIANCE ] = ( struct ibl_cache_image ) {
+	    .format      = params->cube_format,
+	    .width       = params->irradiance_size,
+	    .height      = params->irradiance_size,
+	    .layer_count = 6,
+	    .mip_levels  = 1,
+	    .texel_size  = cube_texel_size,
+	};
+
+	// sh coefficients are signed, they always stay 32 bit float
+	if ( params->irradiance_mode == IBL_IRRADIANCE_SH )
+	{
+		struct ibl_cache_image* sh = &images[ IBL_MAP_IRRADIANCE ];
+		sh->format                 = FT_FORMAT_R32G32B32A32_SFLOAT;
+		sh->width                  = 3;
+		sh->height                 = 3;
+		sh->layer_count            = 1;
+		sh->texel_size             = 4 * sizeof( float );
+	}
+
+	images[ IBL_MAP_SPECULAR ] = ( struct ibl_cache_image ) {
+	    .format      = params->cube_format,
+	    .width       = params->specular_size,
+	    .height      = params->specular_size,
+	    .layer_count = 6,
+	    .mip_levels  = mip_count( params->specular_size ),
+	    .texel_size  = cube_texel_size,
+	};
+
+	images[ IBL_MAP_BRDF_LUT ] = ( struct ibl_cache_image ) {
+	    .format      = params->lut_format,
+	    .width       = params->brdf_lut_size,
+	    .height      = params->brdf_lut_size,
+	    .layer_count = 1,
+	    .mip_levels  = 1,
+	    .texel_size  = ibl_format_texel_size( params->lut_format ),
+	};
+
+	uint64_t offset = align_up( sizeof( *header ), IBL_CACHE_ALIGNMENT );
+
+	for ( uint32_t i = 0; i < IBL_MAP_COUNT; ++i )
+	{
+		images[ i ].offset = offset;
+		images[ i ].size =
+		    ibl_cache_mip_offset( &images[ i ], images[ i ].mip_levels );
+		offset = align_up( offset + images[ i ].size, IBL_CACHE_ALIGNMENT );
+	}
+}
+
+uint32_t
+ibl_cache_mip_size( const struct ibl_cache_image* image, uint32_t mip )
+{
+	return FT_MAX( 1u, image->width >> mip );
+}
+
+uint64_t
+ibl_cache_mip_offset( const struct ibl_cache_image* image, uint32_t mip )
+{
+	uint64_t offset = 0;
+
+	for ( uint32_t m = 0; m < mip; ++m )
+	{
+		uint64_t size = ibl_cache_mip_size( image, m );
+		offset += size * size * image->layer_count * image->texel_size;
+	}
+
+	return offset;
+}
+
+bool
+ibl_cache_writer_begin( struct ibl_cache_writer*       writer,
+                        const char*                    filename,
+                        const struct ibl_cache_header* header )
+{
+	memset( writer, 0, sizeof( *writer ) );
+	writer->header = *header;
+
+	snprintf( writer->filename, sizeof( writer->filename ), "%s", filename );
+	snprintf( writer->tmp_filename,
+	          sizeof( writer->tmp_filename ),
+	          "%s.tmp",
+	          filename );
+
+	// write to a temporary file first so an interrupted bake never leaves
+	// a truncated cache behind
+	writer->file = fopen( writer->tmp_filename, "wb" );
+
+	if ( writer->file == NULL )
+	{
+		return false;
+	}
+
+	ibl_cache_writer_write( writer, header, sizeof( *header ) );
+
+	return true;
+}
+
+void
+ibl_cache_writer_begin_image( struct ibl_cache_writer* writer,
+                              enum ibl_map             map )
+{
+	static const uint8_t zeros[ IBL_CACHE_ALIGNMENT ] = { 0 };
+
+	uint64_t offset = writer->header.images[ map ].offset;
+
+	while ( writer->offset < offset )
+	{
+		size_t pad = ( size_t ) FT_MIN( offset - writer->offset,
+		                                ( uint64_t ) sizeof( zeros ) );
+		ibl_cache_writer_write( writer, zeros, pad );
+	}
+}
+
+void
+ibl_cache_writer_write( struct ibl_cache_writer* writer,
+                        const void*              data,
+                        size_t                   size )
+{
+	if ( writer->file && fwrite( data, 1, size, writer->file ) != size )
+	{
+		fclose( writer->file );
+		remove( writer->tmp_filename );
+		writer->file = NULL;
+	}
+
+	writer->offset += size;
+}
+
+bool
+ibl_cache_writer_end( struct ibl_cache_writer* writer )
+{
+	if ( writer->file == NULL )
+	{
+		return false;
+	}
+
+	bool ok = fclose( writer->file ) == 0;
+	writer->file = NULL;
+
+	if ( ok )
+	{
+		remove( writer->filename );
+		ok = rename( writer->tmp_filename, writer->filename ) == 0;
+	}
+
+	if ( !ok )
+	{
+		remove( writer->tmp_filename );
+	}
+
+	return ok;
+}
+
+void
+ibl_cache_report( const struct ibl_cache_header* header )
+{
+	const double mb = 1024.0 * 1024.0;
+
+	uint64_t total      = 0;
+	uint64_t total_full = 0;
+
+	for ( uint32_t i = 0; i < IBL_MAP_COUNT; ++i )
+	{
+		const struct ibl_cache_image* image = &header->images[ i ];
+
+		uint32_t full_texel_size =
+		    ibl_format_channel_count( image->format ) * sizeof( float );
+		uint64_t full_size =
+		    image->size / image->texel_size * full_texel_size;
+
+		ft_log_info( "ibl %-12s %4ux%-4u x%u mips %-2u %-10s %8.2f MB "
+		             "(%8.2f MB as float), %2u B/texel fetched",
+		             map_names[ i ],
+		             image->width,
+		             image->height,
+		             image->layer_count,
+		             image->mip_levels,
+		             ibl_format_name( image->format ),
+		             ( double ) image->size / mb,
+		             ( double ) full_size / mb,
+		             image->texel_size );
+
+		total += image->size;
+		total_full += full_size;
+	}
+
+	ft_log_info( "ibl total %.2f MB, %.2f MB as float (%.0f%% saved)",
+	             ( double ) total / mb,
+	             ( double ) total_full / mb,
+	             100.0 * ( 1.0 - ( double ) total / ( double ) total_full ) );
+}
+
+bool
+ibl_cache_validate( const void*                    data,
+                    size_t                         size,
+                    const struct ibl_cache_header* expected )
+{
+	if ( size < sizeof( *expected ) ||
+	     memcmp( data, expected, sizeof( *expected ) ) != 0 )
+	{
+		return false;
+	}
+
+	const struct ibl_cache_image* last = &expected->images[ IBL_MAP_COUNT - 1 ];
+
+	return last->offset + last->size <= size;
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct ft_device;
+struct ft_queue;
+struct ft_command_buffer;
+struct ft_buffer;
+struct pbr_maps;
+
+#define IBL_CACHE_MAGIC     0x4C424946u // "FIBL"
+#define IBL_CACHE_VERSION   2
+#define IBL_CACHE_ALIGNMENT 256
+
+// must match the sample counts used by the bake shaders
+#define IBL_IRRADIANCE_SAMPLE_DELTA 0.25f
+#define IBL_IMPORTANCE_SAMPLE_COUNT 64
+
+// diffuse irradiance as l2 spherical harmonics, projected from the
+// environment mip of IBL_SH_SOURCE_SIZE
+#define IBL_SH_COEFFICIENT_COUNT 9
+#define IBL_SH_SOURCE_SIZE       64
+
+// bake and readback shaders are built once per storage format, these
+// pick the variant matching a cube or lut format
+#define IBL_CUBE_SHADER( name, api, format )                                   \
+	( ( format ) == FT_FORMAT_R16G16B16A16_SFLOAT                              \
+	      ? get_##name##_rgba16f_comp_shader( api )                            \
+	  : ( format ) == FT_FORMAT_B10G11R11_UFLOAT_PACK32                        \
+	      ? get_##name##_r11g11b10f_comp_shader( api )                         \
+	      : get_##name##_comp_shader( api ) )
+
+#define IBL_LUT_SHADER( name, api, format )                                    \
+	( ( format ) == FT_FORMAT_R16G16_UNORM                                     \
+	      ? get_##name##_rg16_comp_shader( api )                               \
+	  : ( format ) == FT_FORMAT_R16G16_SFLOAT                                  \
+	      ? get_##name##_rg16f_comp_shader( api )                              \
+	      : get_##name##_comp_shader( api ) )
+
+enum ibl_map
+{
+	IBL_MAP_ENVIRONMENT,
+	IBL_MAP_IRRADIANCE,
+	IBL_MAP_SPECULAR,
+	IBL_MAP_BRDF_LUT,
+	IBL_MAP_COUNT,
+};
+
+enum ibl_irradiance_mode
+{
+	IBL_IRRADIANCE_CUBEMAP,
+	IBL_IRRADIANCE_SH,
+};
+
+struct ibl_bake_params
+{
+	uint32_t skybox_size;
+	uint32_t irradiance_size;
+	uint32_t specular_size;
+	uint32_t brdf_lut_size;
+	uint32_t importance_sample_count;
+	float    irradiance_sample_delta;
+	uint32_t irradiance_mode;
+	uint32_t cube_format;
+	uint32_t lut_format;
+};
+
+// every image is stored mip by mip, each mip holds layer_count tightly
+// packed layers, so a mip can be handed to the uploader as is. in sh mode
+// the irradiance entry is a single 3x3 rgba32f block holding the nine
+// coefficients
+struct ibl_cache_image
+{
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t layer_count;
+	uint32_t mip_levels;
+	uint32_t texel_size;
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct ibl_cache_header
+{
+	uint32_t               magic;
+	uint32_t               version;
+	uint64_t               key;
+	struct ibl_cache_image images[ IBL_MAP_COUNT ];
+};
+
+struct ibl_cache_writer
+{
+	FILE*                   file;
+	uint64_t                offset;
+	struct ibl_cache_header header;
+	char                    filename[ 512 ];
+	char                    tmp_filename[ 512 ];
+};
+
+const char*
+ibl_map_name( enum ibl_map map );
+
+// storage formats the bake shaders have variants for, cube maps take
+// rgba32f, rgba16f or r11g11b10f, the brdf lut rg32f, rg16 or rg16f
+uint32_t
+ibl_format_texel_size( uint32_t format );
+
+uint32_t
+ibl_format_channel_count( uint32_t format );
+
+const char*
+ibl_format_name( uint32_t format );
+
+bool
+ibl_format_parse( const char* name, uint32_t* format );
+
+// convert between the float layout the bakers work in and a storage
+// format, the float side has ibl_format_channel_count channels per texel
+void
+ibl_format_encode( uint32_t     format,
+                   const float* src,
+                   size_t       texel_count,
+                   void*        dst );
+
+void
+ibl_format_decode( uint32_t    format,
+                   const void* src,
+                   size_t      texel_count,
+                   float*      dst );
+
+uint64_t
+ibl_cache_key( const void*                   source,
+               size_t                        source_size,
+               const struct ibl_bake_params* params );
+
+void
+ibl_cache_init_header( struct ibl_cache_header*      header,
+                       uint64_t                      key,
+                       const struct ibl_bake_params* params );
+
+uint32_t
+ibl_cache_mip_size( const struct ibl_cache_image* image, uint32_t mip );
+
+uint64_t
+ibl_cache_mip_offset( const struct ibl_cache_image* image, uint32_t mip );
+
+bool
+ibl_cache_writer_begin( struct ibl_cache_writer*       writer,
+                        const char*                    filename,
+                        const struct ibl_cache_header* header );
+
+void
+ibl_cache_writer_begin_image( struct ibl_cache_writer* writer,
+                              enum ibl_map             map );
+
+void
+ibl_cache_writer_write( struct ibl_cache_writer* writer,
+                        const void*              data,
+                        size_t                   size );
+
+bool
+ibl_cache_writer_end( struct ibl_cache_writer* writer );
+
+// logs the size of every map next to its 32 bit float equivalent
+void
+ibl_cache_report( const struct ibl_cache_header* header );
+
+bool
+ibl_cache_validate( const void*                    data,
+                    size_t                         size,
+                    const struct ibl_cache_header* expected );
+
+// uniform buffer the sh projection writes to and pbr.frag.glsl reads from,
+// host visible so the cache can fill and read it without a staging copy
+void
+ibl_create_sh_buffer( const struct ft_device* device,
+                      struct ft_buffer**      buffer );
+
+bool
+ibl_cache_load( const struct ft_device*       device,
+                const char*                   filename,
+                uint64_t                      key,
+                const struct ibl_bake_params* params,
+                struct pbr_maps*              maps );
+
+bool
+ibl_cache_save( const struct ft_device*       device,
+                struct ft_queue*              queue,
+                struct ft_command_buffer*     cmd,
+                const char*                   filename,
+                uint64_t                      key,
+                const struct ibl_bake_params* params,
+                const struct pbr_maps*        maps );
@@ -0,0 +1,327 @@
+#include <fluent/fluent.h>
+
+#include "cube_readback.comp.h"
+#include "lut_readback.comp.h"
+#include "file_map.h"
+#include "pipeline_timer.h"
+#include "main_pass.h"
+#include "ibl_cache.h"
+
+void
+ibl_create_sh_buffer( const struct ft_device* device,
+                      struct ft_buffer**      buffer )
+{
+	struct ft_buffer_info info = {
+	    .size = IBL_SH_COEFFICIENT_COUNT * 4 * sizeof( float ),
+	    .descriptor_type =
+	        FT_DESCRIPTOR_TYPE_UNIFORM_BUFFER | FT_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+	    .memory_usage = FT_MEMORY_USAGE_CPU_TO_GPU,
+	};
+
+	ft_create_buffer( device, &info, buffer );
+}
+
+bool
+ibl_cache_load( const struct ft_device*       device,
+                const char*                   filename,
+                uint64_t                      key,
+                const struct ibl_bake_params* params,
+                struct pbr_maps*              maps )
+{
+	struct file_map map;
+
+	if ( !file_map_open( filename, &map ) )
+	{
+		return false;
+	}
+
+	struct ibl_cache_header expected;
+	ibl_cache_init_header( &expected, key, params );
+
+	if ( !ibl_cache_validate( map.data, map.size, &expected ) )
+	{
+		ft_log_warn( "ibl cache %s is stale or corrupted, rebaking",
+		             filename );
+		file_map_close( &map );
+		return false;
+	}
+
+	const struct ibl_cache_header* header = map.data;
+
+	maps->irradiance_mode = params->irradiance_mode;
+
+	struct ft_image** images[ IBL_MAP_COUNT ] = {
+	    [IBL_MAP_ENVIRONMENT] = &maps->environment,
+	    [IBL_MAP_IRRADIANCE]  = &maps->irradiance,
+	    [IBL_MAP_SPECULAR]    = &maps->specular,
+	    [IBL_MAP_BRDF_LUT]    = &maps->brdf_lut,
+	};
+
+	for ( uint32_t i = 0; i < IBL_MAP_COUNT; ++i )
+	{
+		const struct ibl_cache_image* image = &header->images[ i ];
+
+		if ( i == IBL_MAP_IRRADIANCE &&
+		     params->irradiance_mode == IBL_IRRADIANCE_SH )
+		{
+			ibl_create_sh_buffer( device, &maps->irradiance_sh );
+			void* dst = ft_map_memory( device, maps->irradiance_sh );
+			memcpy( dst,
+			        ( uint8_t* ) map.data + image->offset,
+			        ( size_t ) image->size );
+			ft_unmap_memory( device, maps->irradiance_sh );
+			continue;
+		}
+
+		struct ft_image_info info = {
+		    .width           = image->width,
+		    .height          = image->height,
+		    .depth           = 1,
+		    .format          = ( enum ft_format ) image->format,
+		    .mip_levels      = image->mip_levels,
+		    .layer_count     = image->layer_count,
+		    .sample_count    = 1,
+		    .descriptor_type = FT_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+		};
+
+		ft_create_image( device, &info, images[ i ] );
+
+		for ( uint32_t mip = 0; mip < image->mip_levels; ++mip )
+		{
+			struct ft_image_upload_job job = {
+			    .image     = *images[ i ],
+			    .width     = ibl_cache_mip_size( image, mip ),
+			    .height    = ibl_cache_mip_size( image, mip ),
+			    .mip_level = mip,
+			    .data      = ( uint8_t* ) map.data + image->offset +
+			            ibl_cache_mip_offset( image, mip ),
+			};
+
+			ft_upload_image( &job );
+		}
+	}
+
+	ft_resource_loader_wait_idle();
+
+	file_map_close( &map );
+
+	return true;
+}
+
+struct readback_pipeline
+{
+	struct ft_shader*                shader;
+	struct ft_descriptor_set_layout* dsl;
+	struct ft_pipeline*              pipeline;
+	struct ft_descriptor_set*        set;
+};
+
+static void
+create_readback_pipeline( const struct ft_device*   device,
+                          const char*               name,
+                          struct ft_shader_info*    shader_info,
+                          struct readback_pipeline* p )
+{
+	ft_create_shader( device, shader_info, &p->shader );
+	ft_create_descriptor_set_layout( device, p->shader, &p->dsl );
+
+	struct ft_pipeline_info pipeline_info = {
+	    .type                  = FT_PIPELINE_TYPE_COMPUTE,
+	    .shader                = p->shader,
+	    .descriptor_set_layout = p->dsl,
+	};
+	create_timed_pipeline( device, name, &pipeline_info, &p->pipeline );
+
+	struct ft_descriptor_set_info set_info = {
+	    .descriptor_set_layout = p->dsl,
+	    .set                   = 0,
+	};
+	ft_create_descriptor_set( device, &set_info, &p->set );
+}
+
+static void
+destroy_readback_pipeline( const struct ft_device*   device,
+                           struct readback_pipeline* p )
+{
+	ft_destroy_descriptor_set( device, p->set );
+	ft_destroy_pipeline( device, p->pipeline );
+	ft_destroy_descriptor_set_layout( device, p->dsl );
+	ft_destroy_shader( device, p->shader );
+}
+
+bool
+ibl_cache_save( const struct ft_device*       device,
+                struct ft_queue*              queue,
+                struct ft_command_buffer*     cmd,
+                const char*                   filename,
+                uint64_t                      key,
+                const struct ibl_bake_params* params,
+                const struct pbr_maps*        maps )
+{
+	struct ibl_cache_header header;
+	ibl_cache_init_header( &header, key, params );
+
+	struct ibl_cache_writer writer;
+	if ( !ibl_cache_writer_begin( &writer, filename, &header ) )
+	{
+		ft_log_warn( "failed to open %s for writing", filename );
+		return false;
+	}
+
+	enum ft_renderer_api api = ft_get_device_api( device );
+
+	struct ft_shader_info shader_info;
+	memset( &shader_info, 0, sizeof( shader_info ) );
+
+	struct readback_pipeline cube_readback;
+	struct readback_pipeline lut_readback;
+	shader_info.compute = IBL_CUBE_SHADER( cube_readback,
+	                                       api,
+	                                       params->cube_format );
+	create_readback_pipeline( device,
+	                          "cube readback",
+	                          &shader_info,
+	                          &cube_readback );
+	shader_info.compute = IBL_LUT_SHADER( lut_readback,
+	                                      api,
+	                                      params->lut_format );
+	create_readback_pipeline( device,
+	                          "lut readback",
+	                          &shader_info,
+	                          &lut_readback );
+
+	// one layer of the largest mip is the biggest chunk we read back at once
+	uint64_t staging_size = 0;
+	for ( uint32_t i = 0; i < IBL_MAP_COUNT; ++i )
+	{
+		const struct ibl_cache_image* image = &header.images[ i ];
+		uint64_t layer_size =
+		    ( uint64_t ) image->width * image->height * image->texel_size;
+		staging_size = FT_MAX( staging_size, layer_size );
+	}
+
+	struct ft_buffer_info buffer_info = {
+	    .size            = staging_size,
+	    .descriptor_type = FT_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+	    .memory_usage    = FT_MEMORY_USAGE_GPU_TO_CPU,
+	};
+
+	struct ft_buffer* staging;
+	ft_create_buffer( device, &buffer_info, &staging );
+
+	struct ft_image* images[ IBL_MAP_COUNT ] = {
+	    [IBL_MAP_ENVIRONMENT] = maps->environment,
+	    [IBL_MAP_IRRADIANCE]  = maps->irradiance,
+	    [IBL_MAP_SPECULAR]    = maps->specular,
+	    [IBL_MAP_BRDF_LUT]    = maps->brdf_lut,
+	};
+
+	for ( uint32_t i = 0; i < IBL_MAP_COUNT; ++i )
+	{
+		const struct ibl_cache_image* image = &header.images[ i ];
+		struct readback_pipeline*     p =
+		    i == IBL_MAP_BRDF_LUT ? &lut_readback : &cube_readback;
+
+		ibl_cache_writer_begin_image( &writer, i );
+
+		if ( i == IBL_MAP_IRRADIANCE &&
+		     params->irradiance_mode == IBL_IRRADIANCE_SH )
+		{
+			void* data = ft_map_memory( device, maps->irradiance_sh );
+			ibl_cache_writer_write( &writer, data, ( size_t ) image->size );
+			ft_unmap_memory( device, maps->irradiance_sh );
+			continue;
+		}
+
+		for ( uint32_t mip = 0; mip < image->mip_levels; ++mip )
+		{
+			uint32_t size = ibl_cache_mip_size( image, mip );
+
+			struct ft_image_descriptor image_descriptor = {
+			    .image          = images[ i ],
+			    .resource_state = FT_RESOURCE_STATE_GENERAL,
+			    .mip_level      = mip,
+			};
+
+			struct ft_buffer_descriptor buffer_descriptor = {
+			    .buffer = staging,
+			    .offset = 0,
+			    .range  = staging_size,
+			};
+
+			struct ft_descriptor_write writes[ 2 ] = {
+			    [0] =
+			        {
+			            .descriptor_count  = 1,
+			            .descriptor_name   = "u_src",
+			            .image_descriptors = &image_descriptor,
+			        },
+			    [1] =
+			        {
+			            .descriptor_count   = 1,
+			            .descriptor_name    = "u_dst",
+			            .buffer_descriptors = &buffer_descriptor,
+			        },
+			};
+
+			ft_update_descriptor_set( device,
+			                          p->set,
+			                          FT_COUNTOF( writes ),
+			                          writes );
+
+			for ( uint32_t layer = 0; layer < image->layer_count; ++layer )
+			{
+				struct
+				{
+					uint32_t mip_size;
+					uint32_t layer;
+				} pc = { size, layer };
+
+				struct ft_image_barrier barrier = {
+				    .image     = images[ i ],
+				    .old_state = FT_RESOURCE_STATE_SHADER_READ_ONLY,
+				    .new_state = FT_RESOURCE_STATE_GENERAL,
+				};
+
+				ft_begin_command_buffer( cmd );
+				ft_cmd_barrier( cmd, 0, NULL, 0, NULL, 1, &barrier );
+				ft_cmd_bind_pipeline( cmd, p->pipeline );
+				ft_cmd_bind_descriptor_set( cmd, 0, p->set, p->pipeline );
+				ft_cmd_push_constants( cmd,
+				                       p->pipeline,
+				                       0,
+				                       sizeof( pc ),
+				                       &pc );
+				ft_cmd_dispatch( cmd,
+				                 ( size + 15 ) / 16,
+				                 ( size + 15 ) / 16,
+				                 1 );
+				barrier.old_state = FT_RESOURCE_STATE_GENERAL;
+				barrier.new_state = FT_RESOURCE_STATE_SHADER_READ_ONLY;
+				ft_cmd_barrier( cmd, 0, NULL, 0, NULL, 1, &barrier );
+				ft_end_command_buffer( cmd );
+
+				ft_immediate_submit( queue, cmd );
+
+				void* data = ft_map_memory( device, staging );
+				ibl_cache_writer_write( &writer,
+				                        data,
+				                        ( size_t ) size * size *
+				                            image->texel_size );
+				ft_unmap_memory( device, staging );
+			}
+		}
+	}
+
+	ft_destroy_buffer( device, staging );
+	destroy_readback_pipeline( device, &lut_readback );
+	destroy_readback_pipeline( device, &cube_readback );
+
+	if ( !ibl_cache_writer_end( &writer ) )
+	{
+		ft_log_warn( "failed to write ibl cache %s", filename );
+		return false;
+	}
+
+	return true;
+}
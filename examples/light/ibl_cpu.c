@@ -0,0 +1,1022 @@
+#include <fluent/fluent.h>
+
+#include "simd.h"
+#include "job_system.h"
+#include "ibl_cpu.h"
+
+#define PI                          3.14159265359f
+#define MAX_SEGMENT_COUNT           32
+#define ROWS_PER_BATCH              4
+#define MAX_IRRADIANCE_SAMPLE_COUNT 512
+#define SH_ROWS_PER_BATCH           8
+
+// the importance sample sets are padded to a multiple of the simd width
+#define PADDED( count ) ( ( ( count ) + SIMD_WIDTH - 1 ) & ~( SIMD_WIDTH - 1 ) )
+
+struct bake_segment
+{
+	enum ibl_map map;
+	uint32_t     mip;
+	uint32_t     first_row;
+	uint32_t     row_count;
+};
+
+struct bake_phase
+{
+	const struct ibl_cpu_maps*    maps;
+	const struct ibl_bake_params* params;
+	const float*                  equirect;
+	uint32_t                      equirect_width;
+	uint32_t                      equirect_height;
+	uint32_t                      segment_count;
+	struct bake_segment           segments[ MAX_SEGMENT_COUNT ];
+};
+
+// per row partial sums of the sh projection, .w of the first coefficient
+// accumulates the solid angle
+struct sh_projection
+{
+	const struct ibl_cpu_maps* maps;
+	uint32_t                   mip;
+	uint32_t                   size;
+	float ( *rows )[ IBL_SH_COEFFICIENT_COUNT ][ 4 ];
+};
+
+struct irradiance_samples
+{
+	uint32_t count;
+	float    x[ PADDED( MAX_IRRADIANCE_SAMPLE_COUNT ) ];
+	float    y[ PADDED( MAX_IRRADIANCE_SAMPLE_COUNT ) ];
+	float    z[ PADDED( MAX_IRRADIANCE_SAMPLE_COUNT ) ];
+	float    weight[ PADDED( MAX_IRRADIANCE_SAMPLE_COUNT ) ];
+};
+
+static float
+clampf( float v, float lo, float hi )
+{
+	return v < lo ? lo : ( v > hi ? hi : v );
+}
+
+static void
+normalize3( float v[ 3 ] )
+{
+	float len = sqrtf( v[ 0 ] * v[ 0 ] + v[ 1 ] * v[ 1 ] + v[ 2 ] * v[ 2 ] );
+	if ( len > 0.0f )
+	{
+		v[ 0 ] /= len;
+		v[ 1 ] /= len;
+		v[ 2 ] /= len;
+	}
+}
+
+static void
+cross3( const float a[ 3 ], const float b[ 3 ], float r[ 3 ] )
+{
+	r[ 0 ] = a[ 1 ] * b[ 2 ] - a[ 2 ] * b[ 1 ];
+	r[ 1 ] = a[ 2 ] * b[ 0 ] - a[ 0 ] * b[ 2 ];
+	r[ 2 ] = a[ 0 ] * b[ 1 ] - a[ 1 ] * b[ 0 ];
+}
+
+static float
+radical_inverse_vdc( uint32_t bits )
+{
+	bits = ( bits << 16u ) | ( bits >> 16u );
+	bits = ( ( bits & 0x55555555u ) << 1u ) | ( ( bits & 0xAAAAAAAAu ) >> 1u );
+	bits = ( ( bits & 0x33333333u ) << 2u ) | ( ( bits & 0xCCCCCCCCu ) >> 2u );
+	bits = ( ( bits & 0x0F0F0F0Fu ) << 4u ) | ( ( bits & 0xF0F0F0F0u ) >> 4u );
+	bits = ( ( bits & 0x00FF00FFu ) << 8u ) | ( ( bits & 0xFF00FF00u ) >> 8u );
+	return ( float ) bits * 2.3283064365386963e-10f;
+}
+
+// ggx half vector in tangent space, z is the normal direction
+static void
+importance_sample_ggx( uint32_t i, uint32_t n, float roughness, float h[ 3 ] )
+{
+	float a  = roughness * roughness;
+	float xi = ( float ) i / ( float ) n;
+	float yi = radical_inverse_vdc( i );
+
+	float phi       = 2.0f * PI * xi;
+	float cos_theta = sqrtf( ( 1.0f - yi ) / ( 1.0f + ( a * a - 1.0f ) * yi ) );
+	float sin_theta = sqrtf( 1.0f - cos_theta * cos_theta );
+
+	h[ 0 ] = cosf( phi ) * sin_theta;
+	h[ 1 ] = sinf( phi ) * sin_theta;
+	h[ 2 ] = cos_theta;
+}
+
+static void
+ggx_frame( const float n[ 3 ], float tangent[ 3 ], float bitangent[ 3 ] )
+{
+	float up[ 3 ] = { 0.0f, 0.0f, 1.0f };
+	if ( fabsf( n[ 2 ] ) >= 0.999f )
+	{
+		up[ 0 ] = 1.0f;
+		up[ 2 ] = 0.0f;
+	}
+
+	cross3( up, n, tangent );
+	normalize3( tangent );
+	cross3( n, tangent, bitangent );
+}
+
+// face directions as written by eq_to_cubemap.comp.glsl
+static void
+eq_face_direction( uint32_t face, float u, float v, float dir[ 3 ] )
+{
+	u -= 0.5f;
+	v -= 0.5f;
+
+	switch ( face )
+	{
+	case 0: dir[ 0 ] = 0.5f, dir[ 1 ] = -v, dir[ 2 ] = -u; break;
+	case 1: dir[ 0 ] = -0.5f, dir[ 1 ] = -v, dir[ 2 ] = u; break;
+	case 2: dir[ 0 ] = u, dir[ 1 ] = -0.5f, dir[ 2 ] = -v; break;
+	case 3: dir[ 0 ] = u, dir[ 1 ] = 0.5f, dir[ 2 ] = v; break;
+	case 4: dir[ 0 ] = u, dir[ 1 ] = -v, dir[ 2 ] = 0.5f; break;
+	default: dir[ 0 ] = -u, dir[ 1 ] = -v, dir[ 2 ] = -0.5f; break;
+	}
+
+	normalize3( dir );
+}
+
+// face directions as written by irradiance.comp.glsl and specular.comp.glsl
+static void
+face_direction( uint32_t face, float u, float v, float dir[ 3 ] )
+{
+	u -= 0.5f;
+	v -= 0.5f;
+
+	switch ( face )
+	{
+	case 0: dir[ 0 ] = 0.5f, dir[ 1 ] = -v, dir[ 2 ] = -u; break;
+	case 1: dir[ 0 ] = -0.5f, dir[ 1 ] = -v, dir[ 2 ] = u; break;
+	case 2: dir[ 0 ] = u, dir[ 1 ] = 0.5f, dir[ 2 ] = v; break;
+	case 3: dir[ 0 ] = u, dir[ 1 ] = -0.5f, dir[ 2 ] = -v; break;
+	case 4: dir[ 0 ] = u, dir[ 1 ] = -v, dir[ 2 ] = 0.5f; break;
+	default: dir[ 0 ] = -u, dir[ 1 ] = -v, dir[ 2 ] = -0.5f; break;
+	}
+
+	normalize3( dir );
+}
+
+static void
+sample_bilinear( const float* texels,
+                 uint32_t     width,
+                 uint32_t     height,
+                 float        u,
+                 float        v,
+                 float        out[ 4 ] )
+{
+	float x  = u * ( float ) width - 0.5f;
+	float y  = v * ( float ) height - 0.5f;
+	float x0 = floorf( x );
+	float y0 = floorf( y );
+	float fx = x - x0;
+	float fy = y - y0;
+
+	int32_t ix0 = ( int32_t ) clampf( x0, 0.0f, ( float ) width - 1 );
+	int32_t iy0 = ( int32_t ) clampf( y0, 0.0f, ( float ) height - 1 );
+	int32_t ix1 = ( int32_t ) clampf( x0 + 1.0f, 0.0f, ( float ) width - 1 );
+	int32_t iy1 = ( int32_t ) clampf( y0 + 1.0f, 0.0f, ( float ) height - 1 );
+
+	const float* t00 = &texels[ ( iy0 * width + ix0 ) * 4 ];
+	const float* t10 = &texels[ ( iy0 * width + ix1 ) * 4 ];
+	const float* t01 = &texels[ ( iy1 * width + ix0 ) * 4 ];
+	const float* t11 = &texels[ ( iy1 * width + ix1 ) * 4 ];
+
+	for ( uint32_t c = 0; c < 4; ++c )
+	{
+		float top    = t00[ c ] + ( t10[ c ] - t00[ c ] ) * fx;
+		float bottom = t01[ c ] + ( t11[ c ] - t01[ c ] ) * fx;
+		out[ c ]     = top + ( bottom - top ) * fy;
+	}
+}
+
+// vulkan cube map face selection
+static uint32_t
+cube_face( const float dir[ 3 ], float* s, float* t )
+{
+	float ax = fabsf( dir[ 0 ] );
+	float ay = fabsf( dir[ 1 ] );
+	float az = fabsf( dir[ 2 ] );
+
+	uint32_t face;
+	float    sc, tc, ma;
+
+	if ( ax >= ay && ax >= az )
+	{
+		face = dir[ 0 ] >= 0.0f ? 0 : 1;
+		sc   = dir[ 0 ] >= 0.0f ? -dir[ 2 ] : dir[ 2 ];
+		tc   = -dir[ 1 ];
+		ma   = ax;
+	}
+	else if ( ay >= az )
+	{
+		face = dir[ 1 ] >= 0.0f ? 2 : 3;
+		sc   = dir[ 0 ];
+		tc   = dir[ 1 ] >= 0.0f ? dir[ 2 ] : -dir[ 2 ];
+		ma   = ay;
+	}
+	else
+	{
+		face = dir[ 2 ] >= 0.0f ? 4 : 5;
+		sc   = dir[ 2 ] >= 0.0f ? dir[ 0 ] : -dir[ 0 ];
+		tc   = -dir[ 1 ];
+		ma   = az;
+	}
+
+	if ( ma == 0.0f )
+	{
+		ma = 1.0f;
+	}
+
+	*s = 0.5f * ( sc / ma + 1.0f );
+	*t = 0.5f * ( tc / ma + 1.0f );
+
+	return face;
+}
+
+static void
+sample_cube_level( const struct ibl_cache_image* image,
+                   const float*                  texels,
+                   uint32_t                      mip,
+                   const float                   dir[ 3 ],
+                   float                         out[ 4 ] )
+{
+	float    s, t;
+	uint32_t face = cube_face( dir, &s, &t );
+	uint32_t size = ibl_cache_mip_size( image, mip );
+
+	const float* level =
+	    texels + ibl_cache_mip_offset( image, mip ) / sizeof( float ) +
+	    ( size_t ) face * size * size * 4;
+
+	sample_bilinear( level, size, size, s, t, out );
+}
+
+static void
+sample_cube_lod( const struct ibl_cache_image* image,
+                 const float*                  texels,
+                 const float                   dir[ 3 ],
+                 float                         lod,
+                 float                         out[ 4 ] )
+{
+	lod = clampf( lod, 0.0f, ( float ) ( image->mip_levels - 1 ) );
+
+	uint32_t mip0 = ( uint32_t ) lod;
+	uint32_t mip1 = FT_MIN( mip0 + 1, image->mip_levels - 1 );
+	float    f    = lod - ( float ) mip0;
+
+	sample_cube_level( image, texels, mip0, dir, out );
+
+	if ( f > 0.0f && mip1 != mip0 )
+	{
+		float next[ 4 ];
+		sample_cube_level( image, texels, mip1, dir, next );
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			out[ c ] += ( next[ c ] - out[ c ] ) * f;
+		}
+	}
+}
+
+static float*
+texel_row( const struct ibl_cpu_maps* maps,
+           enum ibl_map               map,
+           uint32_t                   mip,
+           uint32_t                   face,
+           uint32_t                   y )
+{
+	const struct ibl_cache_image* image = &maps->layout.images[ map ];
+	uint32_t size     = ibl_cache_mip_size( image, mip );
+	uint32_t channels = image->texel_size / sizeof( float );
+
+	return maps->images[ map ] +
+	       ibl_cache_mip_offset( image, mip ) / sizeof( float ) +
+	       ( ( size_t ) face * size + y ) * size * channels;
+}
+
+static void
+bake_environment_row( const struct bake_phase* phase,
+                      uint32_t                 mip,
+                      uint32_t                 face,
+                      uint32_t                 y )
+{
+	const struct ibl_cache_image* image =
+	    &phase->maps->layout.images[ IBL_MAP_ENVIRONMENT ];
+	uint32_t size = ibl_cache_mip_size( image, mip );
+	float*   dst = texel_row( phase->maps, IBL_MAP_ENVIRONMENT, mip, face, y );
+
+	float v = 1.0f - ( ( float ) y + 0.5f ) / ( float ) size;
+
+	for ( uint32_t x = 0; x < size; ++x )
+	{
+		float u = ( ( float ) x + 0.5f ) / ( float ) size;
+
+		float dir[ 3 ];
+		eq_face_direction( face, u, v, dir );
+
+		float pano_u = atan2f( dir[ 2 ], dir[ 0 ] ) * 0.1591f + 0.5f;
+		float pano_v = asinf( dir[ 1 ] ) * 0.3183f + 0.5f;
+
+		sample_bilinear( phase->equirect,
+		                 phase->equirect_width,
+		                 phase->equirect_height,
+		                 pano_u,
+		                 pano_v,
+		                 &dst[ x * 4 ] );
+	}
+}
+
+static void
+init_irradiance_samples( float delta, struct irradiance_samples* samples )
+{
+	memset( samples, 0, sizeof( *samples ) );
+
+	// same float stepping as the shader so the sample count matches
+	for ( float phi = 0.0f; phi < 2.0f * PI; phi += delta )
+	{
+		for ( float theta = 0.0f; theta < 0.5f * PI; theta += delta )
+		{
+			if ( samples->count == MAX_IRRADIANCE_SAMPLE_COUNT )
+			{
+				return;
+			}
+
+			uint32_t i           = samples->count++;
+			samples->x[ i ]      = sinf( theta ) * cosf( phi );
+			samples->y[ i ]      = sinf( theta ) * sinf( phi );
+			samples->z[ i ]      = cosf( theta );
+			samples->weight[ i ] = cosf( theta ) * sinf( theta );
+		}
+	}
+}
+
+static void
+bake_irradiance_row( const struct bake_phase*         phase,
+                     const struct irradiance_samples* samples,
+                     uint32_t                         face,
+                     uint32_t                         y )
+{
+	const struct ibl_cache_image* env =
+	    &phase->maps->layout.images[ IBL_MAP_ENVIRONMENT ];
+	const struct ibl_cache_image* image =
+	    &phase->maps->layout.images[ IBL_MAP_IRRADIANCE ];
+	const float* env_texels = phase->maps->images[ IBL_MAP_ENVIRONMENT ];
+
+	uint32_t size = image->width;
+	float*   dst  = texel_row( phase->maps, IBL_MAP_IRRADIANCE, 0, face, y );
+
+	float dir_x[ PADDED( MAX_IRRADIANCE_SAMPLE_COUNT ) ];
+	float dir_y[ PADDED( MAX_IRRADIANCE_SAMPLE_COUNT ) ];
+	float dir_z[ PADDED( MAX_IRRADIANCE_SAMPLE_COUNT ) ];
+
+	float v = ( ( float ) y + 0.5f ) / ( float ) size;
+
+	for ( uint32_t x = 0; x < size; ++x )
+	{
+		float u = ( ( float ) x + 0.5f ) / ( float ) size;
+
+		float n[ 3 ];
+		face_direction( face, u, v, n );
+
+		float up[ 3 ] = { 0.0f, 1.0f, 0.0f };
+		float right[ 3 ];
+		cross3( up, n, right );
+		cross3( n, right, up );
+
+		simd_float rx = simd_set1( right[ 0 ] );
+		simd_float ry = simd_set1( right[ 1 ] );
+		simd_float rz = simd_set1( right[ 2 ] );
+		simd_float ux = simd_set1( up[ 0 ] );
+		simd_float uy = simd_set1( up[ 1 ] );
+		simd_float uz = simd_set1( up[ 2 ] );
+		simd_float nx = simd_set1( n[ 0 ] );
+		simd_float ny = simd_set1( n[ 1 ] );
+		simd_float nz = simd_set1( n[ 2 ] );
+
+		for ( uint32_t s = 0; s < samples->count; s += SIMD_WIDTH )
+		{
+			simd_float tx = simd_load( &samples->x[ s ] );
+			simd_float ty = simd_load( &samples->y[ s ] );
+			simd_float tz = simd_load( &samples->z[ s ] );
+
+			simd_store( &dir_x[ s ],
+			            simd_madd( tz,
+			                       nx,
+			                       simd_madd( ty, ux, simd_mul( tx, rx ) ) ) );
+			simd_store( &dir_y[ s ],
+			            simd_madd( tz,
+			                       ny,
+			                       simd_madd( ty, uy, simd_mul( tx, ry ) ) ) );
+			simd_store( &dir_z[ s ],
+			            simd_madd( tz,
+			                       nz,
+			                       simd_madd( ty, uz, simd_mul( tx, rz ) ) ) );
+		}
+
+		float irradiance[ 4 ] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+		for ( uint32_t s = 0; s < samples->count; ++s )
+		{
+			float dir[ 3 ] = { dir_x[ s ], dir_y[ s ], dir_z[ s ] };
+			float texel[ 4 ];
+			sample_cube_level( env, env_texels, 0, dir, texel );
+
+			irradiance[ 0 ] += texel[ 0 ] * samples->weight[ s ];
+			irradiance[ 1 ] += texel[ 1 ] * samples->weight[ s ];
+			irradiance[ 2 ] += texel[ 2 ] * samples->weight[ s ];
+			irradiance[ 3 ] += texel[ 3 ];
+		}
+
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			dst[ x * 4 + c ] =
+			    PI * irradiance[ c ] * ( 1.0f / ( float ) samples->count );
+		}
+	}
+}
+
+static void
+bake_specular_row( const struct bake_phase* phase,
+                   uint32_t                 mip,
+                   uint32_t                 face,
+                   uint32_t                 y )
+{
+	const struct ibl_cache_image* env =
+	    &phase->maps->layout.images[ IBL_MAP_ENVIRONMENT ];
+	const struct ibl_cache_image* image =
+	    &phase->maps->layout.images[ IBL_MAP_SPECULAR ];
+	const float* env_texels = phase->maps->images[ IBL_MAP_ENVIRONMENT ];
+
+	uint32_t sample_count = phase->params->importance_sample_count;
+	uint32_t size         = ibl_cache_mip_size( image, mip );
+	float*   dst = texel_row( phase->maps, IBL_MAP_SPECULAR, mip, face, y );
+
+	float roughness =
+	    ( float ) mip /
+	    FT_MAX( ( float ) ( image->mip_levels - 1 ), 0.00001f );
+
+	float    hx[ PADDED( IBL_IMPORTANCE_SAMPLE_COUNT ) ];
+	float    hy[ PADDED( IBL_IMPORTANCE_SAMPLE_COUNT ) ];
+	float    hz[ PADDED( IBL_IMPORTANCE_SAMPLE_COUNT ) ];
+	float    lx[ PADDED( IBL_IMPORTANCE_SAMPLE_COUNT ) ];
+	float    ly[ PADDED( IBL_IMPORTANCE_SAMPLE_COUNT ) ];
+	float    lz[ PADDED( IBL_IMPORTANCE_SAMPLE_COUNT ) ];
+	float    ndotl[ PADDED( IBL_IMPORTANCE_SAMPLE_COUNT ) ];
+	float    lod[ PADDED( IBL_IMPORTANCE_SAMPLE_COUNT ) ];
+	uint32_t padded = PADDED( sample_count );
+
+	memset( hx, 0, sizeof( hx ) );
+	memset( hy, 0, sizeof( hy ) );
+	memset( hz, 0, sizeof( hz ) );
+
+	// with v == n every per sample term except the direction depends only
+	// on the tangent space half vector, so the lod is computed once per row
+	float sa_texel =
+	    4.0f * PI / ( 6.0f * ( float ) env->width * ( float ) env->width );
+
+	for ( uint32_t i = 0; i < sample_count; ++i )
+	{
+		float h[ 3 ];
+		importance_sample_ggx( i, sample_count, roughness, h );
+		hx[ i ] = h[ 0 ];
+		hy[ i ] = h[ 1 ];
+		hz[ i ] = h[ 2 ];
+
+		float ndoth = FT_MAX( h[ 2 ], 0.0f );
+		float a     = roughness * roughness;
+		float a2    = a * a;
+		float denom = ndoth * ndoth * ( a2 - 1.0f ) + 1.0f;
+		float d     = a2 / ( PI * denom * denom );
+		float pdf   = d * ndoth / ( 4.0f * ndoth ) + 0.0001f;
+
+		float sa_sample = 1.0f / ( ( float ) sample_count * pdf + 0.0001f );
+
+		lod[ i ] = roughness == 0.0f
+		               ? 0.0f
+		               : FT_MAX( 0.5f * log2f( sa_sample / sa_texel ) + 1.0f,
+		                         0.0f );
+	}
+
+	float v = ( ( float ) y + 0.5f ) / ( float ) size;
+
+	for ( uint32_t x = 0; x < size; ++x )
+	{
+		float u = ( ( float ) x + 0.5f ) / ( float ) size;
+
+		float n[ 3 ];
+		face_direction( face, u, v, n );
+
+		float t[ 3 ], b[ 3 ];
+		ggx_frame( n, t, b );
+
+		simd_float tx = simd_set1( t[ 0 ] );
+		simd_float ty = simd_set1( t[ 1 ] );
+		simd_float tz = simd_set1( t[ 2 ] );
+		simd_float bx = simd_set1( b[ 0 ] );
+		simd_float by = simd_set1( b[ 1 ] );
+		simd_float bz = simd_set1( b[ 2 ] );
+		simd_float nx = simd_set1( n[ 0 ] );
+		simd_float ny = simd_set1( n[ 1 ] );
+		simd_float nz = simd_set1( n[ 2 ] );
+		simd_float zero    = simd_set1( 0.0f );
+		simd_float two     = simd_set1( 2.0f );
+		simd_float epsilon = simd_set1( 1e-8f );
+
+		for ( uint32_t s = 0; s < padded; s += SIMD_WIDTH )
+		{
+			simd_float sx = simd_load( &hx[ s ] );
+			simd_float sy = simd_load( &hy[ s ] );
+			simd_float sz = simd_load( &hz[ s ] );
+
+			// h = normalize( t * h.x + b * h.y + n * h.z )
+			simd_float wx =
+			    simd_madd( sz, nx, simd_madd( sy, bx, simd_mul( sx, tx ) ) );
+			simd_float wy =
+			    simd_madd( sz, ny, simd_madd( sy, by, simd_mul( sx, ty ) ) );
+			simd_float wz =
+			    simd_madd( sz, nz, simd_madd( sy, bz, simd_mul( sx, tz ) ) );
+			simd_float len = simd_sqrt(
+			    simd_madd( wz, wz, simd_madd( wy, wy, simd_mul( wx, wx ) ) ) );
+			len = simd_max( len, epsilon );
+			wx  = simd_div( wx, len );
+			wy  = simd_div( wy, len );
+			wz  = simd_div( wz, len );
+
+			// l = normalize( 2 * dot( v, h ) * h - v ), v == n
+			simd_float vdoth =
+			    simd_madd( wz, nz, simd_madd( wy, ny, simd_mul( wx, nx ) ) );
+			simd_float k  = simd_mul( two, vdoth );
+			simd_float px = simd_sub( simd_mul( k, wx ), nx );
+			simd_float py = simd_sub( simd_mul( k, wy ), ny );
+			simd_float pz = simd_sub( simd_mul( k, wz ), nz );
+			len = simd_sqrt(
+			    simd_madd( pz, pz, simd_madd( py, py, simd_mul( px, px ) ) ) );
+			len = simd_max( len, epsilon );
+			px  = simd_div( px, len );
+			py  = simd_div( py, len );
+			pz  = simd_div( pz, len );
+
+			simd_float nl = simd_max(
+			    simd_madd( pz, nz, simd_madd( py, ny, simd_mul( px, nx ) ) ),
+			    zero );
+
+			simd_store( &lx[ s ], px );
+			simd_store( &ly[ s ], py );
+			simd_store( &lz[ s ], pz );
+			simd_store( &ndotl[ s ], nl );
+		}
+
+		float color[ 4 ]   = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float total_weight = 0.0f;
+
+		for ( uint32_t s = 0; s < sample_count; ++s )
+		{
+			if ( ndotl[ s ] > 0.0f )
+			{
+				float l[ 3 ] = { lx[ s ], ly[ s ], lz[ s ] };
+				float texel[ 4 ];
+				sample_cube_lod( env, env_texels, l, lod[ s ], texel );
+
+				for ( uint32_t c = 0; c < 4; ++c )
+				{
+					color[ c ] += texel[ c ] * ndotl[ s ];
+				}
+
+				total_weight += ndotl[ s ];
+			}
+		}
+
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			dst[ x * 4 + c ] = color[ c ] / total_weight;
+		}
+	}
+}
+
+static simd_float
+geometry_schlick_ggx( simd_float ndotv, simd_float k )
+{
+	simd_float one = simd_set1( 1.0f );
+	return simd_div( ndotv, simd_madd( ndotv, simd_sub( one, k ), k ) );
+}
+
+static void
+bake_brdf_row( const struct bake_phase* phase, uint32_t y )
+{
+	const struct ibl_cache_image* image =
+	    &phase->maps->layout.images[ IBL_MAP_BRDF_LUT ];
+
+	uint32_t sample_count = phase->params->importance_sample_count;
+	uint32_t size         = image->width;
+	float*   dst = texel_row( phase->maps, IBL_MAP_BRDF_LUT, 0, 0, y );
+
+	float roughness = 1.0f - ( ( float ) y + 0.5f ) / ( float ) size;
+
+	// n = ( 0, 0, 1 ) so the world space half vectors are the same for
+	// every texel of the row
+	float h_x[ IBL_IMPORTANCE_SAMPLE_COUNT ];
+	float h_y[ IBL_IMPORTANCE_SAMPLE_COUNT ];
+	float h_z[ IBL_IMPORTANCE_SAMPLE_COUNT ];
+	float n[ 3 ] = { 0.0f, 0.0f, 1.0f };
+	float t[ 3 ], b[ 3 ];
+	ggx_frame( n, t, b );
+
+	for ( uint32_t i = 0; i < sample_count; ++i )
+	{
+		float h[ 3 ];
+		importance_sample_ggx( i, sample_count, roughness, h );
+
+		float w[ 3 ] = {
+		    t[ 0 ] * h[ 0 ] + b[ 0 ] * h[ 1 ] + n[ 0 ] * h[ 2 ],
+		    t[ 1 ] * h[ 0 ] + b[ 1 ] * h[ 1 ] + n[ 1 ] * h[ 2 ],
+		    t[ 2 ] * h[ 0 ] + b[ 2 ] * h[ 1 ] + n[ 2 ] * h[ 2 ],
+		};
+		normalize3( w );
+
+		h_x[ i ] = w[ 0 ];
+		h_y[ i ] = w[ 1 ];
+		h_z[ i ] = w[ 2 ];
+	}
+
+	simd_float zero  = simd_set1( 0.0f );
+	simd_float one   = simd_set1( 1.0f );
+	simd_float two   = simd_set1( 2.0f );
+	simd_float k     = simd_set1( roughness * roughness / 2.0f );
+	simd_float scale = simd_set1( 1.0f / ( float ) sample_count );
+
+	for ( uint32_t x = 0; x < size; x += SIMD_WIDTH )
+	{
+		float ndotv_lanes[ SIMD_WIDTH ];
+		for ( uint32_t l = 0; l < SIMD_WIDTH; ++l )
+		{
+			float ndotv      = ( ( float ) ( x + l ) + 0.5f ) / ( float ) size;
+			ndotv_lanes[ l ] = FT_MIN( ndotv, 1.0f );
+		}
+
+		// v = ( sqrt( 1 - ndotv^2 ), 0, ndotv )
+		simd_float ndotv = simd_load( ndotv_lanes );
+		simd_float vx  = simd_sqrt( simd_sub( one, simd_mul( ndotv, ndotv ) ) );
+		simd_float vz  = ndotv;
+		simd_float g_v = geometry_schlick_ggx( ndotv, k );
+
+		simd_float sum_a = zero;
+		simd_float sum_b = zero;
+
+		for ( uint32_t i = 0; i < sample_count; ++i )
+		{
+			simd_float hx = simd_set1( h_x[ i ] );
+			simd_float hy = simd_set1( h_y[ i ] );
+			simd_float hz = simd_set1( h_z[ i ] );
+
+			simd_float vdoth = simd_madd( vz, hz, simd_mul( vx, hx ) );
+			simd_float k2    = simd_mul( two, vdoth );
+
+			simd_float lx  = simd_sub( simd_mul( k2, hx ), vx );
+			simd_float ly  = simd_mul( k2, hy );
+			simd_float lz  = simd_sub( simd_mul( k2, hz ), vz );
+			simd_float len = simd_sqrt(
+			    simd_madd( lz, lz, simd_madd( ly, ly, simd_mul( lx, lx ) ) ) );
+			lz = simd_div( lz, simd_max( len, simd_set1( 1e-8f ) ) );
+
+			simd_float ndotl = simd_max( lz, zero );
+			simd_float ndoth = simd_max( hz, zero );
+			vdoth            = simd_max( vdoth, zero );
+
+			simd_float g = simd_mul( geometry_schlick_ggx( ndotl, k ), g_v );
+			simd_float g_vis =
+			    simd_div( simd_mul( g, vdoth ), simd_mul( ndoth, ndotv ) );
+			simd_float f  = simd_sub( one, vdoth );
+			simd_float f2 = simd_mul( f, f );
+			simd_float fc = simd_mul( simd_mul( f2, f2 ), f );
+
+			simd_float mask = simd_cmpgt( ndotl, zero );
+			simd_float da   = simd_mul( simd_sub( one, fc ), g_vis );
+			simd_float db   = simd_mul( fc, g_vis );
+			sum_a = simd_add( sum_a, simd_select( mask, da, zero ) );
+			sum_b = simd_add( sum_b, simd_select( mask, db, zero ) );
+		}
+
+		float a_lanes[ SIMD_WIDTH ];
+		float b_lanes[ SIMD_WIDTH ];
+		simd_store( a_lanes, simd_mul( sum_a, scale ) );
+		simd_store( b_lanes, simd_mul( sum_b, scale ) );
+
+		for ( uint32_t l = 0; l < SIMD_WIDTH && x + l < size; ++l )
+		{
+			dst[ ( x + l ) * 2 + 0 ] = a_lanes[ l ];
+			dst[ ( x + l ) * 2 + 1 ] = b_lanes[ l ];
+		}
+	}
+}
+
+// same basis and folding as sh_project.comp.glsl
+static const float sh_basis_scale[ IBL_SH_COEFFICIENT_COUNT ] = {
+    0.282095f,
+    0.488603f,
+    0.488603f,
+    0.488603f,
+    1.092548f,
+    1.092548f,
+    0.315392f,
+    1.092548f,
+    0.546274f,
+};
+
+static const float sh_band_scale[ IBL_SH_COEFFICIENT_COUNT ] = {
+    1.0f,
+    2.0f / 3.0f,
+    2.0f / 3.0f,
+    2.0f / 3.0f,
+    0.25f,
+    0.25f,
+    0.25f,
+    0.25f,
+    0.25f,
+};
+
+static void
+project_sh_rows( void* user_data, uint32_t begin, uint32_t end )
+{
+	const struct sh_projection*   projection = user_data;
+	const struct ibl_cache_image* image =
+	    &projection->maps->layout.images[ IBL_MAP_ENVIRONMENT ];
+	const float* texels = projection->maps->images[ IBL_MAP_ENVIRONMENT ];
+	uint32_t     size   = projection->size;
+
+	for ( uint32_t row = begin; row < end; ++row )
+	{
+		uint32_t face = row / size;
+		float    v    = ( ( float ) ( row % size ) + 0.5f ) / ( float ) size;
+
+		float( *sums )[ 4 ] = projection->rows[ row ];
+
+		memset( sums, 0, sizeof( projection->rows[ row ] ) );
+
+		for ( uint32_t x = 0; x < size; ++x )
+		{
+			float u = ( ( float ) x + 0.5f ) / ( float ) size;
+
+			float s      = u * 2.0f - 1.0f;
+			float t      = v * 2.0f - 1.0f;
+			float d      = 1.0f + s * s + t * t;
+			float weight = 4.0f / ( d * sqrtf( d ) );
+
+			float n[ 3 ];
+			face_direction( face, u, v, n );
+
+			float l[ 4 ];
+			sample_cube_level( image, texels, projection->mip, n, l );
+
+			float basis[ IBL_SH_COEFFICIENT_COUNT ] = {
+			    1.0f,
+			    n[ 1 ],
+			    n[ 2 ],
+			    n[ 0 ],
+			    n[ 0 ] * n[ 1 ],
+			    n[ 1 ] * n[ 2 ],
+			    3.0f * n[ 2 ] * n[ 2 ] - 1.0f,
+			    n[ 0 ] * n[ 2 ],
+			    n[ 0 ] * n[ 0 ] - n[ 1 ] * n[ 1 ],
+			};
+
+			for ( uint32_t i = 0; i < IBL_SH_COEFFICIENT_COUNT; ++i )
+			{
+				float w = weight * sh_basis_scale[ i ] * basis[ i ];
+				sums[ i ][ 0 ] += l[ 0 ] * w;
+				sums[ i ][ 1 ] += l[ 1 ] * w;
+				sums[ i ][ 2 ] += l[ 2 ] * w;
+			}
+			sums[ 0 ][ 3 ] += weight;
+		}
+	}
+}
+
+static void
+bake_irradiance_sh( const struct ibl_cpu_maps* maps )
+{
+	const struct ibl_cache_image* image =
+	    &maps->layout.images[ IBL_MAP_ENVIRONMENT ];
+
+	struct sh_projection projection = {
+	    .maps = maps,
+	    .mip  = 0,
+	};
+
+	while ( projection.mip + 1 < image->mip_levels &&
+	        ibl_cache_mip_size( image, projection.mip ) > IBL_SH_SOURCE_SIZE )
+	{
+		projection.mip++;
+	}
+
+	projection.size = ibl_cache_mip_size( image, projection.mip );
+
+	uint32_t row_count = 6 * projection.size;
+	projection.rows    = calloc( row_count, sizeof( *projection.rows ) );
+
+	job_system_parallel_for( row_count,
+	                         SH_ROWS_PER_BATCH,
+	                         project_sh_rows,
+	                         &projection );
+
+	double sums[ IBL_SH_COEFFICIENT_COUNT ][ 4 ];
+	memset( sums, 0, sizeof( sums ) );
+
+	for ( uint32_t row = 0; row < row_count; ++row )
+	{
+		for ( uint32_t i = 0; i < IBL_SH_COEFFICIENT_COUNT; ++i )
+		{
+			for ( uint32_t c = 0; c < 4; ++c )
+			{
+				sums[ i ][ c ] += projection.rows[ row ][ i ][ c ];
+			}
+		}
+	}
+
+	// projection and evaluation both carry the basis constant
+	double normalization = 4.0 * PI / sums[ 0 ][ 3 ];
+	float* dst           = maps->images[ IBL_MAP_IRRADIANCE ];
+
+	for ( uint32_t i = 0; i < IBL_SH_COEFFICIENT_COUNT; ++i )
+	{
+		double scale = normalization * sh_band_scale[ i ] * sh_basis_scale[ i ];
+
+		dst[ i * 4 + 0 ] = ( float ) ( sums[ i ][ 0 ] * scale );
+		dst[ i * 4 + 1 ] = ( float ) ( sums[ i ][ 1 ] * scale );
+		dst[ i * 4 + 2 ] = ( float ) ( sums[ i ][ 2 ] * scale );
+		dst[ i * 4 + 3 ] = 0.0f;
+	}
+
+	free( projection.rows );
+}
+
+static struct irradiance_samples irradiance_samples;
+
+static void
+bake_phase_job( void* user_data, uint32_t begin, uint32_t end )
+{
+	const struct bake_phase* phase = user_data;
+
+	for ( uint32_t row = begin; row < end; ++row )
+	{
+		const struct bake_segment* segment = NULL;
+		for ( uint32_t s = 0; s < phase->segment_count; ++s )
+		{
+			segment = &phase->segments[ s ];
+			if ( row < segment->first_row + segment->row_count )
+			{
+				break;
+			}
+		}
+
+		const struct ibl_cache_image* image =
+		    &phase->maps->layout.images[ segment->map ];
+		uint32_t size  = ibl_cache_mip_size( image, segment->mip );
+		uint32_t local = row - segment->first_row;
+		uint32_t face  = local / size;
+		uint32_t y     = local % size;
+
+		switch ( segment->map )
+		{
+		case IBL_MAP_ENVIRONMENT:
+			bake_environment_row( phase, segment->mip, face, y );
+			break;
+		case IBL_MAP_IRRADIANCE:
+			bake_irradiance_row( phase, &irradiance_samples, face, y );
+			break;
+		case IBL_MAP_SPECULAR:
+			bake_specular_row( phase, segment->mip, face, y );
+			break;
+		case IBL_MAP_BRDF_LUT: bake_brdf_row( phase, y ); break;
+		default: break;
+		}
+	}
+}
+
+static uint32_t
+bake_phase_add( struct bake_phase* phase, enum ibl_map map )
+{
+	const struct ibl_cache_image* image = &phase->maps->layout.images[ map ];
+
+	uint32_t row = 0;
+	if ( phase->segment_count != 0 )
+	{
+		const struct bake_segment* last =
+		    &phase->segments[ phase->segment_count - 1 ];
+		row = last->first_row + last->row_count;
+	}
+
+	for ( uint32_t mip = 0; mip < image->mip_levels; ++mip )
+	{
+		if ( phase->segment_count == MAX_SEGMENT_COUNT )
+		{
+			break;
+		}
+
+		struct bake_segment* segment =
+		    &phase->segments[ phase->segment_count++ ];
+		segment->map       = map;
+		segment->mip       = mip;
+		segment->first_row = row;
+		segment->row_count =
+		    ibl_cache_mip_size( image, mip ) * image->layer_count;
+		row += segment->row_count;
+	}
+
+	return row;
+}
+
+void
+ibl_cpu_bake( const float*                  equirect,
+              uint32_t                      width,
+              uint32_t                      height,
+              uint64_t                      key,
+              const struct ibl_bake_params* params,
+              struct ibl_cpu_maps*          maps )
+{
+	memset( maps, 0, sizeof( *maps ) );
+	ibl_cache_init_header( &maps->header, key, params );
+
+	// bake in 32 bit float, the storage format is applied on write
+	struct ibl_bake_params float_params = *params;
+	float_params.cube_format            = FT_FORMAT_R32G32B32A32_SFLOAT;
+	float_params.lut_format             = FT_FORMAT_R32G32_SFLOAT;
+	ibl_cache_init_header( &maps->layout, key, &float_params );
+
+	for ( uint32_t i = 0; i < IBL_MAP_COUNT; ++i )
+	{
+		maps->images[ i ] = malloc( maps->layout.images[ i ].size );
+	}
+
+	FT_ASSERT( params->importance_sample_count <= IBL_IMPORTANCE_SAMPLE_COUNT );
+	init_irradiance_samples( params->irradiance_sample_delta,
+	                         &irradiance_samples );
+
+	struct bake_phase phase = {
+	    .maps            = maps,
+	    .params          = params,
+	    .equirect        = equirect,
+	    .equirect_width  = width,
+	    .equirect_height = height,
+	};
+
+	// the environment cube and the brdf lut are independent, irradiance and
+	// specular sample the finished environment cube
+	uint32_t rows = 0;
+	bake_phase_add( &phase, IBL_MAP_ENVIRONMENT );
+	rows = bake_phase_add( &phase, IBL_MAP_BRDF_LUT );
+	job_system_parallel_for( rows, ROWS_PER_BATCH, bake_phase_job, &phase );
+
+	phase.segment_count = 0;
+	if ( params->irradiance_mode != IBL_IRRADIANCE_SH )
+	{
+		bake_phase_add( &phase, IBL_MAP_IRRADIANCE );
+	}
+	rows = bake_phase_add( &phase, IBL_MAP_SPECULAR );
+	job_system_parallel_for( rows, ROWS_PER_BATCH, bake_phase_job, &phase );
+
+	if ( params->irradiance_mode == IBL_IRRADIANCE_SH )
+	{
+		bake_irradiance_sh( maps );
+	}
+}
+
+void
+ibl_cpu_free( struct ibl_cpu_maps* maps )
+{
+	for ( uint32_t i = 0; i < IBL_MAP_COUNT; ++i )
+	{
+		ft_safe_free( maps->images[ i ] );
+	}
+}
+
+bool
+ibl_cpu_write_cache( const struct ibl_cpu_maps* maps, const char* filename )
+{
+	struct ibl_cache_writer writer;
+
+	if ( !ibl_cache_writer_begin( &writer, filename, &maps->header ) )
+	{
+		return false;
+	}
+
+	for ( uint32_t i = 0; i < IBL_MAP_COUNT; ++i )
+	{
+		const struct ibl_cache_image* image = &maps->header.images[ i ];
+
+		void* data = malloc( image->size );
+		ibl_format_encode( image->format,
+		                   maps->images[ i ],
+		                   image->size / image->texel_size,
+		                   data );
+
+		ibl_cache_writer_begin_image( &writer, i );
+		ibl_cache_writer_write( &writer, data, image->size );
+
+		free( data );
+	}
+
+	return ibl_cache_writer_end( &writer );
+}
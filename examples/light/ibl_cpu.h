@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ibl_cache.h"
+
+// cpu implementation of the ibl bake shaders. images are baked as 32 bit
+// floats laid out as described by layout, header describes the cache file
+// they are encoded to on write
+struct ibl_cpu_maps
+{
+	struct ibl_cache_header header;
+	struct ibl_cache_header layout;
+	float*                  images[ IBL_MAP_COUNT ];
+};
+
+void
+ibl_cpu_bake( const float*                  equirect,
+              uint32_t                      width,
+              uint32_t                      height,
+              uint64_t                      key,
+              const struct ibl_bake_params* params,
+              struct ibl_cpu_maps*          maps );
+
+void
+ibl_cpu_free( struct ibl_cpu_maps* maps );
+
+bool
+ibl_cpu_write_cache( const struct ibl_cpu_maps* maps, const char* filename );
@@ -0,0 +1,404 @@
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "job_system.h"
+
+#define MAX_WORKER_COUNT 64
+
+#ifdef _MSC_VER
+#define JOB_THREAD_LOCAL __declspec( thread )
+#else
+#define JOB_THREAD_LOCAL _Thread_local
+#endif
+
+#ifdef _WIN32
+typedef HANDLE             job_thread;
+typedef SRWLOCK            job_mutex;
+typedef CONDITION_VARIABLE job_cond;
+
+#define job_mutex_init( m )    InitializeSRWLock( m )
+#define job_mutex_destroy( m ) ( ( void ) ( m ) )
+#define job_mutex_lock( m )    AcquireSRWLockExclusive( m )
+#define job_mutex_unlock( m )  ReleaseSRWLockExclusive( m )
+#define job_cond_init( c )     InitializeConditionVariable( c )
+#define job_cond_destroy( c )  ( ( void ) ( c ) )
+#define job_cond_wait( c, m )  SleepConditionVariableSRW( c, m, INFINITE, 0 )
+#define job_cond_broadcast( c ) WakeAllConditionVariable( c )
+
+static uint32_t
+job_atomic_add( volatile uint32_t* value, uint32_t add )
+{
+	return ( uint32_t ) InterlockedExchangeAdd( ( volatile LONG* ) value,
+	                                            ( LONG ) add );
+}
+
+static uint32_t
+hardware_thread_count( void )
+{
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return ( uint32_t ) info.dwNumberOfProcessors;
+}
+#else
+typedef pthread_t       job_thread;
+typedef pthread_mutex_t job_mutex;
+typedef pthread_cond_t  job_cond;
+
+#define job_mutex_init( m )     pthread_mutex_init( m, NULL )
+#define job_mutex_destroy( m )  pthread_mutex_destroy( m )
+#define job_mutex_lock( m )     pthread_mutex_lock( m )
+#define job_mutex_unlock( m )   pthread_mutex_unlock( m )
+#define job_cond_init( c )      pthread_cond_init( c, NULL )
+#define job_cond_destroy( c )   pthread_cond_destroy( c )
+#define job_cond_wait( c, m )   pthread_cond_wait( c, m )
+#define job_cond_broadcast( c ) pthread_cond_broadcast( c )
+
+static uint32_t
+job_atomic_add( volatile uint32_t* value, uint32_t add )
+{
+	return __atomic_fetch_add( value, add, __ATOMIC_RELAXED );
+}
+
+static uint32_t
+hardware_thread_count( void )
+{
+	long count = sysconf( _SC_NPROCESSORS_ONLN );
+	return count > 0 ? ( uint32_t ) count : 1;
+}
+#endif
+
+struct job_system
+{
+	job_thread threads[ MAX_WORKER_COUNT ];
+	uint32_t   worker_count;
+	job_mutex  mutex;
+	job_cond   work_cond;
+	job_cond   done_cond;
+	bool       quit;
+	uint64_t   generation;
+	uint32_t   active_workers;
+
+	job_range_func    func;
+	void*             user_data;
+	uint32_t          count;
+	uint32_t          batch_size;
+	volatile uint32_t next;
+
+	job_cond graph_cond;
+} job_system;
+
+// 0 on the thread that called job_system_init, workers count from 1
+static JOB_THREAD_LOCAL uint32_t job_thread_index;
+// set while a thread runs batches, nested parallel_for calls run inline
+static JOB_THREAD_LOCAL bool job_thread_busy;
+
+static void
+job_system_run_batches( void )
+{
+	bool busy       = job_thread_busy;
+	job_thread_busy = true;
+
+	for ( ;; )
+	{
+		uint32_t begin =
+		    job_atomic_add( &job_system.next, job_system.batch_size );
+
+		if ( begin >= job_system.count )
+		{
+			break;
+		}
+
+		uint32_t end = begin + job_system.batch_size;
+		if ( end > job_system.count )
+		{
+			end = job_system.count;
+		}
+
+		job_system.func( job_system.user_data, begin, end );
+	}
+
+	job_thread_busy = busy;
+}
+
+static void
+job_system_worker( uint32_t index )
+{
+	job_thread_index = index;
+
+	uint64_t seen_generation = 0;
+
+	for ( ;; )
+	{
+		job_mutex_lock( &job_system.mutex );
+		while ( !job_system.quit && job_system.generation == seen_generation )
+		{
+			job_cond_wait( &job_system.work_cond, &job_system.mutex );
+		}
+		bool quit       = job_system.quit;
+		seen_generation = job_system.generation;
+		job_mutex_unlock( &job_system.mutex );
+
+		if ( quit )
+		{
+			break;
+		}
+
+		job_system_run_batches();
+
+		job_mutex_lock( &job_system.mutex );
+		if ( --job_system.active_workers == 0 )
+		{
+			job_cond_broadcast( &job_system.done_cond );
+		}
+		job_mutex_unlock( &job_system.mutex );
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+job_system_thread_main( LPVOID arg )
+{
+	job_system_worker( ( uint32_t ) ( uintptr_t ) arg );
+	return 0;
+}
+#else
+static void*
+job_system_thread_main( void* arg )
+{
+	job_system_worker( ( uint32_t ) ( uintptr_t ) arg );
+	return NULL;
+}
+#endif
+
+void
+job_system_init( uint32_t worker_count )
+{
+	memset( &job_system, 0, sizeof( job_system ) );
+
+	if ( worker_count == 0 )
+	{
+		worker_count = hardware_thread_count() - 1;
+	}
+
+	if ( worker_count > MAX_WORKER_COUNT )
+	{
+		worker_count = MAX_WORKER_COUNT;
+	}
+
+	job_mutex_init( &job_system.mutex );
+	job_cond_init( &job_system.work_cond );
+	job_cond_init( &job_system.done_cond );
+	job_cond_init( &job_system.graph_cond );
+
+	for ( uint32_t i = 0; i < worker_count; ++i )
+	{
+#ifdef _WIN32
+		LPVOID index            = ( LPVOID ) ( uintptr_t ) ( i + 1 );
+		job_system.threads[ i ] = CreateThread( NULL,
+		                                        0,
+		                                        job_system_thread_main,
+		                                        index,
+		                                        0,
+		                                        NULL );
+		if ( job_system.threads[ i ] == NULL )
+		{
+			break;
+		}
+#else
+		if ( pthread_create( &job_system.threads[ i ],
+		                     NULL,
+		                     job_system_thread_main,
+		                     ( void* ) ( uintptr_t ) ( i + 1 ) ) != 0 )
+		{
+			break;
+		}
+#endif
+		job_system.worker_count++;
+	}
+}
+
+void
+job_system_shutdown( void )
+{
+	job_mutex_lock( &job_system.mutex );
+	job_system.quit = true;
+	job_cond_broadcast( &job_system.work_cond );
+	job_mutex_unlock( &job_system.mutex );
+
+	for ( uint32_t i = 0; i < job_system.worker_count; ++i )
+	{
+#ifdef _WIN32
+		WaitForSingleObject( job_system.threads[ i ], INFINITE );
+		CloseHandle( job_system.threads[ i ] );
+#else
+		pthread_join( job_system.threads[ i ], NULL );
+#endif
+	}
+
+	job_cond_destroy( &job_system.graph_cond );
+	job_cond_destroy( &job_system.done_cond );
+	job_cond_destroy( &job_system.work_cond );
+	job_mutex_destroy( &job_system.mutex );
+	job_system.worker_count = 0;
+}
+
+uint32_t
+job_system_get_thread_count( void )
+{
+	return job_system.worker_count + 1;
+}
+
+uint32_t
+job_system_get_thread_index( void )
+{
+	return job_thread_index;
+}
+
+void
+job_system_parallel_for( uint32_t       count,
+                         uint32_t       batch_size,
+                         job_range_func func,
+                         void*          user_data )
+{
+	if ( count == 0 )
+	{
+		return;
+	}
+
+	if ( batch_size == 0 )
+	{
+		batch_size = 1;
+	}
+
+	if ( job_system.worker_count == 0 || count <= batch_size ||
+	     job_thread_busy )
+	{
+		func( user_data, 0, count );
+		return;
+	}
+
+	job_mutex_lock( &job_system.mutex );
+	job_system.func           = func;
+	job_system.user_data      = user_data;
+	job_system.count          = count;
+	job_system.batch_size     = batch_size;
+	job_system.next           = 0;
+	job_system.active_workers = job_system.worker_count;
+	job_system.generation++;
+	job_cond_broadcast( &job_system.work_cond );
+	job_mutex_unlock( &job_system.mutex );
+
+	job_system_run_batches();
+
+	job_mutex_lock( &job_system.mutex );
+	while ( job_system.active_workers != 0 )
+	{
+		job_cond_wait( &job_system.done_cond, &job_system.mutex );
+	}
+	job_mutex_unlock( &job_system.mutex );
+}
+
+void
+job_graph_init( struct job_graph* graph )
+{
+	memset( graph, 0, sizeof( *graph ) );
+}
+
+uint32_t
+job_graph_add( struct job_graph* graph,
+               job_task_func     func,
+               void*             user_data,
+               uint32_t          dependencies )
+{
+	uint32_t task = graph->task_count++;
+
+	graph->tasks[ task ].func         = func;
+	graph->tasks[ task ].user_data    = user_data;
+	graph->tasks[ task ].dependencies = dependencies;
+
+	return task;
+}
+
+struct job_graph_state
+{
+	const struct job_graph* graph;
+	uint32_t                all;
+	uint32_t                started;
+	uint32_t                done;
+};
+
+// every participating thread keeps taking ready tasks until the whole
+// graph has finished, tasks only become ready once their dependencies are
+// done so the loop never waits on work it could run itself
+static void
+job_graph_run_tasks( void* user_data, uint32_t begin, uint32_t end )
+{
+	( void ) begin;
+	( void ) end;
+
+	struct job_graph_state* state = user_data;
+	const struct job_graph* graph = state->graph;
+
+	job_mutex_lock( &job_system.mutex );
+
+	while ( state->done != state->all )
+	{
+		uint32_t task = graph->task_count;
+
+		for ( uint32_t i = 0; i < graph->task_count; ++i )
+		{
+			uint32_t bit = 1u << i;
+			if ( !( state->started & bit ) &&
+			     ( graph->tasks[ i ].dependencies & ~state->done ) == 0 )
+			{
+				task = i;
+				break;
+			}
+		}
+
+		if ( task == graph->task_count )
+		{
+			job_cond_wait( &job_system.graph_cond, &job_system.mutex );
+			continue;
+		}
+
+		state->started |= 1u << task;
+		job_mutex_unlock( &job_system.mutex );
+
+		graph->tasks[ task ].func( graph->tasks[ task ].user_data );
+
+		job_mutex_lock( &job_system.mutex );
+		state->done |= 1u << task;
+		job_cond_broadcast( &job_system.graph_cond );
+	}
+
+	job_mutex_unlock( &job_system.mutex );
+}
+
+void
+job_system_run_graph( const struct job_graph* graph )
+{
+	struct job_graph_state state = {
+	    .graph = graph,
+	    .all   = graph->task_count == JOB_GRAPH_MAX_TASKS
+	                 ? ~0u
+	                 : ( 1u << graph->task_count ) - 1,
+	};
+
+	// one batch per thread, each batch is a scheduler loop
+	uint32_t threads = job_system_get_thread_count();
+	if ( threads > graph->task_count )
+	{
+		threads = graph->task_count;
+	}
+
+	job_system_parallel_for( threads, 1, job_graph_run_tasks, &state );
+}
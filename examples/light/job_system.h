@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef void ( *job_range_func )( void* user_data, uint32_t begin, uint32_t end );
+typedef void ( *job_task_func )( void* user_data );
+
+#define JOB_GRAPH_MAX_TASKS 32
+
+#define JOB_DEPENDS_ON( task ) ( 1u << ( task ) )
+
+// tasks run once all tasks in their dependency mask have finished, a
+// task can only depend on tasks added before it
+struct job_graph
+{
+	uint32_t task_count;
+	struct
+	{
+		job_task_func func;
+		void*         user_data;
+		uint32_t      dependencies;
+	} tasks[ JOB_GRAPH_MAX_TASKS ];
+};
+
+// worker_count == 0 picks one worker per hardware thread minus the caller
+void
+job_system_init( uint32_t worker_count );
+
+void
+job_system_shutdown( void );
+
+uint32_t
+job_system_get_thread_count( void );
+
+// 0 for the thread that called job_system_init, 1.. for the workers
+uint32_t
+job_system_get_thread_index( void );
+
+// splits [0, count) into batches and runs them on the workers and the
+// calling thread, returns once every batch is done. called from inside a
+// job or a graph task the whole range runs inline on the calling thread
+void
+job_system_parallel_for( uint32_t       count,
+                         uint32_t       batch_size,
+                         job_range_func func,
+                         void*          user_data );
+
+void
+job_graph_init( struct job_graph* graph );
+
+// returns the task index to build dependency masks from
+uint32_t
+job_graph_add( struct job_graph* graph,
+               job_task_func     func,
+               void*             user_data,
+               uint32_t          dependencies );
+
+// runs every task of the graph on the workers and the calling thread,
+// returns once all of them are done
+void
+job_system_run_graph( const struct job_graph* graph );
@@ -1,16 +1,120 @@
+#include <ctype.h>
+#include <errno.h>
 #include <fluent/fluent.h>
 
 #include "ui_pass.h"
 #include "main_pass.h"
+#include "file_map.h"
+#include "job_system.h"
+#include "hdr_decode.h"
+#include "timeline.h"
+#include "pipeline_timer.h"
+#include "ibl_cache.h"
+#include "frame_stats.h"
+#include "benchmark.h"
+#include "frame_capture.h"
+#include "profiler.h"
+#include "fluent_features.h"
+#include "gpu_timer.h"
 #include "eq_to_cubemap.comp.h"
 #include "brdf.comp.h"
 #include "irradiance.comp.h"
 #include "specular.comp.h"
+#include "sh_project.comp.h"
+
+#define MAX_FRAME_COUNT MAIN_PASS_MAX_FRAMES_IN_FLIGHT
+#define FRAME_COUNT     2
+#define WINDOW_WIDTH    1400
+#define WINDOW_HEIGHT   900
+
+#define ENVIRONMENT_MAP "Newport_Loft_Ref.hdr"
+#define IBL_CACHE_FILE  "ibl_cache.bin"
+#define SKYBOX_SIZE     2048
+#define IRRADIANCE_SIZE 32
+#define SPECULAR_SIZE   128
+#define BRDF_LUT_SIZE   512
+
+// compiled pipelines of the last run, see pipeline_timer.h
+#define PIPELINE_CACHE_FILE "pipeline_cache.bin"
+
+// frames averaged per line of the --stress-draws report
+#define STRESS_REPORT_FRAMES 120
+
+// --benchmark runs this many frames before it starts recording, and moves
+// animations by a 60 hz step
+#define BENCHMARK_WARMUP_FRAMES 30
+#define BENCHMARK_STEP          ( 1.0f / 60.0f )
+
+// --headless frames advance by a 60 hz step
+#define HEADLESS_STEP ( 1.0f / 60.0f )
+
+// frames written by --trace unless --trace-frames picks others
+#define TRACE_FRAME_COUNT 120
+
+// frames averaged per line of the pacing report
+#define PACING_REPORT_FRAMES 120
+
+// streamed texture levels are evicted past this, see --texture-budget
+#define TEXTURE_BUDGET_MB 512
+
+// --resize-check never shrinks the target below this
+#define RESIZE_CHECK_MIN_EXTENT 16
+
+static struct ibl_bake_params ibl_params = {
+    .skybox_size             = SKYBOX_SIZE,
+    .irradiance_size         = IRRADIANCE_SIZE,
+    .specular_size           = SPECULAR_SIZE,
+    .brdf_lut_size           = BRDF_LUT_SIZE,
+    .importance_sample_count = IBL_IMPORTANCE_SAMPLE_COUNT,
+    .irradiance_sample_delta = IBL_IRRADIANCE_SAMPLE_DELTA,
+    .irradiance_mode         = IBL_IRRADIANCE_CUBEMAP,
+    .cube_format             = FT_FORMAT_R16G16B16A16_SFLOAT,
+    .lut_format              = FT_FORMAT_R16G16_UNORM,
+};
+
+// mailbox adds a swapchain image beyond the frames in flight, which the
+// driver can replace while one is shown. a fluent without present modes
+// only tells the swapchain whether to wait for vblank, fifo asks for it,
+// immediate does not and mailbox can not be asked for
+enum present_mode
+{
+	PRESENT_MODE_FIFO,
+	PRESENT_MODE_MAILBOX,
+	PRESENT_MODE_IMMEDIATE,
+	PRESENT_MODE_COUNT,
+};
+
+// throughput waits for a frame slot's fence just before recording into
+// it again. low latency waits for the last submitted frame before input
+// is sampled, so a frame never queues behind others
+enum frame_pacing
+{
+	FRAME_PACING_THROUGHPUT,
+	FRAME_PACING_LOW_LATENCY,
+	FRAME_PACING_COUNT,
+};
 
-#define FRAME_COUNT   2
-#define WINDOW_WIDTH  1400
-#define WINDOW_HEIGHT 900
+static const char* present_mode_names[ PRESENT_MODE_COUNT ] = {
+    [PRESENT_MODE_FIFO]      = "fifo",
+    [PRESENT_MODE_MAILBOX]   = "mailbox",
+    [PRESENT_MODE_IMMEDIATE] = "immediate",
+};
+
+#if LIGHT_FLUENT_PRESENT_MODE
+static const enum ft_present_mode fluent_present_modes[ PRESENT_MODE_COUNT ] = {
+    [PRESENT_MODE_FIFO]      = FT_PRESENT_MODE_FIFO,
+    [PRESENT_MODE_MAILBOX]   = FT_PRESENT_MODE_MAILBOX,
+    [PRESENT_MODE_IMMEDIATE] = FT_PRESENT_MODE_IMMEDIATE,
+};
+#endif
 
+static const char* frame_pacing_names[ FRAME_PACING_COUNT ] = {
+    [FRAME_PACING_THROUGHPUT]  = "throughput",
+    [FRAME_PACING_LOW_LATENCY] = "low-latency",
+};
+
+// input_ns is when the input of the frame last submitted from the slot
+// was sampled, in_flight until its fence was seen signaled
 struct frame_data
 {
 	struct ft_semaphore* present_semaphore;
@@ -20,6 +124,44 @@ struct frame_data
 	struct ft_command_pool*   cmd_pool;
 	struct ft_command_buffer* cmd;
 	bool                      cmd_recorded;
+	bool                      in_flight;
+	uint64_t                  input_ns;
+};
+
+// decoded equirect environment, rgba16f from hdr_decode or rgba32f from
+// the engine loader
+struct environment_image
+{
+	enum ft_format format;
+	uint32_t       width;
+	uint32_t       height;
+	void*          texels;
+};
+
+enum bake_stage
+{
+	BAKE_EQ_TO_CUBEMAP,
+	BAKE_BRDF,
+	BAKE_IRRADIANCE,
+	BAKE_SPECULAR,
+	BAKE_PIPELINE_COUNT,
+};
+
+struct bake_pipeline
+{
+	struct ft_shader*                shader;
+	struct ft_descriptor_set_layout* dsl;
+	struct ft_pipeline*              pipeline;
+};
+
+// state handed between the startup tasks, see on_init
+struct startup_data
+{
+	struct timeline          timeline;
+	uint64_t                 ibl_key;
+	bool                     ibl_cache_valid;
+	struct environment_image environment;
+	struct bake_pipeline     bake[ BAKE_PIPELINE_COUNT ];
 };
 
 struct app_data
@@ -29,12 +171,15 @@ struct app_data
 	struct ft_device*           device;
 	struct ft_queue*            graphics_queue;
 	struct ft_swapchain*        swapchain;
-	struct frame_data           frames[ FRAME_COUNT ];
+	struct render_target_info   target;
+	struct frame_data           frames[ MAX_FRAME_COUNT ];
+	uint32_t                    frame_count;
 	uint32_t                    frame_index;
 	uint32_t                    image_index;
 
 	struct ft_render_graph* graph;
 
+	struct ft_camera_info       camera_info;
 	struct ft_camera            camera;
 	struct ft_camera_controller camera_controller;
 
@@ -42,6 +187,84 @@ struct app_data
 	struct nk_font_atlas* atlas;
 
 	struct pbr_maps pbr;
+
+	struct startup_data startup;
+
+	// cpu time of on_update and of recording the graph into the command
+	// buffer, reported with --stress-draws
+	uint32_t                   stress_draw_count;
+	enum main_pass_draw_submit draw_submit;
+	struct frame_stats         update_stats;
+	struct frame_stats         record_stats;
+
+	// --benchmark flies the camera along a fixed path for a set number of
+	// frames, headless, writes the frame times to benchmark_output and
+	// quits. the gpu time of a frame comes from its timestamps, bounds are
+	// the scene the path circles
+	uint32_t         benchmark_frames;
+	const char*      benchmark_output;
+	uint32_t         grid_columns;
+	uint32_t         grid_rows;
+	struct benchmark benchmark;
+	bool             benchmark_bounds_ready;
+	float            benchmark_min[ 3 ];
+	float            benchmark_max[ 3 ];
+
+	// set once the benchmark is over, run_headless stops on it and
+	// returns exit_status
+	bool quit;
+	int  exit_status;
+
+	// --headless renders into one offscreen image per frame in flight in
+	// place of a window and a swapchain, capture reads the last frame back
+	// for --capture
+	bool                 headless;
+	uint32_t             headless_frames;
+	uint32_t             frame_number;
+	struct ft_image*     offscreen[ MAX_FRAME_COUNT ];
+	const char*          capture_path;
+	struct frame_capture capture;
+
+	// --trace writes the profiled frames [trace_first, trace_first +
+	// trace_count) as chrome trace json
+	const char* trace_path;
+	uint32_t    trace_first;
+	uint32_t    trace_count;
+
+	// frames in flight, present mode and pacing are picked at startup.
+	// latency runs from input sampling until the frame's fence is seen
+	// signaled, by a wait or by the polls at the start and the end of
+	// every update, whichever comes first. without fence status only the
+	// waits see it, an upper bound when the cpu comes back to it late
+	enum present_mode  present_mode;
+	enum frame_pacing  pacing;
+	bool               report_pacing;
+	uint64_t           input_ns;
+	uint64_t           last_frame_ns;
+	struct frame_stats interval_stats;
+	struct frame_stats latency_stats;
+
+	// on_resize only records the size, apply_resize rebuilds with it.
+	// --resize-check resizes for that many frames, headless, and checks
+	// nothing but the attachments was recreated
+	bool     resize_pending;
+	uint32_t resize_width;
+	uint32_t resize_height;
+	uint32_t resize_count;
+	uint32_t resize_check_count;
+	uint32_t resize_check_width;
+	uint32_t resize_check_height;
+	uint32_t resize_check_uploads;
+	uint32_t resize_check_pipelines;
+};
+
+typedef void ( *startup_func )( struct app_data* );
+
+struct startup_task
+{
+	struct app_data* app;
+	startup_func     func;
+	uint32_t         phase;
 };
 
 static void
@@ -49,24 +272,88 @@ init_renderer( struct app_data* );
 static void
 shutdown_renderer( struct app_data* );
 
+static void
+create_offscreen_targets( struct app_data* );
+static void
+destroy_offscreen_targets( struct app_data* );
+
+static void
+on_shutdown( void* );
+
+static void
+wait_for_frame( struct app_data*, uint32_t index );
+static void
+poll_frame_fences( struct app_data* );
 static void
 begin_frame( struct app_data* );
 static void
 end_frame( struct app_data* );
 
 static void
-compute_pbr_maps( struct app_data* );
+init_ui( struct app_data* );
+static void
+init_render_graph( struct app_data* );
+static void
+build_render_graph( struct app_data* );
+
+static void
+startup_ibl_key( struct app_data* );
+static void
+startup_decode_environment( struct app_data* );
+static void
+startup_ibl_maps( struct app_data* );
+static void
+startup_load_model( struct app_data* );
+static void
+startup_create_bake_pipelines( struct app_data* );
+static void
+startup_create_pbr_pipeline( struct app_data* );
+static void
+startup_create_skybox_pipeline( struct app_data* );
+static void
+startup_create_cull_pipeline( struct app_data* );
+static void
+startup_upload_scene( struct app_data* );
+
+static void
+create_bake_pipelines( struct app_data* );
+static void
+compute_pbr_maps( struct app_data*, struct ft_command_buffer* cmd );
 static void
 free_pbr_maps( struct app_data* );
 
+static void
+run_startup_task( void* p )
+{
+	struct startup_task* task     = p;
+	struct timeline*     timeline = &task->app->startup.timeline;
+
+	timeline_begin( timeline, task->phase );
+	task->func( task->app );
+	timeline_end( timeline, task->phase );
+}
+
+static void
+run_startup_phase( struct app_data* app, const char* name, startup_func func )
+{
+	struct timeline* timeline = &app->startup.timeline;
+	uint32_t         phase    = timeline_add( timeline, name );
+
+	timeline_begin( timeline, phase );
+	func( app );
+	timeline_end( timeline, phase );
+}
+
 static void
 on_init( void* p )
 {
 	struct app_data* app = p;
 
-	struct ft_camera_info camera_info = {
+	app->camera_info = ( struct ft_camera_info ) {
 	    .fov         = radians( 45.0f ),
-	    .aspect      = ft_window_get_aspect( ft_get_app_window() ),
+	    .aspect      = app->headless
+	                       ? ( float ) app->target.width / app->target.height
+	                       : ft_window_get_aspect( ft_get_app_window() ),
 	    .near        = 0.1f,
 	    .far         = 1000.0f,
 	    .speed       = 5.0f,
@@ -76,88 +363,1131 @@ on_init( void* p )
 	    .up          = { 0.0f, 1.0f, 0.0f },
 	};
 
-	ft_camera_init( &app->camera, &camera_info );
+	job_system_init( 0 );
+
+	ft_camera_init( &app->camera, &app->camera_info );
 	ft_camera_controller_init( &app->camera_controller, &app->camera );
 
-	init_renderer( app );
+	struct startup_data* startup = &app->startup;
+	memset( startup, 0, sizeof( *startup ) );
+	timeline_reset( &startup->timeline );
+
+	// window, device and ui stay on the main thread
+	run_startup_phase( app, "renderer", init_renderer );
+	run_startup_phase( app, "ui", init_ui );
+	run_startup_phase( app, "graph setup", init_render_graph );
+
+	// everything between renderer init and the graph build runs as a task
+	// graph. the ibl key, gltf parse and hdr decode only touch the cpu and
+	// run alongside everything else. the device work runs in two chains
+	// that share nothing fluent or vulkan wants synchronized: the scene
+	// pipelines only create shaders, set layouts and pipelines, while the
+	// ibl chain, the only user of descriptor sets, the resource loader and
+	// the queue until the scene upload, compiles its bake pipelines and
+	// bakes with a command pool of its own. the scene upload waits for
+	// both
+	enum
+	{
+		TASK_IBL_KEY,
+		TASK_LOAD_MODEL,
+		TASK_DECODE_ENVIRONMENT,
+		TASK_BAKE_PIPELINES,
+		TASK_PBR_PIPELINE,
+		TASK_SKYBOX_PIPELINE,
+		TASK_CULL_PIPELINE,
+		TASK_IBL_MAPS,
+		TASK_UPLOAD_SCENE,
+		TASK_COUNT,
+	};
+
+	static const struct
+	{
+		const char*  name;
+		startup_func func;
+		uint32_t     dependencies;
+	} task_infos[ TASK_COUNT ] = {
+	    [TASK_IBL_KEY]    = { "ibl key", startup_ibl_key, 0 },
+	    [TASK_LOAD_MODEL] = { "gltf load", startup_load_model, 0 },
+	    [TASK_DECODE_ENVIRONMENT] =
+	        {
+	            "hdr decode",
+	            startup_decode_environment,
+	            JOB_DEPENDS_ON( TASK_IBL_KEY ),
+	        },
+	    [TASK_BAKE_PIPELINES] =
+	        {
+	            "bake pipelines",
+	            startup_create_bake_pipelines,
+	            JOB_DEPENDS_ON( TASK_IBL_KEY ),
+	        },
+	    [TASK_PBR_PIPELINE] =
+	        {
+	            "pbr pipeline",
+	            startup_create_pbr_pipeline,
+	            0,
+	        },
+	    [TASK_SKYBOX_PIPELINE] =
+	        {
+	            "skybox pipeline",
+	            startup_create_skybox_pipeline,
+	            JOB_DEPENDS_ON( TASK_PBR_PIPELINE ),
+	        },
+	    [TASK_CULL_PIPELINE] =
+	        {
+	            "cull pipeline",
+	            startup_create_cull_pipeline,
+	            JOB_DEPENDS_ON( TASK_SKYBOX_PIPELINE ),
+	        },
+	    [TASK_IBL_MAPS] =
+	        {
+	            "ibl maps",
+	            startup_ibl_maps,
+	            JOB_DEPENDS_ON( TASK_DECODE_ENVIRONMENT ) |
+	                JOB_DEPENDS_ON( TASK_BAKE_PIPELINES ),
+	        },
+	    [TASK_UPLOAD_SCENE] =
+	        {
+	            "scene upload",
+	            startup_upload_scene,
+	            JOB_DEPENDS_ON( TASK_LOAD_MODEL ) |
+	                JOB_DEPENDS_ON( TASK_CULL_PIPELINE ) |
+	                JOB_DEPENDS_ON( TASK_IBL_MAPS ),
+	        },
+	};
+
+	struct startup_task tasks[ TASK_COUNT ];
+	struct job_graph    graph;
+	job_graph_init( &graph );
+
+	for ( uint32_t i = 0; i < TASK_COUNT; ++i )
+	{
+		tasks[ i ].app   = app;
+		tasks[ i ].func  = task_infos[ i ].func;
+		tasks[ i ].phase = timeline_add( &startup->timeline,
+		                                 task_infos[ i ].name );
+		job_graph_add( &graph,
+		               run_startup_task,
+		               &tasks[ i ],
+		               task_infos[ i ].dependencies );
+	}
+
+	job_system_run_graph( &graph );
+
+	run_startup_phase( app, "graph build", build_render_graph );
+
+	timeline_print( &startup->timeline, "startup timeline" );
+}
+
+// update time includes waiting for the frame fence and presenting, record
+// time is what the draws cost the cpu
+static void
+report_stress_frame( struct app_data* app,
+                     uint64_t         update_ns,
+                     uint64_t         record_ns )
+{
+	frame_stats_add( &app->update_stats, update_ns );
+	frame_stats_add( &app->record_stats, record_ns );
+
+	if ( app->record_stats.count < STRESS_REPORT_FRAMES )
+	{
+		return;
+	}
+
+	struct main_pass_scene_stats stats;
+	main_pass_get_scene_stats( &stats );
+
+	ft_log_info( "%u draws, %s, %u visible: update %.3f ms avg "
+	             "(%.3f-%.3f), record %.3f ms avg (%.3f-%.3f)",
+	             app->stress_draw_count,
+	             app->draw_submit == MAIN_PASS_DRAW_SUBMIT_DIRECT ? "direct"
+	                                                              : "indirect",
+	             stats.visible_count,
+	             frame_stats_average_ms( &app->update_stats ),
+	             ( double ) app->update_stats.min_ns / 1e6,
+	             ( double ) app->update_stats.max_ns / 1e6,
+	             frame_stats_average_ms( &app->record_stats ),
+	             ( double ) app->record_stats.min_ns / 1e6,
+	             ( double ) app->record_stats.max_ns / 1e6 );
+
+	frame_stats_reset( &app->update_stats );
+	frame_stats_reset( &app->record_stats );
+}
+
+// frames per second from the interval between frames and the latency of
+// the frames whose fences were seen signaled since the last line
+static void
+report_pacing_frame( struct app_data* app )
+{
+	uint64_t now = frame_clock_ns();
+
+	if ( app->last_frame_ns != 0 )
+	{
+		frame_stats_add( &app->interval_stats, now - app->last_frame_ns );
+	}
+	app->last_frame_ns = now;
+
+	if ( app->interval_stats.count < PACING_REPORT_FRAMES ||
+	     app->latency_stats.count == 0 )
+	{
+		return;
+	}
+
+	ft_log_info( "%u frames in flight, %s, %s pacing: %.1f fps, latency "
+	             "%.3f ms avg (%.3f-%.3f)",
+	             app->frame_count,
+	             present_mode_names[ app->present_mode ],
+	             frame_pacing_names[ app->pacing ],
+	             1000.0 / frame_stats_average_ms( &app->interval_stats ),
+	             frame_stats_average_ms( &app->latency_stats ),
+	             ( double ) app->latency_stats.min_ns / 1e6,
+	             ( double ) app->latency_stats.max_ns / 1e6 );
+
+	frame_stats_reset( &app->interval_stats );
+	frame_stats_reset( &app->latency_stats );
+}
+
+// the camera of the next benchmark frame, around the scene as uploaded
+static void
+update_benchmark_camera( struct app_data* app )
+{
+	if ( !app->benchmark_bounds_ready )
+	{
+		main_pass_get_scene_bounds( app->benchmark_min, app->benchmark_max );
+		app->benchmark_bounds_ready = true;
+	}
+
+	struct ft_camera_info info = app->camera_info;
+	benchmark_camera( &app->benchmark,
+	                  app->benchmark_min,
+	                  app->benchmark_max,
+	                  info.position,
+	                  info.direction );
+	ft_camera_init( &app->camera, &info );
+}
+
+// only the last frame of a headless run is read back
+static bool
+capture_this_frame( const struct app_data* app )
+{
+	if ( !app->headless || app->capture_path == NULL )
+	{
+		return false;
+	}
+
+	if ( app->benchmark_frames != 0 )
+	{
+		return app->benchmark.frame + 1 ==
+		       app->benchmark.warmup_count + app->benchmark.frame_count;
+	}
+
+	return app->frame_number + 1 == app->headless_frames;
+}
+
+// what the streamed textures ended a run with, where the ui is not there
+// to show it
+static void
+log_texture_stats( void )
+{
+	struct main_pass_scene_stats stats;
+	main_pass_get_scene_stats( &stats );
+
+	ft_log_info( "textures: %u of %u slots, %.2f of %.2f MB resident, "
+	             "%.0f MB budget, %u streamed, %u evicted, %u pending",
+	             stats.texture_count,
+	             stats.texture_slots,
+	             ( double ) stats.texture_bytes / ( 1024.0 * 1024.0 ),
+	             ( double ) stats.texture_full_bytes / ( 1024.0 * 1024.0 ),
+	             ( double ) stats.streaming.budget / ( 1024.0 * 1024.0 ),
+	             stats.streaming.streamed_count,
+	             stats.streaming.evicted_count,
+	             stats.streaming.pending_count );
+}
+
+// logs the percentiles, writes the frames and ends the headless run
+static void
+finish_benchmark( struct app_data* app )
+{
+	static const char* metric_names[ BENCHMARK_METRIC_COUNT ] = {
+	    [BENCHMARK_METRIC_CPU]    = "cpu",
+	    [BENCHMARK_METRIC_RECORD] = "record",
+	    [BENCHMARK_METRIC_GPU]    = "gpu",
+	};
+
+	static const char* culling_names[ MAIN_PASS_CULLING_COUNT ] = {
+	    [MAIN_PASS_CULLING_GPU] = "gpu",
+	    [MAIN_PASS_CULLING_CPU] = "cpu",
+	    [MAIN_PASS_CULLING_OFF] = "off",
+	};
+
+	struct main_pass_scene_stats stats;
+	main_pass_get_scene_stats( &stats );
+
+	ft_log_info( "benchmark: %u frames, %u draws, %u instances",
+	             app->benchmark_frames,
+	             stats.draw_count,
+	             stats.instance_count );
+
+	for ( uint32_t m = 0; m < BENCHMARK_METRIC_COUNT; ++m )
+	{
+		struct benchmark_summary summary;
+		benchmark_summarize( &app->benchmark, m, &summary );
+
+		ft_log_info( "  %s: %.3f ms avg, p50 %.3f, p95 %.3f, p99 %.3f, "
+		             "max %.3f",
+		             metric_names[ m ],
+		             summary.average_ms,
+		             summary.p50_ms,
+		             summary.p95_ms,
+		             summary.p99_ms,
+		             summary.max_ms );
+	}
+
+	struct benchmark_scene scene = {
+	    .model_count    = stats.model_count,
+	    .draw_count     = stats.draw_count,
+	    .instance_count = stats.instance_count,
+	    .grid_columns   = app->grid_columns,
+	    .grid_rows      = app->grid_rows,
+	    .culling        = culling_names[ stats.culling ],
+	    .submit = app->draw_submit == MAIN_PASS_DRAW_SUBMIT_DIRECT ? "direct"
+	                                                               : "indirect",
+	    .gpu_timing = LIGHT_FLUENT_QUERIES ? "timestamps" : "none",
+	};
+
+	if ( app->benchmark_output &&
+	     !benchmark_write( &app->benchmark, &scene, app->benchmark_output ) )
+	{
+		ft_log_error( "could not write %s", app->benchmark_output );
+		app->exit_status = EXIT_FAILURE;
+	}
 
-	app->ctx = nk_ft_init( ft_get_wsi_info(),
+	benchmark_shutdown( &app->benchmark );
+	app->quit = true;
+}
+
+// dragging a window edge resizes many times a frame, only the last size
+// is applied at the start of the next frame
+static void
+on_resize( uint32_t width, uint32_t height, void* p )
+{
+	struct app_data* app = p;
+
+	app->resize_pending = true;
+	app->resize_width   = width;
+	app->resize_height  = height;
+}
+
+// the rebuild replaces the attachments, which only the frames in flight
+// can still be using. ft_rg_build destroys the graph's depth attachment
+// and ft_resize_swapchain the swapchain images on the spot, fluent takes
+// no images to keep or retire for them, so the last submitted frame is
+// waited for. frames retire in submit order on the one queue, which
+// covers the frames before it. the passes keep everything else, the
+// resource loader is never involved
+static void
+apply_resize( struct app_data* app )
+{
+	app->resize_pending = false;
+
+	// a minimized window reports an empty size, there is nothing to build
+	if ( app->resize_width == 0 || app->resize_height == 0 ||
+	     ( app->resize_width == app->target.width &&
+	       app->resize_height == app->target.height ) )
+	{
+		return;
+	}
+
+	wait_for_frame( app,
+	                ( app->frame_index + app->frame_count - 1 ) %
+	                    app->frame_count );
+
+	app->target.width  = app->resize_width;
+	app->target.height = app->resize_height;
+
+	if ( app->headless )
+	{
+		destroy_offscreen_targets( app );
+		create_offscreen_targets( app );
+	}
+	else
+	{
+		ft_resize_swapchain( app->device,
+		                     app->swapchain,
+		                     app->target.width,
+		                     app->target.height );
+	}
+
+	main_pass_resize( app->target.width, app->target.height );
+	ui_pass_resize( app->target.width, app->target.height );
+	ft_rg_set_swapchain_dimensions( app->graph,
+	                                app->target.width,
+	                                app->target.height );
+	ft_rg_build( app->graph );
+
+	app->resize_count++;
+}
+
+// a --size too small to shrink toggles between the two smallest extents,
+// so every frame still resizes
+static uint32_t
+resize_check_extent( uint32_t extent, uint32_t shrink, uint32_t current )
+{
+	if ( extent >= RESIZE_CHECK_MIN_EXTENT + shrink )
+	{
+		return extent - shrink;
+	}
+
+	return current == RESIZE_CHECK_MIN_EXTENT ? RESIZE_CHECK_MIN_EXTENT + 1
+	                                          : RESIZE_CHECK_MIN_EXTENT;
+}
+
+// --resize-check resizes twice a frame, so every frame applies one resize
+// and drops one. the scene and the pipelines have to survive all of them
+static void
+drive_resize_check( struct app_data* app )
+{
+	struct main_pass_scene_stats stats;
+	main_pass_get_scene_stats( &stats );
+
+	if ( app->frame_number == 0 )
+	{
+		app->resize_check_uploads   = stats.scene_upload_count;
+		app->resize_check_pipelines = stats.pipeline_create_count;
+	}
+
+	if ( app->frame_number < app->resize_check_count )
+	{
+		uint32_t shrink = 64 * ( 1 + app->frame_number % 2 );
+		on_resize( app->target.width / 2, app->target.height / 2, app );
+		on_resize( resize_check_extent( app->resize_check_width,
+		                                shrink,
+		                                app->target.width ),
+		           resize_check_extent( app->resize_check_height,
+		                                shrink,
+		                                app->target.height ),
+		           app );
+	}
+}
+
+static int
+finish_resize_check( struct app_data* app )
+{
+	struct main_pass_scene_stats stats;
+	main_pass_get_scene_stats( &stats );
+
+	uint32_t uploads   = stats.scene_upload_count - app->resize_check_uploads;
+	uint32_t pipelines = stats.pipeline_create_count -
+	                     app->resize_check_pipelines;
+	bool passed = app->resize_count == app->resize_check_count &&
+	              uploads == 0 && pipelines == 0;
+
+	ft_log_info( "resize check %s: %u resizes applied of %u, %u scene "
+	             "uploads and %u pipelines created during them",
+	             passed ? "passed" : "failed",
+	             app->resize_count,
+	             app->resize_check_count,
+	             uploads,
+	             pipelines );
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void
+on_update( float delta_time, void* p )
+{
+	struct app_data* app          = p;
+	uint64_t         update_begin = frame_clock_ns();
+
+	profiler_begin_frame( app->frame_number );
+	profiler_begin( "frame" );
+
+	if ( app->resize_check_count != 0 )
+	{
+		drive_resize_check( app );
+	}
+
+	if ( app->resize_pending )
+	{
+		profiler_begin( "resize" );
+		apply_resize( app );
+		profiler_end();
+	}
+
+	poll_frame_fences( app );
+
+	if ( app->pacing == FRAME_PACING_LOW_LATENCY )
+	{
+		profiler_begin( "pacing wait" );
+		wait_for_frame( app,
+		                ( app->frame_index + app->frame_count - 1 ) %
+		                    app->frame_count );
+		profiler_end();
+	}
+
+	app->input_ns = frame_clock_ns();
+
+	if ( app->benchmark_frames != 0 )
+	{
+		update_benchmark_camera( app );
+	}
+	else if ( !app->headless )
+	{
+		// headless runs have no input, their camera stays where it started
+		if ( ft_is_key_pressed( FT_KEY_LEFT_ALT ) )
+		{
+			ft_camera_controller_update( &app->camera_controller,
+			                             delta_time );
+		}
+		else
+		{
+			ft_camera_controller_reset( &app->camera_controller );
+		}
+	}
+
+	// scene changes asked for by the ui last frame
+	profiler_begin( "requests" );
+	main_pass_process_requests( app->device );
+	profiler_end();
+
+	profiler_begin( "begin frame" );
+	begin_frame( app );
+	profiler_end();
+
+	uint64_t record_begin = frame_clock_ns();
+
+	struct ft_command_buffer* cmd     = app->frames[ app->frame_index ].cmd;
+	struct ft_image*          image   = NULL;
+	bool                      capture = capture_this_frame( app );
+
+	if ( app->headless )
+	{
+		image = app->offscreen[ app->image_index ];
+	}
+	else
+	{
+		image = ft_get_swapchain_image( app->swapchain, app->image_index );
+	}
+
+	profiler_begin( "record" );
+	ft_begin_command_buffer( cmd );
+	gpu_timer_begin_frame( app->device, cmd, app->frame_index, "frame" );
+	profiler_begin( "prepare frame" );
+	main_pass_prepare_frame( app->device, cmd );
+	profiler_end();
+	ft_rg_setup_attachments( app->graph, image );
+	profiler_begin( "graph" );
+	ft_rg_execute( cmd, app->graph );
+	profiler_end();
+	if ( capture )
+	{
+		frame_capture_record( &app->capture, app->device, cmd, image );
+	}
+	gpu_timer_end_frame( cmd );
+	ft_end_command_buffer( cmd );
+	profiler_end();
+
+	uint64_t record_end = frame_clock_ns();
+
+	profiler_begin( "end frame" );
+	end_frame( app );
+	profiler_end();
+
+	if ( capture )
+	{
+		ft_queue_wait_idle( app->graphics_queue );
+		if ( frame_capture_write_ppm( &app->capture,
+		                              app->device,
+		                              app->capture_path ) )
+		{
+			ft_log_info( "captured frame %u to %s",
+			             app->frame_number,
+			             app->capture_path );
+		}
+		else
+		{
+			ft_log_error( "could not write %s", app->capture_path );
+		}
+	}
+
+	profiler_end();
+	profiler_end_frame();
+
+	if ( app->report_pacing )
+	{
+		report_pacing_frame( app );
+	}
+
+	app->frame_number++;
+
+	if ( app->stress_draw_count != 0 )
+	{
+		report_stress_frame( app,
+		                     frame_clock_ns() - update_begin,
+		                     record_end - record_begin );
+	}
+
+	if ( app->benchmark_frames != 0 )
+	{
+		struct benchmark_frame frame;
+		frame.ns[ BENCHMARK_METRIC_CPU ]    = frame_clock_ns() - update_begin;
+		frame.ns[ BENCHMARK_METRIC_RECORD ] = record_end - record_begin;
+		frame.ns[ BENCHMARK_METRIC_GPU ]    = gpu_timer_frame_ns();
+		benchmark_add_frame( &app->benchmark, &frame );
+
+		if ( !benchmark_running( &app->benchmark ) )
+		{
+			finish_benchmark( app );
+		}
+	}
+}
+
+static void
+on_shutdown( void* p )
+{
+	struct app_data* app = p;
+	ft_queue_wait_idle( app->graphics_queue );
+	profiler_shutdown();
+	ft_rg_destroy( app->graph );
+	free_pbr_maps( app );
+	nk_ft_shutdown();
+	shutdown_renderer( app );
+	job_system_shutdown();
+}
+
+static void
+init_ui( struct app_data* app )
+{
+	app->ctx = nk_ft_init( app->headless ? NULL : ft_get_wsi_info(),
 	                       app->device,
 	                       app->graphics_queue,
-	                       ft_get_swapchain_format( app->swapchain ),
+	                       app->target.format,
 	                       FT_FORMAT_UNDEFINED );
 
 	nk_ft_font_stash_begin( &app->atlas );
 	nk_ft_font_stash_end();
+}
 
-	compute_pbr_maps( app );
+// passes only record their inputs here, the pipelines they need are built
+// by the startup tasks before build_render_graph
+static void
+init_render_graph( struct app_data* app )
+{
+	app->pbr.irradiance_mode = ibl_params.irradiance_mode;
 
 	ft_rg_create( app->device, &app->graph );
 	register_main_pass( app->graph,
-	                    app->swapchain,
+	                    &app->target,
 	                    "back",
 	                    &app->camera,
 	                    &app->pbr );
-	register_ui_pass( app->graph, app->swapchain, "back", app->ctx );
+	register_ui_pass( app->graph, &app->target, "back", app->ctx );
 	ft_rg_set_backbuffer_source( app->graph, "back" );
+}
 
-	uint32_t width, height;
-	ft_get_swapchain_size( app->swapchain, &width, &height );
-	ft_rg_set_swapchain_dimensions( app->graph, width, height );
+static void
+build_render_graph( struct app_data* app )
+{
+	ft_rg_set_swapchain_dimensions( app->graph,
+	                                app->target.width,
+	                                app->target.height );
 	ft_rg_build( app->graph );
 }
 
+// reads a whole argument as a decimal number, strtoul alone would take
+// "12abc", "-1" and values past the range of its result
+static bool
+parse_number( const char* text, const char** end, uint32_t* value )
+{
+	if ( !isdigit( ( unsigned char ) text[ 0 ] ) )
+	{
+		return false;
+	}
+
+	char* number_end;
+	errno                = 0;
+	unsigned long number = strtoul( text, &number_end, 10 );
+
+	if ( errno != 0 || number > UINT32_MAX )
+	{
+		return false;
+	}
+
+	*end   = number_end;
+	*value = ( uint32_t ) number;
+	return true;
+}
+
+static bool
+parse_uint( const char* text, uint32_t min, uint32_t max, uint32_t* value )
+{
+	const char* end;
+	uint32_t    number;
+
+	if ( !parse_number( text, &end, &number ) || *end != '\0' ||
+	     number < min || number > max )
+	{
+		return false;
+	}
+
+	*value = number;
+	return true;
+}
+
+// two numbers joined by separator, as in 1280x720, both at least min
+static bool
+parse_uint_pair( const char* text,
+                 char        separator,
+                 uint32_t    min,
+                 uint32_t*   first,
+                 uint32_t*   second )
+{
+	const char* end;
+	uint32_t    a, b;
+
+	if ( !parse_number( text, &end, &a ) || *end != separator ||
+	     !parse_uint( end + 1, min, UINT32_MAX, &b ) || a < min )
+	{
+		return false;
+	}
+
+	*first  = a;
+	*second = b;
+	return true;
+}
+
+// parse_args runs before anything is created, a bad value ends the process
+// rather than running with a setting nobody asked for
 static void
-on_update( float delta_time, void* p )
+invalid_argument( const char* option, const char* value )
 {
-	struct app_data* app = p;
+	fprintf( stderr, "invalid value '%s' for %s\n", value, option );
+	exit( EXIT_FAILURE );
+}
 
-	if ( ft_is_key_pressed( FT_KEY_LEFT_ALT ) )
+// true when argv[ i ] is name, which takes the argument after it as its
+// value. a missing value ends the process like a bad one
+static bool
+option_with_value( int argc, char** argv, int i, const char* name )
+{
+	if ( strcmp( argv[ i ], name ) != 0 )
 	{
-		ft_camera_controller_update( &app->camera_controller, delta_time );
+		return false;
 	}
-	else
+
+	if ( i + 1 == argc )
+	{
+		fprintf( stderr, "missing value for %s\n", name );
+		exit( EXIT_FAILURE );
+	}
+
+	return true;
+}
+
+// --irradiance sh replaces the baked irradiance cube with nine spherical
+// harmonics coefficients for a/b comparisons against the default cubemap
+// irradiance, --cube-format and --lut-format pick the storage formats of
+// the baked maps,
+// --vertex-format quantized switches the scene to 20 byte vertices,
+// --texture-format bc cooks the textures to bc7, bc5 and bc4 instead of
+// rgba8, --texture-streaming full uploads every texture level on load
+// instead of the mip tails with the rest streamed in as the frames sample
+// them, --texture-budget <MB> caps the streamed levels, 0 for no cap, and
+// every --model <gltf> adds a model to the scene in place of the helmet.
+// --stress-draws <n> repeats the scene until it has n draws and logs the
+// cpu time per frame, --draw-submit direct records a draw call per draw
+// instead of the indirect batches to compare the two and --culling
+// gpu|cpu|off picks the frustum culling, cpu culls a bvh of the scene.
+// without multi draw indirect and non-uniform indexing in fluent only
+// direct and cpu culling run, and without non-uniform indexing and
+// fragment atomics only full streaming, see fluent_features.h.
+// --instances <n> places n instances of every mesh behind the scene, drawn
+// with one instanced draw per mesh, --grid <n>x<m> places them in m rows
+// of n. --benchmark <frames> renders headless, flies a fixed camera path
+// around the scene for that many frames after a warmup and exits with the
+// percentiles logged and, with --benchmark-out <file.csv|file.json>, every
+// frame written. nothing in it needs input, so it runs unattended on a
+// software vulkan driver such as lavapipe picked with VK_ICD_FILENAMES.
+// --headless <frames> renders that many frames without a window or a
+// swapchain, at --size <w>x<h>, and exits. --capture <file.ppm> reads the
+// last frame back and writes it out. with --benchmark it runs until the
+// benchmark is done instead. --profile records cpu scopes around the frame
+// and the passes and, where fluent has query pools, timestamps around
+// their gpu work, shown per scope in the ui. --trace <file.json> profiles
+// and writes --trace-frames <first>:<count> frames, the first 120 by
+// default, as a chrome trace.
+// --frames-in-flight <1-4>, --present fifo|mailbox|immediate and --pacing
+// throughput|low-latency pick how frames are queued, any of them logs the
+// frame rate and latency every 120 frames.
+// --resize-check <n> runs headless, resizes the target on n frames and
+// fails unless no scene upload or pipeline creation happened during them.
+// an unknown option, a missing value or a value that does not parse for
+// its option ends the process
+static void
+parse_args( struct app_data* app, int argc, char** argv )
+{
+	for ( int i = 1; i < argc; ++i )
+	{
+		if ( option_with_value( argc, argv, i, "--irradiance" ) )
+		{
+			++i;
+			if ( strcmp( argv[ i ], "cubemap" ) == 0 )
+			{
+				ibl_params.irradiance_mode = IBL_IRRADIANCE_CUBEMAP;
+			}
+			else if ( strcmp( argv[ i ], "sh" ) == 0 )
+			{
+				ibl_params.irradiance_mode = IBL_IRRADIANCE_SH;
+			}
+			else
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+		}
+		else if ( option_with_value( argc, argv, i, "--cube-format" ) )
+		{
+			uint32_t format;
+			if ( !ibl_format_parse( argv[ ++i ], &format ) ||
+			     ibl_format_channel_count( format ) != 4 )
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+			ibl_params.cube_format = format;
+		}
+		else if ( option_with_value( argc, argv, i, "--lut-format" ) )
+		{
+			uint32_t format;
+			if ( !ibl_format_parse( argv[ ++i ], &format ) ||
+			     ibl_format_channel_count( format ) != 2 )
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+			ibl_params.lut_format = format;
+		}
+		else if ( option_with_value( argc, argv, i, "--vertex-format" ) )
+		{
+			enum mesh_vertex_format format;
+			if ( !mesh_vertex_format_parse( argv[ ++i ], &format ) )
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+			main_pass_set_vertex_format( format );
+		}
+		else if ( option_with_value( argc, argv, i, "--texture-format" ) )
+		{
+			enum mesh_texture_format format;
+			if ( !mesh_texture_format_parse( argv[ ++i ], &format ) )
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+			main_pass_set_texture_format( format );
+		}
+		else if ( option_with_value( argc, argv, i, "--texture-streaming" ) )
+		{
+			++i;
+			if ( strcmp( argv[ i ], "progressive" ) == 0 &&
+			     !MAIN_PASS_TEXTURE_FEEDBACK )
+			{
+				fprintf( stderr,
+				         "--texture-streaming progressive needs a fluent "
+				         "enabling non-uniform indexing and fragment "
+				         "atomics, --fluent_features=descriptor_indexing,"
+				         "fragment_atomics\n" );
+				exit( EXIT_FAILURE );
+			}
+			else if ( strcmp( argv[ i ], "progressive" ) == 0 )
+			{
+				main_pass_set_texture_streaming(
+				    MAIN_PASS_TEXTURE_STREAMING_PROGRESSIVE );
+			}
+			else if ( strcmp( argv[ i ], "full" ) == 0 )
+			{
+				main_pass_set_texture_streaming(
+				    MAIN_PASS_TEXTURE_STREAMING_FULL );
+			}
+			else
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+		}
+		else if ( option_with_value( argc, argv, i, "--texture-budget" ) )
+		{
+			uint32_t megabytes;
+			if ( !parse_uint( argv[ ++i ], 0, UINT32_MAX, &megabytes ) )
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+			main_pass_set_texture_budget( ( uint64_t ) megabytes << 20 );
+		}
+		else if ( option_with_value( argc, argv, i, "--model" ) )
+		{
+			main_pass_add_model_path( argv[ ++i ] );
+		}
+		else if ( option_with_value( argc, argv, i, "--draw-submit" ) )
+		{
+			++i;
+			if ( strcmp( argv[ i ], "direct" ) == 0 )
+			{
+				app->draw_submit = MAIN_PASS_DRAW_SUBMIT_DIRECT;
+			}
+			else if ( strcmp( argv[ i ], "indirect" ) == 0 )
+			{
+				app->draw_submit = MAIN_PASS_DRAW_SUBMIT_INDIRECT;
+			}
+			else
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+			if ( app->draw_submit == MAIN_PASS_DRAW_SUBMIT_INDIRECT &&
+			     !MAIN_PASS_INDIRECT_SUBMIT )
+			{
+				fprintf( stderr,
+				         "--draw-submit indirect needs a fluent enabling "
+				         "multi draw indirect and non-uniform indexing, "
+				         "--fluent_features=multi_draw_indirect,"
+				         "descriptor_indexing\n" );
+				exit( EXIT_FAILURE );
+			}
+		}
+		else if ( option_with_value( argc, argv, i, "--culling" ) )
+		{
+			++i;
+			if ( strcmp( argv[ i ], "gpu" ) == 0 )
+			{
+				main_pass_set_culling( MAIN_PASS_CULLING_GPU );
+			}
+			else if ( strcmp( argv[ i ], "cpu" ) == 0 )
+			{
+				main_pass_set_culling( MAIN_PASS_CULLING_CPU );
+			}
+			else if ( strcmp( argv[ i ], "off" ) == 0 )
+			{
+				main_pass_set_culling( MAIN_PASS_CULLING_OFF );
+			}
+			else
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+		}
+		else if ( option_with_value( argc, argv, i, "--stress-draws" ) )
+		{
+			if ( !parse_uint( argv[ ++i ],
+			                  0,
+			                  UINT32_MAX,
+			                  &app->stress_draw_count ) )
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+			main_pass_set_stress_draw_count( app->stress_draw_count );
+			frame_stats_reset( &app->update_stats );
+			frame_stats_reset( &app->record_stats );
+		}
+		else if ( option_with_value( argc, argv, i, "--instances" ) )
+		{
+			uint32_t count;
+			if ( !parse_uint( argv[ ++i ], 0, UINT32_MAX, &count ) )
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+			main_pass_set_instance_count( count );
+		}
+		else if ( option_with_value( argc, argv, i, "--grid" ) )
+		{
+			if ( !parse_uint_pair( argv[ ++i ],
+			                       'x',
+			                       1,
+			                       &app->grid_columns,
+			                       &app->grid_rows ) )
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+			main_pass_set_instance_grid( app->grid_columns, app->grid_rows );
+		}
+		else if ( option_with_value( argc, argv, i, "--benchmark" ) )
+		{
+			if ( !parse_uint( argv[ ++i ],
+			                  1,
+			                  UINT32_MAX,
+			                  &app->benchmark_frames ) )
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+		}
+		else if ( option_with_value( argc, argv, i, "--benchmark-out" ) )
+		{
+			app->benchmark_output = argv[ ++i ];
+		}
+		else if ( option_with_value( argc, argv, i, "--headless" ) )
+		{
+			app->headless = true;
+			if ( !parse_uint( argv[ ++i ],
+			                  1,
+			                  UINT32_MAX,
+			                  &app->headless_frames ) )
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+		}
+		else if ( option_with_value( argc, argv, i, "--size" ) )
+		{
+			if ( !parse_uint_pair( argv[ ++i ],
+			                       'x',
+			                       1,
+			                       &app->target.width,
+			                       &app->target.height ) )
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+		}
+		else if ( option_with_value( argc, argv, i, "--capture" ) )
+		{
+			app->capture_path = argv[ ++i ];
+		}
+		else if ( option_with_value( argc, argv, i, "--frames-in-flight" ) )
+		{
+			if ( !parse_uint( argv[ ++i ],
+			                  1,
+			                  MAIN_PASS_MAX_FRAMES_IN_FLIGHT,
+			                  &app->frame_count ) )
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+			app->report_pacing = true;
+		}
+		else if ( option_with_value( argc, argv, i, "--present" ) )
+		{
+			uint32_t m = 0;
+			while ( m < PRESENT_MODE_COUNT &&
+			        strcmp( argv[ i + 1 ], present_mode_names[ m ] ) != 0 )
+			{
+				++m;
+			}
+			if ( m == PRESENT_MODE_COUNT )
+			{
+				invalid_argument( argv[ i ], argv[ i + 1 ] );
+			}
+			if ( m == PRESENT_MODE_MAILBOX && !LIGHT_FLUENT_PRESENT_MODE )
+			{
+				fprintf( stderr,
+				         "--present mailbox needs a fluent with present "
+				         "modes, --fluent_features=present_mode\n" );
+				exit( EXIT_FAILURE );
+			}
+			app->present_mode  = m;
+			app->report_pacing = true;
+			++i;
+		}
+		else if ( option_with_value( argc, argv, i, "--pacing" ) )
+		{
+			uint32_t m = 0;
+			while ( m < FRAME_PACING_COUNT &&
+			        strcmp( argv[ i + 1 ], frame_pacing_names[ m ] ) != 0 )
+			{
+				++m;
+			}
+			if ( m == FRAME_PACING_COUNT )
+			{
+				invalid_argument( argv[ i ], argv[ i + 1 ] );
+			}
+			app->pacing        = m;
+			app->report_pacing = true;
+			++i;
+		}
+		else if ( option_with_value( argc, argv, i, "--resize-check" ) )
+		{
+			if ( !parse_uint( argv[ ++i ],
+			                  1,
+			                  UINT32_MAX,
+			                  &app->resize_check_count ) )
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+		}
+		else if ( strcmp( argv[ i ], "--profile" ) == 0 )
+		{
+			profiler_set_enabled( true );
+		}
+		else if ( option_with_value( argc, argv, i, "--trace" ) )
+		{
+			app->trace_path = argv[ ++i ];
+		}
+		else if ( option_with_value( argc, argv, i, "--trace-frames" ) )
+		{
+			uint32_t first, count;
+			if ( !parse_uint_pair( argv[ ++i ], ':', 0, &first, &count ) ||
+			     count == 0 )
+			{
+				invalid_argument( argv[ i - 1 ], argv[ i ] );
+			}
+			app->trace_first = first;
+			app->trace_count = count;
+		}
+		else
+		{
+			fprintf( stderr, "unknown option %s\n", argv[ i ] );
+			exit( EXIT_FAILURE );
+		}
+	}
+
+	main_pass_set_draw_submit( app->draw_submit );
+
+	if ( app->resize_check_count != 0 )
+	{
+		app->headless        = true;
+		app->headless_frames = FT_MAX( app->headless_frames,
+		                               app->resize_check_count + 1 );
+		app->resize_check_width  = app->target.width;
+		app->resize_check_height = app->target.height;
+	}
+
+	// ft_app runs until its window is closed, a benchmark has to end on
+	// its own, so it runs in the headless loop, which stops on quit
+	if ( app->benchmark_frames != 0 )
 	{
-		ft_camera_controller_reset( &app->camera_controller );
+		app->headless = true;
 	}
 
-	begin_frame( app );
+	frame_stats_reset( &app->interval_stats );
+	frame_stats_reset( &app->latency_stats );
 
-	struct ft_command_buffer* cmd = app->frames[ app->frame_index ].cmd;
-	ft_begin_command_buffer( cmd );
-	ft_rg_setup_attachments(
-	    app->graph,
-	    ft_get_swapchain_image( app->swapchain, app->image_index ) );
-	ft_rg_execute( cmd, app->graph );
-	ft_end_command_buffer( cmd );
+	if ( app->trace_path )
+	{
+		profiler_set_enabled( true );
+		profiler_set_trace( app->trace_path,
+		                    app->trace_first,
+		                    app->trace_count );
+	}
 
-	end_frame( app );
+	if ( app->benchmark_frames != 0 )
+	{
+		benchmark_init( &app->benchmark,
+		                app->benchmark_frames,
+		                BENCHMARK_WARMUP_FRAMES );
+		main_pass_set_animation_step( BENCHMARK_STEP );
+	}
 }
 
-static void
-on_resize( uint32_t width, uint32_t height, void* p )
+// the frames of on_update without ft_app, until a benchmark quits or the
+// set number of frames ran
+static int
+run_headless( struct app_data* app )
 {
-	struct app_data* app = p;
+	on_init( app );
 
-	ft_resource_loader_wait_idle();
-	ft_queue_wait_idle( app->graphics_queue );
-	ft_resize_swapchain( app->device, app->swapchain, width, height );
+	while ( !app->quit && ( app->benchmark_frames != 0 ||
+	                        app->frame_number < app->headless_frames ) )
+	{
+		on_update( HEADLESS_STEP, app );
+	}
 
-	ft_rg_set_swapchain_dimensions( app->graph, width, height );
-	ft_rg_build( app->graph );
+	if ( app->resize_check_count != 0 )
+	{
+		app->exit_status = finish_resize_check( app );
+	}
 
-	ft_resource_loader_wait_idle();
-}
+	log_texture_stats();
+	on_shutdown( app );
 
-static void
-on_shutdown( void* p )
-{
-	struct app_data* app = p;
-	ft_queue_wait_idle( app->graphics_queue );
-	ft_rg_destroy( app->graph );
-	free_pbr_maps( app );
-	nk_ft_shutdown();
-	shutdown_renderer( app );
+	return app->exit_status;
 }
 
 int
@@ -165,8 +1495,41 @@ main( int argc, char** argv )
 {
 	struct app_data data = {
 	    .renderer_api = FT_RENDERER_API_VULKAN,
+	    .frame_count  = FRAME_COUNT,
+	    .trace_count  = TRACE_FRAME_COUNT,
+	    .exit_status  = EXIT_SUCCESS,
+	    .draw_submit  = MAIN_PASS_INDIRECT_SUBMIT
+	                        ? MAIN_PASS_DRAW_SUBMIT_INDIRECT
+	                        : MAIN_PASS_DRAW_SUBMIT_DIRECT,
+	    .target =
+	        {
+	            .width  = WINDOW_WIDTH,
+	            .height = WINDOW_HEIGHT,
+	        },
 	};
 
+	main_pass_set_texture_budget( ( uint64_t ) TEXTURE_BUDGET_MB << 20 );
+
+	// gpu culling only feeds the indirect submit, without it the scene is
+	// culled on the cpu unless --culling says otherwise. progressive
+	// streaming reads back what the texture array sampled
+	if ( !MAIN_PASS_INDIRECT_SUBMIT )
+	{
+		main_pass_set_culling( MAIN_PASS_CULLING_CPU );
+	}
+
+	if ( !MAIN_PASS_TEXTURE_FEEDBACK )
+	{
+		main_pass_set_texture_streaming( MAIN_PASS_TEXTURE_STREAMING_FULL );
+	}
+
+	parse_args( &data, argc, argv );
+
+	if ( data.headless )
+	{
+		return run_headless( &data );
+	}
+
 	struct ft_window_info window_info = {
 	    .title        = "fluent-sandbox",
 	    .x            = 100,
@@ -199,15 +1562,62 @@ main( int argc, char** argv )
 
 	ft_app_shutdown();
 
-	return EXIT_SUCCESS;
+	return data.exit_status;
+}
+
+// the offscreen images of headless mode and the capture of their frames,
+// at the target size
+static void
+create_offscreen_targets( struct app_data* app )
+{
+	struct ft_image_info image_info = {
+	    .width           = app->target.width,
+	    .height          = app->target.height,
+	    .depth           = 1,
+	    .format          = app->target.format,
+	    .sample_count    = 1,
+	    .layer_count     = 1,
+	    .mip_levels      = 1,
+	    .descriptor_type = FT_DESCRIPTOR_TYPE_COLOR_ATTACHMENT |
+	                       FT_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+	};
+
+	for ( uint32_t i = 0; i < app->frame_count; i++ )
+	{
+		ft_create_image( app->device, &image_info, &app->offscreen[ i ] );
+	}
+
+	if ( app->capture_path )
+	{
+		frame_capture_init( &app->capture,
+		                    app->device,
+		                    app->target.width,
+		                    app->target.height,
+		                    true );
+	}
+}
+
+static void
+destroy_offscreen_targets( struct app_data* app )
+{
+	if ( app->capture_path )
+	{
+		frame_capture_shutdown( &app->capture, app->device );
+	}
+
+	for ( uint32_t i = 0; i < app->frame_count; i++ )
+	{
+		ft_destroy_image( app->device, app->offscreen[ i ] );
+	}
 }
 
 static void
 init_renderer( struct app_data* app )
 {
+	// headless runs have no window to hand the backend
 	struct ft_renderer_backend_info backend_info = {
 	    .api      = app->renderer_api,
-	    .wsi_info = ft_get_wsi_info(),
+	    .wsi_info = app->headless ? NULL : ft_get_wsi_info(),
 	};
 
 	ft_create_renderer_backend( &backend_info, &app->backend );
@@ -217,15 +1627,22 @@ init_renderer( struct app_data* app )
 	};
 	ft_create_device( app->backend, &device_info, &app->device );
 	ft_resource_loader_init( app->device );
+	pipeline_timer_init( app->device, PIPELINE_CACHE_FILE );
 
 	struct ft_queue_info queue_info = {
 	    queue_info.queue_type = FT_QUEUE_TYPE_GRAPHICS,
 	};
 	ft_create_queue( app->device, &queue_info, &app->graphics_queue );
 
-	for ( uint32_t i = 0; i < FRAME_COUNT; i++ )
+	if ( app->benchmark_frames != 0 || profiler_enabled() )
+	{
+		gpu_timer_init( app->device, app->frame_count );
+	}
+
+	for ( uint32_t i = 0; i < app->frame_count; i++ )
 	{
 		app->frames[ i ].cmd_recorded = 0;
+		app->frames[ i ].in_flight    = false;
 		ft_create_semaphore( app->device, &app->frames[ i ].present_semaphore );
 		ft_create_semaphore( app->device, &app->frames[ i ].render_semaphore );
 		ft_create_fence( app->device, &app->frames[ i ].render_fence );
@@ -243,16 +1660,33 @@ init_renderer( struct app_data* app )
 		                           &app->frames[ i ].cmd );
 	}
 
+	if ( app->headless )
+	{
+		app->target.format = FT_FORMAT_B8G8R8A8_SRGB;
+		create_offscreen_targets( app );
+		return;
+	}
+
 	struct ft_swapchain_info swapchain_info = {
 	    .width  = ft_window_get_framebuffer_width( ft_get_app_window() ),
 	    .height = ft_window_get_framebuffer_height( ft_get_app_window() ),
 	    .format = FT_FORMAT_B8G8R8A8_SRGB,
-	    .min_image_count = FRAME_COUNT,
-	    .vsync           = 1,
+	    .min_image_count = app->frame_count +
+	                       ( app->present_mode == PRESENT_MODE_MAILBOX ),
+#if LIGHT_FLUENT_PRESENT_MODE
+	    .present_mode = fluent_present_modes[ app->present_mode ],
+#else
+	    .vsync = app->present_mode == PRESENT_MODE_FIFO,
+#endif
 	    .queue           = app->graphics_queue,
 	    .wsi_info        = ft_get_wsi_info(),
 	};
 	ft_create_swapchain( app->device, &swapchain_info, &app->swapchain );
+
+	ft_get_swapchain_size( app->swapchain,
+	                       &app->target.width,
+	                       &app->target.height );
+	app->target.format = ft_get_swapchain_format( app->swapchain );
 }
 
 static void
@@ -260,9 +1694,18 @@ shutdown_renderer( struct app_data* app )
 {
 	ft_queue_wait_idle( app->graphics_queue );
 
-	ft_destroy_swapchain( app->device, app->swapchain );
+	if ( app->headless )
+	{
+		destroy_offscreen_targets( app );
+	}
+	else
+	{
+		ft_destroy_swapchain( app->device, app->swapchain );
+	}
+
+	gpu_timer_shutdown( app->device );
 
-	for ( uint32_t i = 0; i < FRAME_COUNT; i++ )
+	for ( uint32_t i = 0; i < app->frame_count; i++ )
 	{
 		ft_destroy_command_buffers( app->device,
 		                            app->frames[ i ].cmd_pool,
@@ -277,24 +1720,76 @@ shutdown_renderer( struct app_data* app )
 	ft_destroy_queue( app->graphics_queue );
 	ft_resource_loader_wait_idle();
 	ft_resource_loader_shutdown();
+	pipeline_timer_shutdown( app->device );
 	ft_destroy_device( app->device );
 	ft_destroy_renderer_backend( app->backend );
 }
 
+static void
+end_frame_latency( struct app_data* app, struct frame_data* frame )
+{
+	frame->in_flight = false;
+	frame_stats_add( &app->latency_stats,
+	                 frame_clock_ns() - frame->input_ns );
+}
+
+// waits for the gpu to finish the frame last submitted from a slot. a
+// wait returns as the fence signals, unless it already had
+static void
+wait_for_frame( struct app_data* app, uint32_t index )
+{
+	struct frame_data* frame = &app->frames[ index ];
+
+	ft_wait_for_fences( app->device, 1, &frame->render_fence );
+
+	if ( frame->in_flight )
+	{
+		end_frame_latency( app, frame );
+	}
+}
+
+// checks the fences of the frames in flight without waiting on them, so a
+// frame's latency ends close to its signal whether the cpu waits on the
+// fence soon after, as low latency pacing does, or frames later. without
+// fence status only the waits end it
+static void
+poll_frame_fences( struct app_data* app )
+{
+#if !LIGHT_FLUENT_FENCE_STATUS
+	FT_UNUSED( app );
+#else
+	for ( uint32_t i = 0; i < app->frame_count; ++i )
+	{
+		struct frame_data* frame = &app->frames[ i ];
+
+		if ( frame->in_flight &&
+		     ft_get_fence_status( app->device, frame->render_fence ) )
+		{
+			end_frame_latency( app, frame );
+		}
+	}
+#endif
+}
+
 static void
 begin_frame( struct app_data* app )
 {
 	if ( !app->frames[ app->frame_index ].cmd_recorded )
 	{
-		ft_wait_for_fences( app->device,
-		                    1,
-		                    &app->frames[ app->frame_index ].render_fence );
+		wait_for_frame( app, app->frame_index );
 		ft_reset_fences( app->device,
 		                 1,
 		                 &app->frames[ app->frame_index ].render_fence );
 		app->frames[ app->frame_index ].cmd_recorded = 1;
 	}
 
+	// offscreen images are used round robin with the frames
+	if ( app->headless )
+	{
+		app->image_index = app->frame_index;
+		return;
+	}
+
 	ft_acquire_next_image( app->device,
 	                       app->swapchain,
 	                       app->frames[ app->frame_index ].present_semaphore,
@@ -305,37 +1800,121 @@ begin_frame( struct app_data* app )
 static void
 end_frame( struct app_data* app )
 {
+	// headless frames have no image to wait for or present
+	uint32_t semaphore_count = app->headless ? 0 : 1;
+
 	struct ft_queue_submit_info submit_info = {
-	    .wait_semaphore_count = 1,
+	    .wait_semaphore_count = semaphore_count,
 	    .wait_semaphores = &app->frames[ app->frame_index ].present_semaphore,
 	    .command_buffer_count   = 1,
 	    .command_buffers        = &app->frames[ app->frame_index ].cmd,
-	    .signal_semaphore_count = 1,
+	    .signal_semaphore_count = semaphore_count,
 	    .signal_semaphores = &app->frames[ app->frame_index ].render_semaphore,
 	    .signal_fence      = app->frames[ app->frame_index ].render_fence,
 	};
 
 	ft_queue_submit( app->graphics_queue, &submit_info );
 
-	struct ft_queue_present_info queue_present_info = {
-	    .wait_semaphore_count = 1,
-	    .wait_semaphores = &app->frames[ app->frame_index ].render_semaphore,
-	    .swapchain       = app->swapchain,
-	    .image_index     = app->image_index,
-	};
+	app->frames[ app->frame_index ].in_flight = true;
+	app->frames[ app->frame_index ].input_ns  = app->input_ns;
+
+	if ( !app->headless )
+	{
+		struct ft_queue_present_info queue_present_info = {
+		    .wait_semaphore_count = 1,
+		    .wait_semaphores =
+		        &app->frames[ app->frame_index ].render_semaphore,
+		    .swapchain   = app->swapchain,
+		    .image_index = app->image_index,
+		};
+
+		ft_queue_present( app->graphics_queue, &queue_present_info );
+	}
 
-	ft_queue_present( app->graphics_queue, &queue_present_info );
+	poll_frame_fences( app );
 
 	app->frames[ app->frame_index ].cmd_recorded = 0;
-	app->frame_index = ( app->frame_index + 1 ) % FRAME_COUNT;
+	app->frame_index = ( app->frame_index + 1 ) % app->frame_count;
+}
+
+// radiance files are decoded straight to rgba16f, which halves the upload
+// compared to the float path. anything hdr_open rejects goes through
+// ft_read_image_from_file
+static void
+decode_environment_map( const char* filename, struct environment_image* env )
+{
+	struct ft_timer timer;
+	ft_timer_reset( &timer );
+
+	struct file_map  file;
+	struct hdr_image hdr;
+
+	memset( env, 0, sizeof( *env ) );
+
+	if ( file_map_open( filename, &file ) )
+	{
+		if ( hdr_open( file.data, file.size, &hdr ) )
+		{
+			env->texels = malloc( ( size_t ) hdr.width * hdr.height * 4 *
+			                      sizeof( uint16_t ) );
+
+			if ( hdr_decode_rgba16f( &hdr, env->texels, true ) )
+			{
+				env->format = FT_FORMAT_R16G16B16A16_SFLOAT;
+				env->width  = hdr.width;
+				env->height = hdr.height;
+			}
+			else
+			{
+				ft_log_warn( "failed to decode %s, retrying with the float "
+				             "loader",
+				             filename );
+				ft_safe_free( env->texels );
+			}
+		}
+		file_map_close( &file );
+	}
+
+	if ( env->texels == NULL )
+	{
+		env->format = FT_FORMAT_R32G32B32A32_SFLOAT;
+		env->texels =
+		    ft_read_image_from_file( filename, &env->width, &env->height );
+	}
+
+	ft_log_info( "decoded %s (%ux%u %s) in %.2f ms",
+	             filename,
+	             env->width,
+	             env->height,
+	             env->format == FT_FORMAT_R16G16B16A16_SFLOAT ? "rgba16f"
+	                                                         : "rgba32f",
+	             ( double ) ft_timer_get_ticks( &timer ) );
+}
+
+static void
+free_environment_map( struct environment_image* env )
+{
+	if ( env->format == FT_FORMAT_R16G16B16A16_SFLOAT )
+	{
+		free( env->texels );
+	}
+	else if ( env->texels )
+	{
+		ft_free_image_data( env->texels );
+	}
+
+	memset( env, 0, sizeof( *env ) );
 }
 
 static struct ft_image*
-load_environment_map( const struct ft_device* device, const char* filename )
+load_environment_map( const struct ft_device*         device,
+                      const struct environment_image* env )
 {
 	struct ft_image_info info = {
+	    .width           = env->width,
+	    .height          = env->height,
 	    .depth           = 1,
-	    .format          = FT_FORMAT_R32G32B32A32_SFLOAT,
+	    .format          = env->format,
 	    .mip_levels      = 1,
 	    .layer_count     = 1,
 	    .sample_count    = 1,
@@ -343,8 +1922,6 @@ load_environment_map( const struct ft_device* device, const char* filename )
 	};
 
 	struct ft_image* image;
-	void* data = ft_read_image_from_file( filename, &info.width, &info.height );
-
 	ft_create_image( device, &info, &image );
 
 	struct ft_image_upload_job job = {
@@ -352,31 +1929,230 @@ load_environment_map( const struct ft_device* device, const char* filename )
 	    .width     = info.width,
 	    .height    = info.height,
 	    .mip_level = 0,
-	    .data      = data,
+	    .data      = env->texels,
 	};
 
 	ft_upload_image( &job );
 
 	ft_resource_loader_wait_idle();
 
-	ft_free_image_data( data );
-
 	return image;
 }
 
+// hashes the environment and checks the cache header, so the decode task
+// knows whether its work is needed at all
+static void
+startup_ibl_key( struct app_data* app )
+{
+	struct startup_data* startup = &app->startup;
+	struct file_map      file;
+
+	if ( file_map_open( ENVIRONMENT_MAP, &file ) )
+	{
+		startup->ibl_key =
+		    ibl_cache_key( file.data, file.size, &ibl_params );
+		file_map_close( &file );
+	}
+
+	struct ibl_cache_header header;
+	ibl_cache_init_header( &header, startup->ibl_key, &ibl_params );
+	ibl_cache_report( &header );
+
+	if ( file_map_open( IBL_CACHE_FILE, &file ) )
+	{
+		startup->ibl_cache_valid =
+		    ibl_cache_validate( file.data, file.size, &header );
+		file_map_close( &file );
+	}
+}
+
+static void
+startup_decode_environment( struct app_data* app )
+{
+	if ( !app->startup.ibl_cache_valid )
+	{
+		decode_environment_map( ENVIRONMENT_MAP, &app->startup.environment );
+	}
+}
+
+// runs next to the scene pipeline chain, so it records into a command
+// pool of its own rather than one the frames own
+static void
+startup_ibl_maps( struct app_data* app )
+{
+	struct startup_data* startup = &app->startup;
+
+	struct ft_timer timer;
+	ft_timer_reset( &timer );
+
+	if ( startup->ibl_cache_valid && ibl_cache_load( app->device,
+	                                                 IBL_CACHE_FILE,
+	                                                 startup->ibl_key,
+	                                                 &ibl_params,
+	                                                 &app->pbr ) )
+	{
+		ft_log_info( "ibl maps loaded from %s in %.2f ms (warm start)",
+		             IBL_CACHE_FILE,
+		             ( double ) ft_timer_get_ticks( &timer ) );
+		return;
+	}
+
+	// the cache went bad between the probe and the load
+	if ( startup->environment.texels == NULL )
+	{
+		decode_environment_map( ENVIRONMENT_MAP, &startup->environment );
+	}
+
+	if ( startup->bake[ 0 ].pipeline == NULL )
+	{
+		create_bake_pipelines( app );
+	}
+
+	struct ft_command_pool_info pool_info = {
+	    .queue = app->graphics_queue,
+	};
+
+	struct ft_command_pool*   cmd_pool;
+	struct ft_command_buffer* cmd;
+	ft_create_command_pool( app->device, &pool_info, &cmd_pool );
+	ft_create_command_buffers( app->device, cmd_pool, 1, &cmd );
+
+	compute_pbr_maps( app, cmd );
+	free_environment_map( &startup->environment );
+
+	ft_log_info( "ibl maps baked in %.2f ms (cold start)",
+	             ( double ) ft_timer_get_ticks( &timer ) );
+
+	ibl_cache_save( app->device,
+	                app->graphics_queue,
+	                cmd,
+	                IBL_CACHE_FILE,
+	                startup->ibl_key,
+	                &ibl_params,
+	                &app->pbr );
+
+	ft_destroy_command_buffers( app->device, cmd_pool, 1, &cmd );
+	ft_destroy_command_pool( app->device, cmd_pool );
+}
+
+static void
+startup_load_model( struct app_data* app )
+{
+	( void ) app;
+	main_pass_load_model();
+}
+
+static void
+startup_create_bake_pipelines( struct app_data* app )
+{
+	if ( !app->startup.ibl_cache_valid )
+	{
+		create_bake_pipelines( app );
+	}
+}
+
+static void
+startup_create_pbr_pipeline( struct app_data* app )
+{
+	main_pass_create_pipeline( app->device, MAIN_PASS_PIPELINE_PBR );
+}
+
+static void
+startup_create_skybox_pipeline( struct app_data* app )
+{
+	main_pass_create_pipeline( app->device, MAIN_PASS_PIPELINE_SKYBOX );
+}
+
+static void
+startup_create_cull_pipeline( struct app_data* app )
+{
+	main_pass_create_pipeline( app->device, MAIN_PASS_PIPELINE_CULL );
+}
+
+static void
+startup_upload_scene( struct app_data* app )
+{
+	main_pass_upload_scene( app->device, app->graphics_queue );
+}
+
+// the four compute pipelines of the gpu bake, created in their own task
+// so the driver compiles them while the environment is being decoded
+static void
+create_bake_pipelines( struct app_data* app )
+{
+	const struct ft_device* device = app->device;
+	struct bake_pipeline*   bake   = app->startup.bake;
+	enum ft_renderer_api    api    = ft_get_device_api( device );
+
+	bool     irradiance_sh = ibl_params.irradiance_mode == IBL_IRRADIANCE_SH;
+	uint32_t cube_format   = ibl_params.cube_format;
+	uint32_t lut_format    = ibl_params.lut_format;
+
+	static const char* names[ BAKE_PIPELINE_COUNT ] = {
+	    [BAKE_EQ_TO_CUBEMAP] = "eq to cubemap",
+	    [BAKE_BRDF]          = "brdf",
+	    [BAKE_IRRADIANCE]    = "irradiance",
+	    [BAKE_SPECULAR]      = "specular",
+	};
+
+	struct ft_shader_info shader_info[ BAKE_PIPELINE_COUNT ];
+	memset( shader_info, 0, sizeof( shader_info ) );
+
+	shader_info[ BAKE_EQ_TO_CUBEMAP ].compute =
+	    IBL_CUBE_SHADER( eq_to_cubemap, api, cube_format );
+	shader_info[ BAKE_BRDF ].compute = IBL_LUT_SHADER( brdf, api, lut_format );
+	shader_info[ BAKE_IRRADIANCE ].compute =
+	    irradiance_sh ? get_sh_project_comp_shader( api )
+	                  : IBL_CUBE_SHADER( irradiance, api, cube_format );
+	shader_info[ BAKE_SPECULAR ].compute =
+	    IBL_CUBE_SHADER( specular, api, cube_format );
+
+	for ( uint32_t i = 0; i < BAKE_PIPELINE_COUNT; ++i )
+	{
+		ft_create_shader( device, &shader_info[ i ], &bake[ i ].shader );
+		ft_create_descriptor_set_layout( device,
+		                                 bake[ i ].shader,
+		                                 &bake[ i ].dsl );
+
+		struct ft_pipeline_info pipeline_info = {
+		    .type                  = FT_PIPELINE_TYPE_COMPUTE,
+		    .shader                = bake[ i ].shader,
+		    .descriptor_set_layout = bake[ i ].dsl,
+		};
+
+		create_timed_pipeline( device,
+		                       names[ i ],
+		                       &pipeline_info,
+		                       &bake[ i ].pipeline );
+	}
+}
+
+static void
+destroy_bake_pipelines( struct app_data* app )
+{
+	struct bake_pipeline* bake = app->startup.bake;
+
+	for ( uint32_t i = 0; i < BAKE_PIPELINE_COUNT; ++i )
+	{
+		ft_destroy_pipeline( app->device, bake[ i ].pipeline );
+		ft_destroy_descriptor_set_layout( app->device, bake[ i ].dsl );
+		ft_destroy_shader( app->device, bake[ i ].shader );
+	}
+
+	memset( bake, 0, sizeof( app->startup.bake ) );
+}
+
 static void
-compute_pbr_maps( struct app_data* app )
+compute_pbr_maps( struct app_data* app, struct ft_command_buffer* cmd )
 {
-	static const uint32_t SKYBOX_SIZE = 2048;
-	uint32_t              SKYBOX_MIPS = ( uint32_t ) log2( SKYBOX_SIZE ) + 1;
-	static const uint32_t IRRADIANCE_SIZE = 32;
-	static const uint32_t SPECULAR_SIZE   = 128;
+	uint32_t SKYBOX_MIPS   = ( uint32_t ) log2( SKYBOX_SIZE ) + 1;
 	uint32_t SPECULAR_MIPS = ( uint32_t ) log2( SPECULAR_SIZE ) + 1;
-	static const uint32_t BRDF_LUT_SIZE = 512;
 
-	const struct ft_device*   device = app->device;
-	struct pbr_maps*          pbr    = &app->pbr;
-	struct ft_command_buffer* cmd    = app->frames[ 0 ].cmd;
+	const struct ft_device* device = app->device;
+	struct pbr_maps*        pbr    = &app->pbr;
+
+	pbr->irradiance_mode = ibl_params.irradiance_mode;
+	bool irradiance_sh   = pbr->irradiance_mode == IBL_IRRADIANCE_SH;
 
 	struct ft_sampler_info sampler_info = {
 	    .mag_filter        = FT_FILTER_LINEAR,
@@ -398,14 +2174,14 @@ compute_pbr_maps( struct app_data* app )
 	ft_create_sampler( device, &sampler_info, &skybox_sampler );
 
 	struct ft_image* environment_eq =
-	    load_environment_map( device, "Newport_Loft_Ref.hdr" );
+	    load_environment_map( device, &app->startup.environment );
 
 	struct ft_image_info image_info;
 	memset( &image_info, 0, sizeof( image_info ) );
 	image_info.width        = SKYBOX_SIZE;
 	image_info.height       = SKYBOX_SIZE;
 	image_info.depth        = 1;
-	image_info.format       = FT_FORMAT_R32G32B32A32_SFLOAT;
+	image_info.format       = ibl_params.cube_format;
 	image_info.mip_levels   = SKYBOX_MIPS;
 	image_info.layer_count  = 6;
 	image_info.sample_count = 1;
@@ -415,13 +2191,20 @@ compute_pbr_maps( struct app_data* app )
 	image_info.width        = IRRADIANCE_SIZE;
 	image_info.height       = IRRADIANCE_SIZE;
 	image_info.depth        = 1;
-	image_info.format       = FT_FORMAT_R32G32B32A32_SFLOAT;
+	image_info.format       = ibl_params.cube_format;
 	image_info.layer_count  = 6;
 	image_info.mip_levels   = 1;
 	image_info.sample_count = 1;
 	image_info.descriptor_type =
 	    FT_DESCRIPTOR_TYPE_STORAGE_IMAGE | FT_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-	ft_create_image( device, &image_info, &pbr->irradiance );
+	if ( irradiance_sh )
+	{
+		ibl_create_sh_buffer( device, &pbr->irradiance_sh );
+	}
+	else
+	{
+		ft_create_image( device, &image_info, &pbr->irradiance );
+	}
 	image_info.width      = SPECULAR_SIZE;
 	image_info.height     = SPECULAR_SIZE;
 	image_info.mip_levels = SPECULAR_MIPS;
@@ -430,61 +2213,25 @@ compute_pbr_maps( struct app_data* app )
 	image_info.height      = BRDF_LUT_SIZE;
 	image_info.layer_count = 1;
 	image_info.mip_levels  = 1;
-	image_info.format      = FT_FORMAT_R32G32_SFLOAT;
+	image_info.format      = ibl_params.lut_format;
 	ft_create_image( device, &image_info, &pbr->brdf_lut );
 
-	struct ft_shader* eq_to_cubemap_shader;
-	struct ft_shader* brdf_shader;
-	struct ft_shader* irradiance_shader;
-	struct ft_shader* specular_shader;
-
-	enum ft_renderer_api api = ft_get_device_api( device );
-
-	struct ft_shader_info shader_info;
-	memset( &shader_info, 0, sizeof( shader_info ) );
-	shader_info.compute = get_eq_to_cubemap_comp_shader( api );
-	ft_create_shader( device, &shader_info, &eq_to_cubemap_shader );
-	shader_info.compute = get_brdf_comp_shader( api );
-	ft_create_shader( device, &shader_info, &brdf_shader );
-	shader_info.compute = get_irradiance_comp_shader( api );
-	ft_create_shader( device, &shader_info, &irradiance_shader );
-	shader_info.compute = get_specular_comp_shader( api );
-	ft_create_shader( device, &shader_info, &specular_shader );
-
-	struct ft_descriptor_set_layout* eq_to_cubemap_dsl;
-	struct ft_descriptor_set_layout* brdf_dsl;
-	struct ft_descriptor_set_layout* irradiance_dsl;
-	struct ft_descriptor_set_layout* specular_dsl;
-
-	ft_create_descriptor_set_layout( device,
-	                                 eq_to_cubemap_shader,
-	                                 &eq_to_cubemap_dsl );
-	ft_create_descriptor_set_layout( device, brdf_shader, &brdf_dsl );
-	ft_create_descriptor_set_layout( device,
-	                                 irradiance_shader,
-	                                 &irradiance_dsl );
-	ft_create_descriptor_set_layout( device, specular_shader, &specular_dsl );
-
-	struct ft_pipeline* eq_to_cubemap_pipeline;
-	struct ft_pipeline* brdf_pipeline;
-	struct ft_pipeline* irradiance_pipeline;
-	struct ft_pipeline* specular_pipeline;
-
-	struct ft_pipeline_info pipeline_info;
-	memset( &pipeline_info, 0, sizeof( pipeline_info ) );
-	pipeline_info.type                  = FT_PIPELINE_TYPE_COMPUTE;
-	pipeline_info.shader                = eq_to_cubemap_shader;
-	pipeline_info.descriptor_set_layout = eq_to_cubemap_dsl;
-	ft_create_pipeline( device, &pipeline_info, &eq_to_cubemap_pipeline );
-	pipeline_info.shader                = brdf_shader;
-	pipeline_info.descriptor_set_layout = brdf_dsl;
-	ft_create_pipeline( device, &pipeline_info, &brdf_pipeline );
-	pipeline_info.shader                = irradiance_shader;
-	pipeline_info.descriptor_set_layout = irradiance_dsl;
-	ft_create_pipeline( device, &pipeline_info, &irradiance_pipeline );
-	pipeline_info.shader                = specular_shader;
-	pipeline_info.descriptor_set_layout = specular_dsl;
-	ft_create_pipeline( device, &pipeline_info, &specular_pipeline );
+	struct bake_pipeline* bake = app->startup.bake;
+
+	profiler_begin( "ibl bake" );
+
+	struct ft_descriptor_set_layout* eq_to_cubemap_dsl =
+	    bake[ BAKE_EQ_TO_CUBEMAP ].dsl;
+	struct ft_descriptor_set_layout* brdf_dsl = bake[ BAKE_BRDF ].dsl;
+	struct ft_descriptor_set_layout* irradiance_dsl =
+	    bake[ BAKE_IRRADIANCE ].dsl;
+	struct ft_descriptor_set_layout* specular_dsl = bake[ BAKE_SPECULAR ].dsl;
+
+	struct ft_pipeline* eq_to_cubemap_pipeline =
+	    bake[ BAKE_EQ_TO_CUBEMAP ].pipeline;
+	struct ft_pipeline* brdf_pipeline       = bake[ BAKE_BRDF ].pipeline;
+	struct ft_pipeline* irradiance_pipeline = bake[ BAKE_IRRADIANCE ].pipeline;
+	struct ft_pipeline* specular_pipeline   = bake[ BAKE_SPECULAR ].pipeline;
 
 	struct ft_descriptor_set* eq_to_cubemap_set[ 16 ];
 	memset( eq_to_cubemap_set, 0, sizeof( eq_to_cubemap_set ) );
@@ -554,6 +2301,12 @@ compute_pbr_maps( struct app_data* app )
 		                          writes );
 	}
 
+	struct ft_buffer_descriptor sh_descriptor = {
+	    .buffer = pbr->irradiance_sh,
+	    .offset = 0,
+	    .range  = IBL_SH_COEFFICIENT_COUNT * sizeof( float4 ),
+	};
+
 	memset( image_descriptors, 0, sizeof( image_descriptors ) );
 	memset( writes, 0, sizeof( writes ) );
 	image_descriptors[ 0 ].image          = pbr->environment;
@@ -569,6 +2322,11 @@ compute_pbr_maps( struct app_data* app )
 	writes[ 2 ].descriptor_count          = 1;
 	writes[ 2 ].descriptor_name           = "u_dst";
 	writes[ 2 ].image_descriptors         = &image_descriptors[ 1 ];
+	if ( irradiance_sh )
+	{
+		writes[ 2 ].image_descriptors  = NULL;
+		writes[ 2 ].buffer_descriptors = &sh_descriptor;
+	}
 	ft_update_descriptor_set( device,
 	                          irradiance_set,
 	                          FT_COUNTOF( writes ),
@@ -599,7 +2357,11 @@ compute_pbr_maps( struct app_data* app )
 		                          writes );
 	}
 
+	// every stage is a gpu timer scope, read back as soon as the submit
+	// returns
 	ft_begin_command_buffer( cmd );
+	gpu_timer_begin_frame( device, cmd, 0, "ibl bake" );
+	gpu_timer_begin( cmd, "brdf lut" );
 
 	struct ft_image_barrier image_barrier;
 	memset( &image_barrier, 0, sizeof( image_barrier ) );
@@ -617,6 +2379,9 @@ compute_pbr_maps( struct app_data* app )
 	image_barrier.new_state = FT_RESOURCE_STATE_SHADER_READ_ONLY;
 	ft_cmd_barrier( cmd, 0, NULL, 0, NULL, 1, &image_barrier );
 
+	gpu_timer_end( cmd );
+	gpu_timer_begin( cmd, "eq to cubemap" );
+
 	image_barrier.image     = pbr->environment;
 	image_barrier.old_state = FT_RESOURCE_STATE_UNDEFINED;
 	image_barrier.new_state = FT_RESOURCE_STATE_GENERAL;
@@ -653,18 +2418,47 @@ compute_pbr_maps( struct app_data* app )
 	image_barrier.old_state = FT_RESOURCE_STATE_GENERAL;
 	image_barrier.new_state = FT_RESOURCE_STATE_SHADER_READ_ONLY;
 	ft_cmd_barrier( cmd, 0, NULL, 0, NULL, 1, &image_barrier );
-	image_barrier.image     = pbr->irradiance;
-	image_barrier.old_state = FT_RESOURCE_STATE_UNDEFINED;
-	image_barrier.new_state = FT_RESOURCE_STATE_GENERAL;
-	ft_cmd_barrier( cmd, 0, NULL, 0, NULL, 1, &image_barrier );
+
+	gpu_timer_end( cmd );
+	gpu_timer_begin( cmd, "irradiance" );
 
 	ft_cmd_bind_pipeline( cmd, irradiance_pipeline );
 	ft_cmd_bind_descriptor_set( cmd, 0, irradiance_set, irradiance_pipeline );
-	ft_cmd_dispatch( cmd, IRRADIANCE_SIZE / 16, IRRADIANCE_SIZE / 16, 6 );
 
-	image_barrier.old_state = FT_RESOURCE_STATE_GENERAL;
-	image_barrier.new_state = FT_RESOURCE_STATE_SHADER_READ_ONLY;
-	ft_cmd_barrier( cmd, 0, NULL, 0, NULL, 1, &image_barrier );
+	if ( irradiance_sh )
+	{
+		// a single workgroup reduces a low environment mip to the nine
+		// coefficients, the full resolution faces add nothing to l2
+		struct
+		{
+			uint32_t mip;
+			uint32_t mip_size;
+		} sh_pc = { ( uint32_t ) log2( SKYBOX_SIZE / IBL_SH_SOURCE_SIZE ),
+		            IBL_SH_SOURCE_SIZE };
+
+		ft_cmd_push_constants( cmd,
+		                       irradiance_pipeline,
+		                       0,
+		                       sizeof( sh_pc ),
+		                       &sh_pc );
+		ft_cmd_dispatch( cmd, 1, 1, 1 );
+	}
+	else
+	{
+		image_barrier.image     = pbr->irradiance;
+		image_barrier.old_state = FT_RESOURCE_STATE_UNDEFINED;
+		image_barrier.new_state = FT_RESOURCE_STATE_GENERAL;
+		ft_cmd_barrier( cmd, 0, NULL, 0, NULL, 1, &image_barrier );
+
+		ft_cmd_dispatch( cmd, IRRADIANCE_SIZE / 16, IRRADIANCE_SIZE / 16, 6 );
+
+		image_barrier.old_state = FT_RESOURCE_STATE_GENERAL;
+		image_barrier.new_state = FT_RESOURCE_STATE_SHADER_READ_ONLY;
+		ft_cmd_barrier( cmd, 0, NULL, 0, NULL, 1, &image_barrier );
+	}
+
+	gpu_timer_end( cmd );
+	gpu_timer_begin( cmd, "specular" );
 
 	image_barrier.image     = pbr->specular;
 	image_barrier.old_state = FT_RESOURCE_STATE_UNDEFINED;
@@ -706,9 +2500,12 @@ compute_pbr_maps( struct app_data* app )
 	image_barrier.new_state = FT_RESOURCE_STATE_SHADER_READ_ONLY;
 	ft_cmd_barrier( cmd, 0, NULL, 0, NULL, 1, &image_barrier );
 
+	gpu_timer_end( cmd );
+	gpu_timer_end_frame( cmd );
 	ft_end_command_buffer( cmd );
-
 	ft_immediate_submit( app->graphics_queue, cmd );
+	gpu_timer_read( device );
+	profiler_end();
 
 	for ( uint32_t mip = 0; mip < SPECULAR_MIPS; ++mip )
 	{
@@ -722,20 +2519,7 @@ compute_pbr_maps( struct app_data* app )
 		ft_destroy_descriptor_set( device, eq_to_cubemap_set[ mip ] );
 	}
 
-	ft_destroy_pipeline( device, specular_pipeline );
-	ft_destroy_pipeline( device, irradiance_pipeline );
-	ft_destroy_pipeline( device, brdf_pipeline );
-	ft_destroy_pipeline( device, eq_to_cubemap_pipeline );
-
-	ft_destroy_descriptor_set_layout( device, specular_dsl );
-	ft_destroy_descriptor_set_layout( device, irradiance_dsl );
-	ft_destroy_descriptor_set_layout( device, brdf_dsl );
-	ft_destroy_descriptor_set_layout( device, eq_to_cubemap_dsl );
-
-	ft_destroy_shader( device, specular_shader );
-	ft_destroy_shader( device, irradiance_shader );
-	ft_destroy_shader( device, brdf_shader );
-	ft_destroy_shader( device, eq_to_cubemap_shader );
+	destroy_bake_pipelines( app );
 
 	ft_destroy_image( device, environment_eq );
 	ft_destroy_sampler( device, skybox_sampler );
@@ -746,6 +2530,13 @@ free_pbr_maps( struct app_data* app )
 {
 	ft_destroy_image( app->device, app->pbr.environment );
 	ft_destroy_image( app->device, app->pbr.brdf_lut );
-	ft_destroy_image( app->device, app->pbr.irradiance );
+	if ( app->pbr.irradiance )
+	{
+		ft_destroy_image( app->device, app->pbr.irradiance );
+	}
+	if ( app->pbr.irradiance_sh )
+	{
+		ft_destroy_buffer( app->device, app->pbr.irradiance_sh );
+	}
 	ft_destroy_image( app->device, app->pbr.specular );
 }
\ No newline at end of file
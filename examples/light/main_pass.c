@@ -1,23 +1,83 @@
 #include <fluent/fluent.h>
 
 #include "pbr.vert.h"
+#include "pbr_quantized.vert.h"
 #include "pbr.frag.h"
+#include "pbr_sh.frag.h"
+#include "pbr_feedback.frag.h"
+#include "pbr_sh_feedback.frag.h"
+#include "pbr_per_draw.frag.h"
+#include "pbr_sh_per_draw.frag.h"
 #include "skybox.vert.h"
 #include "skybox.frag.h"
+#include "cull.comp.h"
+#include "fluent_features.h"
 #include "main_pass.h"
-
-#define MODEL_PATH         MODEL_FOLDER "/DamagedHelmet/glTF/DamagedHelmet.gltf"
-#define VERTEX_BUFFER_SIZE 30 * 1024 * 1024 * 8
-#define INDEX_BUFFER_SIZE  30 * 1024 * 1024 * 8
-#define MAX_DRAW_COUNT     200
-
-struct vertex
-{
-	float3 position;
-	float3 normal;
-	float4 tangent;
-	float2 texcoord;
-};
+#include "file_map.h"
+#include "mesh_pack.h"
+#include "geometry_heap.h"
+#include "pipeline_timer.h"
+#include "scene_bvh.h"
+#include "frame_ring.h"
+#include "animation_set.h"
+#include "model_animation.h"
+#include "profiler.h"
+#include "gpu_timer.h"
+#include "frame_stats.h"
+#include "texture_cook.h"
+#include "texture_stream.h"
+
+#define MODEL_PATH      MODEL_FOLDER "/DamagedHelmet/glTF/DamagedHelmet.gltf"
+#define MODEL_PATH_SIZE 256
+#define MAX_MODEL_COUNT 16
+
+// slots of the scene texture array, SCENE_TEXTURE_COUNT in pbr.frag.glsl
+#define MAX_SCENE_TEXTURE_COUNT 512
+
+// distinct texture combinations of the scene materials without bindless
+// textures, each one a set of MATERIAL_TEXTURE_COUNT in pbr.frag.glsl per
+// ring region. set 0 binds no textures
+#define MAX_MATERIAL_SET_COUNT 256
+
+// draw storage starts here and doubles as models are added
+#define MIN_DRAW_CAPACITY 256
+
+// frames recorded before a replaced draw buffer is destroyed, more than
+// the app keeps in flight. every replacement at least doubles the draw or
+// the instance capacity, which start at 2^8 and stay below 2^32, so no
+// more than 2 * 24 replaced buffers can ever wait to be destroyed
+#define RETIRE_FRAME_COUNT ( MAIN_PASS_MAX_FRAMES_IN_FLIGHT + 1 )
+#define MAX_RETIRED_COUNT  ( 2 * 24 )
+
+// regions of the frame rings. a region is written again this many frames
+// after it was, when the frame that read it is done. ring offsets are
+// aligned for any buffer descriptor
+#define RING_FRAME_COUNT RETIRE_FRAME_COUNT
+#define RING_ALIGNMENT   256
+
+// copies of the scene in --stress-draws mode are spaced this far apart,
+// so are the instances of --instances
+#define STRESS_SPACING 2.5f
+
+// instance groups placed with main_pass_place_instances
+#define MAX_PLACEMENT_COUNT 64
+
+// local size of cull.comp.glsl and its two passes
+#define CULL_GROUP_SIZE 64
+#define CULL_PASS_CLEAR 0
+#define CULL_PASS_CULL  1
+
+// the cull counters of a frame are read back this many frames later, when
+// the frame is known to be done
+#define CULL_COUNT_SLOTS RETIRE_FRAME_COUNT
+
+// a ring region of the texture feedback buffer, one lod per texture slot.
+// a multiple of RING_ALIGNMENT so every region can be bound at its offset
+#define FEEDBACK_REGION_SIZE ( MAX_SCENE_TEXTURE_COUNT * sizeof( uint32_t ) )
+
+// a replaced image may still be in the sets of the other regions until
+// each has been used once more, and those frames have to finish as well
+#define TEXTURE_RETIRE_FRAME_COUNT ( 2 * RING_FRAME_COUNT )
 
 struct camera_shader_data
 {
@@ -40,6 +100,64 @@ struct material_shader_data
 
 FT_STATIC_ASSERT( sizeof( struct material_shader_data ) == 80 );
 
+// per draw data of pbr.vert.glsl, indexed by the draw of an instance. the
+// position offset and scale dequantize quantized vertices and are zero
+// and one for float vertices
+struct draw_shader_data
+{
+	float4 position_offset;
+	float4 position_scale;
+};
+
+FT_STATIC_ASSERT( sizeof( struct draw_shader_data ) == 32 );
+
+// per instance data of pbr.vert.glsl and cull.comp.glsl, indexed by
+// gl_InstanceIndex. draw is where the mesh and material data of the
+// instance are
+struct instance_shader_data
+{
+	float4x4 transform;
+	uint32_t draw;
+	uint32_t pad[ 3 ];
+};
+
+FT_STATIC_ASSERT( sizeof( struct instance_shader_data ) == 80 );
+
+// VkDrawIndexedIndirectCommand. a non indexed draw reads the first four
+// fields as a VkDrawIndirectCommand, its first instance goes in
+// vertex_offset. first_instance is the first instance of the draw either
+// way
+struct draw_command
+{
+	uint32_t index_count;
+	uint32_t instance_count;
+	uint32_t first_index;
+	int32_t  vertex_offset;
+	uint32_t first_instance;
+};
+
+// input of cull.comp.glsl, a visible command is appended to the range of
+// its batch starting at output
+struct cull_command
+{
+	struct draw_command command;
+	uint32_t            batch;
+	uint32_t            output;
+	uint32_t            pad;
+};
+
+FT_STATIC_ASSERT( sizeof( struct cull_command ) == 32 );
+
+// frustum planes as xyz normal and w distance, pointing inwards
+struct cull_push_constants
+{
+	float4   planes[ 6 ];
+	uint32_t pass;
+	uint32_t command_count;
+	uint32_t batch_count;
+	uint32_t count_offset;
+};
+
 enum draw_data_type
 {
 	FT_DRAW_DATA_TYPE_NOT_INDEXED,
@@ -47,14 +165,104 @@ enum draw_data_type
 	FT_DRAW_DATA_TYPE_INDEXED_32,
 };
 
+// consecutive commands that share an index type, drawn with one indirect
+// call. the materials index the scene texture array, so nothing else
+// changes between draws
+struct draw_batch
+{
+	enum draw_data_type type;
+	uint32_t            first_command;
+	uint32_t            command_count;
+};
+
+// first_vertex and first_index are relative to the geometry ranges of the
+// model the draw belongs to. the material is kept on the cpu so the
+// materials buffer can be rewritten when draws move. a draw of a mesh has
+// one instance at world, an instance group has instance_count instances
+// at instance_transforms, which its placement owns, and instance_bounds
+// around all of them. first_instance is assigned with the commands, so is
+// material_set without MAIN_PASS_BINDLESS_TEXTURES
 struct draw_data
 {
-	enum draw_data_type       type;
-	int32_t                   first_vertex;
-	uint32_t                  vertex_count;
-	uint32_t                  first_index;
-	uint32_t                  index_count;
-	struct ft_descriptor_set* material_set;
+	enum draw_data_type         type;
+	uint32_t                    model;
+	int32_t                     first_vertex;
+	uint32_t                    vertex_count;
+	uint32_t                    first_index;
+	uint32_t                    index_count;
+	float4x4                    world;
+	float4                      position_offset;
+	float4                      position_scale;
+	float4                      bounds;
+	struct material_shader_data material;
+	uint32_t                    material_set;
+	uint32_t                    first_instance;
+	uint32_t                    instance_count;
+	const float4x4*             instance_transforms;
+	struct scene_bvh_aabb       instance_bounds;
+};
+
+// instances of one mesh of a loaded model, kept so a graph rebuild brings
+// them back with the scene
+struct instance_placement
+{
+	uint32_t  model;
+	uint32_t  mesh;
+	uint32_t  count;
+	float4x4* transforms;
+};
+
+// everything sized by the draw capacity. the cpu writes all but the
+// culled commands and the cull counts, which the cull pass writes. the
+// counts hold CULL_COUNT_SLOTS ranges of capacity + 1 counters. ring is
+// the persistently mapped block of draw_ring, which holds what changes
+// every frame: the instances and the commands that survived cpu culling
+struct draw_buffers
+{
+	struct ft_buffer* ring;
+	struct ft_buffer* draws;
+	struct ft_buffer* materials;
+	struct ft_buffer* bounds;
+	struct ft_buffer* commands;
+	struct ft_buffer* cull_commands;
+	struct ft_buffer* culled_commands;
+	struct ft_buffer* cull_counts;
+};
+
+// draw buffers and the sets pointing at them, kept alive after a resize
+// until the frames that may use them have retired
+struct retired_draw_buffers
+{
+	uint64_t                  frame;
+	struct draw_buffers       buffers;
+	struct ft_descriptor_set* pbr_sets[ RING_FRAME_COUNT ];
+	struct ft_descriptor_set* cull_sets[ RING_FRAME_COUNT ];
+};
+
+// one loaded gltf. the pack is either mapped from its pack file or cooked
+// into pack_memory on a cold start, it is released once the upload is
+// done. model is only kept for animated models. its draws are copy_count
+// copies of its meshes followed by its instance groups. texture_slots are
+// where the images sit in the scene texture array, -1 when it was full.
+// the bases are the heap ranges in elements, refreshed whenever the heap
+// moves them
+struct scene_model
+{
+	char                           path[ MODEL_PATH_SIZE ];
+	struct ft_model                model;
+	struct file_map                pack_file;
+	void*                          pack_memory;
+	const struct mesh_pack_header* pack;
+	uint32_t                       mesh_count;
+	uint32_t                       copy_count;
+	uint32_t                       first_draw;
+	uint32_t                       draw_count;
+	uint32_t                       image_count;
+	uint64_t                       texture_bytes;
+	int32_t*                       texture_slots;
+	uint32_t                       geometry[ GEOMETRY_ARENA_COUNT ];
+	int32_t                        vertex_base;
+	uint32_t                       index_base[ GEOMETRY_ARENA_COUNT ];
 };
 
 struct main_pass_data
@@ -63,33 +271,177 @@ struct main_pass_data
 
 	uint32_t                         width;
 	uint32_t                         height;
-	enum ft_format                   swapchain_format;
+	enum ft_format                   color_format;
+	struct ft_queue*                 queue;
 	struct ft_descriptor_set_layout* dsl;
 	struct ft_pipeline*              pbr_pipeline;
 	struct ft_descriptor_set_layout* skybox_dsl;
 	struct ft_pipeline*              skybox_pipeline;
-	struct ft_buffer*                vertex_buffer;
-	struct ft_buffer*                index_buffer_16;
-	struct ft_buffer*                index_buffer_32;
-	struct ft_buffer*                ubo_buffer;
-	struct ft_buffer*                transforms_buffer;
-	struct ft_buffer*                materials_buffer;
-	struct ft_descriptor_set*        pbr_set;
-	struct ft_descriptor_set*        skybox_set;
-
-	struct ft_model model;
+	struct ft_descriptor_set_layout* cull_dsl;
+	struct ft_pipeline*              cull_pipeline;
+	struct ft_buffer*                camera_buffer;
+	struct draw_buffers              draw_buffers;
+
+	// data written every frame comes from the persistently mapped rings,
+	// with one set per ring region pointing at the camera and instances
+	// written for that region. the instances are the first allocation of
+	// a draw ring region, so they stay put from one use of a region to the
+	// next and a region only gets every instance again when its generation
+	// is behind instance_generation. visible_offset is where this frame's
+	// cpu culled commands are
+	struct frame_ring         camera_ring;
+	struct frame_ring         draw_ring;
+	uint64_t                  visible_offset;
+	uint64_t                  instance_generation;
+	uint64_t                  region_generations[ RING_FRAME_COUNT ];
+	struct ft_descriptor_set* pbr_sets[ RING_FRAME_COUNT ];
+	struct ft_descriptor_set* skybox_sets[ RING_FRAME_COUNT ];
+	struct ft_descriptor_set* cull_sets[ RING_FRAME_COUNT ];
+
+	// one array of every model image, bound once a frame as set 1. free
+	// slots are NULL and hold the unbound image in the set. streaming
+	// swaps images while frames are in flight, so every ring region has its
+	// own set, rewritten when its generation is behind texture_generation.
+	// texture_full_bytes is what every level of the loaded textures takes
+	struct ft_descriptor_set* texture_sets[ RING_FRAME_COUNT ];
+	uint64_t                  texture_generation;
+	uint64_t                  texture_set_generations[ RING_FRAME_COUNT ];
+	uint32_t                  texture_count;
+	uint64_t                  texture_full_bytes;
+	struct ft_image*          textures[ MAX_SCENE_TEXTURE_COUNT ];
+
+	// the images of the slots and their levels, see texture_stream.h. each
+	// ring region has its range of the feedback buffer, which pbr.frag.glsl
+	// writes the lods it sampled at into. feedback_frames is the frame that
+	// last used a region, 0 when it has nothing to read, and
+	// feedback_levels the resident levels its set was written with
+	struct texture_stream            stream;
+	enum main_pass_texture_streaming texture_streaming;
+	uint64_t                         texture_budget;
+	struct ft_buffer*                feedback_buffer;
+	uint32_t*                        feedback;
+	uint64_t                         feedback_frames[ RING_FRAME_COUNT ];
+
+	uint8_t feedback_levels[ RING_FRAME_COUNT ][ MAX_SCENE_TEXTURE_COUNT ];
+
+	// without MAIN_PASS_BINDLESS_TEXTURES set 1 holds the textures of one
+	// material instead, material_set_textures are the distinct slot
+	// combinations of the draws. a ring region has its own sets, made
+	// again when their generation is behind instance_generation
+	uint32_t material_set_count;
+	int32_t  material_set_textures[ MAX_MATERIAL_SET_COUNT ]
+	                             [ FT_TEXTURE_TYPE_COUNT ];
+	uint32_t material_region_counts[ RING_FRAME_COUNT ];
+	uint64_t material_region_generations[ RING_FRAME_COUNT ];
+
+	struct ft_descriptor_set* material_sets[ RING_FRAME_COUNT ]
+	                                       [ MAX_MATERIAL_SET_COUNT ];
+
+	// vertices and indices of every model, sized from what is loaded
+	struct geometry_heap geometry;
+
+	// the scene that is loaded on create. it starts as MODEL_PATH or the
+	// --model paths and follows runtime loads and unloads, so a graph
+	// rebuild brings back the same scene
+	bool     model_paths_ready;
+	uint32_t model_path_count;
+	char     model_paths[ MAX_MODEL_COUNT ][ MODEL_PATH_SIZE ];
+
+	uint32_t           model_count;
+	struct scene_model models[ MAX_MODEL_COUNT ];
+
+	// unloaded models, most recent last, for the reload request
+	uint32_t unloaded_count;
+	char     unloaded_paths[ MAX_MODEL_COUNT ][ MODEL_PATH_SIZE ];
+
+	// instance groups of the scene, each drawn as one instanced draw.
+	// instance_grid_count places that many instances of every mesh on
+	// startup in rows of instance_grid_columns, square when it is 0, see
+	// --instances
+	uint32_t                  placement_count;
+	struct instance_placement placements[ MAX_PLACEMENT_COUNT ];
+	uint32_t                  instance_grid_count;
+	uint32_t                  instance_grid_columns;
+
+	enum main_pass_request request;
+
+	// draws grow with the scene. the draw buffers are sized for
+	// draw_buffer_capacity draws and instance_buffer_capacity instances and
+	// replaced when either is exceeded. commands and batches are rebuilt on
+	// every scene change, animation_transforms is where the animations
+	// write the transforms of animated draws
+	uint32_t                    draw_count;
+	uint32_t                    instance_count;
+	uint32_t                    instance_buffer_capacity;
+	uint32_t                    draw_capacity;
+	struct draw_data*           draws;
+	struct draw_command*        commands;
+	uint32_t                    batch_count;
+	struct draw_batch*          batches;
+	float4x4*                   animation_transforms;
+	uint32_t                    draw_buffer_capacity;
+	enum main_pass_draw_submit  draw_submit;
+	uint64_t                    frame;
+	uint32_t                    retired_count;
+	struct retired_draw_buffers retired[ MAX_RETIRED_COUNT ];
+
+	// frame_culling is how the draws of this frame were culled, gpu
+	// culling writes culled_commands which the draws then read in place of
+	// the unculled commands. count_frames is the frame each slot of the
+	// counts was written in, 0 when it holds nothing
+	enum main_pass_culling culling;
+	enum main_pass_culling frame_culling;
+	enum ft_resource_state culled_state;
+	uint64_t               count_frames[ CULL_COUNT_SLOTS ];
+	uint32_t               visible_count;
+
+	// cpu culling keeps a bvh over the world bounds of the commands. it is
+	// built the first frame it is needed after the commands change and
+	// refit in frames where animation moved draws. the visible commands of
+	// a batch start at its first command, batch_visible counts them
+	struct scene_bvh       bvh;
+	bool                   bvh_built;
+	bool                   bvh_moved;
+	struct scene_bvh_aabb* command_bounds;
+	uint32_t*              command_batches;
+	uint32_t*              draw_commands;
+	uint32_t*              visible;
+	uint32_t*              batch_visible;
+	struct draw_command*   visible_commands;
+
+	// every animated draw of the scene, stress copies included, rebuilt
+	// with the commands. a non zero animation_step moves them that many
+	// seconds per frame in place of following the clock
+	struct animation_set animations;
+	float                animation_step;
+
+	// every model is drawn this many times on a grid, see --stress-draws
+	uint32_t stress_draw_count;
+	uint32_t stress_copy_count;
 
 	struct camera_shader_data shader_data;
-	uint32_t                  draw_count;
-	struct draw_data          draws[ MAX_DRAW_COUNT ];
 	struct ft_sampler*        sampler;
-	uint32_t                  model_image_count;
-	struct ft_image**         model_images;
 	struct ft_image*          unbound_image;
 
 	struct pbr_maps* maps;
 
 	struct ft_timer timer;
+
+	enum mesh_vertex_format  vertex_format;
+	enum mesh_texture_format texture_format;
+
+	bool model_loaded;
+	bool pipeline_created[ MAIN_PASS_PIPELINE_COUNT ];
+	bool scene_uploaded;
+
+	// created from the create callback until a destroy that is not a
+	// resize. resizing is set by main_pass_resize and cleared by the
+	// destroy callback of the rebuild, which then keeps everything. the
+	// counts only grow, each pipeline is created on one thread
+	bool     created;
+	bool     resizing;
+	uint32_t scene_upload_count;
+	uint32_t pipeline_create_counts[ MAIN_PASS_PIPELINE_COUNT ];
 } main_pass_data;
 
 FT_INLINE void
@@ -99,10 +451,28 @@ main_pass_create_pbr_pipeline( const struct ft_device* device,
 	enum ft_renderer_api api = ft_get_device_api( device );
 
 	struct ft_shader_info shader_info = {
-	    .vertex   = get_pbr_vert_shader( api ),
-	    .fragment = get_pbr_frag_shader( api ),
+	    .vertex   = data->vertex_format == MESH_VERTEX_FORMAT_QUANTIZED
+	                    ? get_pbr_quantized_vert_shader( api )
+	                    : get_pbr_vert_shader( api ),
+	    .fragment = data->maps->irradiance_mode == IBL_IRRADIANCE_SH
+	                    ? get_pbr_sh_frag_shader( api )
+	                    : get_pbr_frag_shader( api ),
 	};
 
+	if ( !MAIN_PASS_BINDLESS_TEXTURES )
+	{
+		shader_info.fragment = data->maps->irradiance_mode == IBL_IRRADIANCE_SH
+		                           ? get_pbr_sh_per_draw_frag_shader( api )
+		                           : get_pbr_per_draw_frag_shader( api );
+	}
+	else if ( data->texture_streaming ==
+	          MAIN_PASS_TEXTURE_STREAMING_PROGRESSIVE )
+	{
+		shader_info.fragment = data->maps->irradiance_mode == IBL_IRRADIANCE_SH
+		                           ? get_pbr_sh_feedback_frag_shader( api )
+		                           : get_pbr_feedback_frag_shader( api );
+	}
+
 	struct ft_shader* shader;
 	ft_create_shader( device, &shader_info, &shader );
 
@@ -127,39 +497,57 @@ main_pass_create_pbr_pipeline( const struct ft_device* device,
 	        },
 	    .sample_count                  = 1,
 	    .color_attachment_count        = 1,
-	    .color_attachment_formats[ 0 ] = data->swapchain_format,
+	    .color_attachment_formats[ 0 ] = data->color_format,
 	    .depth_stencil_format          = FT_FORMAT_D32_SFLOAT,
-	    .vertex_layout =
-	        {
-	            .binding_info_count            = 1,
-	            .binding_infos[ 0 ].binding    = 0,
-	            .binding_infos[ 0 ].input_rate = FT_VERTEX_INPUT_RATE_VERTEX,
-	            .binding_infos[ 0 ].stride     = sizeof( struct vertex ),
-	            .attribute_info_count          = 4,
-	            .attribute_infos[ 0 ].binding  = 0,
-	            .attribute_infos[ 0 ].format   = FT_FORMAT_R32G32B32_SFLOAT,
-	            .attribute_infos[ 0 ].location = 0,
-	            .attribute_infos[ 0 ].offset =
-	                offsetof( struct vertex, position ),
-	            .attribute_infos[ 1 ].binding  = 0,
-	            .attribute_infos[ 1 ].format   = FT_FORMAT_R32G32B32_SFLOAT,
-	            .attribute_infos[ 1 ].location = 1,
-	            .attribute_infos[ 1 ].offset =
-	                offsetof( struct vertex, normal ),
-	            .attribute_infos[ 2 ].binding  = 0,
-	            .attribute_infos[ 2 ].format   = FT_FORMAT_R32G32B32A32_SFLOAT,
-	            .attribute_infos[ 2 ].location = 2,
-	            .attribute_infos[ 2 ].offset =
-	                offsetof( struct vertex, tangent ),
-	            .attribute_infos[ 3 ].binding  = 0,
-	            .attribute_infos[ 3 ].format   = FT_FORMAT_R32G32_SFLOAT,
-	            .attribute_infos[ 3 ].location = 3,
-	            .attribute_infos[ 3 ].offset =
-	                offsetof( struct vertex, texcoord ),
-	        },
 	};
 
-	ft_create_pipeline( device, &info, &data->pbr_pipeline );
+	struct ft_vertex_layout* layout = &info.vertex_layout;
+
+	layout->binding_info_count            = 1;
+	layout->binding_infos[ 0 ].binding    = 0;
+	layout->binding_infos[ 0 ].input_rate = FT_VERTEX_INPUT_RATE_VERTEX;
+	layout->binding_infos[ 0 ].stride =
+	    mesh_vertex_stride( data->vertex_format );
+	layout->attribute_info_count = 4;
+
+	for ( uint32_t i = 0; i < 4; ++i )
+	{
+		layout->attribute_infos[ i ].binding  = 0;
+		layout->attribute_infos[ i ].location = i;
+	}
+
+	if ( data->vertex_format == MESH_VERTEX_FORMAT_QUANTIZED )
+	{
+		layout->attribute_infos[ 0 ].format = FT_FORMAT_R16G16B16A16_UNORM;
+		layout->attribute_infos[ 0 ].offset =
+		    offsetof( struct mesh_vertex_quantized, position );
+		layout->attribute_infos[ 1 ].format = FT_FORMAT_R16G16_SNORM;
+		layout->attribute_infos[ 1 ].offset =
+		    offsetof( struct mesh_vertex_quantized, normal );
+		layout->attribute_infos[ 2 ].format = FT_FORMAT_R16G16_SNORM;
+		layout->attribute_infos[ 2 ].offset =
+		    offsetof( struct mesh_vertex_quantized, tangent );
+		layout->attribute_infos[ 3 ].format = FT_FORMAT_R16G16_SFLOAT;
+		layout->attribute_infos[ 3 ].offset =
+		    offsetof( struct mesh_vertex_quantized, texcoord );
+	}
+	else
+	{
+		layout->attribute_infos[ 0 ].format = FT_FORMAT_R32G32B32_SFLOAT;
+		layout->attribute_infos[ 0 ].offset =
+		    offsetof( struct mesh_vertex, position );
+		layout->attribute_infos[ 1 ].format = FT_FORMAT_R32G32B32_SFLOAT;
+		layout->attribute_infos[ 1 ].offset =
+		    offsetof( struct mesh_vertex, normal );
+		layout->attribute_infos[ 2 ].format = FT_FORMAT_R32G32B32A32_SFLOAT;
+		layout->attribute_infos[ 2 ].offset =
+		    offsetof( struct mesh_vertex, tangent );
+		layout->attribute_infos[ 3 ].format = FT_FORMAT_R32G32_SFLOAT;
+		layout->attribute_infos[ 3 ].offset =
+		    offsetof( struct mesh_vertex, texcoord );
+	}
+
+	create_timed_pipeline( device, "pbr", &info, &data->pbr_pipeline );
 
 	ft_destroy_shader( device, shader );
 }
@@ -199,40 +587,159 @@ main_pass_create_skybox_pipeline( const struct ft_device* device,
 	        },
 	    .sample_count                  = 1,
 	    .color_attachment_count        = 1,
-	    .color_attachment_formats[ 0 ] = data->swapchain_format,
+	    .color_attachment_formats[ 0 ] = data->color_format,
 	    .depth_stencil_format          = FT_FORMAT_D32_SFLOAT,
 	};
 
-	ft_create_pipeline( device, &pipeline_info, &data->skybox_pipeline );
+	create_timed_pipeline( device,
+	                       "skybox",
+	                       &pipeline_info,
+	                       &data->skybox_pipeline );
+
+	ft_destroy_shader( device, shader );
+}
+
+FT_INLINE void
+main_pass_create_cull_pipeline( const struct ft_device* device,
+                                struct main_pass_data*  data )
+{
+	struct ft_shader_info shader_info = {
+	    .compute = get_cull_comp_shader( ft_get_device_api( device ) ),
+	};
+
+	struct ft_shader* shader;
+	ft_create_shader( device, &shader_info, &shader );
+
+	ft_create_descriptor_set_layout( device, shader, &data->cull_dsl );
+
+	struct ft_pipeline_info pipeline_info = {
+	    .type                  = FT_PIPELINE_TYPE_COMPUTE,
+	    .shader                = shader,
+	    .descriptor_set_layout = data->cull_dsl,
+	};
+
+	create_timed_pipeline( device,
+	                       "cull",
+	                       &pipeline_info,
+	                       &data->cull_pipeline );
 
 	ft_destroy_shader( device, shader );
 }
 
+// instances and cpu culled commands of one frame
+FT_INLINE uint64_t
+draw_ring_region_size( uint32_t capacity, uint32_t instance_capacity )
+{
+	uint64_t instances_size =
+	    sizeof( struct instance_shader_data ) * instance_capacity;
+
+	return ( instances_size + RING_ALIGNMENT - 1 ) / RING_ALIGNMENT *
+	           RING_ALIGNMENT +
+	       sizeof( struct draw_command ) * capacity;
+}
+
+FT_INLINE void
+main_pass_create_draw_buffers( const struct ft_device* device,
+                               struct main_pass_data*  data,
+                               uint32_t                capacity,
+                               uint32_t                instance_capacity )
+{
+	struct draw_buffers* buffers = &data->draw_buffers;
+	uint64_t             region_size =
+	    draw_ring_region_size( capacity, instance_capacity );
+
+	struct ft_buffer_info info = {
+	    .descriptor_type = FT_DESCRIPTOR_TYPE_STORAGE_BUFFER |
+	                       FT_DESCRIPTOR_TYPE_INDIRECT_BUFFER,
+	    .memory_usage    = FT_MEMORY_USAGE_CPU_TO_GPU,
+	    .size =
+	        frame_ring_size( region_size, RING_FRAME_COUNT, RING_ALIGNMENT ),
+	};
+	ft_create_buffer( device, &info, &buffers->ring );
+	frame_ring_init( &data->draw_ring,
+	                 ft_map_memory( device, buffers->ring ),
+	                 region_size,
+	                 RING_FRAME_COUNT,
+	                 RING_ALIGNMENT );
+
+	info.descriptor_type = FT_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	info.size            = sizeof( struct draw_shader_data ) * capacity;
+	ft_create_buffer( device, &info, &buffers->draws );
+	info.size = sizeof( struct material_shader_data ) * capacity;
+	ft_create_buffer( device, &info, &buffers->materials );
+	info.size = sizeof( float4 ) * capacity;
+	ft_create_buffer( device, &info, &buffers->bounds );
+	info.size = sizeof( struct cull_command ) * capacity;
+	ft_create_buffer( device, &info, &buffers->cull_commands );
+	info.descriptor_type = FT_DESCRIPTOR_TYPE_INDIRECT_BUFFER;
+	info.size            = sizeof( struct draw_command ) * capacity;
+	ft_create_buffer( device, &info, &buffers->commands );
+
+	info.descriptor_type = FT_DESCRIPTOR_TYPE_STORAGE_BUFFER |
+	                       FT_DESCRIPTOR_TYPE_INDIRECT_BUFFER;
+	info.memory_usage    = FT_MEMORY_USAGE_GPU_ONLY;
+	ft_create_buffer( device, &info, &buffers->culled_commands );
+
+	info.descriptor_type = FT_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	info.memory_usage    = FT_MEMORY_USAGE_GPU_TO_CPU;
+	info.size = sizeof( uint32_t ) * ( capacity + 1 ) * CULL_COUNT_SLOTS;
+	ft_create_buffer( device, &info, &buffers->cull_counts );
+
+	data->draw_buffer_capacity     = capacity;
+	data->instance_buffer_capacity = instance_capacity;
+	data->culled_state             = FT_RESOURCE_STATE_UNDEFINED;
+	memset( data->count_frames, 0, sizeof( data->count_frames ) );
+	memset( data->region_generations,
+	        0,
+	        sizeof( data->region_generations ) );
+}
+
+FT_INLINE void
+main_pass_destroy_draw_buffers( const struct ft_device* device,
+                                struct draw_buffers*    buffers )
+{
+	ft_destroy_buffer( device, buffers->cull_counts );
+	ft_destroy_buffer( device, buffers->culled_commands );
+	ft_destroy_buffer( device, buffers->commands );
+	ft_destroy_buffer( device, buffers->cull_commands );
+	ft_destroy_buffer( device, buffers->bounds );
+	ft_destroy_buffer( device, buffers->materials );
+	ft_destroy_buffer( device, buffers->draws );
+	ft_unmap_memory( device, buffers->ring );
+	ft_destroy_buffer( device, buffers->ring );
+}
+
 FT_INLINE void
 main_pass_create_buffers( const struct ft_device* device,
                           struct main_pass_data*  data )
 {
+	// vertices and indices live in the geometry heap
 	struct ft_buffer_info info;
-	info.memory_usage    = FT_MEMORY_USAGE_GPU_ONLY;
-	info.descriptor_type = FT_DESCRIPTOR_TYPE_VERTEX_BUFFER;
-	info.size            = VERTEX_BUFFER_SIZE;
-	ft_create_buffer( device, &info, &data->vertex_buffer );
-	info.descriptor_type = FT_DESCRIPTOR_TYPE_INDEX_BUFFER;
-	info.size            = INDEX_BUFFER_SIZE;
-	ft_create_buffer( device, &info, &data->index_buffer_16 );
-	info.descriptor_type = FT_DESCRIPTOR_TYPE_INDEX_BUFFER;
-	info.size            = INDEX_BUFFER_SIZE * 2;
-	ft_create_buffer( device, &info, &data->index_buffer_32 );
 	info.descriptor_type = FT_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	info.memory_usage    = FT_MEMORY_USAGE_CPU_TO_GPU;
-	info.size            = sizeof( struct camera_shader_data );
-	ft_create_buffer( device, &info, &data->ubo_buffer );
+	info.size            = frame_ring_size( sizeof( struct camera_shader_data ),
+	                                        RING_FRAME_COUNT,
+	                                        RING_ALIGNMENT );
+	ft_create_buffer( device, &info, &data->camera_buffer );
+	frame_ring_init( &data->camera_ring,
+	                 ft_map_memory( device, data->camera_buffer ),
+	                 sizeof( struct camera_shader_data ),
+	                 RING_FRAME_COUNT,
+	                 RING_ALIGNMENT );
+
+	// the shader only lowers the lods, every region starts out with none
 	info.descriptor_type = FT_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	info.size            = sizeof( float4x4 ) * MAX_DRAW_COUNT;
-	ft_create_buffer( device, &info, &data->transforms_buffer );
-	info.descriptor_type = FT_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	info.size = sizeof( struct material_shader_data ) * MAX_DRAW_COUNT;
-	ft_create_buffer( device, &info, &data->materials_buffer );
+	info.memory_usage    = FT_MEMORY_USAGE_GPU_TO_CPU;
+	info.size            = FEEDBACK_REGION_SIZE * RING_FRAME_COUNT;
+	ft_create_buffer( device, &info, &data->feedback_buffer );
+	data->feedback = ft_map_memory( device, data->feedback_buffer );
+	memset( data->feedback, 0xff, info.size );
+	memset( data->feedback_frames, 0, sizeof( data->feedback_frames ) );
+
+	main_pass_create_draw_buffers( device,
+	                               data,
+	                               MIN_DRAW_CAPACITY,
+	                               MIN_DRAW_CAPACITY );
 }
 
 FT_INLINE void
@@ -289,368 +796,2404 @@ main_pass_create_unbound_resources( const struct ft_device* device,
 	ft_upload_image( &job );
 }
 
-FT_INLINE void
-load_model_textures( const struct ft_device* device,
-                     struct main_pass_data*  data )
+// first free slot of the scene texture array, -1 when it is full. the
+// caller puts the image in it
+FT_INLINE int32_t
+main_pass_alloc_texture_slot( struct main_pass_data* data )
 {
-	data->model_image_count = data->model.texture_count;
-	if ( data->model_image_count != 0 )
+	for ( uint32_t i = 0; i < MAX_SCENE_TEXTURE_COUNT; ++i )
 	{
-		data->model_images =
-		    calloc( data->model.texture_count, sizeof( struct ft_image* ) );
+		if ( data->textures[ i ] == NULL )
+		{
+			data->texture_count++;
+			return ( int32_t ) i;
+		}
 	}
 
-	for ( uint32_t t = 0; t < data->model.texture_count; ++t )
+	ft_log_warn( "scene texture array is full, a texture is left out" );
+	return -1;
+}
+
+// the stream creates the images and uploads their levels from the mapped
+// pack, only the mip tails when streaming. a texture that gets no slot is
+// not loaded at all
+FT_INLINE void
+load_model_textures( struct main_pass_data* data, struct scene_model* model )
+{
+	const struct mesh_pack_header*  pack     = model->pack;
+	const struct mesh_pack_texture* textures = mesh_pack_textures( pack );
+
+	model->image_count = pack->texture_count;
+	if ( model->image_count != 0 )
 	{
-		struct ft_texture* texture = &data->model.textures[ t ];
+		model->texture_slots =
+		    calloc( model->image_count, sizeof( int32_t ) );
+	}
 
-		struct ft_image_info image_info = {
-		    .width        = texture->width,
-		    .height       = texture->height,
-		    .depth        = 1,
-		    .format       = FT_FORMAT_R8G8B8A8_UNORM,
-		    .sample_count = 1,
-		    .layer_count  = 1,
-		    .mip_levels   = ( uint32_t ) ( floor( log2(
-                              FT_MAX( texture->width, texture->height ) ) ) ) +
-		                  1,
-		    .descriptor_type = FT_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-		};
+	uint64_t begin_ns       = frame_clock_ns();
+	uint64_t resident_bytes = data->stream.resident_bytes;
 
-		ft_create_image( device, &image_info, &data->model_images[ t ] );
+	for ( uint32_t t = 0; t < model->image_count; ++t )
+	{
+		int32_t slot = main_pass_alloc_texture_slot( data );
 
-		struct ft_image_upload_job image_job = {
-		    .image     = data->model_images[ t ],
-		    .data      = texture->data,
-		    .width     = texture->width,
-		    .height    = texture->height,
-		    .mip_level = 0,
-		};
+		model->texture_bytes += mesh_pack_texture_size( &textures[ t ] );
+		model->texture_slots[ t ] = slot;
 
-		ft_upload_image( &image_job );
+		if ( slot != -1 )
+		{
+			data->textures[ slot ] = texture_stream_add( &data->stream,
+			                                             ( uint32_t ) slot,
+			                                             pack,
+			                                             &textures[ t ] );
+		}
+	}
 
-		struct ft_generate_mipmaps_job mip_job = {
-		    .image = data->model_images[ t ],
-		    .state = FT_RESOURCE_STATE_SHADER_READ_ONLY,
-		};
+	data->texture_full_bytes += model->texture_bytes;
 
-		ft_generate_mipmaps( &mip_job );
+	if ( model->image_count != 0 )
+	{
+		uint64_t uploaded = data->stream.resident_bytes - resident_bytes;
+
+		ft_log_info( "%s: %u %s textures, %.2f of %.2f MB uploaded in %.2f ms",
+		             model->path,
+		             model->image_count,
+		             mesh_texture_format_name( pack->texture_format ),
+		             ( double ) uploaded / ( 1024.0 * 1024.0 ),
+		             ( double ) model->texture_bytes / ( 1024.0 * 1024.0 ),
+		             ( double ) ( frame_clock_ns() - begin_ns ) / 1e6 );
 	}
 }
 
+// the pack is laid out the way the heap arenas are, so the geometry of a
+// model is three ranges and three uploads no matter how many meshes it has
 FT_INLINE void
-main_pass_load_scene( const struct ft_device* device,
-                      struct main_pass_data*  data )
+upload_model_geometry( struct main_pass_data* data, struct scene_model* model )
 {
-	data->model = ft_load_gltf( MODEL_PATH, FT_MODEL_GENERATE_TANGENTS );
+	static const enum mesh_pack_section sections[ GEOMETRY_ARENA_COUNT ] = {
+	    [GEOMETRY_ARENA_VERTEX]   = MESH_PACK_SECTION_VERTICES,
+	    [GEOMETRY_ARENA_INDEX_16] = MESH_PACK_SECTION_INDICES_16,
+	    [GEOMETRY_ARENA_INDEX_32] = MESH_PACK_SECTION_INDICES_32,
+	};
 
-	data->draw_count = data->model.mesh_count;
+	// ranges are aligned to their element size so the bases are whole
+	// vertices and indices
+	uint32_t element_sizes[ GEOMETRY_ARENA_COUNT ] = {
+	    [GEOMETRY_ARENA_VERTEX]   = model->pack->vertex_stride,
+	    [GEOMETRY_ARENA_INDEX_16] = sizeof( uint16_t ),
+	    [GEOMETRY_ARENA_INDEX_32] = sizeof( uint32_t ),
+	};
 
-	uint32_t first_vertex   = 0;
-	uint32_t first_index_16 = 0;
-	uint32_t first_index_32 = 0;
+	for ( uint32_t a = 0; a < GEOMETRY_ARENA_COUNT; ++a )
+	{
+		model->geometry[ a ] =
+		    geometry_heap_alloc( &data->geometry,
+		                         a,
+		                         model->pack->sections[ sections[ a ] ].size,
+		                         element_sizes[ a ] );
+
+		geometry_heap_upload(
+		    &data->geometry,
+		    model->geometry[ a ],
+		    mesh_pack_section_data( model->pack, sections[ a ] ) );
+	}
+}
 
-	load_model_textures( device, data );
+FT_INLINE void
+main_pass_update_geometry_bases( struct main_pass_data* data )
+{
+	const struct geometry_heap* heap = &data->geometry;
+	uint32_t stride = mesh_vertex_stride( data->vertex_format );
 
-	for ( uint32_t m = 0; m < data->draw_count; ++m )
+	for ( uint32_t m = 0; m < data->model_count; ++m )
 	{
-		const struct ft_mesh* mesh = &data->model.meshes[ m ];
+		struct scene_model* model = &data->models[ m ];
+
+		model->vertex_base = ( int32_t ) ( geometry_heap_offset(
+		                                       heap,
+		                                       model->geometry[ 0 ] ) /
+		                                   stride );
+		model->index_base[ GEOMETRY_ARENA_INDEX_16 ] =
+		    ( uint32_t ) ( geometry_heap_offset(
+		                       heap,
+		                       model->geometry[ GEOMETRY_ARENA_INDEX_16 ] ) /
+		                   sizeof( uint16_t ) );
+		model->index_base[ GEOMETRY_ARENA_INDEX_32 ] =
+		    ( uint32_t ) ( geometry_heap_offset(
+		                       heap,
+		                       model->geometry[ GEOMETRY_ARENA_INDEX_32 ] ) /
+		                   sizeof( uint32_t ) );
+	}
+}
+
+FT_INLINE void
+main_pass_create_draw_sets( const struct ft_device* device,
+                            struct main_pass_data*  data );
 
-		data->draws[ m ].index_count  = mesh->index_count;
-		data->draws[ m ].first_vertex = first_vertex;
+FT_INLINE void
+main_pass_release_retired( const struct ft_device* device,
+                           struct main_pass_data*  data,
+                           bool                    all )
+{
+	uint32_t kept = 0;
 
-		struct vertex* vertices =
-		    malloc( sizeof( struct vertex ) * mesh->vertex_count );
+	for ( uint32_t i = 0; i < data->retired_count; ++i )
+	{
+		struct retired_draw_buffers* retired = &data->retired[ i ];
 
-		for ( uint32_t v = 0; v < mesh->vertex_count; ++v )
+		if ( !all && retired->frame + RETIRE_FRAME_COUNT > data->frame )
 		{
-			float3_dup( vertices[ v ].position, &mesh->positions[ v * 3 ] );
+			data->retired[ kept++ ] = *retired;
+			continue;
+		}
 
-			if ( mesh->normals )
-			{
-				float3_dup( vertices[ v ].normal, &mesh->normals[ v * 3 ] );
-			}
+		for ( uint32_t r = 0; r < RING_FRAME_COUNT; ++r )
+		{
+			ft_destroy_descriptor_set( device, retired->cull_sets[ r ] );
+			ft_destroy_descriptor_set( device, retired->pbr_sets[ r ] );
+		}
+		main_pass_destroy_draw_buffers( device, &retired->buffers );
+	}
 
-			if ( mesh->tangents )
-			{
-				float4_dup( vertices[ v ].tangent, &mesh->tangents[ v * 4 ] );
-			}
+	data->retired_count = kept;
+}
 
-			if ( mesh->texcoords )
-			{
-				float2_dup( vertices[ v ].texcoord, &mesh->texcoords[ v * 2 ] );
-			}
-		}
+// resizes *array to count elements, it is left as it was when the
+// allocation fails
+FT_INLINE bool
+grow_array( void** array, uint32_t count, size_t element_size )
+{
+	void* grown = realloc( *array, ( size_t ) count * element_size );
 
-		struct ft_buffer_upload_job job;
-		job.buffer = data->vertex_buffer;
-		job.offset = first_vertex * sizeof( struct vertex );
-		job.size   = mesh->vertex_count * sizeof( struct vertex );
-		job.data   = vertices;
-		ft_upload_buffer( &job );
+	if ( grown == NULL )
+	{
+		return false;
+	}
 
-		data->draws[ m ].type         = FT_DRAW_DATA_TYPE_NOT_INDEXED;
-		data->draws[ m ].vertex_count = mesh->vertex_count;
+	*array = grown;
+	return true;
+}
 
-		if ( mesh->indices_16 )
+// makes room for count draws and instance_count instances, growing by
+// doubling. the gpu buffers are replaced rather than resized: new sets are
+// written for the new buffers and the old sets and buffers are retired,
+// so frames in flight keep reading what they were recorded with. false
+// when the cpu arrays could not grow, the scene is left as it was
+FT_INLINE bool
+main_pass_reserve_draws( const struct ft_device* device,
+                         struct main_pass_data*  data,
+                         uint32_t                count,
+                         uint32_t                instance_count )
+{
+	if ( count > data->draw_capacity )
+	{
+		uint32_t capacity =
+		    FT_MAX( data->draw_capacity * 2, MIN_DRAW_CAPACITY );
+		capacity = FT_MAX( capacity, count );
+
+		bool grown =
+		    grow_array( ( void** ) &data->draws,
+		                capacity,
+		                sizeof( struct draw_data ) ) &&
+		    grow_array( ( void** ) &data->commands,
+		                capacity,
+		                sizeof( struct draw_command ) ) &&
+		    grow_array( ( void** ) &data->batches,
+		                capacity,
+		                sizeof( struct draw_batch ) ) &&
+		    grow_array( ( void** ) &data->animation_transforms,
+		                capacity,
+		                sizeof( float4x4 ) ) &&
+		    grow_array( ( void** ) &data->command_bounds,
+		                capacity,
+		                sizeof( struct scene_bvh_aabb ) ) &&
+		    grow_array( ( void** ) &data->command_batches,
+		                capacity,
+		                sizeof( uint32_t ) ) &&
+		    grow_array( ( void** ) &data->draw_commands,
+		                capacity,
+		                sizeof( uint32_t ) ) &&
+		    grow_array( ( void** ) &data->visible,
+		                capacity,
+		                sizeof( uint32_t ) ) &&
+		    grow_array( ( void** ) &data->batch_visible,
+		                capacity,
+		                sizeof( uint32_t ) ) &&
+		    grow_array( ( void** ) &data->visible_commands,
+		                capacity,
+		                sizeof( struct draw_command ) );
+
+		// the arrays that did grow are only larger than draw_capacity says
+		if ( !grown )
 		{
-			data->draws[ m ].type        = FT_DRAW_DATA_TYPE_INDEXED_16;
-			data->draws[ m ].first_index = first_index_16;
+			ft_log_error( "out of memory growing the scene to %u draws",
+			              capacity );
+			return false;
+		}
 
-			job.buffer = data->index_buffer_16;
-			job.offset = first_index_16 * sizeof( uint16_t );
-			job.size   = mesh->index_count * sizeof( uint16_t );
-			job.data   = mesh->indices_16;
-			ft_upload_buffer( &job );
+		data->draw_capacity = capacity;
+	}
 
-			first_index_16 += mesh->index_count;
-		}
+	if ( count <= data->draw_buffer_capacity &&
+	     instance_count <= data->instance_buffer_capacity )
+	{
+		return true;
+	}
 
-		if ( mesh->indices_32 )
-		{
-			data->draws[ m ].type        = FT_DRAW_DATA_TYPE_INDEXED_16;
-			data->draws[ m ].first_index = first_index_32;
+	uint32_t capacity          = data->draw_capacity;
+	uint32_t instance_capacity = data->instance_buffer_capacity;
+
+	if ( instance_count > instance_capacity )
+	{
+		instance_capacity =
+		    FT_MAX( FT_MAX( instance_capacity * 2, MIN_DRAW_CAPACITY ),
+		            instance_count );
+	}
+
+	if ( data->pbr_sets[ 0 ] == NULL )
+	{
+		// nothing has been recorded with the buffers yet
+		main_pass_destroy_draw_buffers( device, &data->draw_buffers );
+		main_pass_create_draw_buffers( device,
+		                               data,
+		                               capacity,
+		                               instance_capacity );
+		return true;
+	}
 
-			job.buffer = data->index_buffer_32;
-			job.offset = first_index_32 * sizeof( uint32_t );
-			job.size   = mesh->index_count * sizeof( uint32_t );
-			job.data   = mesh->indices_32;
-			ft_upload_buffer( &job );
+	main_pass_release_retired( device, data, false );
+	FT_ASSERT( data->retired_count < MAX_RETIRED_COUNT );
 
-			first_index_32 += mesh->index_count;
-		}
+	struct retired_draw_buffers* retired =
+	    &data->retired[ data->retired_count++ ];
+	retired->frame   = data->frame;
+	retired->buffers = data->draw_buffers;
+	memcpy( retired->pbr_sets, data->pbr_sets, sizeof( data->pbr_sets ) );
+	memcpy( retired->cull_sets, data->cull_sets, sizeof( data->cull_sets ) );
+
+	main_pass_create_draw_buffers( device, data, capacity, instance_capacity );
+	main_pass_create_draw_sets( device, data );
+
+	return true;
+}
+
+// false when there was no room for the draws, the model is then left
+// without any and the caller unloads it
+FT_INLINE bool
+main_pass_upload_model( const struct ft_device* device,
+                        struct main_pass_data*  data,
+                        uint32_t                index )
+{
+	struct scene_model*            model = &data->models[ index ];
+	const struct mesh_pack_header* pack  = model->pack;
 
-		first_vertex += mesh->vertex_count;
+	model->first_draw = data->draw_count;
+	model->draw_count = 0;
+	model->mesh_count = 0;
+	model->copy_count = 0;
 
-		free( vertices );
+	if ( pack == NULL || pack->mesh_count == 0 )
+	{
+		return true;
 	}
 
-	struct material_shader_data* materials =
-	    ft_map_memory( device, data->materials_buffer );
+	uint32_t mesh_count = pack->mesh_count;
+	uint32_t copy_count = FT_MAX( data->stress_copy_count, 1u );
+	uint32_t draw_count = mesh_count * copy_count;
 
-	for ( uint32_t m = 0; m < data->draw_count; ++m )
+	if ( !main_pass_reserve_draws( device,
+	                               data,
+	                               data->draw_count + draw_count,
+	                               data->instance_count + draw_count ) )
 	{
-		const struct ft_mesh*        mesh = &data->model.meshes[ m ];
-		struct material_shader_data* mat  = &materials[ m ];
+		return false;
+	}
 
-		struct ft_descriptor_set_info set_info = {
-		    .set                   = 1,
-		    .descriptor_set_layout = data->dsl,
-		};
+	model->mesh_count = mesh_count;
+	model->copy_count = copy_count;
+	model->draw_count = draw_count;
 
-		struct ft_descriptor_set* set;
-		ft_create_descriptor_set( device, &set_info, &set );
+	load_model_textures( data, model );
+	upload_model_geometry( data, model );
 
-		struct ft_sampler_descriptor sampler_descriptor = {
-		    .sampler = data->sampler,
-		};
+	const struct mesh_pack_mesh* meshes = mesh_pack_meshes( pack );
+	struct draw_data*            draws  = &data->draws[ model->first_draw ];
 
-		struct ft_image_descriptor image_descriptors[ FT_TEXTURE_TYPE_COUNT ];
-		memset( image_descriptors, 0, sizeof( image_descriptors ) );
+	for ( uint32_t m = 0; m < mesh_count; ++m )
+	{
+		const struct mesh_pack_mesh*     mesh     = &meshes[ m ];
+		const struct mesh_pack_material* material = &mesh->material;
+		struct draw_data*                draw     = &draws[ m ];
+		struct material_shader_data*     mat      = &draw->material;
+
+		draw->model        = index;
+		draw->first_vertex = ( int32_t ) mesh->first_vertex;
+		draw->vertex_count = mesh->vertex_count;
+		draw->first_index  = mesh->first_index;
+		draw->index_count  = mesh->index_count;
+		memcpy( draw->world, mesh->world, sizeof( draw->world ) );
+		draw->first_instance      = 0;
+		draw->instance_count      = 1;
+		draw->instance_transforms = NULL;
+		float4_dup( draw->position_offset, mesh->position_offset );
+		float4_dup( draw->position_scale, mesh->position_scale );
+		float4_dup( draw->bounds, mesh->bounds );
+
+		switch ( mesh->index_type )
+		{
+		case MESH_PACK_INDEX_16:
+		{
+			draw->type = FT_DRAW_DATA_TYPE_INDEXED_16;
+			break;
+		}
+		case MESH_PACK_INDEX_32:
+		{
+			draw->type = FT_DRAW_DATA_TYPE_INDEXED_32;
+			break;
+		}
+		default:
+		{
+			draw->type = FT_DRAW_DATA_TYPE_NOT_INDEXED;
+			break;
+		}
+		}
+
+		memset( mat, 0, sizeof( *mat ) );
 		for ( uint32_t i = 0; i < FT_TEXTURE_TYPE_COUNT; ++i )
 		{
-			image_descriptors[ i ].resource_state =
-			    FT_RESOURCE_STATE_SHADER_READ_ONLY;
-			if ( mesh->material.textures[ i ] != -1 )
-			{
-				image_descriptors[ i ].image =
-				    data->model_images[ mesh->material.textures[ i ] ];
-				mat->textures[ i ] = i;
-			}
-			else
-			{
-				image_descriptors[ i ].image = data->unbound_image;
-				mat->textures[ i ]           = -1;
-			}
+			int32_t texture    = material->textures[ i ];
+			mat->textures[ i ] = texture != -1
+			                         ? model->texture_slots[ texture ]
+			                         : -1;
 		}
 
-		float4_dup( mat->base_color_factor, mesh->material.base_color_factor );
-		float3_dup( mat->emissive_factor, mesh->material.emissive_factor );
-		mat->metallic_factor   = mesh->material.metallic_factor;
-		mat->roughness_factor  = mesh->material.roughness_factor;
-		mat->emissive_strength = mesh->material.emissive_strength;
-		mat->alpha_cutoff      = mesh->material.alpha_cutoff;
+		float4_dup( mat->base_color_factor, material->base_color_factor );
+		float3_dup( mat->emissive_factor, material->emissive_factor );
+		mat->metallic_factor   = material->metallic_factor;
+		mat->roughness_factor  = material->roughness_factor;
+		mat->emissive_strength = material->emissive_strength;
+		mat->alpha_cutoff      = material->alpha_cutoff;
+	}
+
+	// stress copies go on a grid around the origin. the first copy is
+	// moved last since the others are made from it
+	if ( copy_count > 1 )
+	{
+		uint32_t side = ( uint32_t ) ceil( sqrt( ( double ) copy_count ) );
+		float    half = ( float ) ( side - 1 ) * 0.5f;
 
-		struct ft_descriptor_write descriptor_writes[ 2 ];
-		memset( descriptor_writes, 0, sizeof( descriptor_writes ) );
-		descriptor_writes[ 0 ].descriptor_count    = 1;
-		descriptor_writes[ 0 ].descriptor_name     = "u_sampler";
-		descriptor_writes[ 0 ].sampler_descriptors = &sampler_descriptor;
-		descriptor_writes[ 1 ].descriptor_count    = FT_TEXTURE_TYPE_COUNT;
-		descriptor_writes[ 1 ].descriptor_name     = "u_textures";
-		descriptor_writes[ 1 ].image_descriptors   = image_descriptors;
+		for ( uint32_t c = copy_count; c-- > 0; )
+		{
+			float x = ( ( float ) ( c % side ) - half ) * STRESS_SPACING;
+			float z = ( ( float ) ( c / side ) - half ) * STRESS_SPACING;
 
-		ft_update_descriptor_set( device,
-		                          set,
-		                          FT_COUNTOF( descriptor_writes ),
-		                          descriptor_writes );
+			for ( uint32_t m = 0; m < mesh_count; ++m )
+			{
+				struct draw_data* draw = &draws[ c * mesh_count + m ];
+
+				if ( c != 0 )
+				{
+					*draw = draws[ m ];
+				}
 
-		data->draws[ m ].material_set = set;
+				draw->world[ 3 ][ 0 ] += x;
+				draw->world[ 3 ][ 2 ] += z;
+			}
+		}
 	}
-	ft_unmap_memory( device, data->materials_buffer );
+
+	data->draw_count += model->draw_count;
+	data->instance_count += model->draw_count;
+
+	return true;
 }
 
-FT_INLINE void
-main_pass_create_descriptor_sets( const struct ft_device* device,
-                                  struct main_pass_data*  data )
+// the draw of an instance group goes after the other draws of its model,
+// a copy of the draw of its mesh with the instances of the placement.
+// false when the placement names no loaded mesh or the draws could not
+// grow
+FT_INLINE bool
+main_pass_add_instance_group( const struct ft_device*          device,
+                              struct main_pass_data*           data,
+                              const struct instance_placement* placement )
 {
-	struct ft_descriptor_set_info set_info = {
-	    .descriptor_set_layout = data->dsl,
-	    .set                   = 0,
-	};
+	if ( placement->model >= data->model_count ||
+	     placement->mesh >= data->models[ placement->model ].mesh_count )
+	{
+		return false;
+	}
 
-	ft_create_descriptor_set( device, &set_info, &data->pbr_set );
+	struct scene_model* model = &data->models[ placement->model ];
 
-	set_info.descriptor_set_layout = data->skybox_dsl;
-	set_info.set                   = 0;
+	if ( !main_pass_reserve_draws( device,
+	                               data,
+	                               data->draw_count + 1,
+	                               data->instance_count + placement->count ) )
+	{
+		return false;
+	}
 
-	ft_create_descriptor_set( device, &set_info, &data->skybox_set );
-}
+	uint32_t index = model->first_draw + model->draw_count;
 
-FT_INLINE void
-main_pass_write_descriptors( const struct ft_device* device,
-                             struct main_pass_data*  data )
-{
-	struct ft_buffer_descriptor buffer_descriptor = {
-	    .buffer = data->ubo_buffer,
-	    .offset = 0,
-	    .range  = sizeof( struct camera_shader_data ),
-	};
+	memmove( &data->draws[ index + 1 ],
+	         &data->draws[ index ],
+	         ( data->draw_count - index ) * sizeof( struct draw_data ) );
 
-	struct ft_buffer_descriptor tbuffer_descriptor = {
-	    .buffer = data->transforms_buffer,
-	    .offset = 0,
-	    .range  = MAX_DRAW_COUNT * sizeof( float4x4 ),
-	};
+	struct draw_data* draw = &data->draws[ index ];
+	*draw = data->draws[ model->first_draw + placement->mesh ];
+	draw->instance_count      = placement->count;
+	draw->instance_transforms = placement->transforms;
 
-	struct ft_buffer_descriptor mbuffer_descriptor = {
-	    .buffer = data->materials_buffer,
-	    .offset = 0,
-	    .range  = MAX_DRAW_COUNT * sizeof( struct material_shader_data ),
-	};
+	struct scene_bvh_aabb* bounds = &draw->instance_bounds;
+	scene_bvh_sphere_aabb( placement->transforms[ 0 ], draw->bounds, bounds );
 
-	struct ft_image_descriptor brdf_lut_descriptor = {
-	    .image          = data->maps->brdf_lut,
-	    .resource_state = FT_RESOURCE_STATE_SHADER_READ_ONLY,
-	};
+	for ( uint32_t i = 1; i < placement->count; ++i )
+	{
+		struct scene_bvh_aabb aabb;
+		scene_bvh_sphere_aabb( placement->transforms[ i ],
+		                       draw->bounds,
+		                       &aabb );
 
-	struct ft_image_descriptor irradiance_descriptor = {
-	    .image          = data->maps->irradiance,
-	    .resource_state = FT_RESOURCE_STATE_SHADER_READ_ONLY,
-	};
+		for ( uint32_t a = 0; a < 3; ++a )
+		{
+			bounds->min[ a ] = FT_MIN( bounds->min[ a ], aabb.min[ a ] );
+			bounds->max[ a ] = FT_MAX( bounds->max[ a ], aabb.max[ a ] );
+		}
+	}
 
-	struct ft_image_descriptor specular_descriptor = {
-	    .image          = data->maps->specular,
-	    .resource_state = FT_RESOURCE_STATE_SHADER_READ_ONLY,
-	};
+	model->draw_count++;
+	for ( uint32_t m = placement->model + 1; m < data->model_count; ++m )
+	{
+		data->models[ m ].first_draw++;
+	}
 
-	struct ft_descriptor_write descriptor_writes[ 6 ] = {
+	data->draw_count++;
+	data->instance_count += placement->count;
+
+	return true;
+}
+
+// --instances puts a grid of instances of every mesh behind the scene,
+// the instanced twin of the --stress-draws copies
+FT_INLINE void
+main_pass_place_instance_grid( struct main_pass_data* data )
+{
+	uint32_t count = data->instance_grid_count;
+	uint32_t side  = data->instance_grid_columns != 0
+	                     ? data->instance_grid_columns
+	                     : ( uint32_t ) ceil( sqrt( ( double ) count ) );
+	float    half  = ( float ) ( side - 1 ) * 0.5f;
+
+	for ( uint32_t m = 0; m < data->model_count; ++m )
+	{
+		const struct mesh_pack_header* pack = data->models[ m ].pack;
+
+		if ( pack == NULL )
+		{
+			continue;
+		}
+
+		const struct mesh_pack_mesh* meshes = mesh_pack_meshes( pack );
+
+		for ( uint32_t mesh = 0; mesh < pack->mesh_count; ++mesh )
+		{
+			if ( data->placement_count == MAX_PLACEMENT_COUNT )
+			{
+				ft_log_warn( "instance placements are full" );
+				return;
+			}
+
+			struct instance_placement* placement =
+			    &data->placements[ data->placement_count ];
+			placement->model      = m;
+			placement->mesh       = mesh;
+			placement->count      = count;
+			placement->transforms = malloc( count * sizeof( float4x4 ) );
+
+			if ( placement->transforms == NULL )
+			{
+				ft_log_error( "out of memory placing %u instances", count );
+				return;
+			}
+
+			data->placement_count++;
+
+			for ( uint32_t i = 0; i < count; ++i )
+			{
+				float4x4* transform = &placement->transforms[ i ];
+				memcpy( transform, meshes[ mesh ].world, sizeof( float4x4 ) );
+				( *transform )[ 3 ][ 0 ] +=
+				    ( ( float ) ( i % side ) - half ) * STRESS_SPACING;
+				( *transform )[ 3 ][ 2 ] -=
+				    ( float ) ( i / side + 1 ) * STRESS_SPACING;
+			}
+		}
+	}
+}
+
+// materials and draws are indexed by draw, so both buffers are rewritten
+// whenever draws are added or move down after an unload
+FT_INLINE void
+main_pass_write_materials( const struct ft_device* device,
+                           struct main_pass_data*  data )
+{
+	struct material_shader_data* materials =
+	    ft_map_memory( device, data->draw_buffers.materials );
+	struct draw_shader_data* shader_draws =
+	    ft_map_memory( device, data->draw_buffers.draws );
+
+	for ( uint32_t i = 0; i < data->draw_count; ++i )
+	{
+		const struct draw_data* draw = &data->draws[ i ];
+
+		materials[ i ] = draw->material;
+		float4_dup( shader_draws[ i ].position_offset, draw->position_offset );
+		float4_dup( shader_draws[ i ].position_scale, draw->position_scale );
+	}
+
+	ft_unmap_memory( device, data->draw_buffers.draws );
+	ft_unmap_memory( device, data->draw_buffers.materials );
+}
+
+struct draw_sort_key
+{
+	uint32_t type;
+	uint32_t material_set;
+	uint32_t draw;
+};
+
+static int
+compare_draw_sort_keys( const void* a, const void* b )
+{
+	const struct draw_sort_key* lhs = a;
+	const struct draw_sort_key* rhs = b;
+
+	if ( lhs->type != rhs->type )
+	{
+		return lhs->type < rhs->type ? -1 : 1;
+	}
+
+	if ( lhs->material_set != rhs->material_set )
+	{
+		return lhs->material_set < rhs->material_set ? -1 : 1;
+	}
+
+	return ( lhs->draw > rhs->draw ) - ( lhs->draw < rhs->draw );
+}
+
+// the channels of every animated model, once per stress copy. a copy is
+// told apart by where its draws were moved to, instance groups are not
+// animated
+FT_INLINE void
+main_pass_build_animations( struct main_pass_data* data )
+{
+	animation_set_clear( &data->animations );
+
+	for ( uint32_t m = 0; m < data->model_count; ++m )
+	{
+		const struct scene_model* model      = &data->models[ m ];
+		uint32_t                  mesh_count = model->model.mesh_count;
+
+		if ( model->model.animation_count == 0 || mesh_count == 0 )
+		{
+			continue;
+		}
+
+		const float* rest = &model->model.meshes[ 0 ].world[ 3 ][ 0 ];
+
+		for ( uint32_t c = 0; c < model->copy_count; ++c )
+		{
+			uint32_t first_draw = model->first_draw + c * mesh_count;
+			const struct draw_data* draw = &data->draws[ first_draw ];
+			float                   offset[ 3 ];
+
+			for ( uint32_t a = 0; a < 3; ++a )
+			{
+				offset[ a ] = draw->world[ 3 ][ a ] - rest[ a ];
+			}
+
+			model_animation_add( &data->animations,
+			                     &model->model,
+			                     first_draw,
+			                     offset );
+		}
+	}
+}
+
+// numbers the texture combinations of the draws' materials for the per
+// material sets. past MAX_MATERIAL_SET_COUNT a draw gets set 0 and is
+// drawn untextured
+FT_INLINE void
+main_pass_gather_material_sets( struct main_pass_data* data )
+{
+	size_t   size         = sizeof( data->material_set_textures[ 0 ] );
+	uint32_t dropped_count = 0;
+
+	memset( data->material_set_textures[ 0 ], 0xff, size );
+	data->material_set_count = 1;
+
+	for ( uint32_t i = 0; i < data->draw_count; ++i )
+	{
+		const int32_t* textures = data->draws[ i ].material.textures;
+		uint32_t       set      = 0;
+
+		while ( set < data->material_set_count &&
+		        memcmp( data->material_set_textures[ set ], textures, size ) )
+		{
+			set++;
+		}
+
+		if ( set == MAX_MATERIAL_SET_COUNT )
+		{
+			set = 0;
+			dropped_count++;
+		}
+		else if ( set == data->material_set_count )
+		{
+			memcpy( data->material_set_textures[ set ], textures, size );
+			data->material_set_count++;
+		}
+
+		data->draws[ i ].material_set = set;
+	}
+
+	if ( dropped_count != 0 )
+	{
+		ft_log_warn( "more than %u texture combinations, %u draws drawn "
+		             "untextured",
+		             MAX_MATERIAL_SET_COUNT,
+		             dropped_count );
+	}
+}
+
+// one command per draw with the geometry bases already applied, sorted so
+// draws that share state are adjacent, then split into batches. the cull
+// pass gets the same commands tagged with their batch and the bounds of
+// every draw. an instance group is one command drawing all of its
+// instances, which are numbered in draw order. has to run after anything
+// that adds, removes or moves draws or geometry
+FT_INLINE void
+main_pass_build_draw_commands( const struct ft_device* device,
+                               struct main_pass_data*  data )
+{
+	data->batch_count = 0;
+	data->bvh_built   = false;
+	data->instance_generation++;
+
+	main_pass_build_animations( data );
+
+	if ( data->draw_count == 0 )
+	{
+		return;
+	}
+
+	uint32_t first_instance = 0;
+
+	for ( uint32_t i = 0; i < data->draw_count; ++i )
+	{
+		data->draws[ i ].first_instance = first_instance;
+		first_instance += data->draws[ i ].instance_count;
+	}
+
+	if ( !MAIN_PASS_BINDLESS_TEXTURES )
+	{
+		main_pass_gather_material_sets( data );
+	}
+
+	struct draw_sort_key* keys =
+	    malloc( data->draw_count * sizeof( struct draw_sort_key ) );
+
+	// no batches, the scene is not drawn until the next rebuild
+	if ( keys == NULL )
+	{
+		ft_log_error( "out of memory sorting %u draws", data->draw_count );
+		return;
+	}
+
+	for ( uint32_t i = 0; i < data->draw_count; ++i )
+	{
+		keys[ i ].type         = data->draws[ i ].type;
+		keys[ i ].material_set = MAIN_PASS_BINDLESS_TEXTURES
+		                             ? 0
+		                             : data->draws[ i ].material_set;
+		keys[ i ].draw         = i;
+	}
+
+	qsort( keys,
+	       data->draw_count,
+	       sizeof( struct draw_sort_key ),
+	       compare_draw_sort_keys );
+
+	struct draw_batch* batch = NULL;
+
+	for ( uint32_t i = 0; i < data->draw_count; ++i )
+	{
+		const struct draw_data*   draw    = &data->draws[ keys[ i ].draw ];
+		const struct scene_model* model   = &data->models[ draw->model ];
+		struct draw_command*      command = &data->commands[ i ];
+
+		int32_t first_vertex = model->vertex_base + draw->first_vertex;
+
+		if ( draw->type == FT_DRAW_DATA_TYPE_NOT_INDEXED )
+		{
+			command->index_count    = draw->vertex_count;
+			command->instance_count = draw->instance_count;
+			command->first_index    = ( uint32_t ) first_vertex;
+			command->vertex_offset  = ( int32_t ) draw->first_instance;
+			command->first_instance = draw->first_instance;
+		}
+		else
+		{
+			uint32_t arena = draw->type == FT_DRAW_DATA_TYPE_INDEXED_16
+			                     ? GEOMETRY_ARENA_INDEX_16
+			                     : GEOMETRY_ARENA_INDEX_32;
+
+			command->index_count    = draw->index_count;
+			command->instance_count = draw->instance_count;
+			command->first_index =
+			    model->index_base[ arena ] + draw->first_index;
+			command->vertex_offset  = first_vertex;
+			command->first_instance = draw->first_instance;
+		}
+
+		if ( batch == NULL || batch->type != draw->type )
+		{
+			batch                = &data->batches[ data->batch_count++ ];
+			batch->type          = draw->type;
+			batch->first_command = i;
+			batch->command_count = 0;
+		}
+
+		batch->command_count++;
+		data->command_batches[ i ]            = data->batch_count - 1;
+		data->draw_commands[ keys[ i ].draw ] = i;
+	}
+
+	free( keys );
+
+	const struct draw_buffers* buffers = &data->draw_buffers;
+
+	void* commands = ft_map_memory( device, buffers->commands );
+	memcpy( commands,
+	        data->commands,
+	        data->draw_count * sizeof( struct draw_command ) );
+	ft_unmap_memory( device, buffers->commands );
+
+	struct cull_command* cull_commands =
+	    ft_map_memory( device, buffers->cull_commands );
+
+	for ( uint32_t b = 0; b < data->batch_count; ++b )
+	{
+		const struct draw_batch* batch = &data->batches[ b ];
+
+		for ( uint32_t c = 0; c < batch->command_count; ++c )
+		{
+			uint32_t             i    = batch->first_command + c;
+			struct cull_command* cull = &cull_commands[ i ];
+
+			cull->command = data->commands[ i ];
+			cull->batch   = b;
+			cull->output  = batch->first_command;
+			cull->pad     = 0;
+		}
+	}
+
+	ft_unmap_memory( device, buffers->cull_commands );
+
+	// the sphere of a mesh is moved by the transform of its instance on
+	// the gpu, a group gets a world sphere around all of its instances
+	float4* bounds = ft_map_memory( device, buffers->bounds );
+
+	for ( uint32_t i = 0; i < data->draw_count; ++i )
+	{
+		const struct draw_data* draw = &data->draws[ i ];
+
+		if ( draw->instance_count == 1 )
+		{
+			float4_dup( bounds[ i ], draw->bounds );
+			continue;
+		}
+
+		const struct scene_bvh_aabb* aabb   = &draw->instance_bounds;
+		float                        radius = 0.0f;
+
+		for ( uint32_t a = 0; a < 3; ++a )
+		{
+			float extent = ( aabb->max[ a ] - aabb->min[ a ] ) * 0.5f;
+
+			bounds[ i ][ a ] = ( aabb->max[ a ] + aabb->min[ a ] ) * 0.5f;
+			radius += extent * extent;
+		}
+		bounds[ i ][ 3 ] = sqrtf( radius );
+	}
+
+	ft_unmap_memory( device, buffers->bounds );
+}
+
+FT_INLINE void
+main_pass_release_pack( struct scene_model* model )
+{
+	if ( model->pack_memory )
+	{
+		free( model->pack_memory );
+		model->pack_memory = NULL;
+	}
+	else if ( model->pack )
+	{
+		file_map_close( &model->pack_file );
+	}
+
+	model->pack = NULL;
+}
+
+// frees everything the model owns and moves the draws and models after it
+// down. the gpu must be done with the model, its images are retired to
+// the stream until every texture set has been rewritten without them
+FT_INLINE void
+main_pass_unload_model( struct main_pass_data* data, uint32_t index )
+{
+	struct scene_model* model = &data->models[ index ];
+
+	for ( uint32_t i = 0; i < model->image_count; ++i )
+	{
+		int32_t slot = model->texture_slots[ i ];
+
+		if ( slot != -1 )
+		{
+			texture_stream_remove( &data->stream,
+			                       ( uint32_t ) slot,
+			                       data->frame );
+			data->textures[ slot ] = NULL;
+			data->texture_count--;
+		}
+	}
+	data->texture_full_bytes -= model->texture_bytes;
+	ft_safe_free( model->texture_slots );
+
+	for ( uint32_t a = 0; a < GEOMETRY_ARENA_COUNT; ++a )
+	{
+		geometry_heap_free( &data->geometry, model->geometry[ a ] );
+	}
+
+	main_pass_release_pack( model );
+	if ( model->model.animation_count != 0 )
+	{
+		ft_free_gltf( &model->model );
+	}
+
+	uint32_t first_draw = model->first_draw;
+	uint32_t draw_count = model->draw_count;
+
+	for ( uint32_t i = first_draw; i < first_draw + draw_count; ++i )
+	{
+		data->instance_count -= data->draws[ i ].instance_count;
+	}
+
+	memmove( &data->draws[ first_draw ],
+	         &data->draws[ first_draw + draw_count ],
+	         ( data->draw_count - first_draw - draw_count ) *
+	             sizeof( struct draw_data ) );
+	data->draw_count -= draw_count;
+
+	memmove( &data->models[ index ],
+	         &data->models[ index + 1 ],
+	         ( data->model_count - index - 1 ) * sizeof( struct scene_model ) );
+	data->model_count--;
+
+	for ( uint32_t i = first_draw; i < data->draw_count; ++i )
+	{
+		data->draws[ i ].model--;
+	}
+
+	for ( uint32_t m = index; m < data->model_count; ++m )
+	{
+		data->models[ m ].first_draw -= draw_count;
+	}
+}
+
+// the pbr and cull sets follow the draw buffers, main_pass_create_draw_sets
+// makes them
+FT_INLINE void
+main_pass_create_descriptor_sets( const struct ft_device* device,
+                                  struct main_pass_data*  data )
+{
+	struct ft_descriptor_set_info set_info = {
+	    .descriptor_set_layout = data->skybox_dsl,
+	    .set                   = 0,
+	};
+
+	for ( uint32_t r = 0; r < RING_FRAME_COUNT; ++r )
+	{
+		ft_create_descriptor_set( device, &set_info, &data->skybox_sets[ r ] );
+	}
+
+	// the per material sets are made as the regions are used
+	if ( !MAIN_PASS_BINDLESS_TEXTURES )
+	{
+		return;
+	}
+
+	set_info.descriptor_set_layout = data->dsl;
+	set_info.set                   = 1;
+	for ( uint32_t r = 0; r < RING_FRAME_COUNT; ++r )
+	{
+		ft_create_descriptor_set( device, &set_info, &data->texture_sets[ r ] );
+	}
+}
+
+// rewrites the texture array and the feedback range of a ring region, the
+// gpu must be done with its set. the levels the images start at are kept
+// to read the feedback of the frames that use it. only the progressive
+// shader has the feedback binding
+FT_INLINE void
+main_pass_write_texture_set( const struct ft_device* device,
+                             struct main_pass_data*  data,
+                             uint32_t                region )
+{
+	struct ft_sampler_descriptor sampler_descriptor = {
+	    .sampler = data->sampler,
+	};
+
+	struct ft_image_descriptor image_descriptors[ MAX_SCENE_TEXTURE_COUNT ];
+	memset( image_descriptors, 0, sizeof( image_descriptors ) );
+
+	for ( uint32_t i = 0; i < MAX_SCENE_TEXTURE_COUNT; ++i )
+	{
+		image_descriptors[ i ].resource_state =
+		    FT_RESOURCE_STATE_SHADER_READ_ONLY;
+		image_descriptors[ i ].image = data->textures[ i ]
+		                                   ? data->textures[ i ]
+		                                   : data->unbound_image;
+
+		data->feedback_levels[ region ][ i ] =
+		    data->textures[ i ]
+		        ? ( uint8_t ) texture_stream_resident_level( &data->stream, i )
+		        : 0;
+	}
+
+	struct ft_buffer_descriptor feedback_descriptor = {
+	    .buffer = data->feedback_buffer,
+	    .offset = FEEDBACK_REGION_SIZE * region,
+	    .range  = FEEDBACK_REGION_SIZE,
+	};
+
+	struct ft_descriptor_write descriptor_writes[ 3 ];
+	memset( descriptor_writes, 0, sizeof( descriptor_writes ) );
+	descriptor_writes[ 0 ].descriptor_count    = 1;
+	descriptor_writes[ 0 ].descriptor_name     = "u_sampler";
+	descriptor_writes[ 0 ].sampler_descriptors = &sampler_descriptor;
+	descriptor_writes[ 1 ].descriptor_count    = MAX_SCENE_TEXTURE_COUNT;
+	descriptor_writes[ 1 ].descriptor_name     = "u_textures";
+	descriptor_writes[ 1 ].image_descriptors   = image_descriptors;
+	descriptor_writes[ 2 ].descriptor_count    = 1;
+	descriptor_writes[ 2 ].descriptor_name     = "u_texture_feedback";
+	descriptor_writes[ 2 ].buffer_descriptors  = &feedback_descriptor;
+
+	uint32_t write_count = data->texture_streaming ==
+	                               MAIN_PASS_TEXTURE_STREAMING_PROGRESSIVE
+	                           ? FT_COUNTOF( descriptor_writes )
+	                           : FT_COUNTOF( descriptor_writes ) - 1;
+
+	ft_update_descriptor_set( device,
+	                          data->texture_sets[ region ],
+	                          write_count,
+	                          descriptor_writes );
+
+	data->texture_set_generations[ region ] = data->texture_generation;
+}
+
+// makes the per material sets of a ring region again, the gpu must be
+// done with the old ones. a material texture without an image binds the
+// unbound image, the material does not sample it
+FT_INLINE void
+main_pass_write_material_sets( const struct ft_device* device,
+                               struct main_pass_data*  data,
+                               uint32_t                region )
+{
+	struct ft_descriptor_set** sets = data->material_sets[ region ];
+
+	for ( uint32_t i = 0; i < data->material_region_counts[ region ]; ++i )
+	{
+		ft_destroy_descriptor_set( device, sets[ i ] );
+	}
+
+	struct ft_descriptor_set_info set_info = {
+	    .descriptor_set_layout = data->dsl,
+	    .set                   = 1,
+	};
+
+	struct ft_sampler_descriptor sampler_descriptor = {
+	    .sampler = data->sampler,
+	};
+
+	for ( uint32_t i = 0; i < data->material_set_count; ++i )
+	{
+		struct ft_image_descriptor image_descriptors[ FT_TEXTURE_TYPE_COUNT ];
+		memset( image_descriptors, 0, sizeof( image_descriptors ) );
+
+		for ( uint32_t t = 0; t < FT_TEXTURE_TYPE_COUNT; ++t )
+		{
+			int32_t slot = data->material_set_textures[ i ][ t ];
+
+			image_descriptors[ t ].resource_state =
+			    FT_RESOURCE_STATE_SHADER_READ_ONLY;
+			image_descriptors[ t ].image = slot != -1 && data->textures[ slot ]
+			                                   ? data->textures[ slot ]
+			                                   : data->unbound_image;
+		}
+
+		struct ft_descriptor_write descriptor_writes[ 2 ];
+		memset( descriptor_writes, 0, sizeof( descriptor_writes ) );
+		descriptor_writes[ 0 ].descriptor_count    = 1;
+		descriptor_writes[ 0 ].descriptor_name     = "u_sampler";
+		descriptor_writes[ 0 ].sampler_descriptors = &sampler_descriptor;
+		descriptor_writes[ 1 ].descriptor_count    = FT_TEXTURE_TYPE_COUNT;
+		descriptor_writes[ 1 ].descriptor_name     = "u_textures";
+		descriptor_writes[ 1 ].image_descriptors   = image_descriptors;
+
+		ft_create_descriptor_set( device, &set_info, &sets[ i ] );
+		ft_update_descriptor_set( device,
+		                          sets[ i ],
+		                          FT_COUNTOF( descriptor_writes ),
+		                          descriptor_writes );
+	}
+
+	data->material_region_counts[ region ]      = data->material_set_count;
+	data->material_region_generations[ region ] = data->instance_generation;
+}
+
+// after the slots changed. the feedback still in flight was written for
+// the old slots and is dropped
+FT_INLINE void
+main_pass_write_texture_sets( const struct ft_device* device,
+                              struct main_pass_data*  data )
+{
+	for ( uint32_t r = 0; r < RING_FRAME_COUNT; ++r )
+	{
+		main_pass_write_texture_set( device, data, r );
+	}
+
+	memset( data->feedback_frames, 0, sizeof( data->feedback_frames ) );
+}
+
+// the camera and instances of a ring region
+FT_INLINE void
+main_pass_write_pbr_set( const struct ft_device* device,
+                         struct main_pass_data*  data,
+                         uint32_t                region )
+{
+	struct ft_buffer_descriptor buffer_descriptor = {
+	    .buffer = data->camera_buffer,
+	    .offset = frame_ring_region_offset( &data->camera_ring, region ),
+	    .range  = sizeof( struct camera_shader_data ),
+	};
+
+	struct ft_buffer_descriptor ibuffer_descriptor = {
+	    .buffer = data->draw_buffers.ring,
+	    .offset = frame_ring_region_offset( &data->draw_ring, region ),
+	    .range  = data->instance_buffer_capacity *
+	              sizeof( struct instance_shader_data ),
+	};
+
+	struct ft_buffer_descriptor dbuffer_descriptor = {
+	    .buffer = data->draw_buffers.draws,
+	    .offset = 0,
+	    .range  = data->draw_buffer_capacity *
+	              sizeof( struct draw_shader_data ),
+	};
+
+	struct ft_buffer_descriptor mbuffer_descriptor = {
+	    .buffer = data->draw_buffers.materials,
+	    .offset = 0,
+	    .range  = data->draw_buffer_capacity *
+	              sizeof( struct material_shader_data ),
+	};
+
+	struct ft_image_descriptor brdf_lut_descriptor = {
+	    .image          = data->maps->brdf_lut,
+	    .resource_state = FT_RESOURCE_STATE_SHADER_READ_ONLY,
+	};
+
+	struct ft_image_descriptor irradiance_descriptor = {
+	    .image          = data->maps->irradiance,
+	    .resource_state = FT_RESOURCE_STATE_SHADER_READ_ONLY,
+	};
+
+	struct ft_buffer_descriptor irradiance_sh_descriptor = {
+	    .buffer = data->maps->irradiance_sh,
+	    .offset = 0,
+	    .range  = IBL_SH_COEFFICIENT_COUNT * sizeof( float4 ),
+	};
+
+	struct ft_image_descriptor specular_descriptor = {
+	    .image          = data->maps->specular,
+	    .resource_state = FT_RESOURCE_STATE_SHADER_READ_ONLY,
+	};
+
+	struct ft_descriptor_write descriptor_writes[ 7 ] = {
+	    [0] =
+	        {
+	            .buffer_descriptors = &buffer_descriptor,
+	            .descriptor_count   = 1,
+	            .descriptor_name    = "ubo",
+	        },
+	    [1] =
+	        {
+	            .descriptor_count   = 1,
+	            .descriptor_name    = "u_instances",
+	            .buffer_descriptors = &ibuffer_descriptor,
+	        },
+	    [2] =
+	        {
+	            .descriptor_count   = 1,
+	            .descriptor_name    = "u_materials",
+	            .buffer_descriptors = &mbuffer_descriptor,
+	        },
+	    [3] =
+	        {
+	            .descriptor_count  = 1,
+	            .descriptor_name   = "u_brdf_lut",
+	            .image_descriptors = &brdf_lut_descriptor,
+	        },
+	    [4] =
+	        {
+	            .descriptor_count  = 1,
+	            .descriptor_name   = "u_irradiance_map",
+	            .image_descriptors = &irradiance_descriptor,
+	        },
+	    [5] =
+	        {
+	            .descriptor_count  = 1,
+	            .descriptor_name   = "u_specular_map",
+	            .image_descriptors = &specular_descriptor,
+	        },
+	    [6] =
+	        {
+	            .descriptor_count   = 1,
+	            .descriptor_name    = "u_draws",
+	            .buffer_descriptors = &dbuffer_descriptor,
+	        },
+	};
+
+	if ( data->maps->irradiance_mode == IBL_IRRADIANCE_SH )
+	{
+		descriptor_writes[ 4 ].descriptor_name    = "u_irradiance_sh";
+		descriptor_writes[ 4 ].image_descriptors  = NULL;
+		descriptor_writes[ 4 ].buffer_descriptors = &irradiance_sh_descriptor;
+	}
+
+	ft_update_descriptor_set( device,
+	                          data->pbr_sets[ region ],
+	                          FT_COUNTOF( descriptor_writes ),
+	                          descriptor_writes );
+}
+
+FT_INLINE void
+main_pass_write_cull_set( const struct ft_device* device,
+                          struct main_pass_data*  data,
+                          uint32_t                region )
+{
+	const struct draw_buffers* buffers  = &data->draw_buffers;
+	uint64_t                   capacity = data->draw_buffer_capacity;
+
+	struct ft_buffer_descriptor buffer_descriptors[ 5 ] = {
+	    [0] =
+	        {
+	            .buffer = buffers->ring,
+	            .offset = frame_ring_region_offset( &data->draw_ring, region ),
+	            .range  = ( uint64_t ) data->instance_buffer_capacity *
+	                      sizeof( struct instance_shader_data ),
+	        },
+	    [1] =
+	        {
+	            .buffer = buffers->bounds,
+	            .range  = capacity * sizeof( float4 ),
+	        },
+	    [2] =
+	        {
+	            .buffer = buffers->cull_commands,
+	            .range  = capacity * sizeof( struct cull_command ),
+	        },
+	    [3] =
+	        {
+	            .buffer = buffers->culled_commands,
+	            .range  = capacity * sizeof( struct draw_command ),
+	        },
+	    [4] =
+	        {
+	            .buffer = buffers->cull_counts,
+	            .range  = ( capacity + 1 ) * CULL_COUNT_SLOTS *
+	                      sizeof( uint32_t ),
+	        },
+	};
+
+	static const char* names[ 5 ] = {
+	    "u_instances",
+	    "u_bounds",
+	    "u_cull_commands",
+	    "u_draw_commands",
+	    "u_cull_counts",
+	};
+
+	struct ft_descriptor_write descriptor_writes[ 5 ];
+
+	for ( uint32_t i = 0; i < 5; ++i )
+	{
+		descriptor_writes[ i ] = ( struct ft_descriptor_write ) {
+		    .descriptor_count   = 1,
+		    .descriptor_name    = names[ i ],
+		    .buffer_descriptors = &buffer_descriptors[ i ],
+		};
+	}
+
+	ft_update_descriptor_set( device,
+	                          data->cull_sets[ region ],
+	                          FT_COUNTOF( descriptor_writes ),
+	                          descriptor_writes );
+}
+
+FT_INLINE void
+main_pass_create_draw_sets( const struct ft_device* device,
+                            struct main_pass_data*  data )
+{
+	struct ft_descriptor_set_info set_info = {
+	    .set = 0,
+	};
+
+	for ( uint32_t r = 0; r < RING_FRAME_COUNT; ++r )
+	{
+		set_info.descriptor_set_layout = data->dsl;
+		ft_create_descriptor_set( device, &set_info, &data->pbr_sets[ r ] );
+		main_pass_write_pbr_set( device, data, r );
+
+		set_info.descriptor_set_layout = data->cull_dsl;
+		ft_create_descriptor_set( device, &set_info, &data->cull_sets[ r ] );
+		main_pass_write_cull_set( device, data, r );
+	}
+}
+
+FT_INLINE void
+main_pass_write_descriptors( const struct ft_device* device,
+                             struct main_pass_data*  data )
+{
+	main_pass_create_draw_sets( device, data );
+	if ( MAIN_PASS_BINDLESS_TEXTURES )
+	{
+		main_pass_write_texture_sets( device, data );
+	}
+
+	struct ft_buffer_descriptor buffer_descriptor = {
+	    .buffer = data->camera_buffer,
+	    .offset = 0,
+	    .range  = sizeof( struct camera_shader_data ),
+	};
+
+	struct ft_sampler_descriptor sampler_descriptor = {
+	    .sampler = data->sampler,
+	};
+
+	struct ft_image_descriptor image_descriptor = {
+	    .image          = data->maps->environment,
+	    .resource_state = FT_RESOURCE_STATE_SHADER_READ_ONLY,
+	};
+
+	struct ft_descriptor_write skybox_descriptor_writes[ 3 ] = {
+	    [0] =
+	        {
+	            .descriptor_count   = 1,
+	            .descriptor_name    = "ubo",
+	            .buffer_descriptors = &buffer_descriptor,
+	        },
+	    [1] =
+	        {
+	            .descriptor_count    = 1,
+	            .descriptor_name     = "u_sampler",
+	            .sampler_descriptors = &sampler_descriptor,
+	        },
+	    [2] =
+	        {
+	            .descriptor_count  = 1,
+	            .descriptor_name   = "u_environment_map",
+	            .image_descriptors = &image_descriptor,
+	        },
+	};
+
+	for ( uint32_t r = 0; r < RING_FRAME_COUNT; ++r )
+	{
+		buffer_descriptor.offset =
+		    frame_ring_region_offset( &data->camera_ring, r );
+
+		ft_update_descriptor_set( device,
+		                          data->skybox_sets[ r ],
+		                          FT_COUNTOF( skybox_descriptor_writes ),
+		                          skybox_descriptor_writes );
+	}
+}
+
+FT_INLINE void
+main_pass_update_ubo( struct main_pass_data* data )
+{
+	float4x4_dup( data->shader_data.view, data->camera->view );
+	float4x4_dup( data->shader_data.projection, data->camera->projection );
+	float3_dup( data->shader_data.view_pos, data->camera->position );
+
+	void* dst = frame_ring_alloc( &data->camera_ring,
+	                              sizeof( struct camera_shader_data ),
+	                              NULL );
+	memcpy( dst, &data->shader_data, sizeof( struct camera_shader_data ) );
+}
+
+// instances of this frame. a region whose instances are older than the
+// commands gets all of them, otherwise only the animated draws change, so
+// a frame of a static scene writes nothing however many instances it has.
+// the animations are evaluated on the job system into the transforms of
+// the animated draws first. once the bvh is built the bounds of animated
+// draws follow them and the bvh is refit before it is culled
+FT_INLINE void
+main_pass_write_instances( struct main_pass_data* data )
+{
+	// first in the region, where the sets of the region point
+	uint32_t                     region = data->draw_ring.region;
+	struct instance_shader_data* instances =
+	    frame_ring_alloc( &data->draw_ring,
+	                      data->instance_count *
+	                          sizeof( struct instance_shader_data ),
+	                      NULL );
+
+	if ( data->region_generations[ region ] != data->instance_generation )
+	{
+		for ( uint32_t i = 0; i < data->draw_count; ++i )
+		{
+			const struct draw_data*      draw = &data->draws[ i ];
+			struct instance_shader_data* instance =
+			    &instances[ draw->first_instance ];
+
+			if ( draw->instance_transforms == NULL )
+			{
+				float4x4_dup( instance->transform, draw->world );
+				instance->draw = i;
+				continue;
+			}
+
+			for ( uint32_t j = 0; j < draw->instance_count; ++j )
+			{
+				float4x4_dup( instance[ j ].transform,
+				              draw->instance_transforms[ j ] );
+				instance[ j ].draw = i;
+			}
+		}
+
+		data->region_generations[ region ] = data->instance_generation;
+	}
+
+	struct animation_set* animations = &data->animations;
+
+	if ( animations->target_count == 0 )
+	{
+		return;
+	}
+
+	float current_time =
+	    data->animation_step != 0.0f
+	        ? ( float ) data->frame * data->animation_step
+	        : ft_timer_get_ticks( &data->timer ) / 1000.0f;
+
+	animation_set_evaluate( animations,
+	                        current_time,
+	                        data->animation_transforms,
+	                        true );
+
+	for ( uint32_t t = 0; t < animations->target_count; ++t )
+	{
+		uint32_t draw = animations->target_ids[ t ];
+
+		float4x4_dup( instances[ data->draws[ draw ].first_instance ].transform,
+		              data->animation_transforms[ draw ] );
+
+		if ( data->bvh_built )
+		{
+			scene_bvh_sphere_aabb(
+			    data->animation_transforms[ draw ],
+			    data->draws[ draw ].bounds,
+			    &data->command_bounds[ data->draw_commands[ draw ] ] );
+		}
+	}
+
+	data->bvh_moved = data->bvh_built;
+}
+
+// the visible count of the frame that used this slot last, which has
+// finished by now
+FT_INLINE void
+main_pass_read_cull_counts( const struct ft_device* device,
+                            struct main_pass_data*  data,
+                            uint32_t                slot )
+{
+	if ( data->count_frames[ slot ] == 0 )
+	{
+		return;
+	}
+
+	const uint32_t* counts =
+	    ft_map_memory( device, data->draw_buffers.cull_counts );
+	data->visible_count =
+	    counts[ ( size_t ) slot * ( data->draw_buffer_capacity + 1 ) ];
+	ft_unmap_memory( device, data->draw_buffers.cull_counts );
+
+	data->count_frames[ slot ] = 0;
+}
+
+// hands the stream the lods the last frame of this region sampled at,
+// which is done by now, and brings the region's texture set up to date
+// with whatever the stream swapped in before the frame binds it
+FT_INLINE void
+main_pass_stream_textures( const struct ft_device*   device,
+                           struct ft_command_buffer* cmd,
+                           struct main_pass_data*    data,
+                           uint32_t                  region )
+{
+	// nothing streams without the array, the slots only change with the
+	// draws
+	if ( !MAIN_PASS_BINDLESS_TEXTURES )
+	{
+		if ( data->material_region_generations[ region ] !=
+		     data->instance_generation )
+		{
+			main_pass_write_material_sets( device, data, region );
+		}
+		return;
+	}
+
+	uint32_t* lods = data->feedback + region * MAX_SCENE_TEXTURE_COUNT;
+
+	if ( data->feedback_frames[ region ] != 0 )
+	{
+		texture_stream_feedback( &data->stream,
+		                         lods,
+		                         data->feedback_levels[ region ] );
+	}
+
+	memset( lods, 0xff, FEEDBACK_REGION_SIZE );
+	data->feedback_frames[ region ] = data->frame;
+
+	if ( texture_stream_update( &data->stream,
+	                            data->frame,
+	                            cmd,
+	                            data->textures ) )
+	{
+		data->texture_generation++;
+	}
+
+	if ( data->texture_set_generations[ region ] != data->texture_generation )
+	{
+		main_pass_write_texture_set( device, data, region );
+	}
+}
+
+// clears this frame's counters and output commands, then culls every
+// command against the camera frustum
+FT_INLINE void
+main_pass_record_culling( const struct ft_device*   device,
+                          struct ft_command_buffer* cmd,
+                          struct main_pass_data*    data )
+{
+	const struct draw_buffers* buffers = &data->draw_buffers;
+
+	uint32_t slot = ( uint32_t ) ( data->frame % CULL_COUNT_SLOTS );
+	main_pass_read_cull_counts( device, data, slot );
+
+	struct cull_push_constants pc = {
+	    .pass          = CULL_PASS_CLEAR,
+	    .command_count = data->draw_count,
+	    .batch_count   = data->batch_count,
+	    .count_offset  = slot * ( data->draw_buffer_capacity + 1 ),
+	};
+	scene_bvh_frustum_planes( data->camera->projection,
+	                          data->camera->view,
+	                          pc.planes );
+
+	struct ft_buffer_barrier barriers[ 2 ] = {
 	    [0] =
 	        {
-	            .buffer_descriptors = &buffer_descriptor,
-	            .descriptor_count   = 1,
-	            .descriptor_name    = "ubo",
+	            .buffer    = buffers->culled_commands,
+	            .old_state = data->culled_state,
+	            .new_state = FT_RESOURCE_STATE_GENERAL,
+	            .offset    = 0,
+	            .size      = data->draw_buffer_capacity *
+	                    sizeof( struct draw_command ),
 	        },
 	    [1] =
 	        {
-	            .descriptor_count   = 1,
-	            .descriptor_name    = "u_transforms",
-	            .buffer_descriptors = &tbuffer_descriptor,
-	        },
-	    [2] =
-	        {
-	            .descriptor_count   = 1,
-	            .descriptor_name    = "u_materials",
-	            .buffer_descriptors = &mbuffer_descriptor,
-	        },
-	    [3] =
-	        {
-	            .descriptor_count  = 1,
-	            .descriptor_name   = "u_brdf_lut",
-	            .image_descriptors = &brdf_lut_descriptor,
-	        },
-	    [4] =
-	        {
-	            .descriptor_count  = 1,
-	            .descriptor_name   = "u_irradiance_map",
-	            .image_descriptors = &irradiance_descriptor,
-	        },
-	    [5] =
-	        {
-	            .descriptor_count  = 1,
-	            .descriptor_name   = "u_specular_map",
-	            .image_descriptors = &specular_descriptor,
+	            .buffer    = buffers->cull_counts,
+	            .old_state = FT_RESOURCE_STATE_GENERAL,
+	            .new_state = FT_RESOURCE_STATE_GENERAL,
+	            .offset    = 0,
+	            .size      = ( data->draw_buffer_capacity + 1 ) *
+	                    CULL_COUNT_SLOTS * sizeof( uint32_t ),
 	        },
 	};
 
-	ft_update_descriptor_set( device,
-	                          data->pbr_set,
-	                          FT_COUNTOF( descriptor_writes ),
-	                          descriptor_writes );
+	uint32_t group_count =
+	    ( data->draw_count + 1 + CULL_GROUP_SIZE - 1 ) / CULL_GROUP_SIZE;
+
+	ft_cmd_barrier( cmd, 0, NULL, 1, barriers, 0, NULL );
+
+	ft_cmd_bind_pipeline( cmd, data->cull_pipeline );
+	ft_cmd_bind_descriptor_set( cmd,
+	                            0,
+	                            data->cull_sets[ data->draw_ring.region ],
+	                            data->cull_pipeline );
+	ft_cmd_push_constants( cmd, data->cull_pipeline, 0, sizeof( pc ), &pc );
+	ft_cmd_dispatch( cmd, group_count, 1, 1 );
+
+	barriers[ 0 ].old_state = FT_RESOURCE_STATE_GENERAL;
+	ft_cmd_barrier( cmd, 0, NULL, 2, barriers, 0, NULL );
+
+	pc.pass = CULL_PASS_CULL;
+	ft_cmd_push_constants( cmd, data->cull_pipeline, 0, sizeof( pc ), &pc );
+	ft_cmd_dispatch( cmd, group_count, 1, 1 );
+
+	barriers[ 0 ].new_state = FT_RESOURCE_STATE_INDIRECT_ARGUMENT;
+	ft_cmd_barrier( cmd, 0, NULL, 1, barriers, 0, NULL );
+
+	data->culled_state         = FT_RESOURCE_STATE_INDIRECT_ARGUMENT;
+	data->count_frames[ slot ] = data->frame;
+}
+
+// bounds of every command from the draw transforms, an instance group is
+// one leaf around all of its instances. animated draws are moved to where
+// they are each frame by main_pass_write_instances
+FT_INLINE void
+main_pass_build_bvh( struct main_pass_data* data )
+{
+	for ( uint32_t i = 0; i < data->draw_count; ++i )
+	{
+		const struct draw_data* draw    = &data->draws[ i ];
+		uint32_t                command = data->draw_commands[ i ];
+
+		if ( draw->instance_transforms != NULL )
+		{
+			data->command_bounds[ command ] = draw->instance_bounds;
+			continue;
+		}
+
+		scene_bvh_sphere_aabb( draw->world,
+		                       draw->bounds,
+		                       &data->command_bounds[ command ] );
+	}
+
+	scene_bvh_build( &data->bvh, data->command_bounds, data->draw_count );
+	data->bvh_built = true;
+	data->bvh_moved = false;
+}
+
+// culls the bvh against the camera and gathers the visible commands of
+// each batch at the front of its range, in the order the tree finds them
+FT_INLINE void
+main_pass_cull_on_cpu( struct main_pass_data* data )
+{
+	if ( data->bvh_moved )
+	{
+		scene_bvh_refit( &data->bvh, data->command_bounds );
+		data->bvh_moved = false;
+	}
+
+	float planes[ 6 ][ 4 ];
+	scene_bvh_frustum_planes( data->camera->projection,
+	                          data->camera->view,
+	                          planes );
+
+	uint32_t count = scene_bvh_cull( &data->bvh, planes, data->visible, NULL );
+
+	memset( data->batch_visible, 0, data->batch_count * sizeof( uint32_t ) );
+
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		uint32_t command = data->visible[ i ];
+		uint32_t b       = data->command_batches[ command ];
+		uint32_t slot    = data->batches[ b ].first_command +
+		                data->batch_visible[ b ]++;
+
+		data->visible_commands[ slot ] = data->commands[ command ];
+	}
+
+	data->visible_count = count;
+
+	if ( data->draw_submit != MAIN_PASS_DRAW_SUBMIT_INDIRECT )
+	{
+		return;
+	}
+
+	struct draw_command* commands =
+	    frame_ring_alloc( &data->draw_ring,
+	                      data->draw_count * sizeof( struct draw_command ),
+	                      &data->visible_offset );
+
+	for ( uint32_t b = 0; b < data->batch_count; ++b )
+	{
+		uint32_t first = data->batches[ b ].first_command;
+
+		memcpy( &commands[ first ],
+		        &data->visible_commands[ first ],
+		        data->batch_visible[ b ] * sizeof( struct draw_command ) );
+	}
+}
+
+// cooks the pack from the gltf on a cold start. the pack is saved for the
+// next run unless the model is animated, in which case the model is kept
+// for its animations and the gltf is parsed every time
+FT_INLINE void
+main_pass_cook_pack( struct main_pass_data* data,
+                     struct scene_model*    model,
+                     uint64_t               key )
+{
+	char filename[ MODEL_PATH_SIZE ];
+	mesh_pack_filename( model->path,
+	                    data->vertex_format,
+	                    data->texture_format,
+	                    filename,
+	                    sizeof( filename ) );
+
+	model->model = ft_load_gltf( model->path, FT_MODEL_GENERATE_TANGENTS );
+
+	size_t size        = 0;
+	model->pack_memory = mesh_pack_build( &model->model,
+	                                      key,
+	                                      data->vertex_format,
+	                                      data->texture_format,
+	                                      &size );
+	model->pack        = model->pack_memory;
+
+	if ( model->pack == NULL )
+	{
+		ft_log_error( "failed to build mesh pack for %s", model->path );
+	}
+
+	if ( model->model.animation_count != 0 )
+	{
+		return;
+	}
+
+	if ( model->pack && !mesh_pack_save( model->pack, size, filename ) )
+	{
+		ft_log_warn( "failed to write mesh pack %s", filename );
+	}
+
+	ft_free_gltf( &model->model );
+	memset( &model->model, 0, sizeof( model->model ) );
+}
+
+// cpu side of loading a model, maps or cooks its pack into the next model
+// slot. the slot only counts once the pack is there
+FT_INLINE bool
+main_pass_load_pack( struct main_pass_data* data, const char* path )
+{
+	if ( data->model_count == MAX_MODEL_COUNT )
+	{
+		ft_log_warn( "scene is full, %s is not loaded", path );
+		return false;
+	}
+
+	struct scene_model* model = &data->models[ data->model_count ];
+	memset( model, 0, sizeof( *model ) );
+	snprintf( model->path, sizeof( model->path ), "%s", path );
+
+	for ( uint32_t a = 0; a < GEOMETRY_ARENA_COUNT; ++a )
+	{
+		model->geometry[ a ] = GEOMETRY_HEAP_INVALID;
+	}
+
+	uint64_t        key = 0;
+	struct file_map file;
+
+	if ( file_map_open( path, &file ) )
+	{
+		key = mesh_pack_key( file.data,
+		                     file.size,
+		                     data->vertex_format,
+		                     data->texture_format );
+		file_map_close( &file );
+	}
+
+	char filename[ MODEL_PATH_SIZE ];
+	mesh_pack_filename( path,
+	                    data->vertex_format,
+	                    data->texture_format,
+	                    filename,
+	                    sizeof( filename ) );
+
+	if ( file_map_open( filename, &model->pack_file ) )
+	{
+		model->pack = mesh_pack_open( model->pack_file.data,
+		                              model->pack_file.size,
+		                              key );
+
+		if ( model->pack == NULL )
+		{
+			file_map_close( &model->pack_file );
+		}
+	}
+
+	if ( model->pack == NULL )
+	{
+		main_pass_cook_pack( data, model, key );
+	}
+
+	if ( model->pack == NULL )
+	{
+		if ( model->model.animation_count != 0 )
+		{
+			ft_free_gltf( &model->model );
+		}
+		return false;
+	}
+
+	data->model_count++;
+
+	return true;
+}
+
+void
+main_pass_set_vertex_format( enum mesh_vertex_format format )
+{
+	main_pass_data.vertex_format = format;
+}
+
+void
+main_pass_set_texture_format( enum mesh_texture_format format )
+{
+	main_pass_data.texture_format = format;
+}
+
+void
+main_pass_set_texture_streaming( enum main_pass_texture_streaming streaming )
+{
+	// the feedback is written through the texture array with fragment
+	// atomics
+	if ( streaming == MAIN_PASS_TEXTURE_STREAMING_PROGRESSIVE &&
+	     !MAIN_PASS_TEXTURE_FEEDBACK )
+	{
+		ft_log_warn( "progressive streaming needs non-uniform indexing and "
+		             "fragmentStoresAndAtomics, uploading every level" );
+		streaming = MAIN_PASS_TEXTURE_STREAMING_FULL;
+	}
+
+	main_pass_data.texture_streaming = streaming;
+}
+
+void
+main_pass_set_texture_budget( uint64_t bytes )
+{
+	main_pass_data.texture_budget = bytes;
+}
+
+void
+main_pass_set_draw_submit( enum main_pass_draw_submit submit )
+{
+	// a multi draw with a first instance per command, which the device
+	// only takes with both features enabled, and draws of many materials
+	// in one call, which only the texture array can serve
+	if ( submit == MAIN_PASS_DRAW_SUBMIT_INDIRECT &&
+	     !MAIN_PASS_INDIRECT_SUBMIT )
+	{
+		ft_log_warn( "indirect draws need multiDrawIndirect, "
+		             "drawIndirectFirstInstance and non-uniform indexing, "
+		             "drawing direct" );
+		submit = MAIN_PASS_DRAW_SUBMIT_DIRECT;
+	}
+
+	main_pass_data.draw_submit = submit;
+}
+
+void
+main_pass_set_stress_draw_count( uint32_t count )
+{
+	main_pass_data.stress_draw_count = count;
+}
+
+void
+main_pass_set_instance_count( uint32_t count )
+{
+	main_pass_data.instance_grid_count   = count;
+	main_pass_data.instance_grid_columns = 0;
+}
+
+void
+main_pass_set_instance_grid( uint32_t columns, uint32_t rows )
+{
+	main_pass_data.instance_grid_count   = columns * rows;
+	main_pass_data.instance_grid_columns = columns;
+}
+
+void
+main_pass_set_animation_step( float seconds )
+{
+	main_pass_data.animation_step = seconds;
+}
+
+void
+main_pass_set_culling( enum main_pass_culling culling )
+{
+	main_pass_data.culling = culling;
+}
+
+void
+main_pass_add_model_path( const char* path )
+{
+	struct main_pass_data* data = &main_pass_data;
+
+	if ( data->model_path_count == MAX_MODEL_COUNT )
+	{
+		ft_log_warn( "scene is full, %s is not loaded", path );
+		return;
+	}
+
+	char* model_path = data->model_paths[ data->model_path_count++ ];
+
+	// a bare name is a model of the sample folder, laid out like MODEL_PATH
+	if ( strpbrk( path, "/\\." ) == NULL )
+	{
+		snprintf( model_path,
+		          MODEL_PATH_SIZE,
+		          "%s/%s/glTF/%s.gltf",
+		          MODEL_FOLDER,
+		          path,
+		          path );
+	}
+	else
+	{
+		snprintf( model_path, MODEL_PATH_SIZE, "%s", path );
+	}
+
+	data->model_paths_ready = true;
+}
+
+void
+main_pass_load_model( void )
+{
+	struct main_pass_data* data = &main_pass_data;
+
+	if ( data->model_loaded )
+	{
+		return;
+	}
+
+	if ( !data->model_paths_ready )
+	{
+		main_pass_add_model_path( MODEL_PATH );
+	}
+
+	for ( uint32_t i = 0; i < data->model_path_count; ++i )
+	{
+		main_pass_load_pack( data, data->model_paths[ i ] );
+	}
+
+	data->model_loaded = true;
+}
+
+void
+main_pass_create_pipeline( const struct ft_device* device,
+                           enum main_pass_pipeline pipeline )
+{
+	struct main_pass_data* data = &main_pass_data;
+
+	if ( data->pipeline_created[ pipeline ] )
+	{
+		return;
+	}
+
+	switch ( pipeline )
+	{
+	case MAIN_PASS_PIPELINE_PBR:
+	{
+		main_pass_create_pbr_pipeline( device, data );
+		break;
+	}
+	case MAIN_PASS_PIPELINE_SKYBOX:
+	{
+		main_pass_create_skybox_pipeline( device, data );
+		break;
+	}
+	case MAIN_PASS_PIPELINE_CULL:
+	{
+		main_pass_create_cull_pipeline( device, data );
+		break;
+	}
+	default: break;
+	}
+
+	data->pipeline_created[ pipeline ] = true;
+	data->pipeline_create_counts[ pipeline ]++;
+}
+
+void
+main_pass_upload_scene( const struct ft_device* device,
+                        struct ft_queue*        queue )
+{
+	struct main_pass_data* data = &main_pass_data;
+
+	if ( !data->scene_uploaded )
+	{
+		data->queue = queue;
+		main_pass_load_model();
+		main_pass_create_pipeline( device, MAIN_PASS_PIPELINE_PBR );
+		main_pass_create_pipeline( device, MAIN_PASS_PIPELINE_SKYBOX );
+		main_pass_create_pipeline( device, MAIN_PASS_PIPELINE_CULL );
+		main_pass_create_buffers( device, data );
+		main_pass_create_sampler( device, data );
+		main_pass_create_unbound_resources( device, data );
+		geometry_heap_init( &data->geometry, device, queue );
+		texture_stream_init( &data->stream,
+		                     device,
+		                     MAX_SCENE_TEXTURE_COUNT,
+		                     TEXTURE_RETIRE_FRAME_COUNT,
+		                     data->texture_streaming ==
+		                         MAIN_PASS_TEXTURE_STREAMING_PROGRESSIVE,
+		                     data->texture_budget );
+
+		uint32_t mesh_count = 0;
+		for ( uint32_t m = 0; m < data->model_count; ++m )
+		{
+			mesh_count += data->models[ m ].pack
+			                  ? data->models[ m ].pack->mesh_count
+			                  : 0;
+		}
+
+		data->stress_copy_count =
+		    mesh_count != 0 && data->stress_draw_count != 0
+		        ? ( data->stress_draw_count + mesh_count - 1 ) / mesh_count
+		        : 1;
+
+		if ( data->instance_grid_count != 0 && data->placement_count == 0 )
+		{
+			main_pass_place_instance_grid( data );
+		}
+
+		// out of memory for the draws of a model, it and the models after
+		// it are left out of the scene
+		for ( uint32_t m = 0; m < data->model_count; ++m )
+		{
+			if ( !main_pass_upload_model( device, data, m ) )
+			{
+				while ( data->model_count > m )
+				{
+					main_pass_unload_model( data, data->model_count - 1 );
+				}
+			}
+		}
+
+		for ( uint32_t p = 0; p < data->placement_count; ++p )
+		{
+			if ( !main_pass_add_instance_group( device,
+			                                    data,
+			                                    &data->placements[ p ] ) )
+			{
+				ft_log_warn( "instance group %u is left out", p );
+			}
+		}
+		main_pass_update_geometry_bases( data );
+		main_pass_write_materials( device, data );
+		main_pass_build_draw_commands( device, data );
+		data->scene_uploaded = true;
+		data->scene_upload_count++;
+	}
+}
+
+bool
+main_pass_add_model( const struct ft_device* device, const char* path )
+{
+	struct main_pass_data* data = &main_pass_data;
+
+	if ( !main_pass_load_pack( data, path ) )
+	{
+		return false;
+	}
+
+	uint32_t index = data->model_count - 1;
+
+	if ( !main_pass_upload_model( device, data, index ) )
+	{
+		main_pass_unload_model( data, index );
+		return false;
+	}
+
+	main_pass_update_geometry_bases( data );
+	main_pass_write_materials( device, data );
+	main_pass_build_draw_commands( device, data );
+
+	// streaming reads finer levels from the pack until the model is
+	// unloaded
+	ft_resource_loader_wait_idle();
+	if ( !data->stream.enabled )
+	{
+		main_pass_release_pack( &data->models[ index ] );
+	}
+
+	if ( data->texture_sets[ 0 ] )
+	{
+		main_pass_write_texture_sets( device, data );
+	}
 
-	struct ft_sampler_descriptor sampler_descriptor = {
-	    .sampler = data->sampler,
-	};
+	return true;
+}
 
-	struct ft_image_descriptor image_descriptor = {
-	    .image          = data->maps->environment,
-	    .resource_state = FT_RESOURCE_STATE_SHADER_READ_ONLY,
-	};
+void
+main_pass_remove_model( const struct ft_device* device, uint32_t index )
+{
+	struct main_pass_data* data = &main_pass_data;
 
-	struct ft_descriptor_write skybox_descriptor_writes[ 3 ] = {
-	    [0] =
-	        {
-	            .descriptor_count   = 1,
-	            .descriptor_name    = "ubo",
-	            .buffer_descriptors = &buffer_descriptor,
-	        },
-	    [1] =
-	        {
-	            .descriptor_count    = 1,
-	            .descriptor_name     = "u_sampler",
-	            .sampler_descriptors = &sampler_descriptor,
-	        },
-	    [2] =
-	        {
-	            .descriptor_count  = 1,
-	            .descriptor_name   = "u_environment_map",
-	            .image_descriptors = &image_descriptor,
-	        },
-	};
+	if ( index >= data->model_count )
+	{
+		return;
+	}
 
-	ft_update_descriptor_set( device,
-	                          data->skybox_set,
-	                          FT_COUNTOF( skybox_descriptor_writes ),
-	                          skybox_descriptor_writes );
+	main_pass_unload_model( data, index );
+	main_pass_write_materials( device, data );
+	main_pass_build_draw_commands( device, data );
+
+	// the instance groups went with the model's draws
+	uint32_t kept = 0;
+
+	for ( uint32_t p = 0; p < data->placement_count; ++p )
+	{
+		struct instance_placement* placement = &data->placements[ p ];
+
+		if ( placement->model == index )
+		{
+			free( placement->transforms );
+			continue;
+		}
+
+		placement->model -= placement->model > index ? 1 : 0;
+		data->placements[ kept++ ] = *placement;
+	}
+
+	data->placement_count = kept;
+
+	// the freed slots still point at the retired images
+	if ( data->texture_sets[ 0 ] )
+	{
+		main_pass_write_texture_sets( device, data );
+	}
 }
 
-FT_INLINE void
-main_pass_update_ubo( const struct ft_device* device,
-                      struct main_pass_data*  data )
+bool
+main_pass_place_instances( const struct ft_device* device,
+                           uint32_t                model,
+                           uint32_t                mesh,
+                           uint32_t                count,
+                           const float ( *transforms )[ 4 ][ 4 ] )
 {
-	float4x4_dup( data->shader_data.view, data->camera->view );
-	float4x4_dup( data->shader_data.projection, data->camera->projection );
-	float3_dup( data->shader_data.view_pos, data->camera->position );
+	struct main_pass_data* data = &main_pass_data;
 
-	uint8_t* dst = ft_map_memory( device, data->ubo_buffer );
-	memcpy( dst, &data->shader_data, sizeof( struct camera_shader_data ) );
-	ft_unmap_memory( device, data->ubo_buffer );
+	if ( model >= data->model_count || count == 0 ||
+	     mesh >= data->models[ model ].mesh_count ||
+	     data->placement_count == MAX_PLACEMENT_COUNT )
+	{
+		return false;
+	}
+
+	struct instance_placement* placement =
+	    &data->placements[ data->placement_count ];
+	placement->model      = model;
+	placement->mesh       = mesh;
+	placement->count      = count;
+	placement->transforms = malloc( count * sizeof( float4x4 ) );
+
+	if ( placement->transforms == NULL )
+	{
+		return false;
+	}
+
+	memcpy( placement->transforms, transforms, count * sizeof( float4x4 ) );
+
+	if ( !main_pass_add_instance_group( device, data, placement ) )
+	{
+		free( placement->transforms );
+		return false;
+	}
+
+	data->placement_count++;
+	main_pass_write_materials( device, data );
+	main_pass_build_draw_commands( device, data );
+
+	return true;
+}
+
+void
+main_pass_compact_geometry( const struct ft_device* device )
+{
+	struct main_pass_data* data = &main_pass_data;
+
+	struct geometry_heap_stats before, after;
+	geometry_heap_get_stats( &data->geometry, &before );
+	geometry_heap_compact( &data->geometry );
+	geometry_heap_get_stats( &data->geometry, &after );
+
+	main_pass_update_geometry_bases( data );
+	main_pass_build_draw_commands( device, data );
+
+	uint64_t capacity_before = 0;
+	uint64_t capacity_after  = 0;
+	for ( uint32_t a = 0; a < GEOMETRY_ARENA_COUNT; ++a )
+	{
+		capacity_before += before.capacity[ a ];
+		capacity_after += after.capacity[ a ];
+	}
+
+	ft_log_info( "geometry compacted from %.2f MB to %.2f MB",
+	             ( double ) capacity_before / ( 1024.0 * 1024.0 ),
+	             ( double ) capacity_after / ( 1024.0 * 1024.0 ) );
+}
+
+void
+main_pass_request( enum main_pass_request request )
+{
+	main_pass_data.request = request;
+}
+
+void
+main_pass_process_requests( const struct ft_device* device )
+{
+	struct main_pass_data* data    = &main_pass_data;
+	enum main_pass_request request = data->request;
+
+	data->request = MAIN_PASS_REQUEST_NONE;
+
+	if ( request == MAIN_PASS_REQUEST_NONE || !data->scene_uploaded )
+	{
+		return;
+	}
+
+	// draws, images and geometry ranges may still be used by frames in
+	// flight
+	ft_queue_wait_idle( data->queue );
+
+	switch ( request )
+	{
+	case MAIN_PASS_REQUEST_UNLOAD_MODEL:
+	{
+		if ( data->model_count == 0 )
+		{
+			break;
+		}
+
+		uint32_t index = data->model_count - 1;
+
+		if ( data->unloaded_count < MAX_MODEL_COUNT )
+		{
+			memcpy( data->unloaded_paths[ data->unloaded_count++ ],
+			        data->models[ index ].path,
+			        MODEL_PATH_SIZE );
+		}
+
+		main_pass_remove_model( device, index );
+		break;
+	}
+	case MAIN_PASS_REQUEST_RELOAD_MODEL:
+	{
+		if ( data->unloaded_count == 0 )
+		{
+			break;
+		}
+
+		main_pass_add_model( device,
+		                     data->unloaded_paths[ --data->unloaded_count ] );
+		break;
+	}
+	case MAIN_PASS_REQUEST_COMPACT_GEOMETRY:
+	{
+		main_pass_compact_geometry( device );
+		break;
+	}
+	default: break;
+	}
+}
+
+void
+main_pass_get_scene_stats( struct main_pass_scene_stats* stats )
+{
+	struct main_pass_data* data = &main_pass_data;
+
+	stats->model_count    = data->model_count;
+	stats->draw_count     = data->draw_count;
+	stats->instance_count = data->instance_count;
+	stats->unloaded_count = data->unloaded_count;
+	stats->culling        = data->culling;
+	stats->visible_count =
+	    data->frame_culling != MAIN_PASS_CULLING_OFF
+	        ? FT_MIN( data->visible_count, data->draw_count )
+	        : data->draw_count;
+	stats->culled_count       = data->draw_count - stats->visible_count;
+	stats->texture_count      = data->texture_count;
+	stats->texture_slots      = MAX_SCENE_TEXTURE_COUNT;
+	stats->texture_bytes      = data->stream.resident_bytes;
+	stats->texture_full_bytes = data->texture_full_bytes;
+	texture_stream_get_stats( &data->stream, &stats->streaming );
+	geometry_heap_get_stats( &data->geometry, &stats->geometry );
+
+	stats->scene_upload_count    = data->scene_upload_count;
+	stats->pipeline_create_count = 0;
+	for ( uint32_t p = 0; p < MAIN_PASS_PIPELINE_COUNT; ++p )
+	{
+		stats->pipeline_create_count += data->pipeline_create_counts[ p ];
+	}
+}
+
+void
+main_pass_get_scene_bounds( float min[ 3 ], float max[ 3 ] )
+{
+	struct main_pass_data* data = &main_pass_data;
+
+	for ( uint32_t a = 0; a < 3; ++a )
+	{
+		min[ a ] = 0.0f;
+		max[ a ] = 0.0f;
+	}
+
+	for ( uint32_t i = 0; i < data->draw_count; ++i )
+	{
+		const struct draw_data* draw = &data->draws[ i ];
+		struct scene_bvh_aabb   aabb = draw->instance_bounds;
+
+		if ( draw->instance_transforms == NULL )
+		{
+			scene_bvh_sphere_aabb( draw->world, draw->bounds, &aabb );
+		}
+
+		for ( uint32_t a = 0; a < 3; ++a )
+		{
+			float lo = aabb.min[ a ];
+			float hi = aabb.max[ a ];
+
+			min[ a ] = i == 0 ? lo : FT_MIN( min[ a ], lo );
+			max[ a ] = i == 0 ? hi : FT_MAX( max[ a ], hi );
+		}
+	}
+}
+
+void
+main_pass_prepare_frame( const struct ft_device*   device,
+                         struct ft_command_buffer* cmd )
+{
+	struct main_pass_data* data = &main_pass_data;
+
+	if ( !data->scene_uploaded )
+	{
+		return;
+	}
+
+	data->frame++;
+	main_pass_release_retired( device, data, false );
+
+	// the direct path draws the cpu commands one by one, it can not use
+	// what the gpu culled
+	data->frame_culling = MAIN_PASS_CULLING_OFF;
+
+	if ( data->batch_count != 0 && data->culling == MAIN_PASS_CULLING_CPU )
+	{
+		data->frame_culling = MAIN_PASS_CULLING_CPU;
+	}
+	else if ( data->batch_count != 0 &&
+	          data->culling == MAIN_PASS_CULLING_GPU &&
+	          data->draw_submit == MAIN_PASS_DRAW_SUBMIT_INDIRECT )
+	{
+		data->frame_culling = MAIN_PASS_CULLING_GPU;
+	}
+
+	if ( data->frame_culling == MAIN_PASS_CULLING_CPU && !data->bvh_built )
+	{
+		main_pass_build_bvh( data );
+	}
+
+	frame_ring_begin_frame( &data->camera_ring, data->frame );
+	frame_ring_begin_frame( &data->draw_ring, data->frame );
+	main_pass_update_ubo( data );
+	profiler_begin( "textures" );
+	main_pass_stream_textures( device, cmd, data, data->draw_ring.region );
+	profiler_end();
+	profiler_begin( "instances" );
+	main_pass_write_instances( data );
+	profiler_end();
+
+	if ( data->frame_culling != MAIN_PASS_CULLING_GPU )
+	{
+		memset( data->count_frames, 0, sizeof( data->count_frames ) );
+		data->visible_count = data->draw_count;
+	}
+
+	profiler_begin( "culling" );
+	switch ( data->frame_culling )
+	{
+	case MAIN_PASS_CULLING_GPU:
+	{
+		gpu_timer_begin( cmd, "culling" );
+		main_pass_record_culling( device, cmd, data );
+		gpu_timer_end( cmd );
+		break;
+	}
+	case MAIN_PASS_CULLING_CPU:
+	{
+		main_pass_cull_on_cpu( data );
+		break;
+	}
+	default: break;
+	}
+	profiler_end();
 }
 
 static void
 main_pass_create( const struct ft_device* device, void* user_data )
 {
 	struct main_pass_data* data = user_data;
-	main_pass_create_pbr_pipeline( device, data );
-	main_pass_create_skybox_pipeline( device, data );
-	main_pass_create_buffers( device, data );
-	main_pass_create_sampler( device, data );
-	main_pass_create_unbound_resources( device, data );
-	main_pass_load_scene( device, data );
+
+	if ( data->created )
+	{
+		return;
+	}
+
+	main_pass_upload_scene( device, data->queue );
 	main_pass_create_descriptor_sets( device, data );
 	main_pass_write_descriptors( device, data );
 
+	// streaming reads finer levels from the packs until the models are
+	// unloaded
 	ft_resource_loader_wait_idle();
+	if ( !data->stream.enabled )
+	{
+		for ( uint32_t m = 0; m < data->model_count; ++m )
+		{
+			main_pass_release_pack( &data->models[ m ] );
+		}
+	}
+
+	data->created = true;
+}
+
+// the draw a command was made from. draws take their first instances in
+// order, so the last draw starting at or before the command's is it
+FT_INLINE const struct draw_data*
+main_pass_command_draw( const struct main_pass_data* data,
+                        const struct draw_command*   command )
+{
+	uint32_t low  = 0;
+	uint32_t high = data->draw_count;
+
+	while ( high - low > 1 )
+	{
+		uint32_t middle = low + ( high - low ) / 2;
+
+		if ( data->draws[ middle ].first_instance <= command->first_instance )
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return &data->draws[ low ];
 }
 
 static void
@@ -658,130 +3201,274 @@ main_pass_execute( const struct ft_device*   device,
                    struct ft_command_buffer* cmd,
                    void*                     user_data )
 {
+	FT_UNUSED( device );
+
 	struct main_pass_data* data = user_data;
 
-	main_pass_update_ubo( device, data );
+	profiler_begin( "main pass" );
+	gpu_timer_begin( cmd, "main pass" );
 
 	ft_cmd_set_scissor( cmd, 0, 0, data->width, data->height );
 	ft_cmd_set_viewport( cmd, 0, 0, data->width, data->height, 0, 1.0f );
 
+	struct ft_buffer* vertex_buffer =
+	    geometry_heap_buffer( &data->geometry, GEOMETRY_ARENA_VERTEX );
+	struct ft_buffer* index_buffer_16 =
+	    geometry_heap_buffer( &data->geometry, GEOMETRY_ARENA_INDEX_16 );
+	struct ft_buffer* index_buffer_32 =
+	    geometry_heap_buffer( &data->geometry, GEOMETRY_ARENA_INDEX_32 );
+
+	// the sets of the ring region this frame was written to
+	uint32_t region = data->draw_ring.region;
+
 	ft_cmd_bind_pipeline( cmd, data->pbr_pipeline );
-	ft_cmd_bind_descriptor_set( cmd, 0, data->pbr_set, data->pbr_pipeline );
-	ft_cmd_bind_vertex_buffer( cmd, data->vertex_buffer, 0 );
+	ft_cmd_bind_descriptor_set( cmd,
+	                            0,
+	                            data->pbr_sets[ region ],
+	                            data->pbr_pipeline );
 
-	float4x4* transforms = ft_map_memory( device, data->transforms_buffer );
+	// without the texture array set 1 follows the material, bound in the
+	// direct loop whenever it changes
+	uint32_t material_set = UINT32_MAX;
 
-	for ( uint32_t i = 0; i < data->draw_count; ++i )
+	if ( MAIN_PASS_BINDLESS_TEXTURES )
 	{
-		float4x4_dup( transforms[ i ], data->model.meshes[ i ].world );
+		ft_cmd_bind_descriptor_set( cmd,
+		                            1,
+		                            data->texture_sets[ region ],
+		                            data->pbr_pipeline );
 	}
 
-	for ( uint32_t a = 0; a < data->model.animation_count; ++a )
+	if ( vertex_buffer )
 	{
-		struct ft_animation* animation    = &data->model.animations[ a ];
-		float                current_time = ft_timer_get_ticks( &data->timer );
-		current_time /= 1000.0f;
-		apply_animation( transforms, current_time, animation );
+		ft_cmd_bind_vertex_buffer( cmd, vertex_buffer, 0 );
 	}
 
-	ft_unmap_memory( device, data->transforms_buffer );
+	// culled commands are compacted to the front of each batch's range. the
+	// rest of the range draws nothing after gpu culling and is not drawn
+	// after cpu culling, which knows how many commands survived
+	struct ft_buffer*          commands_buffer = data->draw_buffers.commands;
+	uint64_t                   commands_offset = 0;
+	const struct draw_command* commands        = data->commands;
 
-	for ( uint32_t i = 0; i < data->draw_count; ++i )
+	switch ( data->frame_culling )
 	{
-		struct draw_data* draw = &data->draws[ i ];
-
-		ft_cmd_push_constants( cmd,
-		                       data->pbr_pipeline,
-		                       0,
-		                       sizeof( uint32_t ),
-		                       &i );
+	case MAIN_PASS_CULLING_GPU:
+	{
+		commands_buffer = data->draw_buffers.culled_commands;
+		break;
+	}
+	case MAIN_PASS_CULLING_CPU:
+	{
+		commands_buffer = data->draw_buffers.ring;
+		commands_offset = data->visible_offset;
+		commands        = data->visible_commands;
+		break;
+	}
+	default: break;
+	}
 
-		ft_cmd_bind_descriptor_set( cmd,
-		                            1,
-		                            draw->material_set,
-		                            data->pbr_pipeline );
+	for ( uint32_t b = 0; b < data->batch_count; ++b )
+	{
+		const struct draw_batch* batch = &data->batches[ b ];
+		uint32_t command_count = data->frame_culling == MAIN_PASS_CULLING_CPU
+		                             ? data->batch_visible[ b ]
+		                             : batch->command_count;
 
-		switch ( draw->type )
-		{
-		case FT_DRAW_DATA_TYPE_NOT_INDEXED:
+		if ( command_count == 0 )
 		{
-			ft_cmd_draw( cmd, draw->vertex_count, 1, draw->first_vertex, 0 );
-			break;
+			continue;
 		}
+
+		switch ( batch->type )
+		{
 		case FT_DRAW_DATA_TYPE_INDEXED_16:
 		{
 			ft_cmd_bind_index_buffer( cmd,
-			                          data->index_buffer_16,
+			                          index_buffer_16,
 			                          0,
 			                          FT_INDEX_TYPE_U16 );
-			ft_cmd_draw_indexed( cmd,
-			                     draw->index_count,
-			                     1,
-			                     draw->first_index,
-			                     draw->first_vertex,
-			                     0 );
 			break;
 		}
 		case FT_DRAW_DATA_TYPE_INDEXED_32:
 		{
 			ft_cmd_bind_index_buffer( cmd,
-			                          data->index_buffer_32,
+			                          index_buffer_32,
 			                          0,
 			                          FT_INDEX_TYPE_U32 );
-
-			ft_cmd_draw_indexed( cmd,
-			                     draw->index_count,
-			                     1,
-			                     draw->first_index,
-			                     draw->first_vertex,
-			                     0 );
 			break;
 		}
 		default: break;
 		}
+
+		bool indexed = batch->type != FT_DRAW_DATA_TYPE_NOT_INDEXED;
+
+		if ( data->draw_submit == MAIN_PASS_DRAW_SUBMIT_INDIRECT )
+		{
+			uint64_t offset =
+			    commands_offset +
+			    batch->first_command * sizeof( struct draw_command );
+
+			if ( indexed )
+			{
+				ft_cmd_draw_indexed_indirect( cmd,
+				                              commands_buffer,
+				                              offset,
+				                              command_count,
+				                              sizeof( struct draw_command ) );
+			}
+			else
+			{
+				ft_cmd_draw_indirect( cmd,
+				                      commands_buffer,
+				                      offset,
+				                      command_count,
+				                      sizeof( struct draw_command ) );
+			}
+
+			continue;
+		}
+
+		// the same commands one call at a time, kept to measure against
+		for ( uint32_t c = 0; c < command_count; ++c )
+		{
+			const struct draw_command* command =
+			    &commands[ batch->first_command + c ];
+
+			if ( !MAIN_PASS_BINDLESS_TEXTURES )
+			{
+				const struct draw_data* draw =
+				    main_pass_command_draw( data, command );
+
+				if ( draw->material_set != material_set )
+				{
+					material_set = draw->material_set;
+					ft_cmd_bind_descriptor_set(
+					    cmd,
+					    1,
+					    data->material_sets[ region ][ material_set ],
+					    data->pbr_pipeline );
+				}
+			}
+
+			if ( indexed )
+			{
+				ft_cmd_draw_indexed( cmd,
+				                     command->index_count,
+				                     command->instance_count,
+				                     command->first_index,
+				                     command->vertex_offset,
+				                     command->first_instance );
+			}
+			else
+			{
+				ft_cmd_draw( cmd,
+				             command->index_count,
+				             command->instance_count,
+				             command->first_index,
+				             command->first_instance );
+			}
+		}
 	}
 
 	ft_cmd_bind_pipeline( cmd, data->skybox_pipeline );
 	ft_cmd_bind_descriptor_set( cmd,
 	                            0,
-	                            data->skybox_set,
+	                            data->skybox_sets[ region ],
 	                            data->skybox_pipeline );
 
 	ft_cmd_draw( cmd, 36, 1, 0, 0 );
+
+	gpu_timer_end( cmd );
+	profiler_end();
 }
 
 static void
 main_pass_destroy( const struct ft_device* device, void* user_data )
 {
 	struct main_pass_data* data = user_data;
-	ft_destroy_descriptor_set( device, data->skybox_set );
-	ft_destroy_descriptor_set( device, data->pbr_set );
-	for ( uint32_t i = 0; i < data->draw_count; i++ )
+
+	if ( data->resizing )
+	{
+		data->resizing = false;
+		return;
+	}
+
+	for ( uint32_t r = 0; r < RING_FRAME_COUNT; ++r )
 	{
-		if ( data->draws[ i ].material_set )
+		for ( uint32_t i = 0; i < data->material_region_counts[ r ]; ++i )
 		{
-			ft_destroy_descriptor_set( device, data->draws[ i ].material_set );
+			ft_destroy_descriptor_set( device, data->material_sets[ r ][ i ] );
 		}
+
+		if ( data->texture_sets[ r ] )
+		{
+			ft_destroy_descriptor_set( device, data->texture_sets[ r ] );
+		}
+
+		ft_destroy_descriptor_set( device, data->cull_sets[ r ] );
+		ft_destroy_descriptor_set( device, data->skybox_sets[ r ] );
+		ft_destroy_descriptor_set( device, data->pbr_sets[ r ] );
 	}
 
-	for ( uint32_t i = 0; i < data->model.texture_count; i++ )
+	// the next create loads what is loaded now
+	data->model_path_count = data->model_count;
+	for ( uint32_t m = 0; m < data->model_count; ++m )
 	{
-		ft_destroy_image( device, data->model_images[ i ] );
+		memcpy( data->model_paths[ m ],
+		        data->models[ m ].path,
+		        MODEL_PATH_SIZE );
 	}
-	ft_safe_free( data->model_images );
+
+	while ( data->model_count != 0 )
+	{
+		main_pass_unload_model( data, data->model_count - 1 );
+	}
+
+	geometry_heap_shutdown( &data->geometry );
+	texture_stream_shutdown( &data->stream );
+	main_pass_release_retired( device, data, true );
+	ft_safe_free( data->draws );
+	ft_safe_free( data->commands );
+	ft_safe_free( data->batches );
+	ft_safe_free( data->animation_transforms );
+	ft_safe_free( data->command_bounds );
+	ft_safe_free( data->command_batches );
+	ft_safe_free( data->draw_commands );
+	ft_safe_free( data->visible );
+	ft_safe_free( data->batch_visible );
+	ft_safe_free( data->visible_commands );
+	scene_bvh_shutdown( &data->bvh );
+	animation_set_shutdown( &data->animations );
+	data->batch_count          = 0;
+	data->draw_capacity        = 0;
+	data->draw_buffer_capacity = 0;
+	data->texture_generation   = 0;
+	data->frame_culling        = MAIN_PASS_CULLING_OFF;
+	data->bvh_built            = false;
+	memset( data->pbr_sets, 0, sizeof( data->pbr_sets ) );
+	memset( data->texture_sets, 0, sizeof( data->texture_sets ) );
+	memset( data->material_region_counts,
+	        0,
+	        sizeof( data->material_region_counts ) );
 	ft_destroy_image( device, data->unbound_image );
 	ft_destroy_sampler( device, data->sampler );
-	ft_free_gltf( &data->model );
-	ft_destroy_buffer( device, data->materials_buffer );
-	ft_destroy_buffer( device, data->transforms_buffer );
-	ft_destroy_buffer( device, data->ubo_buffer );
-	ft_destroy_buffer( device, data->index_buffer_32 );
-	ft_destroy_buffer( device, data->index_buffer_16 );
-	ft_destroy_buffer( device, data->vertex_buffer );
+	main_pass_destroy_draw_buffers( device, &data->draw_buffers );
+	ft_unmap_memory( device, data->camera_buffer );
+	ft_destroy_buffer( device, data->camera_buffer );
+	ft_unmap_memory( device, data->feedback_buffer );
+	ft_destroy_buffer( device, data->feedback_buffer );
 	ft_destroy_pipeline( device, data->pbr_pipeline );
 	ft_destroy_pipeline( device, data->skybox_pipeline );
+	ft_destroy_pipeline( device, data->cull_pipeline );
 	ft_destroy_descriptor_set_layout( device, data->dsl );
 	ft_destroy_descriptor_set_layout( device, data->skybox_dsl );
+	ft_destroy_descriptor_set_layout( device, data->cull_dsl );
+
+	data->model_loaded   = false;
+	data->scene_uploaded = false;
+	data->created        = false;
+	memset( data->pipeline_created, 0, sizeof( data->pipeline_created ) );
 }
 
 static bool
@@ -812,19 +3499,17 @@ main_pass_get_clear_depth_stencil(
 }
 
 void
-register_main_pass( struct ft_render_graph*    graph,
-                    const struct ft_swapchain* swapchain,
-                    const char*                backbuffer_source_name,
-                    const struct ft_camera*    camera,
-                    struct pbr_maps*           maps )
-{
-	ft_get_swapchain_size( swapchain,
-	                       &main_pass_data.width,
-	                       &main_pass_data.height );
-
-	main_pass_data.swapchain_format = ft_get_swapchain_format( swapchain );
-	main_pass_data.camera           = camera;
-	main_pass_data.maps             = maps;
+register_main_pass( struct ft_render_graph*          graph,
+                    const struct render_target_info* target,
+                    const char*                      backbuffer_source_name,
+                    const struct ft_camera*          camera,
+                    struct pbr_maps*                 maps )
+{
+	main_pass_data.width        = target->width;
+	main_pass_data.height       = target->height;
+	main_pass_data.color_format = ( enum ft_format ) target->format;
+	main_pass_data.camera       = camera;
+	main_pass_data.maps         = maps;
 	ft_timer_reset( &main_pass_data.timer );
 
 	struct ft_render_pass* pass;
@@ -850,3 +3535,15 @@ register_main_pass( struct ft_render_graph*    graph,
 	};
 	ft_rg_add_depth_stencil_output( pass, "depth", &depth_image );
 }
+
+void
+main_pass_resize( uint32_t width, uint32_t height )
+{
+	struct main_pass_data* data = &main_pass_data;
+
+	data->width  = width;
+	data->height = height;
+
+	// a pass that was never created gets no destroy callback to clear it
+	data->resizing = data->created;
+}
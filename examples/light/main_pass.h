@@ -1,21 +1,246 @@
 #pragma once
 
+#include "ibl_cache.h"
+#include "mesh_pack.h"
+#include "geometry_heap.h"
+#include "texture_stream.h"
+#include "fluent_features.h"
+
+struct ft_device;
 struct ft_render_graph;
-struct ft_swapchain;
 struct ft_camera;
 struct ft_image;
+struct ft_buffer;
+struct ft_queue;
+struct ft_command_buffer;
+
+// frames the app may keep in flight. the frame rings and the buffers the
+// main pass retires are sized for this many
+#define MAIN_PASS_MAX_FRAMES_IN_FLIGHT 4
+
+// the scene textures are one array the materials index into where fluent
+// enables non-uniform indexing, see fluent_features.h, and a small set
+// per material bound around every draw otherwise. the indirect submit and
+// progressive streaming only run on the array, and streaming also needs
+// the fragment stage to write what it sampled
+#define MAIN_PASS_BINDLESS_TEXTURES LIGHT_FLUENT_DESCRIPTOR_INDEXING
+#define MAIN_PASS_INDIRECT_SUBMIT                                              \
+	( LIGHT_FLUENT_MULTI_DRAW_INDIRECT && MAIN_PASS_BINDLESS_TEXTURES )
+#define MAIN_PASS_TEXTURE_FEEDBACK                                             \
+	( LIGHT_FLUENT_FRAGMENT_ATOMICS && MAIN_PASS_BINDLESS_TEXTURES )
 
+// irradiance is only created in cubemap mode, irradiance_sh holds the
+// IBL_SH_COEFFICIENT_COUNT coefficients in sh mode
 struct pbr_maps
 {
-	struct ft_image* environment;
-	struct ft_image* brdf_lut;
-	struct ft_image* irradiance;
-	struct ft_image* specular;
+	enum ibl_irradiance_mode irradiance_mode;
+	struct ft_image*         environment;
+	struct ft_image*         brdf_lut;
+	struct ft_image*         irradiance;
+	struct ft_buffer*        irradiance_sh;
+	struct ft_image*         specular;
+};
+
+// what the graph renders into, the swapchain images or the offscreen
+// images of headless mode. format is an ft_format
+struct render_target_info
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;
+};
+
+void
+register_main_pass( struct ft_render_graph*          graph,
+                    const struct render_target_info* target,
+                    const char*                      backbuffer_source_name,
+                    const struct ft_camera*          camera,
+                    struct pbr_maps*                 maps );
+
+// the next graph rebuild only resizes the pass. its destroy and create
+// callbacks keep the scene, the pipelines and the descriptor sets, none of
+// which depend on the target size, and the graph recreates the attachments
+void
+main_pass_resize( uint32_t width, uint32_t height );
+
+// float or quantized vertices, must be set before the model is loaded
+void
+main_pass_set_vertex_format( enum mesh_vertex_format format );
+
+// rgba8 or bc textures, must be set before the model is loaded. either
+// way every level comes cooked from the pack
+void
+main_pass_set_texture_format( enum mesh_texture_format format );
+
+// progressive loads every texture with its mip tail and streams the finer
+// levels in as the frames sample them, full uploads every level on load.
+// progressive falls back to full without MAIN_PASS_TEXTURE_FEEDBACK
+enum main_pass_texture_streaming
+{
+	MAIN_PASS_TEXTURE_STREAMING_PROGRESSIVE,
+	MAIN_PASS_TEXTURE_STREAMING_FULL,
+	MAIN_PASS_TEXTURE_STREAMING_COUNT,
+};
+
+// both must be set before the scene is uploaded. levels are evicted from
+// the least recently sampled textures while the streamed ones take more
+// than bytes, 0 never evicts
+void
+main_pass_set_texture_streaming( enum main_pass_texture_streaming streaming );
+
+void
+main_pass_set_texture_budget( uint64_t bytes );
+
+// adds a gltf to the startup scene, the default model is only loaded when
+// none was added. a bare name like Sponza is looked up in MODEL_FOLDER as
+// Sponza/glTF/Sponza.gltf
+void
+main_pass_add_model_path( const char* path );
+
+// indirect records one multi draw per run of draws that share an index
+// type, direct records one draw call per draw. indirect falls back to
+// direct without MAIN_PASS_INDIRECT_SUBMIT, which needs multiDrawIndirect
+// and drawIndirectFirstInstance on top of the bindless textures
+enum main_pass_draw_submit
+{
+	MAIN_PASS_DRAW_SUBMIT_INDIRECT,
+	MAIN_PASS_DRAW_SUBMIT_DIRECT,
+};
+
+void
+main_pass_set_draw_submit( enum main_pass_draw_submit submit );
+
+// draws every model on a grid as many times as it takes to reach count
+// draws, for measuring the cpu cost of large scenes. 0 turns it off
+void
+main_pass_set_stress_draw_count( uint32_t count );
+
+// places count instances of every mesh on a grid behind the scene when it
+// is uploaded, each mesh drawn as one instanced draw. 0 turns it off
+void
+main_pass_set_instance_count( uint32_t count );
+
+// the same grid with a set number of columns and rows
+void
+main_pass_set_instance_grid( uint32_t columns, uint32_t rows );
+
+// moves animations by seconds every frame instead of following the clock,
+// so a run renders the same frames every time. 0 follows the clock
+void
+main_pass_set_animation_step( float seconds );
+
+// gpu culling tests every draw's bounding sphere against the camera in a
+// compute pass and draws only what survives. it needs the indirect submit.
+// cpu culling walks a bvh over the draws before anything is recorded and
+// works with either submit
+enum main_pass_culling
+{
+	MAIN_PASS_CULLING_GPU,
+	MAIN_PASS_CULLING_CPU,
+	MAIN_PASS_CULLING_OFF,
+	MAIN_PASS_CULLING_COUNT,
+};
+
+void
+main_pass_set_culling( enum main_pass_culling culling );
+
+// startup steps of the main pass, exposed so on_init can run them as tasks
+// before the render graph is built. main_pass_load_model only touches the
+// cpu, the create callback runs whichever step has not happened yet
+void
+main_pass_load_model( void );
+
+// pipelines are created one by one so startup tasks can compile them while
+// the cpu only tasks run. two of them must not be created at once, the
+// device is not synchronized between threads
+enum main_pass_pipeline
+{
+	MAIN_PASS_PIPELINE_PBR,
+	MAIN_PASS_PIPELINE_SKYBOX,
+	MAIN_PASS_PIPELINE_CULL,
+	MAIN_PASS_PIPELINE_COUNT,
 };
 
 void
-register_main_pass( struct ft_render_graph*    graph,
-                    const struct ft_swapchain* swapchain,
-                    const char*                backbuffer_source_name,
-                    const struct ft_camera*    camera,
-                    struct pbr_maps*           maps );
+main_pass_create_pipeline( const struct ft_device* device,
+                           enum main_pass_pipeline pipeline );
+
+void
+main_pass_upload_scene( const struct ft_device* device,
+                        struct ft_queue*        queue );
+
+// runtime scene changes. the caller makes sure the gpu is done with the
+// scene, main_pass_process_requests does that for requests made from the ui
+bool
+main_pass_add_model( const struct ft_device* device, const char* path );
+
+void
+main_pass_remove_model( const struct ft_device* device, uint32_t index );
+
+// draws mesh of a loaded model count times, once at each of the column
+// major transforms, with a single instanced draw. the transforms are
+// copied and the instances are unloaded with the model
+bool
+main_pass_place_instances( const struct ft_device* device,
+                           uint32_t                model,
+                           uint32_t                mesh,
+                           uint32_t                count,
+                           const float ( *transforms )[ 4 ][ 4 ] );
+
+void
+main_pass_compact_geometry( const struct ft_device* device );
+
+// unload drops the most recently loaded model and reload brings back the
+// most recently unloaded one
+enum main_pass_request
+{
+	MAIN_PASS_REQUEST_NONE,
+	MAIN_PASS_REQUEST_UNLOAD_MODEL,
+	MAIN_PASS_REQUEST_RELOAD_MODEL,
+	MAIN_PASS_REQUEST_COMPACT_GEOMETRY,
+};
+
+void
+main_pass_request( enum main_pass_request request );
+
+// call between frames, waits for the queue to idle when there is work
+void
+main_pass_process_requests( const struct ft_device* device );
+
+// the visible and culled counts of gpu culling are read back a few frames
+// after they were culled and count draws, an instance group is one draw.
+// texture_count of the texture_slots in the scene texture array are taken
+// and their resident levels hold texture_bytes of video memory, out of the
+// texture_full_bytes every level would
+struct main_pass_scene_stats
+{
+	uint32_t                    model_count;
+	uint32_t                    draw_count;
+	uint32_t                    instance_count;
+	uint32_t                    unloaded_count;
+	enum main_pass_culling      culling;
+	uint32_t                    visible_count;
+	uint32_t                    culled_count;
+	uint32_t                    texture_count;
+	uint32_t                    texture_slots;
+	uint64_t                    texture_bytes;
+	uint64_t                    texture_full_bytes;
+	struct texture_stream_stats streaming;
+	struct geometry_heap_stats  geometry;
+	uint32_t                    scene_upload_count;
+	uint32_t                    pipeline_create_count;
+};
+
+void
+main_pass_get_scene_stats( struct main_pass_scene_stats* stats );
+
+// world bounds of every draw at rest, zero for an empty scene
+void
+main_pass_get_scene_bounds( float min[ 3 ], float max[ 3 ] );
+
+// writes the camera and the draws of this frame and records the culling
+// dispatches. call before ft_rg_execute, compute work can not be recorded
+// inside the render passes the graph begins around its passes
+void
+main_pass_prepare_frame( const struct ft_device*   device,
+                         struct ft_command_buffer* cmd );
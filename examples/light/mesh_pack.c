@@ -0,0 +1,965 @@
+#include <stdio.h>
+#include <fluent/fluent.h>
+
+#include "mesh_pack.h"
+#include "texture_cook.h"
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME        0x100000001b3ull
+
+FT_STATIC_ASSERT( FT_TEXTURE_TYPE_COUNT <= MESH_PACK_MAX_MATERIAL_TEXTURES );
+FT_STATIC_ASSERT( MESH_PACK_MAX_TEXTURE_LEVELS == TEXTURE_MAX_LEVELS );
+FT_STATIC_ASSERT( sizeof( struct mesh_vertex ) == 48 );
+FT_STATIC_ASSERT( sizeof( struct mesh_vertex_quantized ) == 20 );
+FT_STATIC_ASSERT( sizeof( struct mesh_pack_mesh ) % 16 == 0 );
+
+static uint64_t
+fnv1a( uint64_t hash, const void* data, size_t size )
+{
+	const uint8_t* bytes = data;
+
+	for ( size_t i = 0; i < size; ++i )
+	{
+		hash ^= bytes[ i ];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+static uint64_t
+align_up( uint64_t value, uint64_t alignment )
+{
+	return ( value + alignment - 1 ) & ~( alignment - 1 );
+}
+
+static const char* vertex_format_names[ MESH_VERTEX_FORMAT_COUNT ] = {
+    [MESH_VERTEX_FORMAT_FLOAT]     = "float",
+    [MESH_VERTEX_FORMAT_QUANTIZED] = "quantized",
+};
+
+static const char* texture_format_names[ MESH_TEXTURE_FORMAT_COUNT ] = {
+    [MESH_TEXTURE_FORMAT_RGBA8] = "rgba8",
+    [MESH_TEXTURE_FORMAT_BC]    = "bc",
+};
+
+// what each material slot samples, the cooker picks codecs and mip
+// filters from it
+static const uint32_t slot_usages[ FT_TEXTURE_TYPE_COUNT ] = {
+    [FT_TEXTURE_TYPE_BASE_COLOR]         = TEXTURE_USAGE_COLOR,
+    [FT_TEXTURE_TYPE_NORMAL]             = TEXTURE_USAGE_NORMAL,
+    [FT_TEXTURE_TYPE_AMBIENT_OCCLUSION]  = TEXTURE_USAGE_SINGLE,
+    [FT_TEXTURE_TYPE_METALLIC_ROUGHNESS] = TEXTURE_USAGE_DATA,
+    [FT_TEXTURE_TYPE_EMISSIVE]           = TEXTURE_USAGE_COLOR,
+};
+
+uint32_t
+mesh_vertex_stride( enum mesh_vertex_format format )
+{
+	return format == MESH_VERTEX_FORMAT_QUANTIZED
+	           ? sizeof( struct mesh_vertex_quantized )
+	           : sizeof( struct mesh_vertex );
+}
+
+const char*
+mesh_vertex_format_name( enum mesh_vertex_format format )
+{
+	return format < MESH_VERTEX_FORMAT_COUNT ? vertex_format_names[ format ]
+	                                         : "unknown";
+}
+
+bool
+mesh_vertex_format_parse( const char* name, enum mesh_vertex_format* format )
+{
+	for ( uint32_t i = 0; i < MESH_VERTEX_FORMAT_COUNT; ++i )
+	{
+		if ( strcmp( name, vertex_format_names[ i ] ) == 0 )
+		{
+			*format = ( enum mesh_vertex_format ) i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const char*
+mesh_texture_format_name( enum mesh_texture_format format )
+{
+	return format < MESH_TEXTURE_FORMAT_COUNT ? texture_format_names[ format ]
+	                                          : "unknown";
+}
+
+bool
+mesh_texture_format_parse( const char* name, enum mesh_texture_format* format )
+{
+	for ( uint32_t i = 0; i < MESH_TEXTURE_FORMAT_COUNT; ++i )
+	{
+		if ( strcmp( name, texture_format_names[ i ] ) == 0 )
+		{
+			*format = ( enum mesh_texture_format ) i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// round to nearest even, values past the largest finite half are clamped
+static uint16_t
+float_to_half( float value )
+{
+	uint32_t bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+
+	uint16_t sign = ( uint16_t ) ( ( bits >> 16 ) & 0x8000 );
+	uint32_t abs  = bits & 0x7fffffff;
+
+	if ( abs > 0x7f800000 )
+	{
+		return sign | 0x7e00;
+	}
+
+	if ( abs >= 0x477ff000 )
+	{
+		return sign | 0x7bff;
+	}
+
+	uint32_t half;
+	uint32_t remainder;
+	uint32_t halfway;
+
+	if ( abs < 0x38800000 )
+	{
+		// subnormal half, the implicit one is shifted in with the mantissa
+		if ( abs < 0x33000000 )
+		{
+			return sign;
+		}
+
+		uint32_t mantissa = ( abs & 0x7fffff ) | 0x800000;
+		uint32_t shift    = 126 - ( abs >> 23 );
+
+		half      = mantissa >> shift;
+		remainder = mantissa & ( ( 1u << shift ) - 1 );
+		halfway   = 1u << ( shift - 1 );
+	}
+	else
+	{
+		half      = ( abs - 0x38000000 ) >> 13;
+		remainder = abs & 0x1fff;
+		halfway   = 0x1000;
+	}
+
+	if ( remainder > halfway || ( remainder == halfway && ( half & 1 ) ) )
+	{
+		half++;
+	}
+
+	return sign | ( uint16_t ) half;
+}
+
+static float
+half_to_float( uint16_t value )
+{
+	uint32_t sign     = ( uint32_t ) ( value & 0x8000 ) << 16;
+	uint32_t exponent = ( value >> 10 ) & 0x1f;
+	uint32_t mantissa = value & 0x3ff;
+
+	if ( exponent == 0 )
+	{
+		float result = ldexpf( ( float ) mantissa, -24 );
+		return sign ? -result : result;
+	}
+
+	uint32_t bits = sign | ( mantissa << 13 );
+	bits |= exponent == 31 ? 0x7f800000 : ( exponent + 112 ) << 23;
+
+	float result;
+	memcpy( &result, &bits, sizeof( result ) );
+	return result;
+}
+
+static int16_t
+float_to_snorm16( float value )
+{
+	value = FT_MAX( FT_MIN( value, 1.0f ), -1.0f );
+	return ( int16_t ) lrintf( value * 32767.0f );
+}
+
+static float
+snorm16_to_float( int16_t value )
+{
+	return FT_MAX( ( float ) value / 32767.0f, -1.0f );
+}
+
+// octahedral mapping, the lower hemisphere is folded over the diagonals
+static void
+oct_encode( const float* v, int16_t* dst )
+{
+	float length = fabsf( v[ 0 ] ) + fabsf( v[ 1 ] ) + fabsf( v[ 2 ] );
+	float x      = 0.0f;
+	float y      = 0.0f;
+
+	if ( length > 0.0f )
+	{
+		x = v[ 0 ] / length;
+		y = v[ 1 ] / length;
+
+		if ( v[ 2 ] < 0.0f )
+		{
+			float fx = ( 1.0f - fabsf( y ) ) * ( x >= 0.0f ? 1.0f : -1.0f );
+			float fy = ( 1.0f - fabsf( x ) ) * ( y >= 0.0f ? 1.0f : -1.0f );
+			x        = fx;
+			y        = fy;
+		}
+	}
+
+	dst[ 0 ] = float_to_snorm16( x );
+	dst[ 1 ] = float_to_snorm16( y );
+}
+
+static void
+oct_decode( const int16_t* src, float* v )
+{
+	float x = snorm16_to_float( src[ 0 ] );
+	float y = snorm16_to_float( src[ 1 ] );
+	float z = 1.0f - fabsf( x ) - fabsf( y );
+	float t = FT_MAX( -z, 0.0f );
+
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	float length = sqrtf( x * x + y * y + z * z );
+
+	v[ 0 ] = x / length;
+	v[ 1 ] = y / length;
+	v[ 2 ] = z / length;
+}
+
+void
+mesh_vertex_dequantize( const struct mesh_vertex_quantized* src,
+                        const struct mesh_pack_mesh*        mesh,
+                        struct mesh_vertex*                 dst )
+{
+	for ( uint32_t i = 0; i < 3; ++i )
+	{
+		dst->position[ i ] =
+		    mesh->position_offset[ i ] +
+		    ( float ) src->position[ i ] / 65535.0f * mesh->position_scale[ i ];
+	}
+
+	oct_decode( src->normal, dst->normal );
+	oct_decode( src->tangent, dst->tangent );
+	dst->tangent[ 3 ] = src->position[ 3 ] != 0 ? 1.0f : -1.0f;
+
+	dst->texcoord[ 0 ] = half_to_float( src->texcoord[ 0 ] );
+	dst->texcoord[ 1 ] = half_to_float( src->texcoord[ 1 ] );
+}
+
+uint64_t
+mesh_pack_key( const void*              gltf,
+               size_t                   gltf_size,
+               enum mesh_vertex_format  format,
+               enum mesh_texture_format texture_format )
+{
+	uint32_t version = MESH_PACK_VERSION;
+	uint32_t stride  = mesh_vertex_stride( format );
+
+	uint64_t hash = fnv1a( FNV_OFFSET_BASIS, gltf, gltf_size );
+	hash          = fnv1a( hash, &version, sizeof( version ) );
+	hash          = fnv1a( hash, &format, sizeof( format ) );
+	hash          = fnv1a( hash, &stride, sizeof( stride ) );
+	hash          = fnv1a( hash, &texture_format, sizeof( texture_format ) );
+
+	return hash;
+}
+
+void
+mesh_pack_filename( const char*              gltf,
+                    enum mesh_vertex_format  format,
+                    enum mesh_texture_format texture_format,
+                    char*                    filename,
+                    size_t                   size )
+{
+	const char* name = gltf;
+
+	for ( const char* p = gltf; *p; ++p )
+	{
+		if ( *p == '/' || *p == '\\' )
+		{
+			name = p + 1;
+		}
+	}
+
+	const char* extension = strrchr( name, '.' );
+	int         length    = extension ? ( int ) ( extension - name )
+	                                  : ( int ) strlen( name );
+
+	snprintf( filename,
+	          size,
+	          "%.*s%s%s.pack",
+	          length,
+	          name,
+	          format == MESH_VERTEX_FORMAT_QUANTIZED ? ".quantized" : "",
+	          texture_format == MESH_TEXTURE_FORMAT_BC ? ".bc" : "" );
+}
+
+static void
+interleave_vertices( const struct ft_mesh* mesh, struct mesh_vertex* dst )
+{
+	for ( uint32_t v = 0; v < mesh->vertex_count; ++v )
+	{
+		memcpy( dst[ v ].position,
+		        &mesh->positions[ v * 3 ],
+		        sizeof( dst[ v ].position ) );
+
+		if ( mesh->normals )
+		{
+			memcpy( dst[ v ].normal,
+			        &mesh->normals[ v * 3 ],
+			        sizeof( dst[ v ].normal ) );
+		}
+
+		if ( mesh->tangents )
+		{
+			memcpy( dst[ v ].tangent,
+			        &mesh->tangents[ v * 4 ],
+			        sizeof( dst[ v ].tangent ) );
+		}
+
+		if ( mesh->texcoords )
+		{
+			memcpy( dst[ v ].texcoord,
+			        &mesh->texcoords[ v * 2 ],
+			        sizeof( dst[ v ].texcoord ) );
+		}
+	}
+}
+
+// offset and scale map unorm16 positions onto the mesh bounds
+static void
+compute_position_bounds( const struct ft_mesh* mesh,
+                         float*                offset,
+                         float*                scale )
+{
+	for ( uint32_t i = 0; i < 3; ++i )
+	{
+		float min = mesh->vertex_count ? mesh->positions[ i ] : 0.0f;
+		float max = min;
+
+		for ( uint32_t v = 1; v < mesh->vertex_count; ++v )
+		{
+			min = FT_MIN( min, mesh->positions[ v * 3 + i ] );
+			max = FT_MAX( max, mesh->positions[ v * 3 + i ] );
+		}
+
+		offset[ i ] = min;
+		scale[ i ]  = max - min;
+	}
+}
+
+// centered on the box around the positions, which is close enough to the
+// minimal sphere for culling
+static void
+compute_bounding_sphere( const struct ft_mesh* mesh, float* sphere )
+{
+	float min[ 3 ] = { 0.0f, 0.0f, 0.0f };
+	float max[ 3 ] = { 0.0f, 0.0f, 0.0f };
+
+	for ( uint32_t i = 0; i < 3 && mesh->vertex_count != 0; ++i )
+	{
+		min[ i ] = mesh->positions[ i ];
+		max[ i ] = min[ i ];
+
+		for ( uint32_t v = 1; v < mesh->vertex_count; ++v )
+		{
+			min[ i ] = FT_MIN( min[ i ], mesh->positions[ v * 3 + i ] );
+			max[ i ] = FT_MAX( max[ i ], mesh->positions[ v * 3 + i ] );
+		}
+	}
+
+	float radius_squared = 0.0f;
+
+	for ( uint32_t i = 0; i < 3; ++i )
+	{
+		sphere[ i ] = ( min[ i ] + max[ i ] ) * 0.5f;
+	}
+
+	for ( uint32_t v = 0; v < mesh->vertex_count; ++v )
+	{
+		const float* position = &mesh->positions[ v * 3 ];
+
+		float dx = position[ 0 ] - sphere[ 0 ];
+		float dy = position[ 1 ] - sphere[ 1 ];
+		float dz = position[ 2 ] - sphere[ 2 ];
+
+		radius_squared =
+		    FT_MAX( radius_squared, dx * dx + dy * dy + dz * dz );
+	}
+
+	sphere[ 3 ] = sqrtf( radius_squared );
+}
+
+static void
+quantize_vertices( const struct ft_mesh*         mesh,
+                   const struct mesh_pack_mesh*  bounds,
+                   struct mesh_vertex_quantized* dst )
+{
+	static const float zero[ 4 ] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	for ( uint32_t v = 0; v < mesh->vertex_count; ++v )
+	{
+		const float* position = &mesh->positions[ v * 3 ];
+		const float* normal   = mesh->normals ? &mesh->normals[ v * 3 ] : zero;
+		const float* tangent =
+		    mesh->tangents ? &mesh->tangents[ v * 4 ] : zero;
+
+		for ( uint32_t i = 0; i < 3; ++i )
+		{
+			float t = bounds->position_scale[ i ] > 0.0f
+			              ? ( position[ i ] - bounds->position_offset[ i ] ) /
+			                    bounds->position_scale[ i ]
+			              : 0.0f;
+			t       = FT_MAX( FT_MIN( t, 1.0f ), 0.0f );
+
+			dst[ v ].position[ i ] = ( uint16_t ) lrintf( t * 65535.0f );
+		}
+
+		dst[ v ].position[ 3 ] = tangent[ 3 ] < 0.0f ? 0 : 0xffff;
+
+		oct_encode( normal, dst[ v ].normal );
+		oct_encode( tangent, dst[ v ].tangent );
+
+		if ( mesh->texcoords )
+		{
+			dst[ v ].texcoord[ 0 ] =
+			    float_to_half( mesh->texcoords[ v * 2 + 0 ] );
+			dst[ v ].texcoord[ 1 ] =
+			    float_to_half( mesh->texcoords[ v * 2 + 1 ] );
+		}
+	}
+}
+
+static void
+copy_material( const struct ft_material* src, struct mesh_pack_material* dst )
+{
+	memcpy( dst->base_color_factor,
+	        src->base_color_factor,
+	        sizeof( float ) * 4 );
+	memcpy( dst->emissive_factor, src->emissive_factor, sizeof( float ) * 3 );
+	dst->metallic_factor   = src->metallic_factor;
+	dst->roughness_factor  = src->roughness_factor;
+	dst->emissive_strength = src->emissive_strength;
+	dst->alpha_cutoff      = src->alpha_cutoff;
+
+	for ( uint32_t i = 0; i < MESH_PACK_MAX_MATERIAL_TEXTURES; ++i )
+	{
+		dst->textures[ i ] =
+		    i < FT_TEXTURE_TYPE_COUNT ? src->textures[ i ] : -1;
+	}
+}
+
+// fills the level index of a texture starting at offset, returns the
+// bytes its levels span
+static uint64_t
+layout_texture( const struct ft_texture*  texture,
+                enum texture_codec        codec,
+                uint64_t                  offset,
+                struct mesh_pack_texture* dst )
+{
+	dst->width       = texture->width;
+	dst->height      = texture->height;
+	dst->codec       = codec;
+	dst->level_count = texture_level_count( texture->width, texture->height );
+
+	uint64_t size = 0;
+
+	for ( uint32_t l = 0; l < dst->level_count; ++l )
+	{
+		dst->levels[ l ].offset = offset + size;
+		dst->levels[ l ].size =
+		    texture_level_size( codec,
+		                        texture_level_extent( texture->width, l ),
+		                        texture_level_extent( texture->height, l ) );
+		size += align_up( dst->levels[ l ].size, MESH_PACK_LEVEL_ALIGNMENT );
+	}
+
+	return size;
+}
+
+// every level is filtered down from the one above it and encoded into the
+// pack, two scratch levels are enough to walk the chain
+static void
+cook_texture( const struct ft_texture*        texture,
+              const struct mesh_pack_texture* dst,
+              uint32_t                        usage,
+              uint8_t*                        pack )
+{
+	uint32_t width  = texture->width;
+	uint32_t height = texture->height;
+
+	size_t scratch_size = ( size_t ) texture_level_extent( width, 1 ) *
+	                      texture_level_extent( height, 1 ) * 4;
+	uint8_t* scratch[ 2 ] = { NULL, NULL };
+
+	if ( dst->level_count > 1 )
+	{
+		scratch[ 0 ] = malloc( scratch_size );
+		scratch[ 1 ] = malloc( scratch_size );
+	}
+
+	const uint8_t* level = texture->data;
+
+	for ( uint32_t l = 0; l < dst->level_count; ++l )
+	{
+		texture_encode( dst->codec,
+		                level,
+		                width,
+		                height,
+		                pack + dst->levels[ l ].offset );
+
+		if ( l + 1 < dst->level_count )
+		{
+			uint8_t* next = scratch[ l % 2 ];
+			texture_downsample( level, width, height, usage, next );
+
+			level  = next;
+			width  = texture_level_extent( width, 1 );
+			height = texture_level_extent( height, 1 );
+		}
+	}
+
+	free( scratch[ 0 ] );
+	free( scratch[ 1 ] );
+}
+
+static void*
+section_data( uint8_t*                       pack,
+              const struct mesh_pack_header* header,
+              enum mesh_pack_section         section )
+{
+	return pack + header->sections[ section ].offset;
+}
+
+void*
+mesh_pack_build( const struct ft_model*   model,
+                 uint64_t                 key,
+                 enum mesh_vertex_format  format,
+                 enum mesh_texture_format texture_format,
+                 size_t*                  size )
+{
+	uint32_t stride = mesh_vertex_stride( format );
+
+	struct mesh_pack_header header = {
+	    .magic          = MESH_PACK_MAGIC,
+	    .version        = MESH_PACK_VERSION,
+	    .key            = key,
+	    .vertex_stride  = stride,
+	    .mesh_count     = model->mesh_count,
+	    .texture_count  = model->texture_count,
+	    .vertex_format  = format,
+	    .texture_format = texture_format,
+	};
+
+	uint64_t section_sizes[ MESH_PACK_SECTION_COUNT ] = {
+	    [MESH_PACK_SECTION_MESHES] =
+	        model->mesh_count * sizeof( struct mesh_pack_mesh ),
+	    [MESH_PACK_SECTION_TEXTURES] =
+	        model->texture_count * sizeof( struct mesh_pack_texture ),
+	};
+
+	for ( uint32_t m = 0; m < model->mesh_count; ++m )
+	{
+		const struct ft_mesh* mesh = &model->meshes[ m ];
+
+		section_sizes[ MESH_PACK_SECTION_VERTICES ] +=
+		    ( uint64_t ) mesh->vertex_count * stride;
+
+		if ( mesh->indices_32 )
+		{
+			section_sizes[ MESH_PACK_SECTION_INDICES_32 ] +=
+			    ( uint64_t ) mesh->index_count * sizeof( uint32_t );
+		}
+		else if ( mesh->indices_16 )
+		{
+			section_sizes[ MESH_PACK_SECTION_INDICES_16 ] +=
+			    ( uint64_t ) mesh->index_count * sizeof( uint16_t );
+		}
+	}
+
+	// a texture sampled by several slots gets all their usage bits
+	uint32_t* usages = calloc( model->texture_count + 1, sizeof( uint32_t ) );
+
+	for ( uint32_t m = 0; m < model->mesh_count; ++m )
+	{
+		const struct ft_material* material = &model->meshes[ m ].material;
+
+		for ( uint32_t i = 0; i < FT_TEXTURE_TYPE_COUNT; ++i )
+		{
+			int32_t texture = material->textures[ i ];
+
+			if ( texture >= 0 && ( uint32_t ) texture < model->texture_count )
+			{
+				usages[ texture ] |= slot_usages[ i ];
+			}
+		}
+	}
+
+	for ( uint32_t t = 0; t < model->texture_count; ++t )
+	{
+		struct mesh_pack_texture layout;
+		enum texture_codec       codec =
+		    texture_codec_pick( usages[ t ],
+		                        texture_format == MESH_TEXTURE_FORMAT_BC );
+
+		uint64_t texture_size =
+		    layout_texture( &model->textures[ t ], codec, 0, &layout );
+
+		section_sizes[ MESH_PACK_SECTION_TEXELS ] +=
+		    align_up( texture_size, MESH_PACK_ALIGNMENT );
+	}
+
+	uint64_t offset = align_up( sizeof( header ), MESH_PACK_ALIGNMENT );
+
+	for ( uint32_t s = 0; s < MESH_PACK_SECTION_COUNT; ++s )
+	{
+		header.sections[ s ].offset = offset;
+		header.sections[ s ].size   = section_sizes[ s ];
+		offset = align_up( offset + section_sizes[ s ], MESH_PACK_ALIGNMENT );
+	}
+
+	header.file_size = offset;
+
+	// calloc keeps the padding between sections zeroed
+	uint8_t* pack = calloc( 1, ( size_t ) header.file_size );
+
+	if ( pack == NULL )
+	{
+		free( usages );
+		return NULL;
+	}
+
+	memcpy( pack, &header, sizeof( header ) );
+
+	struct mesh_pack_mesh* meshes =
+	    section_data( pack, &header, MESH_PACK_SECTION_MESHES );
+	uint8_t* vertices =
+	    section_data( pack, &header, MESH_PACK_SECTION_VERTICES );
+	uint16_t* indices_16 =
+	    section_data( pack, &header, MESH_PACK_SECTION_INDICES_16 );
+	uint32_t* indices_32 =
+	    section_data( pack, &header, MESH_PACK_SECTION_INDICES_32 );
+
+	uint32_t first_vertex   = 0;
+	uint32_t first_index_16 = 0;
+	uint32_t first_index_32 = 0;
+
+	for ( uint32_t m = 0; m < model->mesh_count; ++m )
+	{
+		const struct ft_mesh*  mesh = &model->meshes[ m ];
+		struct mesh_pack_mesh* dst  = &meshes[ m ];
+
+		memcpy( dst->world, mesh->world, sizeof( dst->world ) );
+		copy_material( &mesh->material, &dst->material );
+
+		dst->first_vertex = first_vertex;
+		dst->vertex_count = mesh->vertex_count;
+		dst->index_type   = MESH_PACK_INDEX_NONE;
+		compute_bounding_sphere( mesh, dst->bounds );
+
+		void* mesh_vertices = vertices + ( size_t ) first_vertex * stride;
+
+		if ( format == MESH_VERTEX_FORMAT_QUANTIZED )
+		{
+			compute_position_bounds( mesh,
+			                         dst->position_offset,
+			                         dst->position_scale );
+			quantize_vertices( mesh, dst, mesh_vertices );
+		}
+		else
+		{
+			dst->position_scale[ 0 ] = 1.0f;
+			dst->position_scale[ 1 ] = 1.0f;
+			dst->position_scale[ 2 ] = 1.0f;
+			interleave_vertices( mesh, mesh_vertices );
+		}
+		first_vertex += mesh->vertex_count;
+
+		if ( mesh->indices_32 )
+		{
+			dst->index_type  = MESH_PACK_INDEX_32;
+			dst->first_index = first_index_32;
+			dst->index_count = mesh->index_count;
+
+			memcpy( &indices_32[ first_index_32 ],
+			        mesh->indices_32,
+			        mesh->index_count * sizeof( uint32_t ) );
+			first_index_32 += mesh->index_count;
+		}
+		else if ( mesh->indices_16 )
+		{
+			dst->index_type  = MESH_PACK_INDEX_16;
+			dst->first_index = first_index_16;
+			dst->index_count = mesh->index_count;
+
+			memcpy( &indices_16[ first_index_16 ],
+			        mesh->indices_16,
+			        mesh->index_count * sizeof( uint16_t ) );
+			first_index_16 += mesh->index_count;
+		}
+	}
+
+	struct mesh_pack_texture* textures =
+	    section_data( pack, &header, MESH_PACK_SECTION_TEXTURES );
+
+	offset = header.sections[ MESH_PACK_SECTION_TEXELS ].offset;
+
+	for ( uint32_t t = 0; t < model->texture_count; ++t )
+	{
+		const struct ft_texture*  texture = &model->textures[ t ];
+		struct mesh_pack_texture* dst     = &textures[ t ];
+		enum texture_codec        codec =
+		    texture_codec_pick( usages[ t ],
+		                        texture_format == MESH_TEXTURE_FORMAT_BC );
+
+		offset += align_up( layout_texture( texture, codec, offset, dst ),
+		                    MESH_PACK_ALIGNMENT );
+
+		if ( texture->data )
+		{
+			cook_texture( texture, dst, usages[ t ], pack );
+		}
+	}
+
+	free( usages );
+
+	*size = ( size_t ) header.file_size;
+	return pack;
+}
+
+bool
+mesh_pack_save( const void* pack, size_t size, const char* filename )
+{
+	char tmp_filename[ 512 ];
+	snprintf( tmp_filename, sizeof( tmp_filename ), "%s.tmp", filename );
+
+	FILE* file = fopen( tmp_filename, "wb" );
+
+	if ( file == NULL )
+	{
+		return false;
+	}
+
+	bool ok = fwrite( pack, 1, size, file ) == size;
+	ok      = ( fclose( file ) == 0 ) && ok;
+
+	if ( ok )
+	{
+		remove( filename );
+		ok = rename( tmp_filename, filename ) == 0;
+	}
+
+	if ( !ok )
+	{
+		remove( tmp_filename );
+	}
+
+	return ok;
+}
+
+static bool
+range_valid( const struct mesh_pack_range* range, uint64_t file_size )
+{
+	return range->offset % MESH_PACK_ALIGNMENT == 0 &&
+	       range->offset <= file_size &&
+	       range->size <= file_size - range->offset;
+}
+
+static bool
+mesh_valid( const struct mesh_pack_header* header,
+            const struct mesh_pack_mesh*   mesh )
+{
+	const struct mesh_pack_range* sections = header->sections;
+
+	uint64_t vertex_capacity =
+	    sections[ MESH_PACK_SECTION_VERTICES ].size / header->vertex_stride;
+
+	if ( ( uint64_t ) mesh->first_vertex + mesh->vertex_count >
+	     vertex_capacity )
+	{
+		return false;
+	}
+
+	uint64_t index_capacity = 0;
+
+	switch ( mesh->index_type )
+	{
+	case MESH_PACK_INDEX_NONE:
+	{
+		break;
+	}
+	case MESH_PACK_INDEX_16:
+	{
+		index_capacity =
+		    sections[ MESH_PACK_SECTION_INDICES_16 ].size / sizeof( uint16_t );
+		break;
+	}
+	case MESH_PACK_INDEX_32:
+	{
+		index_capacity =
+		    sections[ MESH_PACK_SECTION_INDICES_32 ].size / sizeof( uint32_t );
+		break;
+	}
+	default: return false;
+	}
+
+	if ( mesh->index_type != MESH_PACK_INDEX_NONE &&
+	     ( uint64_t ) mesh->first_index + mesh->index_count > index_capacity )
+	{
+		return false;
+	}
+
+	for ( uint32_t i = 0; i < MESH_PACK_MAX_MATERIAL_TEXTURES; ++i )
+	{
+		int32_t texture = mesh->material.textures[ i ];
+
+		if ( texture < -1 || texture >= ( int32_t ) header->texture_count )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool
+texture_valid( const struct mesh_pack_header*  header,
+               const struct mesh_pack_texture* texture )
+{
+	const struct mesh_pack_range* texels =
+	    &header->sections[ MESH_PACK_SECTION_TEXELS ];
+
+	if ( texture->codec >= TEXTURE_CODEC_COUNT ||
+	     texture->level_count == 0 ||
+	     texture->level_count > MESH_PACK_MAX_TEXTURE_LEVELS )
+	{
+		return false;
+	}
+
+	for ( uint32_t l = 0; l < texture->level_count; ++l )
+	{
+		const struct mesh_pack_range* level = &texture->levels[ l ];
+
+		if ( level->offset < texels->offset ||
+		     level->offset > texels->offset + texels->size ||
+		     level->size > texels->offset + texels->size - level->offset ||
+		     level->size <
+		         texture_level_size( texture->codec,
+		                             texture_level_extent( texture->width, l ),
+		                             texture_level_extent( texture->height,
+		                                                   l ) ) )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+const struct mesh_pack_header*
+mesh_pack_open( const void* data, size_t size, uint64_t key )
+{
+	const struct mesh_pack_header* header = data;
+
+	if ( size < sizeof( *header ) || header->magic != MESH_PACK_MAGIC ||
+	     header->version != MESH_PACK_VERSION || header->key != key ||
+	     header->vertex_format >= MESH_VERTEX_FORMAT_COUNT ||
+	     header->texture_format >= MESH_TEXTURE_FORMAT_COUNT ||
+	     header->vertex_stride != mesh_vertex_stride( header->vertex_format ) ||
+	     header->file_size > size )
+	{
+		return NULL;
+	}
+
+	for ( uint32_t s = 0; s < MESH_PACK_SECTION_COUNT; ++s )
+	{
+		if ( !range_valid( &header->sections[ s ], header->file_size ) )
+		{
+			return NULL;
+		}
+	}
+
+	const struct mesh_pack_range* sections = header->sections;
+
+	if ( ( uint64_t ) header->mesh_count * sizeof( struct mesh_pack_mesh ) >
+	         sections[ MESH_PACK_SECTION_MESHES ].size ||
+	     ( uint64_t ) header->texture_count *
+	             sizeof( struct mesh_pack_texture ) >
+	         sections[ MESH_PACK_SECTION_TEXTURES ].size )
+	{
+		return NULL;
+	}
+
+	const struct mesh_pack_mesh* meshes = mesh_pack_meshes( header );
+
+	for ( uint32_t m = 0; m < header->mesh_count; ++m )
+	{
+		if ( !mesh_valid( header, &meshes[ m ] ) )
+		{
+			return NULL;
+		}
+	}
+
+	const struct mesh_pack_texture* textures = mesh_pack_textures( header );
+
+	for ( uint32_t t = 0; t < header->texture_count; ++t )
+	{
+		if ( !texture_valid( header, &textures[ t ] ) )
+		{
+			return NULL;
+		}
+	}
+
+	return header;
+}
+
+const void*
+mesh_pack_section_data( const struct mesh_pack_header* header,
+                        enum mesh_pack_section         section )
+{
+	return ( const uint8_t* ) header + header->sections[ section ].offset;
+}
+
+const struct mesh_pack_mesh*
+mesh_pack_meshes( const struct mesh_pack_header* header )
+{
+	return mesh_pack_section_data( header, MESH_PACK_SECTION_MESHES );
+}
+
+const struct mesh_pack_texture*
+mesh_pack_textures( const struct mesh_pack_header* header )
+{
+	return mesh_pack_section_data( header, MESH_PACK_SECTION_TEXTURES );
+}
+
+const void*
+mesh_pack_texels( const struct mesh_pack_header*  header,
+                  const struct mesh_pack_texture* texture,
+                  uint32_t                        level )
+{
+	return ( const uint8_t* ) header + texture->levels[ level ].offset;
+}
+
+uint64_t
+mesh_pack_texture_size( const struct mesh_pack_texture* texture )
+{
+	uint64_t size = 0;
+
+	for ( uint32_t l = 0; l < texture->level_count; ++l )
+	{
+		size += texture->levels[ l ].size;
+	}
+
+	return size;
+}
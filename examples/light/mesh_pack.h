@@ -0,0 +1,221 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ft_model;
+
+#define MESH_PACK_MAGIC     0x4B41504Du // "MPAK"
+#define MESH_PACK_VERSION   4
+#define MESH_PACK_ALIGNMENT 256
+
+// texture slots per material, at least FT_TEXTURE_TYPE_COUNT
+#define MESH_PACK_MAX_MATERIAL_TEXTURES 8
+
+// mip levels per texture, TEXTURE_MAX_LEVELS of the cooker
+#define MESH_PACK_MAX_TEXTURE_LEVELS 16
+
+// levels inside a texture start on whole bc blocks
+#define MESH_PACK_LEVEL_ALIGNMENT 16
+
+enum mesh_vertex_format
+{
+	MESH_VERTEX_FORMAT_FLOAT,
+	MESH_VERTEX_FORMAT_QUANTIZED,
+	MESH_VERTEX_FORMAT_COUNT,
+};
+
+// rgba8 keeps every texel as the gltf had it, bc picks a block format per
+// texture from the material slots that sample it. both store the whole
+// mip chain, nothing is generated on upload
+enum mesh_texture_format
+{
+	MESH_TEXTURE_FORMAT_RGBA8,
+	MESH_TEXTURE_FORMAT_BC,
+	MESH_TEXTURE_FORMAT_COUNT,
+};
+
+// the vertex layouts the main pass pipeline consumes, stored in the pack
+// exactly as they are uploaded
+struct mesh_vertex
+{
+	float position[ 3 ];
+	float normal[ 3 ];
+	float tangent[ 4 ];
+	float texcoord[ 2 ];
+};
+
+// position is unorm16 within the mesh bounds, dequantized with the mesh
+// position_offset and position_scale, w is 0 for a negative tangent sign.
+// normal and tangent are octahedral snorm16, texcoord is half float
+struct mesh_vertex_quantized
+{
+	uint16_t position[ 4 ];
+	int16_t  normal[ 2 ];
+	int16_t  tangent[ 2 ];
+	uint16_t texcoord[ 2 ];
+};
+
+enum mesh_pack_section
+{
+	MESH_PACK_SECTION_MESHES,
+	MESH_PACK_SECTION_TEXTURES,
+	MESH_PACK_SECTION_VERTICES,
+	MESH_PACK_SECTION_INDICES_16,
+	MESH_PACK_SECTION_INDICES_32,
+	MESH_PACK_SECTION_TEXELS,
+	MESH_PACK_SECTION_COUNT,
+};
+
+enum mesh_pack_index_type
+{
+	MESH_PACK_INDEX_NONE,
+	MESH_PACK_INDEX_16,
+	MESH_PACK_INDEX_32,
+};
+
+struct mesh_pack_range
+{
+	uint64_t offset;
+	uint64_t size;
+};
+
+// textures index the pack texture table, -1 marks an unused slot
+struct mesh_pack_material
+{
+	float   base_color_factor[ 4 ];
+	float   emissive_factor[ 4 ];
+	float   metallic_factor;
+	float   roughness_factor;
+	float   emissive_strength;
+	float   alpha_cutoff;
+	int32_t textures[ MESH_PACK_MAX_MATERIAL_TEXTURES ];
+};
+
+// first_vertex and first_index are element offsets into the vertex and
+// matching index section, so every mesh is one draw. the position offset
+// and scale are zero and one for float vertices. bounds is a sphere around
+// the positions in mesh space, center in xyz and radius in w
+struct mesh_pack_mesh
+{
+	float                     world[ 16 ];
+	float                     position_offset[ 4 ];
+	float                     position_scale[ 4 ];
+	float                     bounds[ 4 ];
+	uint32_t                  index_type;
+	uint32_t                  first_vertex;
+	uint32_t                  vertex_count;
+	uint32_t                  first_index;
+	uint32_t                  index_count;
+	uint32_t                  pad[ 3 ];
+	struct mesh_pack_material material;
+};
+
+// a texture and its level index the way ktx2 lays one out, codec is an
+// enum texture_codec. level 0 is the full size and every level after it
+// halves both extents down to 1x1
+struct mesh_pack_texture
+{
+	uint32_t               width;
+	uint32_t               height;
+	uint32_t               codec;
+	uint32_t               level_count;
+	struct mesh_pack_range levels[ MESH_PACK_MAX_TEXTURE_LEVELS ];
+};
+
+// every section starts on MESH_PACK_ALIGNMENT, so a mapped pack can be
+// handed to the uploader range by range without touching a vertex
+struct mesh_pack_header
+{
+	uint32_t               magic;
+	uint32_t               version;
+	uint64_t               key;
+	uint32_t               vertex_stride;
+	uint32_t               mesh_count;
+	uint32_t               texture_count;
+	uint32_t               vertex_format;
+	uint32_t               texture_format;
+	uint32_t               pad;
+	uint64_t               file_size;
+	struct mesh_pack_range sections[ MESH_PACK_SECTION_COUNT ];
+};
+
+uint32_t
+mesh_vertex_stride( enum mesh_vertex_format format );
+
+const char*
+mesh_vertex_format_name( enum mesh_vertex_format format );
+
+bool
+mesh_vertex_format_parse( const char* name, enum mesh_vertex_format* format );
+
+const char*
+mesh_texture_format_name( enum mesh_texture_format format );
+
+bool
+mesh_texture_format_parse( const char* name, enum mesh_texture_format* format );
+
+// cpu mirror of the decode in pbr.vert.glsl
+void
+mesh_vertex_dequantize( const struct mesh_vertex_quantized* src,
+                        const struct mesh_pack_mesh*        mesh,
+                        struct mesh_vertex*                 dst );
+
+// key of the gltf document a pack was cooked from. external buffers and
+// images are not hashed, delete the pack when only those change
+uint64_t
+mesh_pack_key( const void*              gltf,
+               size_t                   gltf_size,
+               enum mesh_vertex_format  format,
+               enum mesh_texture_format texture_format );
+
+// <name>.pack in the working directory for <dir>/<name>.gltf, with
+// .quantized and .bc ahead of the extension for those formats. shared by
+// light and the mesh-pack tool
+void
+mesh_pack_filename( const char*              gltf,
+                    enum mesh_vertex_format  format,
+                    enum mesh_texture_format texture_format,
+                    char*                    filename,
+                    size_t                   size );
+
+// interleaves a loaded model into a pack in memory, free the result with
+// free. textures get their mips built and encoded here, which is most of
+// the cook time for bc. animations have no place in the pack, animated
+// models should keep the gltf around and not save the pack
+void*
+mesh_pack_build( const struct ft_model*   model,
+                 uint64_t                 key,
+                 enum mesh_vertex_format  format,
+                 enum mesh_texture_format texture_format,
+                 size_t*                  size );
+
+// writes through a temporary file so an interrupted cook never leaves a
+// truncated pack behind
+bool
+mesh_pack_save( const void* pack, size_t size, const char* filename );
+
+// checks the header against key and every range against size, returns
+// NULL if the pack is stale or damaged
+const struct mesh_pack_header*
+mesh_pack_open( const void* data, size_t size, uint64_t key );
+
+const void*
+mesh_pack_section_data( const struct mesh_pack_header* header,
+                        enum mesh_pack_section         section );
+
+const struct mesh_pack_mesh*
+mesh_pack_meshes( const struct mesh_pack_header* header );
+
+const struct mesh_pack_texture*
+mesh_pack_textures( const struct mesh_pack_header* header );
+
+const void*
+mesh_pack_texels( const struct mesh_pack_header*  header,
+                  const struct mesh_pack_texture* texture,
+                  uint32_t                        level );
+
+// bytes of every level, what the texture takes in video memory
+uint64_t
+mesh_pack_texture_size( const struct mesh_pack_texture* texture );
@@ -0,0 +1,89 @@
+#include <fluent/fluent.h>
+
+#include "animation_set.h"
+#include "model_animation.h"
+
+#define NO_TARGET UINT32_MAX
+
+uint32_t
+model_animation_add( struct animation_set*  set,
+                     const struct ft_model* model,
+                     uint32_t               first_id,
+                     const float*           offset )
+{
+	if ( model->animation_count == 0 || model->mesh_count == 0 )
+	{
+		return 0;
+	}
+
+	uint32_t* targets = malloc( model->mesh_count * sizeof( uint32_t ) );
+	for ( uint32_t m = 0; m < model->mesh_count; ++m )
+	{
+		targets[ m ] = NO_TARGET;
+	}
+
+	uint32_t added = 0;
+
+	for ( uint32_t a = 0; a < model->animation_count; ++a )
+	{
+		const struct ft_animation* animation = &model->animations[ a ];
+		uint32_t                   clip      = animation_set_add_clip( set );
+
+		for ( uint32_t c = 0; c < animation->channel_count; ++c )
+		{
+			const struct ft_animation_channel* channel =
+			    &animation->channels[ c ];
+			const struct ft_animation_sampler* sampler = channel->sampler;
+
+			enum animation_path path;
+			switch ( channel->path )
+			{
+			case FT_ANIMATION_PATH_TRANSLATION:
+			{
+				path = ANIMATION_PATH_TRANSLATION;
+				break;
+			}
+			case FT_ANIMATION_PATH_ROTATION:
+			{
+				path = ANIMATION_PATH_ROTATION;
+				break;
+			}
+			case FT_ANIMATION_PATH_SCALE:
+			{
+				path = ANIMATION_PATH_SCALE;
+				break;
+			}
+			default: continue;
+			}
+
+			uint32_t mesh = channel->target;
+			if ( mesh >= model->mesh_count || sampler == NULL ||
+			     sampler->frame_count == 0 )
+			{
+				continue;
+			}
+
+			if ( targets[ mesh ] == NO_TARGET )
+			{
+				targets[ mesh ] =
+				    animation_set_add_target( set,
+				                              first_id + mesh,
+				                              model->meshes[ mesh ].world,
+				                              offset );
+				added++;
+			}
+
+			animation_set_add_channel( set,
+			                           clip,
+			                           targets[ mesh ],
+			                           path,
+			                           sampler->times,
+			                           sampler->values,
+			                           sampler->frame_count );
+		}
+	}
+
+	free( targets );
+
+	return added;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+struct animation_set;
+struct ft_model;
+
+// adds the meshes of model its animations move as targets of set, with a
+// clip per animation. mesh m writes its transform to id first_id + m and
+// is moved by offset, which may be NULL. returns how many targets were
+// added
+uint32_t
+model_animation_add( struct animation_set*  set,
+                     const struct ft_model* model,
+                     uint32_t               first_id,
+                     const float*           offset );
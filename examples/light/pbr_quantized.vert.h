@@ -0,0 +1,6 @@
+#pragma once
+
+extern unsigned char shader_pbr_quantized_vert_spirv[];
+extern unsigned int  shader_pbr_quantized_vert_spirv_len;
+
+FT_DECLARE_SHADER( pbr_quantized_vert );
@@ -0,0 +1,6 @@
+#pragma once
+
+extern unsigned char shader_pbr_sh_feedback_frag_spirv[];
+extern unsigned int  shader_pbr_sh_feedback_frag_spirv_len;
+
+FT_DECLARE_SHADER( pbr_sh_feedback_frag );
@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fluent/fluent.h>
+
+#include "fluent_features.h"
+#include "file_map.h"
+#include "pipeline_timer.h"
+
+#define PIPELINE_CACHE_MAGIC   0x4C505446u // "FTPL"
+#define PIPELINE_CACHE_VERSION 1
+
+// the header every vulkan pipeline cache blob starts with: its length,
+// version, vendor and device ids and the pipeline cache uuid
+#define PIPELINE_CACHE_BLOB_HEADER_SIZE 32
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME        0x100000001b3ull
+
+#define PIPELINE_CACHE_FILENAME_SIZE 256
+
+// blob_size bytes of ft_get_pipeline_cache_data follow the header
+struct pipeline_cache_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t blob_size;
+	uint64_t blob_hash;
+};
+
+#if LIGHT_FLUENT_PIPELINE_CACHE
+static struct
+{
+	struct ft_pipeline_cache* cache;
+	char                      filename[ PIPELINE_CACHE_FILENAME_SIZE ];
+} pipeline_cache;
+
+static uint64_t
+fnv1a( uint64_t hash, const void* data, size_t size )
+{
+	const uint8_t* bytes = data;
+
+	for ( size_t i = 0; i < size; ++i )
+	{
+		hash ^= bytes[ i ];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+// the blob of a cache with nothing in it is the header of this device
+// and driver, anything else was written by another one
+static bool
+blob_matches_device( const struct ft_device* device, const uint8_t* blob )
+{
+	struct ft_pipeline_cache_info info = { 0 };
+	struct ft_pipeline_cache*     empty;
+	ft_create_pipeline_cache( device, &info, &empty );
+
+	uint8_t header[ PIPELINE_CACHE_BLOB_HEADER_SIZE ];
+	size_t  size = 0;
+	ft_get_pipeline_cache_data( device, empty, &size, NULL );
+
+	bool matches = false;
+
+	if ( size >= sizeof( header ) )
+	{
+		uint8_t* data = malloc( size );
+
+		if ( data )
+		{
+			ft_get_pipeline_cache_data( device, empty, &size, data );
+			matches = memcmp( data, blob, sizeof( header ) ) == 0;
+			free( data );
+		}
+	}
+
+	ft_destroy_pipeline_cache( device, empty );
+
+	return matches;
+}
+
+// the blob of filename, NULL when it can not be used
+static const uint8_t*
+load_blob( const struct ft_device* device,
+           const struct file_map*  file,
+           size_t*                 size )
+{
+	const struct pipeline_cache_header* header = file->data;
+
+	if ( file->size < sizeof( *header ) ||
+	     header->magic != PIPELINE_CACHE_MAGIC ||
+	     header->version != PIPELINE_CACHE_VERSION ||
+	     header->blob_size != file->size - sizeof( *header ) ||
+	     header->blob_size < PIPELINE_CACHE_BLOB_HEADER_SIZE )
+	{
+		return NULL;
+	}
+
+	const uint8_t* blob = ( const uint8_t* ) ( header + 1 );
+
+	if ( fnv1a( FNV_OFFSET_BASIS, blob, header->blob_size ) !=
+	         header->blob_hash ||
+	     !blob_matches_device( device, blob ) )
+	{
+		return NULL;
+	}
+
+	*size = ( size_t ) header->blob_size;
+	return blob;
+}
+#endif
+
+void
+pipeline_timer_init( const struct ft_device* device, const char* filename )
+{
+#if LIGHT_FLUENT_PIPELINE_CACHE
+	snprintf( pipeline_cache.filename,
+	          sizeof( pipeline_cache.filename ),
+	          "%s",
+	          filename );
+
+	struct ft_pipeline_cache_info info = { 0 };
+	struct file_map               file;
+	bool                          mapped = file_map_open( filename, &file );
+
+	if ( mapped )
+	{
+		info.data = load_blob( device, &file, &info.data_size );
+
+		if ( info.data == NULL )
+		{
+			ft_log_warn( "pipeline cache %s is stale or corrupt, ignoring it",
+			             filename );
+		}
+	}
+
+	ft_create_pipeline_cache( device, &info, &pipeline_cache.cache );
+
+	ft_log_info( "pipeline cache %s: %llu bytes loaded",
+	             filename,
+	             ( unsigned long long ) info.data_size );
+
+	if ( mapped )
+	{
+		file_map_close( &file );
+	}
+#else
+	FT_UNUSED( device );
+	FT_UNUSED( filename );
+#endif
+}
+
+void
+pipeline_timer_shutdown( const struct ft_device* device )
+{
+#if LIGHT_FLUENT_PIPELINE_CACHE
+	if ( pipeline_cache.cache == NULL )
+	{
+		return;
+	}
+
+	size_t size = 0;
+	ft_get_pipeline_cache_data( device, pipeline_cache.cache, &size, NULL );
+
+	uint8_t* blob = malloc( size );
+
+	if ( blob )
+	{
+		ft_get_pipeline_cache_data( device, pipeline_cache.cache, &size, blob );
+
+		struct pipeline_cache_header header = {
+		    .magic     = PIPELINE_CACHE_MAGIC,
+		    .version   = PIPELINE_CACHE_VERSION,
+		    .blob_size = size,
+		    .blob_hash = fnv1a( FNV_OFFSET_BASIS, blob, size ),
+		};
+
+		// a temporary file first, an interrupted write never leaves a
+		// truncated cache behind
+		char tmp_filename[ PIPELINE_CACHE_FILENAME_SIZE + 4 ];
+		snprintf( tmp_filename,
+		          sizeof( tmp_filename ),
+		          "%s.tmp",
+		          pipeline_cache.filename );
+
+		FILE* file = fopen( tmp_filename, "wb" );
+		bool  ok   = file != NULL &&
+		          fwrite( &header, sizeof( header ), 1, file ) == 1 &&
+		          fwrite( blob, 1, size, file ) == size;
+
+		ok = file != NULL && fclose( file ) == 0 && ok;
+
+		if ( ok )
+		{
+			remove( pipeline_cache.filename );
+			ok = rename( tmp_filename, pipeline_cache.filename ) == 0;
+		}
+
+		if ( !ok )
+		{
+			remove( tmp_filename );
+			ft_log_warn( "could not write pipeline cache %s",
+			             pipeline_cache.filename );
+		}
+
+		free( blob );
+	}
+
+	ft_destroy_pipeline_cache( device, pipeline_cache.cache );
+	pipeline_cache.cache = NULL;
+#else
+	FT_UNUSED( device );
+#endif
+}
+
+void
+create_timed_pipeline( const struct ft_device*        device,
+                       const char*                    name,
+                       const struct ft_pipeline_info* info,
+                       struct ft_pipeline**           pipeline )
+{
+	struct ft_timer timer;
+	ft_timer_reset( &timer );
+
+#if LIGHT_FLUENT_PIPELINE_CACHE
+	// vulkan synchronizes the cache itself, pipelines of different threads
+	// can share it
+	struct ft_pipeline_info cached_info = *info;
+	cached_info.pipeline_cache          = pipeline_cache.cache;
+	ft_create_pipeline( device, &cached_info, pipeline );
+#else
+	ft_create_pipeline( device, info, pipeline );
+#endif
+
+	ft_log_info( "pipeline %s created in %llu ms",
+	             name,
+	             ( unsigned long long ) ft_timer_get_ticks( &timer ) );
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+struct ft_device;
+struct ft_pipeline_info;
+struct ft_pipeline;
+
+// ft_create_pipeline that logs how long the creation took. most of it is
+// the driver compiling shaders, which dominates startup on software
+// implementations such as lavapipe. with LIGHT_FLUENT_PIPELINE_CACHE every
+// pipeline goes through one pipeline cache, see pipeline_timer_init.
+// without it nothing is cached between runs unless the driver keeps a
+// cache of its own
+void
+create_timed_pipeline( const struct ft_device*        device,
+                       const char*                    name,
+                       const struct ft_pipeline_info* info,
+                       struct ft_pipeline**           pipeline );
+
+// creates the pipeline cache from filename. a file written for another
+// device or driver, which the pipeline cache uuid in the blob header tells
+// apart, or one that is truncated or fails its hash is ignored and the
+// cache starts empty. call before the first pipeline
+void
+pipeline_timer_init( const struct ft_device* device, const char* filename );
+
+// writes the cache back to the file it was loaded from and destroys it,
+// after the last pipeline
+void
+pipeline_timer_shutdown( const struct ft_device* device );
@@ -0,0 +1,405 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fluent/fluent.h>
+
+#include "frame_stats.h"
+#include "profiler.h"
+
+#define PROFILER_NO_SCOPE UINT32_MAX
+
+static const char* track_names[ PROFILER_TRACK_COUNT ] = {
+    [PROFILER_TRACK_CPU] = "cpu",
+    [PROFILER_TRACK_GPU] = "gpu",
+};
+
+struct profiler_data
+{
+	bool                   enabled;
+	struct profiler_frame* frame;
+	struct profiler_frame  current;
+	struct profiler_frame  startup;
+	uint32_t               stack[ PROFILER_MAX_DEPTH ];
+	uint32_t               stack_depth;
+
+	struct profiler_frame history[ PROFILER_HISTORY ];
+	uint32_t              history_count;
+	uint32_t              history_next;
+
+	const char*            trace_path;
+	uint32_t               trace_first;
+	uint32_t               trace_count;
+	uint32_t               trace_recorded;
+	bool                   trace_written;
+	struct profiler_frame* trace;
+};
+
+static struct profiler_data profiler_data = {
+    .frame = &profiler_data.startup,
+};
+
+void
+profiler_set_enabled( bool enabled )
+{
+	profiler_data.enabled = enabled;
+}
+
+bool
+profiler_enabled( void )
+{
+	return profiler_data.enabled;
+}
+
+void
+profiler_set_trace( const char* path,
+                    uint32_t    first_frame,
+                    uint32_t    frame_count )
+{
+	struct profiler_data* data = &profiler_data;
+
+	free( data->trace );
+	data->trace_path     = path;
+	data->trace_first    = first_frame;
+	data->trace_count    = frame_count;
+	data->trace_recorded = 0;
+	data->trace_written  = false;
+	data->trace = calloc( frame_count, sizeof( struct profiler_frame ) );
+}
+
+static void
+write_pending_trace( struct profiler_data* data )
+{
+	if ( data->trace_path == NULL || data->trace_written ||
+	     data->trace_recorded == 0 )
+	{
+		return;
+	}
+
+	data->trace_written = true;
+
+	if ( profiler_write_trace( data->trace_path ) )
+	{
+		ft_log_info( "wrote %u profiled frames to %s",
+		             data->trace_recorded,
+		             data->trace_path );
+	}
+	else
+	{
+		ft_log_error( "could not write %s", data->trace_path );
+	}
+}
+
+void
+profiler_shutdown( void )
+{
+	struct profiler_data* data = &profiler_data;
+
+	write_pending_trace( data );
+	free( data->trace );
+	memset( data, 0, sizeof( *data ) );
+	data->frame = &data->startup;
+}
+
+void
+profiler_begin_frame( uint32_t number )
+{
+	struct profiler_data* data = &profiler_data;
+
+	if ( !data->enabled )
+	{
+		return;
+	}
+
+	data->frame              = &data->current;
+	data->frame->number      = number;
+	data->frame->scope_count = 0;
+	data->stack_depth        = 0;
+}
+
+void
+profiler_end_frame( void )
+{
+	struct profiler_data*  data  = &profiler_data;
+	struct profiler_frame* frame = &data->current;
+
+	if ( !data->enabled || data->frame != frame )
+	{
+		return;
+	}
+
+	data->history[ data->history_next ] = *frame;
+	data->history_next = ( data->history_next + 1 ) % PROFILER_HISTORY;
+	if ( data->history_count < PROFILER_HISTORY )
+	{
+		data->history_count++;
+	}
+
+	if ( data->trace != NULL && frame->number >= data->trace_first &&
+	     data->trace_recorded < data->trace_count )
+	{
+		data->trace[ data->trace_recorded++ ] = *frame;
+
+		if ( data->trace_recorded == data->trace_count )
+		{
+			write_pending_trace( data );
+		}
+	}
+
+	data->frame = &data->startup;
+}
+
+static struct profiler_scope*
+add_scope( struct profiler_data* data, uint32_t* index )
+{
+	struct profiler_frame* frame = data->frame;
+
+	if ( frame->scope_count == PROFILER_MAX_SCOPES )
+	{
+		*index = PROFILER_NO_SCOPE;
+		return NULL;
+	}
+
+	*index = frame->scope_count++;
+	return &frame->scopes[ *index ];
+}
+
+void
+profiler_begin( const char* name )
+{
+	struct profiler_data* data = &profiler_data;
+
+	if ( !data->enabled )
+	{
+		return;
+	}
+
+	uint32_t               index;
+	struct profiler_scope* scope = add_scope( data, &index );
+
+	if ( scope != NULL )
+	{
+		scope->name     = name;
+		scope->track    = PROFILER_TRACK_CPU;
+		scope->depth    = data->stack_depth;
+		scope->begin_ns = frame_clock_ns();
+		scope->end_ns   = scope->begin_ns;
+	}
+
+	// scopes nested deeper than the stack are dropped, their parents still
+	// cover them
+	if ( data->stack_depth < PROFILER_MAX_DEPTH )
+	{
+		data->stack[ data->stack_depth ] = index;
+	}
+	data->stack_depth++;
+}
+
+void
+profiler_end( void )
+{
+	struct profiler_data* data = &profiler_data;
+
+	if ( !data->enabled || data->stack_depth == 0 )
+	{
+		return;
+	}
+
+	data->stack_depth--;
+
+	if ( data->stack_depth < PROFILER_MAX_DEPTH )
+	{
+		uint32_t index = data->stack[ data->stack_depth ];
+
+		if ( index != PROFILER_NO_SCOPE )
+		{
+			data->frame->scopes[ index ].end_ns = frame_clock_ns();
+		}
+	}
+}
+
+void
+profiler_gpu_span( const char* name, uint64_t begin_ns, uint64_t end_ns )
+{
+	struct profiler_data* data = &profiler_data;
+
+	if ( !data->enabled )
+	{
+		return;
+	}
+
+	uint32_t               index;
+	struct profiler_scope* scope = add_scope( data, &index );
+
+	if ( scope != NULL )
+	{
+		scope->name     = name;
+		scope->track    = PROFILER_TRACK_GPU;
+		scope->depth    = 0;
+		scope->begin_ns = begin_ns;
+		scope->end_ns   = end_ns;
+	}
+}
+
+static uint32_t
+find_row( struct profiler_row*         rows,
+          uint32_t*                    row_count,
+          uint32_t                     max_rows,
+          const struct profiler_scope* scope )
+{
+	for ( uint32_t r = 0; r < *row_count; ++r )
+	{
+		if ( rows[ r ].track == scope->track &&
+		     rows[ r ].depth == scope->depth &&
+		     strcmp( rows[ r ].name, scope->name ) == 0 )
+		{
+			return r;
+		}
+	}
+
+	if ( *row_count == max_rows )
+	{
+		return PROFILER_NO_SCOPE;
+	}
+
+	struct profiler_row* row = &rows[ ( *row_count )++ ];
+	row->name                = scope->name;
+	row->track               = scope->track;
+	row->depth               = scope->depth;
+	row->average_ms          = 0.0;
+	row->max_ms              = 0.0;
+
+	return *row_count - 1;
+}
+
+uint32_t
+profiler_get_breakdown( struct profiler_row* rows, uint32_t max_rows )
+{
+	const struct profiler_data* data = &profiler_data;
+
+	// the history is a ring, oldest is taken modulo its size below
+	uint32_t row_count = 0;
+	uint32_t oldest =
+	    data->history_next + PROFILER_HISTORY - data->history_count;
+
+	if ( max_rows > PROFILER_MAX_ROWS )
+	{
+		max_rows = PROFILER_MAX_ROWS;
+	}
+
+	for ( uint32_t f = 0; f < data->history_count; ++f )
+	{
+		const struct profiler_frame* frame =
+		    &data->history[ ( oldest + f ) % PROFILER_HISTORY ];
+
+		// a scope can run more than once a frame, the row takes the sum
+		double frame_ms[ PROFILER_MAX_ROWS ] = { 0 };
+
+		for ( uint32_t s = 0; s < frame->scope_count; ++s )
+		{
+			const struct profiler_scope* scope = &frame->scopes[ s ];
+			uint32_t r = find_row( rows, &row_count, max_rows, scope );
+
+			if ( r != PROFILER_NO_SCOPE )
+			{
+				frame_ms[ r ] +=
+				    ( double ) ( scope->end_ns - scope->begin_ns ) / 1e6;
+			}
+		}
+
+		for ( uint32_t r = 0; r < row_count; ++r )
+		{
+			rows[ r ].average_ms += frame_ms[ r ];
+			rows[ r ].max_ms = FT_MAX( rows[ r ].max_ms, frame_ms[ r ] );
+		}
+	}
+
+	for ( uint32_t r = 0; r < row_count; ++r )
+	{
+		rows[ r ].average_ms /= data->history_count;
+	}
+
+	return row_count;
+}
+
+static void
+write_frame_events( FILE*                        file,
+                    const struct profiler_frame* frame,
+                    uint64_t                     base_ns,
+                    const char*                  frame_name )
+{
+	for ( uint32_t s = 0; s < frame->scope_count; ++s )
+	{
+		const struct profiler_scope* scope = &frame->scopes[ s ];
+
+		fprintf( file,
+		         ",\n    {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", "
+		         "\"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %u, "
+		         "\"args\": {\"frame\": \"%s\"}}",
+		         scope->name,
+		         track_names[ scope->track ],
+		         ( double ) ( scope->begin_ns - base_ns ) / 1e3,
+		         ( double ) ( scope->end_ns - scope->begin_ns ) / 1e3,
+		         scope->track,
+		         frame_name );
+	}
+}
+
+// chrome trace event format, loads in chrome://tracing and perfetto. each
+// track is a thread of one process, timestamps are in microseconds from
+// the first recorded scope
+bool
+profiler_write_trace( const char* path )
+{
+	const struct profiler_data* data = &profiler_data;
+
+	FILE* file = fopen( path, "w" );
+
+	if ( file == NULL )
+	{
+		return false;
+	}
+
+	uint64_t base_ns = UINT64_MAX;
+
+	for ( uint32_t s = 0; s < data->startup.scope_count; ++s )
+	{
+		base_ns = FT_MIN( base_ns, data->startup.scopes[ s ].begin_ns );
+	}
+
+	for ( uint32_t f = 0; f < data->trace_recorded; ++f )
+	{
+		for ( uint32_t s = 0; s < data->trace[ f ].scope_count; ++s )
+		{
+			base_ns = FT_MIN( base_ns, data->trace[ f ].scopes[ s ].begin_ns );
+		}
+	}
+
+	fprintf( file, "{\n  \"displayTimeUnit\": \"ms\",\n" );
+	fprintf( file, "  \"traceEvents\": [" );
+
+	for ( uint32_t t = 0; t < PROFILER_TRACK_COUNT; ++t )
+	{
+		fprintf( file,
+		         "%s\n    {\"name\": \"thread_name\", \"ph\": \"M\", "
+		         "\"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+		         t == 0 ? "" : ",",
+		         t,
+		         track_names[ t ] );
+	}
+
+	write_frame_events( file, &data->startup, base_ns, "startup" );
+
+	for ( uint32_t f = 0; f < data->trace_recorded; ++f )
+	{
+		char frame_name[ 16 ];
+		snprintf( frame_name,
+		          sizeof( frame_name ),
+		          "%u",
+		          data->trace[ f ].number );
+		write_frame_events( file, &data->trace[ f ], base_ns, frame_name );
+	}
+
+	fprintf( file, "\n  ]\n}\n" );
+
+	return fclose( file ) == 0;
+}
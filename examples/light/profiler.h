@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PROFILER_MAX_SCOPES 48
+#define PROFILER_MAX_DEPTH  8
+#define PROFILER_HISTORY    60
+#define PROFILER_MAX_ROWS   32
+
+// gpu spans come from the timestamp queries of gpu_timer, read back
+// frames after they were recorded and placed on the cpu clock. they get a
+// track of their own next to the cpu scopes
+enum profiler_track
+{
+	PROFILER_TRACK_CPU,
+	PROFILER_TRACK_GPU,
+	PROFILER_TRACK_COUNT,
+};
+
+struct profiler_scope
+{
+	const char*         name;
+	enum profiler_track track;
+	uint32_t            depth;
+	uint64_t            begin_ns;
+	uint64_t            end_ns;
+};
+
+// every scope that ended between profiler_begin_frame and
+// profiler_end_frame. scopes recorded outside a frame, such as the ibl
+// bake, land in a startup frame that is written ahead of the others
+struct profiler_frame
+{
+	uint32_t              number;
+	uint32_t              scope_count;
+	struct profiler_scope scopes[ PROFILER_MAX_SCOPES ];
+};
+
+// one line of the frame breakdown, averaged over the last
+// PROFILER_HISTORY frames
+struct profiler_row
+{
+	const char*         name;
+	enum profiler_track track;
+	uint32_t            depth;
+	double              average_ms;
+	double              max_ms;
+};
+
+// nothing is recorded until the profiler is enabled. scopes must be
+// recorded from one thread at a time, the main thread while frames run
+void
+profiler_set_enabled( bool enabled );
+
+bool
+profiler_enabled( void );
+
+// frames [first_frame, first_frame + frame_count) are kept and written to
+// path as chrome trace json once the last of them ends, or at shutdown
+void
+profiler_set_trace( const char* path,
+                    uint32_t    first_frame,
+                    uint32_t    frame_count );
+
+void
+profiler_shutdown( void );
+
+void
+profiler_begin_frame( uint32_t number );
+
+void
+profiler_end_frame( void );
+
+// name must outlive the profiler, string literals in practice
+void
+profiler_begin( const char* name );
+
+void
+profiler_end( void );
+
+void
+profiler_gpu_span( const char* name, uint64_t begin_ns, uint64_t end_ns );
+
+// rows in the order their scopes first appear, returns the row count
+uint32_t
+profiler_get_breakdown( struct profiler_row* rows, uint32_t max_rows );
+
+bool
+profiler_write_trace( const char* path );
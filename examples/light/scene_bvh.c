@@ -0,0 +1,555 @@
+#include <float.h>
+#include <stdbool.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simd.h"
+#include "scene_bvh.h"
+
+// deepest the tree gets is about log8 of the object count, the stack holds
+// every lane pushed on the way down
+#define CULL_STACK_SIZE 512
+
+struct split_key
+{
+	float    centroid;
+	uint32_t object;
+};
+
+static inline bool
+split_key_less( const struct split_key* lhs, const struct split_key* rhs )
+{
+	if ( lhs->centroid != rhs->centroid )
+	{
+		return lhs->centroid < rhs->centroid;
+	}
+
+	return lhs->object < rhs->object;
+}
+
+static inline void
+swap_split_keys( struct split_key* a, struct split_key* b )
+{
+	struct split_key tmp = *a;
+	*a                   = *b;
+	*b                   = tmp;
+}
+
+// partially orders keys so the nth key is in place, every key before it
+// is smaller and every key after it is larger. a full sort is not needed
+// to split a range
+static void
+select_split_key( struct split_key* keys, uint32_t count, uint32_t nth )
+{
+	uint32_t low  = 0;
+	uint32_t high = count - 1;
+
+	while ( low < high )
+	{
+		// median of three pivot, moved to high
+		uint32_t middle = low + ( high - low ) / 2;
+		if ( split_key_less( &keys[ middle ], &keys[ low ] ) )
+		{
+			swap_split_keys( &keys[ middle ], &keys[ low ] );
+		}
+		if ( split_key_less( &keys[ high ], &keys[ low ] ) )
+		{
+			swap_split_keys( &keys[ high ], &keys[ low ] );
+		}
+		if ( split_key_less( &keys[ middle ], &keys[ high ] ) )
+		{
+			swap_split_keys( &keys[ middle ], &keys[ high ] );
+		}
+
+		uint32_t store = low;
+		for ( uint32_t i = low; i < high; ++i )
+		{
+			if ( split_key_less( &keys[ i ], &keys[ high ] ) )
+			{
+				swap_split_keys( &keys[ i ], &keys[ store++ ] );
+			}
+		}
+		swap_split_keys( &keys[ store ], &keys[ high ] );
+
+		if ( store == nth )
+		{
+			return;
+		}
+
+		if ( store < nth )
+		{
+			low = store + 1;
+		}
+		else
+		{
+			high = store - 1;
+		}
+	}
+}
+
+struct object_range
+{
+	uint32_t first;
+	uint32_t count;
+};
+
+// orders the range by centroid along the axis its centroids spread the
+// most on and splits it near the middle, on a multiple of the node width
+// so the nodes above the objects come out full
+static void
+split_range( struct scene_bvh*            bvh,
+             const struct scene_bvh_aabb* objects,
+             struct split_key*            keys,
+             struct object_range*         range,
+             struct object_range*         upper )
+{
+	float min[ 3 ] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float max[ 3 ] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for ( uint32_t i = 0; i < range->count; ++i )
+	{
+		const struct scene_bvh_aabb* aabb =
+		    &objects[ bvh->order[ range->first + i ] ];
+
+		for ( uint32_t a = 0; a < 3; ++a )
+		{
+			float centroid = aabb->min[ a ] + aabb->max[ a ];
+			min[ a ]       = fminf( min[ a ], centroid );
+			max[ a ]       = fmaxf( max[ a ], centroid );
+		}
+	}
+
+	uint32_t axis = 0;
+	for ( uint32_t a = 1; a < 3; ++a )
+	{
+		if ( max[ a ] - min[ a ] > max[ axis ] - min[ axis ] )
+		{
+			axis = a;
+		}
+	}
+
+	for ( uint32_t i = 0; i < range->count; ++i )
+	{
+		uint32_t object = bvh->order[ range->first + i ];
+
+		keys[ i ].centroid =
+		    objects[ object ].min[ axis ] + objects[ object ].max[ axis ];
+		keys[ i ].object = object;
+	}
+
+	uint32_t half = ( range->count / 2 + SCENE_BVH_WIDTH - 1 ) /
+	                SCENE_BVH_WIDTH * SCENE_BVH_WIDTH;
+	half          = half < range->count ? half : range->count / 2;
+
+	select_split_key( keys, range->count, half );
+
+	for ( uint32_t i = 0; i < range->count; ++i )
+	{
+		bvh->order[ range->first + i ] = keys[ i ].object;
+	}
+
+	upper->first = range->first + half;
+	upper->count = range->count - half;
+	range->count = half;
+}
+
+static uint32_t
+alloc_node( struct scene_bvh* bvh )
+{
+	if ( bvh->node_count == bvh->node_capacity )
+	{
+		bvh->node_capacity = bvh->node_capacity ? bvh->node_capacity * 2 : 64;
+
+		bvh->nodes = realloc( bvh->nodes,
+		                      bvh->node_capacity * sizeof( *bvh->nodes ) );
+	}
+
+	struct scene_bvh_node* node = &bvh->nodes[ bvh->node_count ];
+	memset( node, 0, sizeof( *node ) );
+
+	return bvh->node_count++;
+}
+
+// a node over a few objects holds them directly. otherwise the largest
+// range is split until the lanes are used up or every range fits in one
+// node, then the lanes' subtrees are built
+static void
+build_node( struct scene_bvh*            bvh,
+            const struct scene_bvh_aabb* objects,
+            struct split_key*            keys,
+            uint32_t                     index,
+            struct object_range          range )
+{
+	struct object_range ranges[ SCENE_BVH_WIDTH ];
+	uint32_t            range_count = 1;
+	ranges[ 0 ]                     = range;
+
+	if ( range.count <= SCENE_BVH_WIDTH )
+	{
+		for ( uint32_t i = 0; i < range.count; ++i )
+		{
+			ranges[ i ].first = range.first + i;
+			ranges[ i ].count = 1;
+		}
+		range_count = range.count;
+	}
+
+	while ( range_count < SCENE_BVH_WIDTH )
+	{
+		uint32_t largest = 0;
+		for ( uint32_t r = 1; r < range_count; ++r )
+		{
+			if ( ranges[ r ].count > ranges[ largest ].count )
+			{
+				largest = r;
+			}
+		}
+
+		if ( ranges[ largest ].count <= SCENE_BVH_WIDTH )
+		{
+			break;
+		}
+
+		split_range( bvh,
+		             objects,
+		             keys,
+		             &ranges[ largest ],
+		             &ranges[ range_count++ ] );
+	}
+
+	for ( uint32_t lane = 0; lane < range_count; ++lane )
+	{
+		uint32_t child = SCENE_BVH_LEAF;
+
+		if ( ranges[ lane ].count > 1 )
+		{
+			child = alloc_node( bvh );
+			build_node( bvh, objects, keys, child, ranges[ lane ] );
+		}
+
+		// alloc_node may have moved the nodes
+		struct scene_bvh_node* node = &bvh->nodes[ index ];
+		node->child[ lane ]         = child;
+		node->first[ lane ]         = ranges[ lane ].first;
+		node->count[ lane ]         = ranges[ lane ].count;
+	}
+}
+
+void
+scene_bvh_init( struct scene_bvh* bvh )
+{
+	memset( bvh, 0, sizeof( *bvh ) );
+}
+
+void
+scene_bvh_shutdown( struct scene_bvh* bvh )
+{
+	free( bvh->order );
+	free( bvh->nodes );
+	scene_bvh_init( bvh );
+}
+
+void
+scene_bvh_build( struct scene_bvh*            bvh,
+                 const struct scene_bvh_aabb* objects,
+                 uint32_t                     object_count )
+{
+	bvh->object_count = object_count;
+	bvh->node_count   = 0;
+
+	if ( object_count == 0 )
+	{
+		return;
+	}
+
+	bvh->order = realloc( bvh->order, object_count * sizeof( uint32_t ) );
+
+	for ( uint32_t i = 0; i < object_count; ++i )
+	{
+		bvh->order[ i ] = i;
+	}
+
+	struct split_key* keys = malloc( object_count * sizeof( *keys ) );
+
+	struct object_range range = { 0, object_count };
+	build_node( bvh, objects, keys, alloc_node( bvh ), range );
+
+	free( keys );
+
+	scene_bvh_refit( bvh, objects );
+}
+
+void
+scene_bvh_refit( struct scene_bvh*            bvh,
+                 const struct scene_bvh_aabb* objects )
+{
+	for ( uint32_t n = bvh->node_count; n-- > 0; )
+	{
+		struct scene_bvh_node* node = &bvh->nodes[ n ];
+
+		for ( uint32_t lane = 0; lane < SCENE_BVH_WIDTH; ++lane )
+		{
+			float min[ 3 ] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float max[ 3 ] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+			if ( node->count[ lane ] == 0 )
+			{
+				// culled by every plane whatever its center
+				for ( uint32_t a = 0; a < 3; ++a )
+				{
+					node->center[ a ][ lane ] = 0.0f;
+					node->extent[ a ][ lane ] = -FLT_MAX;
+				}
+				continue;
+			}
+
+			if ( node->child[ lane ] == SCENE_BVH_LEAF )
+			{
+				const struct scene_bvh_aabb* aabb =
+				    &objects[ bvh->order[ node->first[ lane ] ] ];
+
+				for ( uint32_t a = 0; a < 3; ++a )
+				{
+					min[ a ] = aabb->min[ a ];
+					max[ a ] = aabb->max[ a ];
+				}
+			}
+			else
+			{
+				// the child was refit already, it comes later in the array.
+				// its empty lanes have a negative extent that leaves the
+				// union as it is
+				const struct scene_bvh_node* child =
+				    &bvh->nodes[ node->child[ lane ] ];
+
+				for ( uint32_t a = 0; a < 3; ++a )
+				{
+					for ( uint32_t c = 0; c < SCENE_BVH_WIDTH; ++c )
+					{
+						float center = child->center[ a ][ c ];
+						float extent = child->extent[ a ][ c ];
+						float low    = center - extent;
+						float high   = center + extent;
+
+						min[ a ] = low < min[ a ] ? low : min[ a ];
+						max[ a ] = high > max[ a ] ? high : max[ a ];
+					}
+				}
+			}
+
+			for ( uint32_t a = 0; a < 3; ++a )
+			{
+				node->center[ a ][ lane ] = ( min[ a ] + max[ a ] ) * 0.5f;
+				node->extent[ a ][ lane ] = ( max[ a ] - min[ a ] ) * 0.5f;
+			}
+		}
+	}
+}
+
+uint32_t
+scene_bvh_cull( const struct scene_bvh*      bvh,
+                const float                  planes[ 6 ][ 4 ],
+                uint32_t*                    visible,
+                struct scene_bvh_cull_stats* stats )
+{
+	struct scene_bvh_cull_stats counters = { 0 };
+
+	if ( bvh->node_count == 0 )
+	{
+		if ( stats )
+		{
+			*stats = counters;
+		}
+		return 0;
+	}
+
+	simd_float normals[ 6 ][ 3 ];
+	simd_float abs_normals[ 6 ][ 3 ];
+	simd_float distances[ 6 ];
+
+	for ( uint32_t p = 0; p < 6; ++p )
+	{
+		for ( uint32_t a = 0; a < 3; ++a )
+		{
+			normals[ p ][ a ]     = simd_set1( planes[ p ][ a ] );
+			abs_normals[ p ][ a ] = simd_set1( fabsf( planes[ p ][ a ] ) );
+		}
+		distances[ p ] = simd_set1( planes[ p ][ 3 ] );
+	}
+
+	simd_float zero = simd_set1( 0.0f );
+
+	uint32_t stack[ CULL_STACK_SIZE ];
+	uint32_t stack_size    = 0;
+	uint32_t visible_count = 0;
+
+	stack[ stack_size++ ] = 0;
+
+	while ( stack_size != 0 )
+	{
+		const struct scene_bvh_node* node =
+		    &bvh->nodes[ stack[ --stack_size ] ];
+
+		uint32_t outside     = 0;
+		uint32_t intersected = 0;
+
+		// a lane is outside when its box is behind any plane and fully
+		// inside when it is in front of all of them
+		for ( uint32_t base = 0; base < SCENE_BVH_WIDTH; base += SIMD_WIDTH )
+		{
+			simd_float cx = simd_load( &node->center[ 0 ][ base ] );
+			simd_float cy = simd_load( &node->center[ 1 ][ base ] );
+			simd_float cz = simd_load( &node->center[ 2 ][ base ] );
+			simd_float ex = simd_load( &node->extent[ 0 ][ base ] );
+			simd_float ey = simd_load( &node->extent[ 1 ][ base ] );
+			simd_float ez = simd_load( &node->extent[ 2 ][ base ] );
+
+			simd_float out  = zero;
+			simd_float part = zero;
+
+			for ( uint32_t p = 0; p < 6; ++p )
+			{
+				// signed distance of the center and the box's reach
+				// towards the plane
+				simd_float d = distances[ p ];
+				d            = simd_madd( normals[ p ][ 0 ], cx, d );
+				d            = simd_madd( normals[ p ][ 1 ], cy, d );
+				d            = simd_madd( normals[ p ][ 2 ], cz, d );
+				simd_float r = simd_mul( abs_normals[ p ][ 0 ], ex );
+				r            = simd_madd( abs_normals[ p ][ 1 ], ey, r );
+				r            = simd_madd( abs_normals[ p ][ 2 ], ez, r );
+
+				out  = simd_or( out, simd_cmpgt( zero, simd_add( d, r ) ) );
+				part = simd_or( part, simd_cmpgt( zero, simd_sub( d, r ) ) );
+			}
+
+			outside |= ( uint32_t ) simd_movemask( out ) << base;
+			intersected |= ( uint32_t ) simd_movemask( part ) << base;
+		}
+
+		counters.nodes_visited++;
+
+		for ( uint32_t lane = 0; lane < SCENE_BVH_WIDTH; ++lane )
+		{
+			uint32_t count = node->count[ lane ];
+
+			if ( count == 0 )
+			{
+				continue;
+			}
+
+			counters.lanes_tested++;
+
+			if ( outside & ( 1u << lane ) )
+			{
+				continue;
+			}
+
+			if ( ( intersected & ( 1u << lane ) ) == 0 ||
+			     node->child[ lane ] == SCENE_BVH_LEAF )
+			{
+				// fully inside, the whole subtree is visible untested
+				memcpy( &visible[ visible_count ],
+				        &bvh->order[ node->first[ lane ] ],
+				        count * sizeof( uint32_t ) );
+				visible_count += count;
+				continue;
+			}
+
+			if ( stack_size < CULL_STACK_SIZE )
+			{
+				stack[ stack_size++ ] = node->child[ lane ];
+			}
+			else
+			{
+				// out of stack, keep the subtree rather than lose it
+				memcpy( &visible[ visible_count ],
+				        &bvh->order[ node->first[ lane ] ],
+				        count * sizeof( uint32_t ) );
+				visible_count += count;
+			}
+		}
+	}
+
+	counters.visible_count = visible_count;
+
+	if ( stats )
+	{
+		*stats = counters;
+	}
+
+	return visible_count;
+}
+
+void
+scene_bvh_frustum_planes( const float projection[ 4 ][ 4 ],
+                          const float view[ 4 ][ 4 ],
+                          float       planes[ 6 ][ 4 ] )
+{
+	float m[ 4 ][ 4 ];
+
+	for ( uint32_t c = 0; c < 4; ++c )
+	{
+		for ( uint32_t r = 0; r < 4; ++r )
+		{
+			m[ c ][ r ] = 0.0f;
+
+			for ( uint32_t k = 0; k < 4; ++k )
+			{
+				m[ c ][ r ] += projection[ k ][ r ] * view[ c ][ k ];
+			}
+		}
+	}
+
+	// left, right, bottom, top, near and far
+	for ( uint32_t p = 0; p < 6; ++p )
+	{
+		uint32_t row  = p / 2;
+		float    sign = ( p % 2 ) ? -1.0f : 1.0f;
+
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			planes[ p ][ c ] = m[ c ][ 3 ] + sign * m[ c ][ row ];
+		}
+
+		float length = sqrtf( planes[ p ][ 0 ] * planes[ p ][ 0 ] +
+		                      planes[ p ][ 1 ] * planes[ p ][ 1 ] +
+		                      planes[ p ][ 2 ] * planes[ p ][ 2 ] );
+		length       = fmaxf( length, 1e-6f );
+
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			planes[ p ][ c ] /= length;
+		}
+	}
+}
+
+void
+scene_bvh_sphere_aabb( const float            transform[ 4 ][ 4 ],
+                       const float            sphere[ 4 ],
+                       struct scene_bvh_aabb* aabb )
+{
+	// the radius grows with the largest axis scale of the transform
+	float scale = 0.0f;
+
+	for ( uint32_t c = 0; c < 3; ++c )
+	{
+		float length = sqrtf( transform[ c ][ 0 ] * transform[ c ][ 0 ] +
+		                      transform[ c ][ 1 ] * transform[ c ][ 1 ] +
+		                      transform[ c ][ 2 ] * transform[ c ][ 2 ] );
+		scale        = fmaxf( scale, length );
+	}
+
+	float radius = sphere[ 3 ] * scale;
+
+	for ( uint32_t a = 0; a < 3; ++a )
+	{
+		float center = transform[ 3 ][ a ] + transform[ 0 ][ a ] * sphere[ 0 ] +
+		               transform[ 1 ][ a ] * sphere[ 1 ] +
+		               transform[ 2 ][ a ] * sphere[ 2 ];
+
+		aabb->min[ a ] = center - radius;
+		aabb->max[ a ] = center + radius;
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+
+// children per node. a node's children are tested together, 8 at once
+// with AVX2 and in two halves with SSE2
+#define SCENE_BVH_WIDTH 8
+
+// child of a lane holding a single object instead of a node
+#define SCENE_BVH_LEAF UINT32_MAX
+
+struct scene_bvh_aabb
+{
+	float min[ 3 ];
+	float max[ 3 ];
+};
+
+// the lanes of a node are kept as center and half extent, one array per
+// axis so a plane is tested against every lane with a few vector ops.
+// first and count are the range of the lane's subtree in the object
+// order, an empty lane has a count of 0 and a negative extent
+struct scene_bvh_node
+{
+	float    center[ 3 ][ SCENE_BVH_WIDTH ];
+	float    extent[ 3 ][ SCENE_BVH_WIDTH ];
+	uint32_t child[ SCENE_BVH_WIDTH ];
+	uint32_t first[ SCENE_BVH_WIDTH ];
+	uint32_t count[ SCENE_BVH_WIDTH ];
+};
+
+// built top down over the object bounds by median splits along the
+// longest axis. children always come after their parent, so a refit is
+// one pass over the nodes in reverse
+struct scene_bvh
+{
+	uint32_t               object_count;
+	uint32_t*              order;
+	uint32_t               node_count;
+	uint32_t               node_capacity;
+	struct scene_bvh_node* nodes;
+};
+
+// counters of the last cull, for the benchmark
+struct scene_bvh_cull_stats
+{
+	uint32_t nodes_visited;
+	uint32_t lanes_tested;
+	uint32_t visible_count;
+};
+
+void
+scene_bvh_init( struct scene_bvh* bvh );
+
+void
+scene_bvh_shutdown( struct scene_bvh* bvh );
+
+// replaces the tree, the objects are indexed by their position in objects
+void
+scene_bvh_build( struct scene_bvh*            bvh,
+                 const struct scene_bvh_aabb* objects,
+                 uint32_t                     object_count );
+
+// refreshes every bound after objects moved, keeping the tree. the tree
+// gets looser the further objects move from where they were built
+void
+scene_bvh_refit( struct scene_bvh*            bvh,
+                 const struct scene_bvh_aabb* objects );
+
+// writes the index of every object whose box touches the frustum to
+// visible, which has room for every object, and returns how many there
+// are. planes point inwards as xyz normal and w distance
+uint32_t
+scene_bvh_cull( const struct scene_bvh*      bvh,
+                const float                  planes[ 6 ][ 4 ],
+                uint32_t*                    visible,
+                struct scene_bvh_cull_stats* stats );
+
+// planes of projection * view, both column major. the near plane is the
+// opengl one, which also holds every point in front of a zero to one near
+// plane, so a test stays conservative whichever depth range the camera
+// projects to
+void
+scene_bvh_frustum_planes( const float projection[ 4 ][ 4 ],
+                          const float view[ 4 ][ 4 ],
+                          float       planes[ 6 ][ 4 ] );
+
+// world bounds of a mesh space sphere under a column major transform
+void
+scene_bvh_sphere_aabb( const float            transform[ 4 ][ 4 ],
+                       const float            sphere[ 4 ],
+                       struct scene_bvh_aabb* aabb );
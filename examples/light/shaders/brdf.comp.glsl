@@ -2,7 +2,13 @@
 
 layout( local_size_x = 16, local_size_y = 16, local_size_z = 1 ) in;
 
-layout( set = 0, binding = 0, rgba32f ) uniform image2D u_dst;
+// storage format of the destination, compile_shaders.sh builds one
+// variant per supported ibl format
+#ifndef DST_FORMAT
+#define DST_FORMAT rg32f
+#endif
+
+layout( set = 0, binding = 0, DST_FORMAT ) uniform image2D u_dst;
 
 #define IMPORTANCE_SAMPLE_COUNT 64
 #define PI                      3.14159265359
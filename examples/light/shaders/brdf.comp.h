@@ -4,3 +4,13 @@ extern unsigned char shader_brdf_comp_spirv[];
 extern unsigned int  shader_brdf_comp_spirv_len;
 
 FT_DECLARE_SHADER( brdf_comp );
+
+extern unsigned char shader_brdf_rg16_comp_spirv[];
+extern unsigned int  shader_brdf_rg16_comp_spirv_len;
+
+FT_DECLARE_SHADER( brdf_rg16_comp );
+
+extern unsigned char shader_brdf_rg16f_comp_spirv[];
+extern unsigned int  shader_brdf_rg16f_comp_spirv_len;
+
+FT_DECLARE_SHADER( brdf_rg16f_comp );
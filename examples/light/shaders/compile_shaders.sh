@@ -2,22 +2,70 @@ glslangValidator -V brdf.comp.glsl -o shader_brdf_comp_spirv
 xxd -i shader_brdf_comp_spirv > shader_brdf_comp_spirv.c
 rm shader_brdf_comp_spirv
 
+glslangValidator -V -DDST_FORMAT=rg16 brdf.comp.glsl -o shader_brdf_rg16_comp_spirv
+xxd -i shader_brdf_rg16_comp_spirv > shader_brdf_rg16_comp_spirv.c
+rm shader_brdf_rg16_comp_spirv
+
+glslangValidator -V -DDST_FORMAT=rg16f brdf.comp.glsl -o shader_brdf_rg16f_comp_spirv
+xxd -i shader_brdf_rg16f_comp_spirv > shader_brdf_rg16f_comp_spirv.c
+rm shader_brdf_rg16f_comp_spirv
+
 glslangValidator -V eq_to_cubemap.comp.glsl -o shader_eq_to_cubemap_comp_spirv
 xxd -i shader_eq_to_cubemap_comp_spirv > shader_eq_to_cubemap_comp_spirv.c
 rm shader_eq_to_cubemap_comp_spirv
 
+glslangValidator -V -DDST_FORMAT=rgba16f eq_to_cubemap.comp.glsl -o shader_eq_to_cubemap_rgba16f_comp_spirv
+xxd -i shader_eq_to_cubemap_rgba16f_comp_spirv > shader_eq_to_cubemap_rgba16f_comp_spirv.c
+rm shader_eq_to_cubemap_rgba16f_comp_spirv
+
+glslangValidator -V -DDST_FORMAT=r11f_g11f_b10f eq_to_cubemap.comp.glsl -o shader_eq_to_cubemap_r11g11b10f_comp_spirv
+xxd -i shader_eq_to_cubemap_r11g11b10f_comp_spirv > shader_eq_to_cubemap_r11g11b10f_comp_spirv.c
+rm shader_eq_to_cubemap_r11g11b10f_comp_spirv
+
 glslangValidator -V irradiance.comp.glsl -o shader_irradiance_comp_spirv
 xxd -i shader_irradiance_comp_spirv > shader_irradiance_comp_spirv.c
 rm shader_irradiance_comp_spirv
 
+glslangValidator -V -DDST_FORMAT=rgba16f irradiance.comp.glsl -o shader_irradiance_rgba16f_comp_spirv
+xxd -i shader_irradiance_rgba16f_comp_spirv > shader_irradiance_rgba16f_comp_spirv.c
+rm shader_irradiance_rgba16f_comp_spirv
+
+glslangValidator -V -DDST_FORMAT=r11f_g11f_b10f irradiance.comp.glsl -o shader_irradiance_r11g11b10f_comp_spirv
+xxd -i shader_irradiance_r11g11b10f_comp_spirv > shader_irradiance_r11g11b10f_comp_spirv.c
+rm shader_irradiance_r11g11b10f_comp_spirv
+
 glslangValidator -V pbr.vert.glsl -o shader_pbr_vert_spirv
 xxd -i shader_pbr_vert_spirv > shader_pbr_vert_spirv.c
 rm shader_pbr_vert_spirv
 
+glslangValidator -V -DQUANTIZED_VERTEX pbr.vert.glsl -o shader_pbr_quantized_vert_spirv
+xxd -i shader_pbr_quantized_vert_spirv > shader_pbr_quantized_vert_spirv.c
+rm shader_pbr_quantized_vert_spirv
+
 glslangValidator -V pbr.frag.glsl -o shader_pbr_frag_spirv
 xxd -i shader_pbr_frag_spirv > shader_pbr_frag_spirv.c
 rm shader_pbr_frag_spirv
 
+glslangValidator -V -DIRRADIANCE_SH pbr.frag.glsl -o shader_pbr_sh_frag_spirv
+xxd -i shader_pbr_sh_frag_spirv > shader_pbr_sh_frag_spirv.c
+rm shader_pbr_sh_frag_spirv
+
+glslangValidator -V -DTEXTURE_FEEDBACK pbr.frag.glsl -o shader_pbr_feedback_frag_spirv
+xxd -i shader_pbr_feedback_frag_spirv > shader_pbr_feedback_frag_spirv.c
+rm shader_pbr_feedback_frag_spirv
+
+glslangValidator -V -DIRRADIANCE_SH -DTEXTURE_FEEDBACK pbr.frag.glsl -o shader_pbr_sh_feedback_frag_spirv
+xxd -i shader_pbr_sh_feedback_frag_spirv > shader_pbr_sh_feedback_frag_spirv.c
+rm shader_pbr_sh_feedback_frag_spirv
+
+glslangValidator -V -DPER_DRAW_TEXTURES pbr.frag.glsl -o shader_pbr_per_draw_frag_spirv
+xxd -i shader_pbr_per_draw_frag_spirv > shader_pbr_per_draw_frag_spirv.c
+rm shader_pbr_per_draw_frag_spirv
+
+glslangValidator -V -DIRRADIANCE_SH -DPER_DRAW_TEXTURES pbr.frag.glsl -o shader_pbr_sh_per_draw_frag_spirv
+xxd -i shader_pbr_sh_per_draw_frag_spirv > shader_pbr_sh_per_draw_frag_spirv.c
+rm shader_pbr_sh_per_draw_frag_spirv
+
 glslangValidator -V skybox.frag.glsl -o shader_skybox_frag_spirv
 xxd -i shader_skybox_frag_spirv > shader_skybox_frag_spirv.c
 rm shader_skybox_frag_spirv
@@ -29,3 +77,47 @@ rm shader_skybox_vert_spirv
 glslangValidator -V specular.comp.glsl -o shader_specular_comp_spirv
 xxd -i shader_specular_comp_spirv > shader_specular_comp_spirv.c
 rm shader_specular_comp_spirv
+
+glslangValidator -V -DDST_FORMAT=rgba16f specular.comp.glsl -o shader_specular_rgba16f_comp_spirv
+xxd -i shader_specular_rgba16f_comp_spirv > shader_specular_rgba16f_comp_spirv.c
+rm shader_specular_rgba16f_comp_spirv
+
+glslangValidator -V -DDST_FORMAT=r11f_g11f_b10f specular.comp.glsl -o shader_specular_r11g11b10f_comp_spirv
+xxd -i shader_specular_r11g11b10f_comp_spirv > shader_specular_r11g11b10f_comp_spirv.c
+rm shader_specular_r11g11b10f_comp_spirv
+
+glslangValidator -V sh_project.comp.glsl -o shader_sh_project_comp_spirv
+xxd -i shader_sh_project_comp_spirv > shader_sh_project_comp_spirv.c
+rm shader_sh_project_comp_spirv
+
+glslangValidator -V readback.comp.glsl -o shader_cube_readback_comp_spirv
+xxd -i shader_cube_readback_comp_spirv > shader_cube_readback_comp_spirv.c
+rm shader_cube_readback_comp_spirv
+
+glslangValidator -V -DSRC_FORMAT=rgba16f -DPACK_RGBA16F readback.comp.glsl -o shader_cube_readback_rgba16f_comp_spirv
+xxd -i shader_cube_readback_rgba16f_comp_spirv > shader_cube_readback_rgba16f_comp_spirv.c
+rm shader_cube_readback_rgba16f_comp_spirv
+
+glslangValidator -V -DSRC_FORMAT=r11f_g11f_b10f -DPACK_R11G11B10F readback.comp.glsl -o shader_cube_readback_r11g11b10f_comp_spirv
+xxd -i shader_cube_readback_r11g11b10f_comp_spirv > shader_cube_readback_r11g11b10f_comp_spirv.c
+rm shader_cube_readback_r11g11b10f_comp_spirv
+
+glslangValidator -V -DREADBACK_2D readback.comp.glsl -o shader_lut_readback_comp_spirv
+xxd -i shader_lut_readback_comp_spirv > shader_lut_readback_comp_spirv.c
+rm shader_lut_readback_comp_spirv
+
+glslangValidator -V -DREADBACK_2D -DSRC_FORMAT=rg16 -DPACK_RG16 readback.comp.glsl -o shader_lut_readback_rg16_comp_spirv
+xxd -i shader_lut_readback_rg16_comp_spirv > shader_lut_readback_rg16_comp_spirv.c
+rm shader_lut_readback_rg16_comp_spirv
+
+glslangValidator -V -DREADBACK_2D -DSRC_FORMAT=rg16f -DPACK_RG16F readback.comp.glsl -o shader_lut_readback_rg16f_comp_spirv
+xxd -i shader_lut_readback_rg16f_comp_spirv > shader_lut_readback_rg16f_comp_spirv.c
+rm shader_lut_readback_rg16f_comp_spirv
+
+glslangValidator -V cull.comp.glsl -o shader_cull_comp_spirv
+xxd -i shader_cull_comp_spirv > shader_cull_comp_spirv.c
+rm shader_cull_comp_spirv
+
+glslangValidator -V frame_readback.comp.glsl -o shader_frame_readback_comp_spirv
+xxd -i shader_frame_readback_comp_spirv > shader_frame_readback_comp_spirv.c
+rm shader_frame_readback_comp_spirv
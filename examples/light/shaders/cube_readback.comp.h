@@ -0,0 +1,16 @@
+#pragma once
+
+extern unsigned char shader_cube_readback_comp_spirv[];
+extern unsigned int  shader_cube_readback_comp_spirv_len;
+
+FT_DECLARE_SHADER( cube_readback_comp );
+
+extern unsigned char shader_cube_readback_rgba16f_comp_spirv[];
+extern unsigned int  shader_cube_readback_rgba16f_comp_spirv_len;
+
+FT_DECLARE_SHADER( cube_readback_rgba16f_comp );
+
+extern unsigned char shader_cube_readback_r11g11b10f_comp_spirv[];
+extern unsigned int  shader_cube_readback_r11g11b10f_comp_spirv_len;
+
+FT_DECLARE_SHADER( cube_readback_r11g11b10f_comp );
@@ -0,0 +1,152 @@
+#version 460
+
+// frustum culling of the pbr draws. the clear pass empties the commands
+// and counters of this frame, the cull pass tests every draw's bounding
+// sphere and appends the draws that survive to their batch's range of the
+// output commands. the rest of each range is left with no instances. an
+// instance group is kept or culled as a whole
+
+#define CULL_PASS_CLEAR 0
+#define CULL_PASS_CULL  1
+
+layout( local_size_x = 64 ) in;
+
+struct Instance
+{
+	mat4 transform;
+	uint draw;
+	uint pad0;
+	uint pad1;
+	uint pad2;
+};
+
+struct DrawCommand
+{
+	uint index_count;
+	uint instance_count;
+	uint first_index;
+	int  vertex_offset;
+	uint first_instance;
+};
+
+// output is the first command of the batch the command belongs to
+struct CullCommand
+{
+	DrawCommand command;
+	uint        batch;
+	uint        output;
+	uint        pad;
+};
+
+layout( push_constant ) uniform constants
+{
+	vec4 planes[ 6 ];
+	uint pass;
+	uint command_count;
+	uint batch_count;
+	uint count_offset;
+}
+pc;
+
+layout( std430, set = 0, binding = 0 ) readonly buffer u_instances
+{
+	Instance instances[];
+}
+instances;
+
+// the mesh sphere of a draw with one instance, a world sphere around every
+// instance of a group
+
+layout( std430, set = 0, binding = 1 ) readonly buffer u_bounds
+{
+	vec4 spheres[];
+}
+bounds;
+
+layout( std430, set = 0, binding = 2 ) readonly buffer u_cull_commands
+{
+	CullCommand commands[];
+}
+input_commands;
+
+layout( std430, set = 0, binding = 3 ) writeonly buffer u_draw_commands
+{
+	DrawCommand commands[];
+}
+output_commands;
+
+// counts[ count_offset ] is the visible total of the frame, the batch
+// counters follow it
+layout( std430, set = 0, binding = 4 ) buffer u_cull_counts
+{
+	uint counts[];
+}
+cull_counts;
+
+bool
+sphere_visible( vec3 center, float radius )
+{
+	for ( int i = 0; i < 6; ++i )
+	{
+		if ( dot( pc.planes[ i ].xyz, center ) + pc.planes[ i ].w < -radius )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void
+main()
+{
+	uint id = gl_GlobalInvocationID.x;
+
+	if ( pc.pass == CULL_PASS_CLEAR )
+	{
+		if ( id < pc.command_count )
+		{
+			output_commands.commands[ id ] = DrawCommand( 0, 0, 0, 0, 0 );
+		}
+
+		if ( id <= pc.batch_count )
+		{
+			cull_counts.counts[ pc.count_offset + id ] = 0;
+		}
+
+		return;
+	}
+
+	if ( id >= pc.command_count )
+	{
+		return;
+	}
+
+	CullCommand cull     = input_commands.commands[ id ];
+	Instance    instance = instances.instances[ cull.command.first_instance ];
+	vec4        sphere   = bounds.spheres[ instance.draw ];
+	vec3        center   = sphere.xyz;
+	float       radius   = sphere.w;
+
+	// the sphere is scaled by the largest axis of the transform so it
+	// still covers the mesh under non uniform scale
+	if ( cull.command.instance_count == 1 )
+	{
+		mat4 transform = instance.transform;
+		center         = ( transform * vec4( sphere.xyz, 1.0 ) ).xyz;
+		radius *= max( length( transform[ 0 ].xyz ),
+		               max( length( transform[ 1 ].xyz ),
+		                    length( transform[ 2 ].xyz ) ) );
+	}
+
+	if ( !sphere_visible( center, radius ) )
+	{
+		return;
+	}
+
+	uint slot =
+	    atomicAdd( cull_counts.counts[ pc.count_offset + 1 + cull.batch ], 1 );
+	atomicAdd( cull_counts.counts[ pc.count_offset ], 1 );
+
+	output_commands.commands[ cull.output + slot ] = cull.command;
+}
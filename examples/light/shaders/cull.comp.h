@@ -0,0 +1,6 @@
+#pragma once
+
+extern unsigned char shader_cull_comp_spirv[];
+extern unsigned int  shader_cull_comp_spirv_len;
+
+FT_DECLARE_SHADER( cull_comp );
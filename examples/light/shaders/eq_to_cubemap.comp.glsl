@@ -11,7 +11,13 @@ pc;
 
 layout( set = 0, binding = 0 ) uniform sampler u_sampler;
 layout( set = 0, binding = 1 ) uniform texture2D u_src;
-layout( set = 0, binding = 2, rgba32f ) uniform image2DArray u_dst;
+// storage format of the destination, compile_shaders.sh builds one
+// variant per supported ibl format
+#ifndef DST_FORMAT
+#define DST_FORMAT rgba32f
+#endif
+
+layout( set = 0, binding = 2, DST_FORMAT ) uniform image2DArray u_dst;
 
 void main()
 {
@@ -4,3 +4,13 @@ extern unsigned char shader_eq_to_cubemap_comp_spirv[];
 extern unsigned int  shader_eq_to_cubemap_comp_spirv_len;
 
 FT_DECLARE_SHADER( eq_to_cubemap_comp );
+
+extern unsigned char shader_eq_to_cubemap_rgba16f_comp_spirv[];
+extern unsigned int  shader_eq_to_cubemap_rgba16f_comp_spirv_len;
+
+FT_DECLARE_SHADER( eq_to_cubemap_rgba16f_comp );
+
+extern unsigned char shader_eq_to_cubemap_r11g11b10f_comp_spirv[];
+extern unsigned int  shader_eq_to_cubemap_r11g11b10f_comp_spirv_len;
+
+FT_DECLARE_SHADER( eq_to_cubemap_r11g11b10f_comp );
@@ -0,0 +1,51 @@
+#version 460
+
+// copies a rendered frame into a buffer as rgba8 with srgb encoding, one
+// word per pixel. the frame is fetched through a sampler, so srgb targets
+// come back linear and are encoded again here
+
+layout( local_size_x = 16, local_size_y = 16, local_size_z = 1 ) in;
+
+layout( push_constant ) uniform constants
+{
+	uint width;
+	uint height;
+	uint srgb;
+}
+pc;
+
+layout( set = 0, binding = 0 ) uniform sampler u_sampler;
+layout( set = 0, binding = 1 ) uniform texture2D u_frame;
+
+layout( std430, set = 0, binding = 2 ) writeonly buffer u_dst
+{
+	uint words[];
+}
+dst;
+
+vec3
+linear_to_srgb( vec3 c )
+{
+	vec3 low  = c * 12.92;
+	vec3 high = 1.055 * pow( c, vec3( 1.0 / 2.4 ) ) - 0.055;
+	return mix( low, high, greaterThan( c, vec3( 0.0031308 ) ) );
+}
+
+void
+main()
+{
+	uvec2 pos = gl_GlobalInvocationID.xy;
+
+	if ( pos.x >= pc.width || pos.y >= pc.height )
+		return;
+
+	vec4 texel =
+	    texelFetch( sampler2D( u_frame, u_sampler ), ivec2( pos ), 0 );
+
+	if ( pc.srgb != 0 )
+	{
+		texel.rgb = linear_to_srgb( clamp( texel.rgb, 0.0, 1.0 ) );
+	}
+
+	dst.words[ pos.y * pc.width + pos.x ] = packUnorm4x8( texel );
+}
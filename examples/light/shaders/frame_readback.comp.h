@@ -0,0 +1,6 @@
+#pragma once
+
+extern unsigned char shader_frame_readback_comp_spirv[];
+extern unsigned int  shader_frame_readback_comp_spirv_len;
+
+FT_DECLARE_SHADER( frame_readback_comp );
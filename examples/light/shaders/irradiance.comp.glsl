@@ -7,7 +7,13 @@ layout( local_size_x = 16, local_size_y = 16, local_size_z = 1 ) in;
 
 layout( set = 0, binding = 0 ) uniform sampler u_sampler;
 layout( set = 0, binding = 1 ) uniform textureCube u_src;
-layout( set = 0, binding = 2, rgba32f ) uniform image2DArray u_dst;
+// storage format of the destination, compile_shaders.sh builds one
+// variant per supported ibl format
+#ifndef DST_FORMAT
+#define DST_FORMAT rgba32f
+#endif
+
+layout( set = 0, binding = 2, DST_FORMAT ) uniform image2DArray u_dst;
 
 vec4
 compute_irradiance( vec3 n )
@@ -46,10 +52,7 @@ compute_irradiance( vec3 n )
 void
 main()
 {
-	vec3 thread_pos   = vec3( gl_GlobalInvocationID );
-	uint pixel_offset = 0;
-
-	for ( uint i = 0; i < thread_pos.z; ++i ) { pixel_offset += 32 * 32; }
+	vec3 thread_pos = vec3( gl_GlobalInvocationID );
 
 	vec2 texcoords = vec2( float( thread_pos.x + 0.5 ) / 32.0f,
 	                       float( thread_pos.y + 0.5 ) / 32.0f );
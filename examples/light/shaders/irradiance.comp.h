@@ -4,3 +4,13 @@ extern unsigned char shader_irradiance_comp_spirv[];
 extern unsigned int  shader_irradiance_comp_spirv_len;
 
 FT_DECLARE_SHADER( irradiance_comp );
+
+extern unsigned char shader_irradiance_rgba16f_comp_spirv[];
+extern unsigned int  shader_irradiance_rgba16f_comp_spirv_len;
+
+FT_DECLARE_SHADER( irradiance_rgba16f_comp );
+
+extern unsigned char shader_irradiance_r11g11b10f_comp_spirv[];
+extern unsigned int  shader_irradiance_r11g11b10f_comp_spirv_len;
+
+FT_DECLARE_SHADER( irradiance_r11g11b10f_comp );
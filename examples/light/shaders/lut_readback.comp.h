@@ -0,0 +1,16 @@
+#pragma once
+
+extern unsigned char shader_lut_readback_comp_spirv[];
+extern unsigned int  shader_lut_readback_comp_spirv_len;
+
+FT_DECLARE_SHADER( lut_readback_comp );
+
+extern unsigned char shader_lut_readback_rg16_comp_spirv[];
+extern unsigned int  shader_lut_readback_rg16_comp_spirv_len;
+
+FT_DECLARE_SHADER( lut_readback_rg16_comp );
+
+extern unsigned char shader_lut_readback_rg16f_comp_spirv[];
+extern unsigned int  shader_lut_readback_rg16f_comp_spirv_len;
+
+FT_DECLARE_SHADER( lut_readback_rg16f_comp );
@@ -1,10 +1,14 @@
 #version 460
+#ifndef PER_DRAW_TEXTURES
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
 
 layout( location = 0 ) in vec3 in_normal;
 layout( location = 1 ) in vec2 in_tex_coord;
 layout( location = 2 ) in vec3 in_frag_pos;
 layout( location = 3 ) in vec3 in_view_pos;
 layout( location = 4 ) in mat3 in_tbn;
+layout( location = 7 ) flat in uint in_draw_id;
 
 layout( location = 0 ) out vec4 out_color;
 
@@ -33,18 +37,52 @@ layout( std140, set = 0, binding = 2 ) readonly buffer u_materials
 materials;
 
 layout( set = 0, binding = 3 ) uniform texture2D u_brdf_lut;
+#ifdef IRRADIANCE_SH
+layout( set = 0, binding = 4 ) uniform u_irradiance_sh
+{
+	vec4 coefficients[ 9 ];
+}
+irradiance_sh;
+#else
 layout( set = 0, binding = 4 ) uniform textureCube u_irradiance_map;
+#endif
 layout( set = 0, binding = 5 ) uniform textureCube u_specular_map;
 
-layout( push_constant ) uniform constants
+#ifdef PER_DRAW_TEXTURES
+// only the textures of the draw's material, in the order of its texture
+// fields, for devices without non-uniform indexing. main_pass.c binds a
+// set per material around every draw, so the array is only ever indexed
+// with constants. matches FT_TEXTURE_TYPE_COUNT
+#define MATERIAL_TEXTURE_COUNT 5
+layout( set = 1, binding = 0 ) uniform sampler u_sampler;
+layout( set = 1, binding = 1 ) uniform texture2D
+    u_textures[ MATERIAL_TEXTURE_COUNT ];
+
+#define SAMPLE_MATERIAL_TEXTURE( index, slot )                                \
+	texture( sampler2D( u_textures[ slot ], u_sampler ), in_tex_coord )
+#else
+// every texture of the scene, the materials hold indices into it. draws of
+// one multi draw can land in the same subgroup, so the index is not
+// uniform. matches MAX_SCENE_TEXTURE_COUNT in main_pass.c
+#define SCENE_TEXTURE_COUNT 512
+layout( set = 1, binding = 0 ) uniform sampler u_sampler;
+layout( set = 1,
+        binding = 1 ) uniform texture2D u_textures[ SCENE_TEXTURE_COUNT ];
+
+#ifdef TEXTURE_FEEDBACK
+// the finest level each texture was sampled at this frame, floor( lod )
+// plus FEEDBACK_LOD_BIAS relative to the levels that are bound. main_pass.c
+// fills it with ~0 and streams in what it asks for, see texture_stream.h.
+// only the progressive streaming variant writes it, storing from the
+// fragment stage needs fragmentStoresAndAtomics
+#define FEEDBACK_LOD_BIAS 16
+layout( std430, set = 1, binding = 2 ) buffer u_texture_feedback
 {
-	uint instance_id; // DirectX12 compatibility
+	uint lods[ SCENE_TEXTURE_COUNT ];
 }
-pc;
-
-#define TEXTURE_COUNT 5
-layout( set = 1, binding = 0 ) uniform sampler u_sampler;
-layout( set = 1, binding = 1 ) uniform texture2D u_textures[ TEXTURE_COUNT ];
+feedback;
+#endif
+#endif
 
 const float PI = 3.14159265359;
 
@@ -59,6 +97,49 @@ const Light lights[ LIGHT_COUNT ] = {
     { vec3( 100.0 ), vec3( -5.0, 2.0, 0.0 ) },
 };
 
+#ifndef PER_DRAW_TEXTURES
+#ifdef TEXTURE_FEEDBACK
+// one pixel of every 4x4 writes, that is enough to see the finest level a
+// texture is sampled at and keeps the atomics off the hot path. the
+// derivatives are taken before the branch so the whole quad has them
+void
+record_texture_lod( int index )
+{
+	vec2 dx = dFdx( in_tex_coord );
+	vec2 dy = dFdy( in_tex_coord );
+
+	uvec2 pixel = uvec2( gl_FragCoord.xy );
+	if ( ( ( pixel.x | pixel.y ) & 3u ) != 0u )
+	{
+		return;
+	}
+
+	vec2 size = vec2( textureSize(
+	    sampler2D( u_textures[ nonuniformEXT( index ) ], u_sampler ),
+	    0 ) );
+	float rho = max( dot( dx * size, dx * size ), dot( dy * size, dy * size ) );
+	float lod = 0.5 * log2( max( rho, 1e-6 ) );
+
+	atomicMin( feedback.lods[ index ],
+	           uint( clamp( floor( lod ) + FEEDBACK_LOD_BIAS, 0.0, 31.0 ) ) );
+}
+#else
+#define record_texture_lod( index )
+#endif
+
+vec4
+sample_material_texture( int index )
+{
+	record_texture_lod( index );
+
+	return texture(
+	    sampler2D( u_textures[ nonuniformEXT( index ) ], u_sampler ),
+	    in_tex_coord );
+}
+
+#define SAMPLE_MATERIAL_TEXTURE( index, slot ) sample_material_texture( index )
+#endif
+
 vec4
 srgb_to_linear( vec4 c )
 {
@@ -113,17 +194,34 @@ geometry_smith( float ndotv, float ndotl, float roughness )
 	return ggx1 * ggx2;
 }
 
+#ifdef IRRADIANCE_SH
+// coefficients already hold the basis constants and the cosine lobe
+// convolution, see sh_project.comp.glsl
+vec3
+irradiance_sh_eval( vec3 n )
+{
+	vec4 c[ 9 ] = irradiance_sh.coefficients;
+
+	vec3 e = c[ 0 ].rgb;
+	e += c[ 1 ].rgb * n.y + c[ 2 ].rgb * n.z + c[ 3 ].rgb * n.x;
+	e += c[ 4 ].rgb * ( n.x * n.y ) + c[ 5 ].rgb * ( n.y * n.z );
+	e += c[ 6 ].rgb * ( 3.0 * n.z * n.z - 1.0 );
+	e += c[ 7 ].rgb * ( n.x * n.z ) + c[ 8 ].rgb * ( n.x * n.x - n.y * n.y );
+
+	return max( e, vec3( 0.0 ) );
+}
+#endif
+
 void
 main()
 {
-	Material mat = materials.materials[ pc.instance_id ];
+	Material mat = materials.materials[ in_draw_id ];
 
 	vec4 base_color = mat.base_color_factor;
 	if ( mat.base_color_texture != -1 )
 	{
-		base_color = srgb_to_linear( texture(
-		    sampler2D( u_textures[ mat.base_color_texture ], u_sampler ),
-		    in_tex_coord ) );
+		base_color = srgb_to_linear(
+		    SAMPLE_MATERIAL_TEXTURE( mat.base_color_texture, 0 ) );
 	}
 
 	if ( base_color.a < mat.alpha_cutoff )
@@ -134,11 +232,10 @@ main()
 	vec3 n = in_normal;
 	if ( mat.normal_texture != -1 )
 	{
-		n = texture( sampler2D( u_textures[ mat.normal_texture ], u_sampler ),
-		             in_tex_coord )
-		        .rgb;
-		n.z = sqrt( 1.0 - dot( n.xy, n.xy ) );
-		n   = in_tbn * ( n * 2.0 - 1.0 );
+		// z is rebuilt from xy, bc5 normal maps only store those two
+		n.xy = SAMPLE_MATERIAL_TEXTURE( mat.normal_texture, 1 ).rg * 2.0 - 1.0;
+		n.z  = sqrt( max( 1.0 - dot( n.xy, n.xy ), 0.0 ) );
+		n    = in_tbn * n;
 	}
 	n = normalize( n );
 
@@ -147,10 +244,7 @@ main()
 	if ( mat.metallic_roughness_texture != -1 )
 	{
 		vec3 metallic_roughness =
-		    texture( sampler2D( u_textures[ mat.metallic_roughness_texture ],
-		                        u_sampler ),
-		             in_tex_coord )
-		        .rgb;
+		    SAMPLE_MATERIAL_TEXTURE( mat.metallic_roughness_texture, 3 ).rgb;
 		metallic  = metallic_roughness.b * metallic;
 		roughness = metallic_roughness.g * roughness;
 	}
@@ -201,8 +295,12 @@ main()
 	vec3 kd = 1.0 - ks;
 	kd *= 1.0 - metallic;
 
+#ifdef IRRADIANCE_SH
+	vec3 irradiance = irradiance_sh_eval( n );
+#else
 	vec3 irradiance =
 	    texture( samplerCube( u_irradiance_map, u_sampler ), n ).rgb;
+#endif
 	vec3 diffuse = irradiance * base_color.rgb;
 
 	const float MAX_REFLECTION_LOD = 4.0;
@@ -223,10 +321,7 @@ main()
 	if ( mat.ambient_occlusion_texture != -1 )
 	{
 		float ao =
-		    texture( sampler2D( u_textures[ mat.ambient_occlusion_texture ],
-		                        u_sampler ),
-		             in_tex_coord )
-		        .r;
+		    SAMPLE_MATERIAL_TEXTURE( mat.ambient_occlusion_texture, 2 ).r;
 		color = mix( color, color * ao, 1.0 ); // TODO:
 	}
 
@@ -234,10 +329,7 @@ main()
 	if ( mat.emissive_texture != -1 )
 	{
 		emissive_factor =
-		    srgb_to_linear(
-		        texture(
-		            sampler2D( u_textures[ mat.emissive_texture ], u_sampler ),
-		            in_tex_coord ) )
+		    srgb_to_linear( SAMPLE_MATERIAL_TEXTURE( mat.emissive_texture, 4 ) )
 		        .rgb;
 	}
 
@@ -8,33 +8,84 @@ layout( set = 0, binding = 0 ) uniform ubo
 }
 u;
 
-layout( std140, set = 0, binding = 1 ) readonly buffer u_transforms
+// draw is where the mesh and material data of the instance are
+struct Instance
 {
-	mat4 transforms[];
+	mat4 transform;
+	uint draw;
+	uint pad0;
+	uint pad1;
+	uint pad2;
+};
+
+layout( std140, set = 0, binding = 1 ) readonly buffer u_instances
+{
+	Instance instances[];
 }
-transforms;
+instances;
 
-layout( push_constant ) uniform constants
+// position_offset and position_scale dequantize quantized vertices
+struct Draw
 {
-	uint instance_id; // DirectX12 compatibility
+	vec4 position_offset;
+	vec4 position_scale;
+};
+
+layout( std140, set = 0, binding = 6 ) readonly buffer u_draws
+{
+	Draw draws[];
 }
-pc;
+draws;
+
+#ifdef QUANTIZED_VERTEX
+// unorm16 position within the mesh bounds with the tangent sign in w,
+// octahedral snorm16 normal and tangent, half float texcoord
+layout( location = 0 ) in vec4 in_quantized_position;
+layout( location = 1 ) in vec2 in_oct_normal;
+layout( location = 2 ) in vec2 in_oct_tangent;
+layout( location = 3 ) in vec2 in_texcoord;
 
+vec3
+oct_decode( vec2 e )
+{
+	vec3  v = vec3( e, 1.0 - abs( e.x ) - abs( e.y ) );
+	float t = max( -v.z, 0.0 );
+	v.x += v.x >= 0.0 ? -t : t;
+	v.y += v.y >= 0.0 ? -t : t;
+	return normalize( v );
+}
+#else
 layout( location = 0 ) in vec3 in_position;
 layout( location = 1 ) in vec3 in_normal;
 layout( location = 2 ) in vec4 in_tangent;
 layout( location = 3 ) in vec2 in_texcoord;
+#endif
 
 layout( location = 0 ) out vec3 out_normal;
 layout( location = 1 ) out vec2 out_tex_coord;
 layout( location = 2 ) out vec3 out_frag_pos;
 layout( location = 3 ) out vec3 out_view_pos;
 layout( location = 4 ) out mat3 out_tbn;
+layout( location = 7 ) flat out uint out_draw_id;
 
 void
 main()
 {
-	mat4 transform     = transforms.transforms[ pc.instance_id ];
+	// the first instance of the draw command is the first instance of the
+	// draw, vulkan adds it to gl_InstanceIndex
+	Instance instance = instances.instances[ gl_InstanceIndex ];
+	uint     draw_id  = instance.draw;
+	Draw     draw     = draws.draws[ draw_id ];
+
+#ifdef QUANTIZED_VERTEX
+	vec3 in_position = draw.position_offset.xyz +
+	                   in_quantized_position.xyz * draw.position_scale.xyz;
+	vec3 in_normal  = oct_decode( in_oct_normal );
+	vec4 in_tangent = vec4( oct_decode( in_oct_tangent ),
+	                        in_quantized_position.w > 0.5 ? 1.0 : -1.0 );
+#endif
+
+	mat4 transform     = instance.transform;
 	mat3 normal_matrix = mat3( transform );
 
 	vec3 T = normalize( vec3( transform * vec4( in_tangent.xyz, 0.0 ) ) );
@@ -47,6 +98,7 @@ main()
 	out_frag_pos  = ( transform * vec4( in_position, 1.0 ) ).xyz;
 	out_view_pos  = u.view_pos.xyz;
 	out_tbn       = mat3( T, B, N );
+	out_draw_id   = draw_id;
 
 	gl_Position = u.projection * u.view * transform * vec4( in_position, 1.0 );
 }
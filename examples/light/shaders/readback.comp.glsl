@@ -0,0 +1,85 @@
+#version 460
+
+layout( local_size_x = 16, local_size_y = 16, local_size_z = 1 ) in;
+
+layout( push_constant ) uniform constants
+{
+	uint mip_size;
+	uint layer;
+}
+pc;
+
+// SRC_FORMAT selects the storage format of the image, the texels are
+// written out bit exact in that format
+#ifdef READBACK_2D
+#ifndef SRC_FORMAT
+#define SRC_FORMAT rg32f
+#endif
+layout( set = 0, binding = 0, SRC_FORMAT ) uniform readonly image2D u_src;
+#else
+#ifndef SRC_FORMAT
+#define SRC_FORMAT rgba32f
+#endif
+layout( set = 0, binding = 0, SRC_FORMAT ) uniform readonly image2DArray u_src;
+#endif
+
+#if defined( PACK_RGBA16F )
+#define TEXEL_WORDS 2
+#elif defined( PACK_R11G11B10F ) || defined( PACK_RG16 ) ||                   \
+    defined( PACK_RG16F )
+#define TEXEL_WORDS 1
+#elif defined( READBACK_2D )
+#define TEXEL_WORDS 2
+#else
+#define TEXEL_WORDS 4
+#endif
+
+layout( std430, set = 0, binding = 1 ) writeonly buffer u_dst
+{
+	uint words[];
+}
+dst;
+
+// the stored value is already representable, so dropping the low half
+// float mantissa bits is exact
+uint
+pack_r11g11b10f( vec3 c )
+{
+	uint r = ( packHalf2x16( vec2( c.r, 0.0 ) ) >> 4 ) & 0x7FFu;
+	uint g = ( packHalf2x16( vec2( c.g, 0.0 ) ) >> 4 ) & 0x7FFu;
+	uint b = ( packHalf2x16( vec2( c.b, 0.0 ) ) >> 5 ) & 0x3FFu;
+	return r | ( g << 11 ) | ( b << 22 );
+}
+
+void
+main()
+{
+	uvec2 thread_pos = uvec2( gl_GlobalInvocationID.xy );
+
+	if ( thread_pos.x >= pc.mip_size || thread_pos.y >= pc.mip_size )
+		return;
+
+#ifdef READBACK_2D
+	vec4 texel = imageLoad( u_src, ivec2( thread_pos ) );
+#else
+	vec4 texel = imageLoad( u_src, ivec3( thread_pos, pc.layer ) );
+#endif
+
+	uint index = ( thread_pos.y * pc.mip_size + thread_pos.x ) * TEXEL_WORDS;
+
+#if defined( PACK_RGBA16F )
+	dst.words[ index + 0 ] = packHalf2x16( texel.rg );
+	dst.words[ index + 1 ] = packHalf2x16( texel.ba );
+#elif defined( PACK_R11G11B10F )
+	dst.words[ index ] = pack_r11g11b10f( texel.rgb );
+#elif defined( PACK_RG16 )
+	dst.words[ index ] = packUnorm2x16( texel.rg );
+#elif defined( PACK_RG16F )
+	dst.words[ index ] = packHalf2x16( texel.rg );
+#else
+	for ( uint i = 0; i < TEXEL_WORDS; ++i )
+	{
+		dst.words[ index + i ] = floatBitsToUint( texel[ i ] );
+	}
+#endif
+}
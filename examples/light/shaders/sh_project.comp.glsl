@@ -0,0 +1,140 @@
+#version 460
+
+#define PI         3.14159265359
+#define GROUP_SIZE 64
+#define SH_COUNT   9
+
+layout( local_size_x = GROUP_SIZE, local_size_y = 1, local_size_z = 1 ) in;
+
+layout( set = 0, binding = 0 ) uniform sampler u_sampler;
+layout( set = 0, binding = 1 ) uniform textureCube u_src;
+layout( std430, set = 0, binding = 2 ) writeonly buffer u_dst
+{
+	vec4 coefficients[ SH_COUNT ];
+}
+dst;
+
+layout( push_constant ) uniform constants
+{
+	uint mip;
+	uint mip_size;
+}
+pc;
+
+// 9 * 64 * 16 bytes, well under the 16384 every device guarantees
+shared vec4 partial_sums[ SH_COUNT ][ GROUP_SIZE ];
+
+vec3
+face_direction( uint face, vec2 uv )
+{
+	uv -= 0.5;
+
+	if ( face == 0 )
+		return normalize( vec3( 0.5, -uv.y, -uv.x ) );
+	else if ( face == 1 )
+		return normalize( vec3( -0.5, -uv.y, uv.x ) );
+	else if ( face == 2 )
+		return normalize( vec3( uv.x, 0.5, uv.y ) );
+	else if ( face == 3 )
+		return normalize( vec3( uv.x, -0.5, -uv.y ) );
+	else if ( face == 4 )
+		return normalize( vec3( uv.x, -uv.y, 0.5 ) );
+
+	return normalize( vec3( -uv.x, -uv.y, -0.5 ) );
+}
+
+void
+main()
+{
+	uint tid         = gl_LocalInvocationIndex;
+	uint face_size   = pc.mip_size * pc.mip_size;
+	uint texel_count = 6 * face_size;
+
+	vec3  sums[ SH_COUNT ];
+	float weight_sum = 0.0;
+
+	for ( uint i = 0; i < SH_COUNT; ++i ) { sums[ i ] = vec3( 0.0 ); }
+
+	for ( uint i = tid; i < texel_count; i += GROUP_SIZE )
+	{
+		uint face  = i / face_size;
+		uint texel = i % face_size;
+
+		vec2 uv =
+		    ( vec2( texel % pc.mip_size, texel / pc.mip_size ) + 0.5 ) /
+		    float( pc.mip_size );
+
+		// solid angle of the texel, the sum is renormalized to 4pi below
+		vec2  st     = uv * 2.0 - 1.0;
+		float d      = 1.0 + dot( st, st );
+		float weight = 4.0 / ( d * sqrt( d ) );
+
+		vec3 n = face_direction( face, uv );
+		vec3 l = textureLod( samplerCube( u_src, u_sampler ),
+		                     n,
+		                     float( pc.mip ) )
+		             .rgb *
+		         weight;
+
+		sums[ 0 ] += l * 0.282095;
+		sums[ 1 ] += l * 0.488603 * n.y;
+		sums[ 2 ] += l * 0.488603 * n.z;
+		sums[ 3 ] += l * 0.488603 * n.x;
+		sums[ 4 ] += l * 1.092548 * n.x * n.y;
+		sums[ 5 ] += l * 1.092548 * n.y * n.z;
+		sums[ 6 ] += l * 0.315392 * ( 3.0 * n.z * n.z - 1.0 );
+		sums[ 7 ] += l * 1.092548 * n.x * n.z;
+		sums[ 8 ] += l * 0.546274 * ( n.x * n.x - n.y * n.y );
+		weight_sum += weight;
+	}
+
+	for ( uint i = 0; i < SH_COUNT; ++i )
+	{
+		partial_sums[ i ][ tid ] = vec4( sums[ i ], i == 0 ? weight_sum : 0.0 );
+	}
+
+	barrier();
+
+	for ( uint stride = GROUP_SIZE / 2; stride > 0; stride /= 2 )
+	{
+		if ( tid < stride )
+		{
+			for ( uint i = 0; i < SH_COUNT; ++i )
+			{
+				partial_sums[ i ][ tid ] += partial_sums[ i ][ tid + stride ];
+			}
+		}
+		barrier();
+	}
+
+	if ( tid < SH_COUNT )
+	{
+		// radiance -> irradiance / pi, the cosine lobe convolution folded
+		// together with the basis constants used by pbr.frag.glsl
+		const float band_scale[ SH_COUNT ] = { 1.0,
+		                                       2.0 / 3.0,
+		                                       2.0 / 3.0,
+		                                       2.0 / 3.0,
+		                                       0.25,
+		                                       0.25,
+		                                       0.25,
+		                                       0.25,
+		                                       0.25 };
+		const float basis_scale[ SH_COUNT ] = { 0.282095,
+		                                        0.488603,
+		                                        0.488603,
+		                                        0.488603,
+		                                        1.092548,
+		                                        1.092548,
+		                                        0.315392,
+		                                        1.092548,
+		                                        0.546274 };
+
+		float normalization = 4.0 * PI / partial_sums[ 0 ][ 0 ].w;
+
+		dst.coefficients[ tid ] =
+		    vec4( partial_sums[ tid ][ 0 ].rgb * normalization *
+		              band_scale[ tid ] * basis_scale[ tid ],
+		          0.0 );
+	}
+}
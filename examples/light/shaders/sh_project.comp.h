@@ -0,0 +1,6 @@
+#pragma once
+
+extern unsigned char shader_sh_project_comp_spirv[];
+extern unsigned int  shader_sh_project_comp_spirv_len;
+
+FT_DECLARE_SHADER( sh_project_comp );
@@ -4,7 +4,13 @@ layout( local_size_x = 16, local_size_y = 16, local_size_z = 1 ) in;
 
 layout( set = 0, binding = 0 ) uniform sampler u_sampler;
 layout( set = 0, binding = 1 ) uniform textureCube u_src;
-layout( set = 0, binding = 2, rgba32f ) uniform image2DArray u_dst;
+// storage format of the destination, compile_shaders.sh builds one
+// variant per supported ibl format
+#ifndef DST_FORMAT
+#define DST_FORMAT rgba32f
+#endif
+
+layout( set = 0, binding = 2, DST_FORMAT ) uniform image2DArray u_dst;
 
 #define IMPORTANCE_SAMPLE_COUNT 64
 #define PI                      3.14159265359
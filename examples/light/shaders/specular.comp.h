@@ -4,3 +4,13 @@ extern unsigned char shader_specular_comp_spirv[];
 extern unsigned int  shader_specular_comp_spirv_len;
 
 FT_DECLARE_SHADER( specular_comp );
+
+extern unsigned char shader_specular_rgba16f_comp_spirv[];
+extern unsigned int  shader_specular_rgba16f_comp_spirv_len;
+
+FT_DECLARE_SHADER( specular_rgba16f_comp );
+
+extern unsigned char shader_specular_r11g11b10f_comp_spirv[];
+extern unsigned int  shader_specular_r11g11b10f_comp_spirv_len;
+
+FT_DECLARE_SHADER( specular_r11g11b10f_comp );
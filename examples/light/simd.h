@@ -0,0 +1,82 @@
+#pragma once
+
+// minimal float vector wrapper, AVX2 when the compiler targets it, SSE2 on
+// any x64 build and a one lane scalar fallback everywhere else. masks come
+// from simd_cmpgt, simd_movemask turns one into a bit per lane
+
+#if defined( __AVX2__ )
+
+#include <immintrin.h>
+
+#define SIMD_WIDTH 8
+
+typedef __m256 simd_float;
+
+#define simd_set1( x )            _mm256_set1_ps( x )
+#define simd_load( p )            _mm256_loadu_ps( p )
+#define simd_store( p, v )        _mm256_storeu_ps( p, v )
+#define simd_add( a, b )          _mm256_add_ps( a, b )
+#define simd_sub( a, b )          _mm256_sub_ps( a, b )
+#define simd_mul( a, b )          _mm256_mul_ps( a, b )
+#define simd_div( a, b )          _mm256_div_ps( a, b )
+#define simd_min( a, b )          _mm256_min_ps( a, b )
+#define simd_max( a, b )          _mm256_max_ps( a, b )
+#define simd_sqrt( a )            _mm256_sqrt_ps( a )
+#define simd_cmpgt( a, b )        _mm256_cmp_ps( a, b, _CMP_GT_OQ )
+#define simd_select( mask, a, b ) _mm256_blendv_ps( b, a, mask )
+#define simd_or( a, b )           _mm256_or_ps( a, b )
+#define simd_abs( a )             _mm256_andnot_ps( _mm256_set1_ps( -0.0f ), a )
+#define simd_movemask( mask )     _mm256_movemask_ps( mask )
+
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+
+#include <emmintrin.h>
+
+#define SIMD_WIDTH 4
+
+typedef __m128 simd_float;
+
+#define simd_set1( x )     _mm_set1_ps( x )
+#define simd_load( p )     _mm_loadu_ps( p )
+#define simd_store( p, v ) _mm_storeu_ps( p, v )
+#define simd_add( a, b )   _mm_add_ps( a, b )
+#define simd_sub( a, b )   _mm_sub_ps( a, b )
+#define simd_mul( a, b )   _mm_mul_ps( a, b )
+#define simd_div( a, b )   _mm_div_ps( a, b )
+#define simd_min( a, b )   _mm_min_ps( a, b )
+#define simd_max( a, b )   _mm_max_ps( a, b )
+#define simd_sqrt( a )     _mm_sqrt_ps( a )
+#define simd_cmpgt( a, b ) _mm_cmpgt_ps( a, b )
+#define simd_select( mask, a, b )                                              \
+	_mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) )
+#define simd_or( a, b )       _mm_or_ps( a, b )
+#define simd_abs( a )         _mm_andnot_ps( _mm_set1_ps( -0.0f ), a )
+#define simd_movemask( mask ) _mm_movemask_ps( mask )
+
+#else
+
+#include <math.h>
+
+#define SIMD_WIDTH 1
+
+typedef float simd_float;
+
+#define simd_set1( x )            ( x )
+#define simd_load( p )            ( *( p ) )
+#define simd_store( p, v )        ( *( p ) = ( v ) )
+#define simd_add( a, b )          ( ( a ) + ( b ) )
+#define simd_sub( a, b )          ( ( a ) - ( b ) )
+#define simd_mul( a, b )          ( ( a ) * ( b ) )
+#define simd_div( a, b )          ( ( a ) / ( b ) )
+#define simd_min( a, b )          fminf( a, b )
+#define simd_max( a, b )          fmaxf( a, b )
+#define simd_sqrt( a )            sqrtf( a )
+#define simd_cmpgt( a, b )        ( ( a ) > ( b ) ? 1.0f : 0.0f )
+#define simd_select( mask, a, b ) ( ( mask ) != 0.0f ? ( a ) : ( b ) )
+#define simd_or( a, b )           fmaxf( a, b )
+#define simd_abs( a )             fabsf( a )
+#define simd_movemask( mask )     ( ( mask ) != 0.0f ? 1 : 0 )
+
+#endif
+
+#define simd_madd( a, b, c ) simd_add( simd_mul( a, b ), c )
@@ -0,0 +1,610 @@
+#include <math.h>
+#include <string.h>
+#include <fluent/fluent.h>
+
+#include "job_system.h"
+#include "texture_cook.h"
+
+#define BLOCK_ROWS_PER_BATCH 4
+
+// bc7 mode 6 has 4 bit indices, the weights are the ones the format
+// defines for them
+#define BC7_INDEX_COUNT 16
+
+// power iterations for the principal axis of a block
+#define BC7_AXIS_ITERATIONS 8
+
+// shaders decode srgb color with a 2.2 gamma, mips average with the same
+static const float COLOR_GAMMA = 2.2f;
+
+static const char* codec_names[ TEXTURE_CODEC_COUNT ] = {
+    [TEXTURE_CODEC_RGBA8] = "rgba8",
+    [TEXTURE_CODEC_BC7]   = "bc7",
+    [TEXTURE_CODEC_BC5]   = "bc5",
+    [TEXTURE_CODEC_BC4]   = "bc4",
+};
+
+static const uint32_t codec_formats[ TEXTURE_CODEC_COUNT ] = {
+    [TEXTURE_CODEC_RGBA8] = FT_FORMAT_R8G8B8A8_UNORM,
+    [TEXTURE_CODEC_BC7]   = FT_FORMAT_BC7_UNORM_BLOCK,
+    [TEXTURE_CODEC_BC5]   = FT_FORMAT_BC5_UNORM_BLOCK,
+    [TEXTURE_CODEC_BC4]   = FT_FORMAT_BC4_UNORM_BLOCK,
+};
+
+// bytes per 4x4 block, rgba8 is stored per texel
+static const uint32_t codec_block_sizes[ TEXTURE_CODEC_COUNT ] = {
+    [TEXTURE_CODEC_RGBA8] = 0,
+    [TEXTURE_CODEC_BC7]   = 16,
+    [TEXTURE_CODEC_BC5]   = 16,
+    [TEXTURE_CODEC_BC4]   = 8,
+};
+
+static const uint32_t bc7_weights[ BC7_INDEX_COUNT ] = {
+    0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64,
+};
+
+const char*
+texture_codec_name( enum texture_codec codec )
+{
+	return codec_names[ codec ];
+}
+
+uint32_t
+texture_codec_format( enum texture_codec codec )
+{
+	return codec_formats[ codec ];
+}
+
+enum texture_codec
+texture_codec_pick( uint32_t usage, bool compress )
+{
+	if ( !compress )
+	{
+		return TEXTURE_CODEC_RGBA8;
+	}
+
+	if ( usage == TEXTURE_USAGE_NORMAL )
+	{
+		return TEXTURE_CODEC_BC5;
+	}
+
+	if ( usage == TEXTURE_USAGE_SINGLE )
+	{
+		return TEXTURE_CODEC_BC4;
+	}
+
+	return TEXTURE_CODEC_BC7;
+}
+
+uint32_t
+texture_level_count( uint32_t width, uint32_t height )
+{
+	uint32_t extent = FT_MAX( width, height );
+	uint32_t count  = 1;
+
+	while ( extent > 1 && count < TEXTURE_MAX_LEVELS )
+	{
+		extent >>= 1;
+		count++;
+	}
+
+	return count;
+}
+
+uint32_t
+texture_level_extent( uint32_t extent, uint32_t level )
+{
+	return FT_MAX( extent >> level, 1u );
+}
+
+uint64_t
+texture_level_size( enum texture_codec codec,
+                    uint32_t           width,
+                    uint32_t           height )
+{
+	if ( codec == TEXTURE_CODEC_RGBA8 )
+	{
+		return ( uint64_t ) width * height * 4;
+	}
+
+	uint64_t blocks_x = ( width + 3 ) / 4;
+	uint64_t blocks_y = ( height + 3 ) / 4;
+
+	return blocks_x * blocks_y * codec_block_sizes[ codec ];
+}
+
+static uint8_t
+unorm8( float value )
+{
+	return ( uint8_t ) ( FT_MIN( FT_MAX( value, 0.0f ), 1.0f ) * 255.0f +
+	                     0.5f );
+}
+
+void
+texture_downsample( const uint8_t* src,
+                    uint32_t       width,
+                    uint32_t       height,
+                    uint32_t       usage,
+                    uint8_t*       dst )
+{
+	// normals take priority, a normal map that is also sampled as color
+	// would be a broken material anyway
+	bool normal = ( usage & TEXTURE_USAGE_NORMAL ) != 0;
+	bool color  = !normal && ( usage & TEXTURE_USAGE_COLOR ) != 0;
+
+	float decode[ 256 ];
+	for ( uint32_t i = 0; i < 256; ++i )
+	{
+		float value = ( float ) i / 255.0f;
+		decode[ i ] = color    ? powf( value, COLOR_GAMMA )
+		              : normal ? value * 2.0f - 1.0f
+		                       : value;
+	}
+
+	uint32_t dst_width  = texture_level_extent( width, 1 );
+	uint32_t dst_height = texture_level_extent( height, 1 );
+
+	for ( uint32_t y = 0; y < dst_height; ++y )
+	{
+		const uint8_t* rows[ 2 ] = {
+		    src + ( size_t ) FT_MIN( 2 * y, height - 1 ) * width * 4,
+		    src + ( size_t ) FT_MIN( 2 * y + 1, height - 1 ) * width * 4,
+		};
+
+		for ( uint32_t x = 0; x < dst_width; ++x )
+		{
+			uint32_t columns[ 2 ] = {
+			    FT_MIN( 2 * x, width - 1 ) * 4,
+			    FT_MIN( 2 * x + 1, width - 1 ) * 4,
+			};
+
+			float sum[ 4 ] = { 0 };
+			for ( uint32_t i = 0; i < 4; ++i )
+			{
+				const uint8_t* texel = rows[ i / 2 ] + columns[ i % 2 ];
+
+				sum[ 0 ] += decode[ texel[ 0 ] ];
+				sum[ 1 ] += decode[ texel[ 1 ] ];
+				sum[ 2 ] += decode[ texel[ 2 ] ];
+				sum[ 3 ] += ( float ) texel[ 3 ] / 255.0f;
+			}
+
+			uint8_t* out = dst + ( ( size_t ) y * dst_width + x ) * 4;
+			out[ 3 ]     = unorm8( sum[ 3 ] * 0.25f );
+
+			if ( normal )
+			{
+				float length = sqrtf( sum[ 0 ] * sum[ 0 ] +
+				                      sum[ 1 ] * sum[ 1 ] +
+				                      sum[ 2 ] * sum[ 2 ] );
+				float scale  = length > 0.0f ? 1.0f / length : 0.0f;
+
+				for ( uint32_t c = 0; c < 3; ++c )
+				{
+					out[ c ] = unorm8( sum[ c ] * scale * 0.5f + 0.5f );
+				}
+			}
+			else
+			{
+				for ( uint32_t c = 0; c < 3; ++c )
+				{
+					float value = sum[ c ] * 0.25f;
+					if ( color )
+					{
+						value = powf( value, 1.0f / COLOR_GAMMA );
+					}
+					out[ c ] = unorm8( value );
+				}
+			}
+		}
+	}
+}
+
+static void
+put_bits( uint8_t* block, uint32_t* position, uint32_t value, uint32_t count )
+{
+	for ( uint32_t i = 0; i < count; ++i, ++*position )
+	{
+		if ( ( value >> i ) & 1 )
+		{
+			block[ *position / 8 ] |= ( uint8_t ) ( 1u << ( *position % 8 ) );
+		}
+	}
+}
+
+// bc4 in its eight value mode. the palette is evenly spaced between the
+// endpoints, so the nearest entry comes straight from the position of
+// the value between them
+static void
+encode_bc4( const uint8_t texels[ 16 ][ 4 ], uint32_t channel, uint8_t* dst )
+{
+	uint32_t low  = 255;
+	uint32_t high = 0;
+
+	for ( uint32_t i = 0; i < 16; ++i )
+	{
+		low  = FT_MIN( low, texels[ i ][ channel ] );
+		high = FT_MAX( high, texels[ i ][ channel ] );
+	}
+
+	memset( dst, 0, 8 );
+	dst[ 0 ] = ( uint8_t ) high;
+	dst[ 1 ] = ( uint8_t ) low;
+
+	if ( high == low )
+	{
+		return;
+	}
+
+	uint32_t range    = high - low;
+	uint32_t position = 16;
+
+	for ( uint32_t i = 0; i < 16; ++i )
+	{
+		// 0 is the high endpoint, 7 the low one and 1..6 the steps between,
+		// which the format numbers 2..7
+		uint32_t step =
+		    ( ( high - texels[ i ][ channel ] ) * 7 + range / 2 ) / range;
+		uint32_t index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+
+		put_bits( dst, &position, index, 3 );
+	}
+}
+
+struct bc7_endpoints
+{
+	uint8_t  colors[ 2 ][ 4 ];
+	uint32_t pbits[ 2 ];
+	uint8_t  indices[ 16 ];
+	uint32_t error;
+};
+
+// quantizes float endpoints to 7 bits and a shared p bit each, then picks
+// the nearest of the 16 interpolated colors for every texel
+static void
+bc7_fit_indices( const uint8_t         texels[ 16 ][ 4 ],
+                 const float           endpoints[ 2 ][ 4 ],
+                 uint32_t              pbit_0,
+                 uint32_t              pbit_1,
+                 struct bc7_endpoints* fit )
+{
+	uint32_t pbits[ 2 ] = { pbit_0, pbit_1 };
+	int32_t  palette[ BC7_INDEX_COUNT ][ 4 ];
+
+	for ( uint32_t e = 0; e < 2; ++e )
+	{
+		fit->pbits[ e ] = pbits[ e ];
+
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			float value = ( endpoints[ e ][ c ] - ( float ) pbits[ e ] ) * 0.5f;
+			int32_t q   = ( int32_t ) ( value + 0.5f );
+
+			q                     = FT_MIN( FT_MAX( q, 0 ), 127 );
+			fit->colors[ e ][ c ] = ( uint8_t ) ( q << 1 | pbits[ e ] );
+		}
+	}
+
+	for ( uint32_t i = 0; i < BC7_INDEX_COUNT; ++i )
+	{
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			uint32_t w = bc7_weights[ i ];
+
+			palette[ i ][ c ] =
+			    ( int32_t ) ( ( ( 64 - w ) * fit->colors[ 0 ][ c ] +
+			                    w * fit->colors[ 1 ][ c ] + 32 ) >>
+			                  6 );
+		}
+	}
+
+	fit->error = 0;
+
+	for ( uint32_t t = 0; t < 16; ++t )
+	{
+		uint32_t best       = 0;
+		uint32_t best_error = UINT32_MAX;
+
+		for ( uint32_t i = 0; i < BC7_INDEX_COUNT; ++i )
+		{
+			uint32_t error = 0;
+			for ( uint32_t c = 0; c < 4; ++c )
+			{
+				int32_t d = palette[ i ][ c ] - texels[ t ][ c ];
+				error += ( uint32_t ) ( d * d );
+			}
+
+			if ( error < best_error )
+			{
+				best       = i;
+				best_error = error;
+			}
+		}
+
+		fit->indices[ t ] = ( uint8_t ) best;
+		fit->error += best_error;
+	}
+}
+
+// tries every p bit pair and keeps the closest
+static void
+bc7_fit( const uint8_t         texels[ 16 ][ 4 ],
+         const float           endpoints[ 2 ][ 4 ],
+         struct bc7_endpoints* best )
+{
+	best->error = UINT32_MAX;
+
+	for ( uint32_t p = 0; p < 4; ++p )
+	{
+		struct bc7_endpoints fit;
+		bc7_fit_indices( texels, endpoints, p & 1, p >> 1, &fit );
+
+		if ( fit.error < best->error )
+		{
+			*best = fit;
+		}
+	}
+}
+
+// endpoints along the principal axis of the block, the texels projected
+// onto it give the extent
+static void
+bc7_axis_endpoints( const uint8_t texels[ 16 ][ 4 ], float endpoints[ 2 ][ 4 ] )
+{
+	float mean[ 4 ] = { 0 };
+	for ( uint32_t t = 0; t < 16; ++t )
+	{
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			mean[ c ] += texels[ t ][ c ] / 16.0f;
+		}
+	}
+
+	float covariance[ 4 ][ 4 ] = { { 0 } };
+	for ( uint32_t t = 0; t < 16; ++t )
+	{
+		for ( uint32_t a = 0; a < 4; ++a )
+		{
+			for ( uint32_t b = 0; b < 4; ++b )
+			{
+				covariance[ a ][ b ] += ( texels[ t ][ a ] - mean[ a ] ) *
+				                        ( texels[ t ][ b ] - mean[ b ] );
+			}
+		}
+	}
+
+	float axis[ 4 ] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for ( uint32_t i = 0; i < BC7_AXIS_ITERATIONS; ++i )
+	{
+		float next[ 4 ] = { 0 };
+		float length    = 0.0f;
+
+		for ( uint32_t a = 0; a < 4; ++a )
+		{
+			for ( uint32_t b = 0; b < 4; ++b )
+			{
+				next[ a ] += covariance[ a ][ b ] * axis[ b ];
+			}
+			length += next[ a ] * next[ a ];
+		}
+
+		// a flat block has no axis, its endpoints collapse onto the mean
+		if ( length < 1e-6f )
+		{
+			memset( axis, 0, sizeof( axis ) );
+			break;
+		}
+
+		length = 1.0f / sqrtf( length );
+		for ( uint32_t a = 0; a < 4; ++a )
+		{
+			axis[ a ] = next[ a ] * length;
+		}
+	}
+
+	float low  = 0.0f;
+	float high = 0.0f;
+	for ( uint32_t t = 0; t < 16; ++t )
+	{
+		float d = 0.0f;
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			d += ( texels[ t ][ c ] - mean[ c ] ) * axis[ c ];
+		}
+		low  = FT_MIN( low, d );
+		high = FT_MAX( high, d );
+	}
+
+	for ( uint32_t c = 0; c < 4; ++c )
+	{
+		endpoints[ 0 ][ c ] =
+		    FT_MIN( FT_MAX( mean[ c ] + low * axis[ c ], 0.0f ), 255.0f );
+		endpoints[ 1 ][ c ] =
+		    FT_MIN( FT_MAX( mean[ c ] + high * axis[ c ], 0.0f ), 255.0f );
+	}
+}
+
+// least squares endpoints for the weights the first fit picked
+static bool
+bc7_refine_endpoints( const uint8_t               texels[ 16 ][ 4 ],
+                      const struct bc7_endpoints* fit,
+                      float                       endpoints[ 2 ][ 4 ] )
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[ 4 ] = { 0 }, bx[ 4 ] = { 0 };
+
+	for ( uint32_t t = 0; t < 16; ++t )
+	{
+		float b = bc7_weights[ fit->indices[ t ] ] / 64.0f;
+		float a = 1.0f - b;
+
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			ax[ c ] += a * texels[ t ][ c ];
+			bx[ c ] += b * texels[ t ][ c ];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if ( fabsf( determinant ) < 1e-6f )
+	{
+		return false;
+	}
+
+	float inverse = 1.0f / determinant;
+	for ( uint32_t c = 0; c < 4; ++c )
+	{
+		float e0 = ( bb * ax[ c ] - ab * bx[ c ] ) * inverse;
+		float e1 = ( aa * bx[ c ] - ab * ax[ c ] ) * inverse;
+
+		endpoints[ 0 ][ c ] = FT_MIN( FT_MAX( e0, 0.0f ), 255.0f );
+		endpoints[ 1 ][ c ] = FT_MIN( FT_MAX( e1, 0.0f ), 255.0f );
+	}
+
+	return true;
+}
+
+// bc7 mode 6, one rgba subset with 7 bit endpoints, a p bit each and 4
+// bit indices. one mode keeps the encoder simple and is what most fast
+// encoders fall back to for smooth blocks
+static void
+encode_bc7( const uint8_t texels[ 16 ][ 4 ], uint8_t* dst )
+{
+	float                endpoints[ 2 ][ 4 ];
+	struct bc7_endpoints fit;
+
+	bc7_axis_endpoints( texels, endpoints );
+	bc7_fit( texels, endpoints, &fit );
+
+	if ( fit.error != 0 && bc7_refine_endpoints( texels, &fit, endpoints ) )
+	{
+		struct bc7_endpoints refined;
+		bc7_fit( texels, endpoints, &refined );
+
+		if ( refined.error < fit.error )
+		{
+			fit = refined;
+		}
+	}
+
+	// the first index drops its top bit, swapping the endpoints flips every
+	// index so it always fits
+	uint32_t first = 0;
+	if ( fit.indices[ 0 ] >= BC7_INDEX_COUNT / 2 )
+	{
+		first = 1;
+		for ( uint32_t t = 0; t < 16; ++t )
+		{
+			fit.indices[ t ] =
+			    ( uint8_t ) ( BC7_INDEX_COUNT - 1 - fit.indices[ t ] );
+		}
+	}
+
+	memset( dst, 0, 16 );
+
+	uint32_t position = 0;
+	put_bits( dst, &position, 1u << 6, 7 );
+
+	for ( uint32_t c = 0; c < 4; ++c )
+	{
+		put_bits( dst, &position, fit.colors[ first ][ c ] >> 1, 7 );
+		put_bits( dst, &position, fit.colors[ !first ][ c ] >> 1, 7 );
+	}
+
+	put_bits( dst, &position, fit.pbits[ first ], 1 );
+	put_bits( dst, &position, fit.pbits[ !first ], 1 );
+
+	for ( uint32_t t = 0; t < 16; ++t )
+	{
+		put_bits( dst, &position, fit.indices[ t ], t == 0 ? 3 : 4 );
+	}
+}
+
+struct encode_job
+{
+	enum texture_codec codec;
+	const uint8_t*     rgba;
+	uint32_t           width;
+	uint32_t           height;
+	uint8_t*           dst;
+};
+
+static void
+encode_block_rows( void* user_data, uint32_t begin, uint32_t end )
+{
+	const struct encode_job* job        = user_data;
+	uint32_t                 blocks_x   = ( job->width + 3 ) / 4;
+	uint32_t                 block_size = codec_block_sizes[ job->codec ];
+
+	for ( uint32_t by = begin; by < end; ++by )
+	{
+		uint8_t* dst = job->dst + ( size_t ) by * blocks_x * block_size;
+
+		for ( uint32_t bx = 0; bx < blocks_x; ++bx, dst += block_size )
+		{
+			// edge blocks repeat the last row and column of the level
+			uint8_t texels[ 16 ][ 4 ];
+			for ( uint32_t t = 0; t < 16; ++t )
+			{
+				uint32_t x = FT_MIN( bx * 4 + t % 4, job->width - 1 );
+				uint32_t y = FT_MIN( by * 4 + t / 4, job->height - 1 );
+
+				memcpy( texels[ t ],
+				        job->rgba + ( ( size_t ) y * job->width + x ) * 4,
+				        4 );
+			}
+
+			switch ( job->codec )
+			{
+			case TEXTURE_CODEC_BC7:
+			{
+				encode_bc7( texels, dst );
+				break;
+			}
+			case TEXTURE_CODEC_BC5:
+			{
+				encode_bc4( texels, 0, dst );
+				encode_bc4( texels, 1, dst + 8 );
+				break;
+			}
+			case TEXTURE_CODEC_BC4:
+			{
+				encode_bc4( texels, 0, dst );
+				break;
+			}
+			default: break;
+			}
+		}
+	}
+}
+
+void
+texture_encode( enum texture_codec codec,
+                const uint8_t*     rgba,
+                uint32_t           width,
+                uint32_t           height,
+                uint8_t*           dst )
+{
+	if ( codec == TEXTURE_CODEC_RGBA8 )
+	{
+		memcpy( dst, rgba, texture_level_size( codec, width, height ) );
+		return;
+	}
+
+	struct encode_job job = {
+	    .codec  = codec,
+	    .rgba   = rgba,
+	    .width  = width,
+	    .height = height,
+	    .dst    = dst,
+	};
+
+	job_system_parallel_for( ( height + 3 ) / 4,
+	                         BLOCK_ROWS_PER_BATCH,
+	                         encode_block_rows,
+	                         &job );
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// mip levels of the largest texture a pack stores, 32k on a side
+#define TEXTURE_MAX_LEVELS 16
+
+// how the levels of a cooked texture are stored. bc7 keeps rgba at 8
+// bits per texel, bc5 the two channels of a normal map and bc4 the one
+// channel of an occlusion map, each in 4x4 blocks
+enum texture_codec
+{
+	TEXTURE_CODEC_RGBA8,
+	TEXTURE_CODEC_BC7,
+	TEXTURE_CODEC_BC5,
+	TEXTURE_CODEC_BC4,
+	TEXTURE_CODEC_COUNT,
+};
+
+// what a texture is bound as, one bit per ft_texture_type slot that uses
+// it across the materials of a model
+enum texture_usage
+{
+	TEXTURE_USAGE_COLOR  = 1u << 0,
+	TEXTURE_USAGE_NORMAL = 1u << 1,
+	TEXTURE_USAGE_SINGLE = 1u << 2,
+	TEXTURE_USAGE_DATA   = 1u << 3,
+};
+
+const char*
+texture_codec_name( enum texture_codec codec );
+
+// the ft_format the levels are uploaded as
+uint32_t
+texture_codec_format( enum texture_codec codec );
+
+// bc5 only for textures used as nothing but normal maps and bc4 only for
+// ones used as nothing but occlusion, anything shared with another slot
+// keeps all four channels in bc7
+enum texture_codec
+texture_codec_pick( uint32_t usage, bool compress );
+
+uint32_t
+texture_level_count( uint32_t width, uint32_t height );
+
+uint32_t
+texture_level_extent( uint32_t extent, uint32_t level );
+
+// bytes of one level, whole blocks for the bc codecs
+uint64_t
+texture_level_size( enum texture_codec codec,
+                    uint32_t           width,
+                    uint32_t           height );
+
+// halves an rgba8 level with a box filter. color averages in linear space
+// and normals are renormalized, so mips keep their brightness and length
+void
+texture_downsample( const uint8_t* src,
+                    uint32_t       width,
+                    uint32_t       height,
+                    uint32_t       usage,
+                    uint8_t*       dst );
+
+// encodes an rgba8 level into texture_level_size bytes at dst. the block
+// rows are split over the job system when called outside a job
+void
+texture_encode( enum texture_codec codec,
+                const uint8_t*     rgba,
+                uint32_t           width,
+                uint32_t           height,
+                uint8_t*           dst );
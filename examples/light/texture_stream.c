@@ -0,0 +1,669 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fluent/fluent.h>
+
+#include "fluent_features.h"
+#include "mesh_pack.h"
+#include "texture_cook.h"
+#include "texture_stream.h"
+
+// frames between queueing an upload and binding its image. the resource
+// loader has normally finished by then, so the wait before the swap
+// returns at once instead of stalling the frame. copies recorded in the
+// frame need no latency
+#define STREAM_LATENCY_FRAMES 3
+
+// a texture the feedback has not seen for this many frames only needs its
+// tail, it is the first to give up levels when over budget
+#define STREAM_IDLE_FRAMES 120
+
+// bytes of new levels queued per frame, bounds the staging copies the
+// loader does in the background
+#define STREAM_UPLOAD_BYTES ( 32ull << 20 )
+
+#define MIN_RETIRED_CAPACITY 16
+
+static uint64_t
+chain_size( const struct mesh_pack_texture* texture, uint32_t first_level )
+{
+	uint64_t size = 0;
+
+	for ( uint32_t l = first_level; l < texture->level_count; ++l )
+	{
+		size += texture->levels[ l ].size;
+	}
+
+	return size;
+}
+
+// first level whose larger side fits in the tail extent
+static uint32_t
+tail_level( const struct mesh_pack_texture* texture )
+{
+	uint32_t level = 0;
+
+	while ( level + 1 < texture->level_count &&
+	        FT_MAX( texture_level_extent( texture->width, level ),
+	                texture_level_extent( texture->height, level ) ) >
+	            TEXTURE_STREAM_TAIL_EXTENT )
+	{
+		level++;
+	}
+
+	return level;
+}
+
+// an image for levels first_level.. of the chain, its level 0 is
+// first_level of the pack
+static struct ft_image*
+create_image( const struct ft_device*           device,
+              const struct texture_stream_slot* slot,
+              uint32_t                          first_level )
+{
+	const struct mesh_pack_texture* texture = slot->texture;
+
+	struct ft_image_info info = {
+	    .width           = texture_level_extent( texture->width, first_level ),
+	    .height          = texture_level_extent( texture->height, first_level ),
+	    .depth           = 1,
+	    .format          = texture_codec_format( texture->codec ),
+	    .sample_count    = 1,
+	    .layer_count     = 1,
+	    .mip_levels      = texture->level_count - first_level,
+	    .descriptor_type = FT_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+	};
+
+	struct ft_image* image;
+	ft_create_image( device, &info, &image );
+
+	return image;
+}
+
+// the image with every level of it uploaded by the resource loader
+static struct ft_image*
+create_levels( const struct ft_device*           device,
+               const struct texture_stream_slot* slot,
+               uint32_t                          first_level )
+{
+	const struct mesh_pack_texture* texture = slot->texture;
+	struct ft_image* image = create_image( device, slot, first_level );
+
+	for ( uint32_t l = first_level; l < texture->level_count; ++l )
+	{
+		struct ft_image_upload_job job = {
+		    .image     = image,
+		    .data      = ( void* ) mesh_pack_texels( slot->pack, texture, l ),
+		    .width     = texture_level_extent( texture->width, l ),
+		    .height    = texture_level_extent( texture->height, l ),
+		    .mip_level = l - first_level,
+		};
+
+		ft_upload_image( &job );
+	}
+
+	return image;
+}
+
+static void
+retire_image( struct texture_stream* stream,
+              struct ft_image*       image,
+              struct ft_buffer*      staging,
+              uint64_t               frame )
+{
+	if ( image == NULL && staging == NULL )
+	{
+		return;
+	}
+
+	if ( stream->retired_count == stream->retired_capacity )
+	{
+		stream->retired_capacity =
+		    FT_MAX( stream->retired_capacity * 2, MIN_RETIRED_CAPACITY );
+		stream->retired =
+		    realloc( stream->retired,
+		             stream->retired_capacity * sizeof( *stream->retired ) );
+	}
+
+	stream->retired[ stream->retired_count ].image   = image;
+	stream->retired[ stream->retired_count ].staging = staging;
+	stream->retired[ stream->retired_count ].frame   = frame;
+	stream->retired_count++;
+}
+
+static void
+release_retired( struct texture_stream* stream, uint64_t frame, bool all )
+{
+	uint32_t kept = 0;
+
+	for ( uint32_t i = 0; i < stream->retired_count; ++i )
+	{
+		struct texture_stream_retired* retired = &stream->retired[ i ];
+
+		if ( !all && retired->frame + stream->retire_frames > frame )
+		{
+			stream->retired[ kept++ ] = *retired;
+			continue;
+		}
+
+		if ( retired->image )
+		{
+			ft_destroy_image( stream->device, retired->image );
+		}
+
+		if ( retired->staging )
+		{
+			ft_destroy_buffer( stream->device, retired->staging );
+		}
+	}
+
+	stream->retired_count = kept;
+}
+
+// the level the slot should hold, its tail once nothing samples it
+static uint32_t
+target_level( const struct texture_stream_slot* slot )
+{
+	if ( slot->idle_frames >= STREAM_IDLE_FRAMES )
+	{
+		return slot->tail_level;
+	}
+
+	return FT_MIN( slot->wanted_level, slot->tail_level );
+}
+
+static void
+queue_levels( struct texture_stream*      stream,
+              struct texture_stream_slot* slot,
+              uint32_t                    level,
+              uint64_t                    frame )
+{
+	uint64_t size     = chain_size( slot->texture, level );
+	uint64_t resident = chain_size( slot->texture, slot->resident_level );
+
+	stream->committed_bytes -= resident;
+	stream->committed_bytes += size;
+	stream->resident_bytes += size;
+
+#if LIGHT_FLUENT_IMAGE_COPY
+	slot->pending = create_image( stream->device, slot, level );
+	slot->staging = NULL;
+
+	// only the levels finer than the resident ones come from the pack
+	uint64_t staging_size = size - FT_MIN( size, resident );
+
+	if ( staging_size != 0 )
+	{
+		struct ft_buffer_info info = {
+		    .size            = staging_size,
+		    .descriptor_type = FT_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		    .memory_usage    = FT_MEMORY_USAGE_CPU_TO_GPU,
+		};
+
+		ft_create_buffer( stream->device, &info, &slot->staging );
+
+		uint8_t* texels = ft_map_memory( stream->device, slot->staging );
+
+		for ( uint32_t l = level; l < slot->resident_level; ++l )
+		{
+			uint64_t level_size = slot->texture->levels[ l ].size;
+			memcpy( texels,
+			        mesh_pack_texels( slot->pack, slot->texture, l ),
+			        level_size );
+			texels += level_size;
+		}
+
+		ft_unmap_memory( stream->device, slot->staging );
+	}
+#else
+	slot->pending = create_levels( stream->device, slot, level );
+#endif
+	slot->pending_level = level;
+	slot->pending_frame = frame;
+}
+
+void
+texture_stream_init( struct texture_stream*  stream,
+                     const struct ft_device* device,
+                     uint32_t                slot_count,
+                     uint32_t                retire_frames,
+                     bool                    enabled,
+                     uint64_t                budget )
+{
+	memset( stream, 0, sizeof( *stream ) );
+	stream->device        = device;
+	stream->enabled       = enabled;
+	stream->budget        = budget;
+	stream->retire_frames = retire_frames;
+	stream->slot_count    = slot_count;
+	stream->slots         = calloc( slot_count, sizeof( *stream->slots ) );
+}
+
+void
+texture_stream_shutdown( struct texture_stream* stream )
+{
+	ft_resource_loader_wait_idle();
+
+	for ( uint32_t s = 0; s < stream->slot_count; ++s )
+	{
+		struct texture_stream_slot* slot = &stream->slots[ s ];
+
+		if ( slot->image )
+		{
+			ft_destroy_image( stream->device, slot->image );
+		}
+
+		if ( slot->pending )
+		{
+			ft_destroy_image( stream->device, slot->pending );
+		}
+
+		if ( slot->staging )
+		{
+			ft_destroy_buffer( stream->device, slot->staging );
+		}
+	}
+
+	release_retired( stream, 0, true );
+	free( stream->retired );
+	free( stream->slots );
+	memset( stream, 0, sizeof( *stream ) );
+}
+
+struct ft_image*
+texture_stream_add( struct texture_stream*          stream,
+                    uint32_t                        slot_index,
+                    const struct mesh_pack_header*  pack,
+                    const struct mesh_pack_texture* texture )
+{
+	struct texture_stream_slot* slot = &stream->slots[ slot_index ];
+
+	memset( slot, 0, sizeof( *slot ) );
+	slot->pack       = pack;
+	slot->texture    = texture;
+	slot->tail_level = stream->enabled ? tail_level( texture ) : 0;
+
+	// nothing has asked for finer levels yet, the tail is all it wants
+	// until the first feedback comes back
+	slot->resident_level = slot->tail_level;
+	slot->wanted_level   = slot->tail_level;
+	slot->image = create_levels( stream->device, slot, slot->tail_level );
+
+	uint64_t size = chain_size( texture, slot->tail_level );
+	stream->resident_bytes += size;
+	stream->committed_bytes += size;
+
+	return slot->image;
+}
+
+void
+texture_stream_remove( struct texture_stream* stream,
+                       uint32_t               slot_index,
+                       uint64_t               frame )
+{
+	struct texture_stream_slot* slot = &stream->slots[ slot_index ];
+
+	if ( slot->texture == NULL )
+	{
+		return;
+	}
+
+	uint64_t size = chain_size( slot->texture, slot->resident_level );
+
+	if ( slot->pending )
+	{
+		ft_resource_loader_wait_idle();
+
+		uint64_t pending_size =
+		    chain_size( slot->texture, slot->pending_level );
+
+		stream->resident_bytes -= pending_size;
+		stream->committed_bytes -= pending_size;
+		stream->committed_bytes += size;
+		retire_image( stream, slot->pending, slot->staging, frame );
+	}
+
+	stream->resident_bytes -= size;
+	stream->committed_bytes -= size;
+	retire_image( stream, slot->image, NULL, frame );
+
+	memset( slot, 0, sizeof( *slot ) );
+}
+
+uint32_t
+texture_stream_resident_level( const struct texture_stream* stream,
+                               uint32_t                     slot )
+{
+	return stream->slots[ slot ].resident_level;
+}
+
+void
+texture_stream_feedback( struct texture_stream* stream,
+                         const uint32_t*        lods,
+                         const uint8_t*         levels )
+{
+	if ( !stream->enabled )
+	{
+		return;
+	}
+
+	for ( uint32_t s = 0; s < stream->slot_count; ++s )
+	{
+		struct texture_stream_slot* slot = &stream->slots[ s ];
+
+		if ( slot->texture == NULL )
+		{
+			continue;
+		}
+
+		if ( lods[ s ] == TEXTURE_STREAM_NO_REQUEST )
+		{
+			slot->idle_frames += slot->idle_frames < UINT32_MAX ? 1 : 0;
+			continue;
+		}
+
+		// the lod is relative to the level the bound image started at
+		int32_t level = ( int32_t ) lods[ s ] - TEXTURE_STREAM_LOD_BIAS +
+		                ( int32_t ) levels[ s ];
+
+		slot->wanted_level = ( uint32_t ) FT_MAX( level, 0 );
+		slot->idle_frames  = 0;
+	}
+}
+
+// uploads that had their frames are bound, the image they replace is
+// destroyed once no frame can be using it
+static bool
+swap_pending( struct texture_stream* stream,
+              uint64_t               frame,
+              struct ft_image**      images )
+{
+	bool changed = false;
+
+	for ( uint32_t s = 0; s < stream->slot_count; ++s )
+	{
+		struct texture_stream_slot* slot = &stream->slots[ s ];
+
+		if ( slot->pending == NULL ||
+		     slot->pending_frame + STREAM_LATENCY_FRAMES > frame )
+		{
+			continue;
+		}
+
+		if ( !changed )
+		{
+			ft_resource_loader_wait_idle();
+		}
+
+		stream->resident_bytes -=
+		    chain_size( slot->texture, slot->resident_level );
+		retire_image( stream, slot->image, NULL, frame );
+
+		slot->image          = slot->pending;
+		slot->resident_level = slot->pending_level;
+		slot->pending        = NULL;
+		images[ s ]          = slot->image;
+		changed              = true;
+	}
+
+	return changed;
+}
+
+// bytes the slots that want finer levels than they hold would add
+static uint64_t
+wanted_bytes( const struct texture_stream* stream )
+{
+	uint64_t size = 0;
+
+	for ( uint32_t s = 0; s < stream->slot_count; ++s )
+	{
+		const struct texture_stream_slot* slot = &stream->slots[ s ];
+
+		if ( slot->texture == NULL || slot->pending != NULL ||
+		     target_level( slot ) >= slot->resident_level )
+		{
+			continue;
+		}
+
+		size += chain_size( slot->texture, target_level( slot ) ) -
+		        chain_size( slot->texture, slot->resident_level );
+	}
+
+	return size;
+}
+
+// drops levels from the slots that hold more than they want while the
+// budget can not take what the others ask for, the ones idle the longest
+// and then the largest first
+static void
+evict_over_budget( struct texture_stream* stream, uint64_t frame )
+{
+	uint64_t wanted = stream->budget != 0 ? wanted_bytes( stream ) : 0;
+
+	while ( stream->budget != 0 &&
+	        stream->committed_bytes + wanted > stream->budget )
+	{
+		struct texture_stream_slot* victim     = NULL;
+		uint64_t                    victim_gain = 0;
+
+		for ( uint32_t s = 0; s < stream->slot_count; ++s )
+		{
+			struct texture_stream_slot* slot = &stream->slots[ s ];
+
+			if ( slot->texture == NULL || slot->pending != NULL ||
+			     target_level( slot ) <= slot->resident_level )
+			{
+				continue;
+			}
+
+			uint64_t gain =
+			    chain_size( slot->texture, slot->resident_level ) -
+			    chain_size( slot->texture, target_level( slot ) );
+
+			if ( victim == NULL || slot->idle_frames > victim->idle_frames ||
+			     ( slot->idle_frames == victim->idle_frames &&
+			       gain > victim_gain ) )
+			{
+				victim      = slot;
+				victim_gain = gain;
+			}
+		}
+
+		if ( victim == NULL )
+		{
+			break;
+		}
+
+		queue_levels( stream, victim, target_level( victim ), frame );
+		stream->evicted_count++;
+	}
+}
+
+// queues the levels the feedback asked for, as many as fit in the budget
+// and in this frame's upload bytes. the cursor moves on so every slot gets
+// its turn when the uploads run short
+static void
+stream_wanted_levels( struct texture_stream* stream, uint64_t frame )
+{
+	uint64_t queued = 0;
+	uint32_t first  = stream->cursor;
+
+	for ( uint32_t i = 0; i < stream->slot_count; ++i )
+	{
+		if ( queued >= STREAM_UPLOAD_BYTES )
+		{
+			break;
+		}
+
+		uint32_t                    s    = ( first + i ) % stream->slot_count;
+		struct texture_stream_slot* slot = &stream->slots[ s ];
+
+		if ( slot->texture == NULL || slot->pending != NULL ||
+		     target_level( slot ) >= slot->resident_level )
+		{
+			continue;
+		}
+
+		uint64_t resident = chain_size( slot->texture, slot->resident_level );
+		uint32_t level    = target_level( slot );
+
+		// short of the budget it streams the finest level that fits
+		while ( stream->budget != 0 && level < slot->resident_level &&
+		        stream->committed_bytes - resident +
+		                chain_size( slot->texture, level ) >
+		            stream->budget )
+		{
+			level++;
+		}
+
+		if ( level == slot->resident_level )
+		{
+			continue;
+		}
+
+		queue_levels( stream, slot, level, frame );
+		queued += chain_size( slot->texture, level );
+		stream->streamed_count++;
+		stream->cursor = ( s + 1 ) % stream->slot_count;
+	}
+}
+
+#if LIGHT_FLUENT_IMAGE_COPY
+// records the copies into the images queued this frame, the levels the
+// slot holds from its image and the rest from staging, and swaps them in.
+// the copies run ahead of everything that samples the images in the
+// frame, so nothing waits on the resource loader
+static bool
+copy_pending( struct texture_stream*    stream,
+              uint64_t                  frame,
+              struct ft_command_buffer* cmd,
+              struct ft_image**         images )
+{
+	bool changed = false;
+
+	for ( uint32_t s = 0; s < stream->slot_count; ++s )
+	{
+		struct texture_stream_slot*     slot    = &stream->slots[ s ];
+		const struct mesh_pack_texture* texture = slot->texture;
+
+		if ( slot->pending == NULL )
+		{
+			continue;
+		}
+
+		struct ft_image_barrier barriers[ 2 ] = {
+		    {
+		        .image     = slot->pending,
+		        .old_state = FT_RESOURCE_STATE_UNDEFINED,
+		        .new_state = FT_RESOURCE_STATE_TRANSFER_DST,
+		    },
+		    {
+		        .image     = slot->image,
+		        .old_state = FT_RESOURCE_STATE_SHADER_READ_ONLY,
+		        .new_state = FT_RESOURCE_STATE_TRANSFER_SRC,
+		    },
+		};
+
+		ft_cmd_barrier( cmd, 0, NULL, 0, NULL, 2, barriers );
+
+		uint64_t staging_offset = 0;
+
+		for ( uint32_t l = slot->pending_level; l < texture->level_count; ++l )
+		{
+			uint32_t width  = texture_level_extent( texture->width, l );
+			uint32_t height = texture_level_extent( texture->height, l );
+
+			if ( l < slot->resident_level )
+			{
+				struct ft_buffer_image_copy copy = {
+				    .buffer_offset = staging_offset,
+				    .width         = width,
+				    .height        = height,
+				    .mip_level     = l - slot->pending_level,
+				};
+
+				ft_cmd_copy_buffer_to_image( cmd,
+				                             slot->staging,
+				                             slot->pending,
+				                             &copy );
+				staging_offset += texture->levels[ l ].size;
+			}
+			else
+			{
+				struct ft_image_copy copy = {
+				    .src_mip_level = l - slot->resident_level,
+				    .dst_mip_level = l - slot->pending_level,
+				    .width         = width,
+				    .height        = height,
+				};
+
+				ft_cmd_copy_image( cmd, slot->image, slot->pending, &copy );
+			}
+		}
+
+		barriers[ 0 ].old_state = FT_RESOURCE_STATE_TRANSFER_DST;
+		barriers[ 0 ].new_state = FT_RESOURCE_STATE_SHADER_READ_ONLY;
+		barriers[ 1 ].old_state = FT_RESOURCE_STATE_TRANSFER_SRC;
+		barriers[ 1 ].new_state = FT_RESOURCE_STATE_SHADER_READ_ONLY;
+		ft_cmd_barrier( cmd, 0, NULL, 0, NULL, 2, barriers );
+
+		stream->resident_bytes -= chain_size( texture, slot->resident_level );
+		retire_image( stream, slot->image, slot->staging, frame );
+
+		slot->image          = slot->pending;
+		slot->resident_level = slot->pending_level;
+		slot->pending        = NULL;
+		slot->staging        = NULL;
+		images[ s ]          = slot->image;
+		changed              = true;
+	}
+
+	return changed;
+}
+#endif
+
+bool
+texture_stream_update( struct texture_stream*    stream,
+                       uint64_t                  frame,
+                       struct ft_command_buffer* cmd,
+                       struct ft_image**         images )
+{
+	release_retired( stream, frame, false );
+
+	if ( !stream->enabled )
+	{
+		return false;
+	}
+
+#if LIGHT_FLUENT_IMAGE_COPY
+	evict_over_budget( stream, frame );
+	stream_wanted_levels( stream, frame );
+
+	return copy_pending( stream, frame, cmd, images );
+#else
+	FT_UNUSED( cmd );
+
+	bool changed = swap_pending( stream, frame, images );
+
+	evict_over_budget( stream, frame );
+	stream_wanted_levels( stream, frame );
+
+	return changed;
+#endif
+}
+
+void
+texture_stream_get_stats( const struct texture_stream* stream,
+                          struct texture_stream_stats* stats )
+{
+	stats->resident_bytes  = stream->resident_bytes;
+	stats->committed_bytes = stream->committed_bytes;
+	stats->budget          = stream->budget;
+	stats->streamed_count  = stream->streamed_count;
+	stats->evicted_count   = stream->evicted_count;
+	stats->pending_count   = 0;
+
+	for ( uint32_t s = 0; s < stream->slot_count; ++s )
+	{
+		stats->pending_count += stream->slots[ s ].pending != NULL ? 1 : 0;
+	}
+}
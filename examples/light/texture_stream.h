@@ -0,0 +1,141 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct ft_device;
+struct ft_image;
+struct ft_buffer;
+struct ft_command_buffer;
+struct mesh_pack_header;
+struct mesh_pack_texture;
+
+// levels whose larger side is at most this many texels load with the
+// texture and are never evicted
+#define TEXTURE_STREAM_TAIL_EXTENT 64
+
+// pbr.frag.glsl records floor( lod ) plus this bias relative to the levels
+// it has bound, so asking for finer levels than are resident still fits
+// in an unsigned value. FEEDBACK_LOD_BIAS there
+#define TEXTURE_STREAM_LOD_BIAS 16
+
+// a feedback slot no pixel wrote this frame
+#define TEXTURE_STREAM_NO_REQUEST UINT32_MAX
+
+// wanted_level is the finest level the feedback asked for, idle_frames
+// counts frames since it last asked for anything. a replacement image with
+// the levels from pending_level is uploaded in the background and swapped
+// in a few frames later, or with LIGHT_FLUENT_IMAGE_COPY copied in the
+// frame that queued it, the levels it did not have from staging
+struct texture_stream_slot
+{
+	const struct mesh_pack_header*  pack;
+	const struct mesh_pack_texture* texture;
+	struct ft_image*                image;
+	uint32_t                        resident_level;
+	uint32_t                        tail_level;
+	uint32_t                        wanted_level;
+	uint32_t                        idle_frames;
+	struct ft_image*                pending;
+	struct ft_buffer*               staging;
+	uint32_t                        pending_level;
+	uint64_t                        pending_frame;
+};
+
+struct texture_stream_retired
+{
+	struct ft_image*  image;
+	struct ft_buffer* staging;
+	uint64_t          frame;
+};
+
+// one slot per entry of the scene texture array. a texture starts with
+// its mip tail, finer levels are streamed in from the mapped pack as the
+// feedback asks for them and dropped again when the budget runs out.
+// committed_bytes is what the slots hold once every pending image is
+// swapped in, budgets are checked against it
+struct texture_stream
+{
+	const struct ft_device*        device;
+	bool                           enabled;
+	uint64_t                       budget;
+	uint32_t                       retire_frames;
+	uint32_t                       slot_count;
+	struct texture_stream_slot*    slots;
+	uint32_t                       cursor;
+	uint64_t                       resident_bytes;
+	uint64_t                       committed_bytes;
+	uint32_t                       retired_count;
+	uint32_t                       retired_capacity;
+	struct texture_stream_retired* retired;
+	uint32_t                       streamed_count;
+	uint32_t                       evicted_count;
+};
+
+struct texture_stream_stats
+{
+	uint64_t resident_bytes;
+	uint64_t committed_bytes;
+	uint64_t budget;
+	uint32_t pending_count;
+	uint32_t streamed_count;
+	uint32_t evicted_count;
+};
+
+// replaced images are destroyed retire_frames frames after they were
+// unbound. with streaming off every level is loaded up front and the
+// feedback is ignored. a budget of 0 is unlimited
+void
+texture_stream_init( struct texture_stream*  stream,
+                     const struct ft_device* device,
+                     uint32_t                slot_count,
+                     uint32_t                retire_frames,
+                     bool                    enabled,
+                     uint64_t                budget );
+
+// destroys every image right away, the gpu must be done with them
+void
+texture_stream_shutdown( struct texture_stream* stream );
+
+// creates the image of a pack texture with its mip tail, or with every
+// level when streaming is off, and queues the uploads. the pack has to
+// stay mapped until the slot is removed
+struct ft_image*
+texture_stream_add( struct texture_stream*          stream,
+                    uint32_t                        slot,
+                    const struct mesh_pack_header*  pack,
+                    const struct mesh_pack_texture* texture );
+
+// retires the images of the slot. queued uploads still read the pack, so
+// this waits for them when any are in flight
+void
+texture_stream_remove( struct texture_stream* stream,
+                       uint32_t               slot,
+                       uint64_t               frame );
+
+// the first level of the full chain the bound image of a slot starts at
+uint32_t
+texture_stream_resident_level( const struct texture_stream* stream,
+                               uint32_t                     slot );
+
+// lods of a finished frame, levels holds the resident level of each slot
+// when the descriptors that frame used were written
+void
+texture_stream_feedback( struct texture_stream* stream,
+                         const uint32_t*        lods,
+                         const uint8_t*         levels );
+
+// swaps in the uploads queued a few frames ago, evicts levels while over
+// budget and queues what the feedback asks for. with
+// LIGHT_FLUENT_IMAGE_COPY the queued levels are copied in cmd, which must
+// run before anything samples images, and swapped in right away. returns
+// true when the image of any slot in images changed
+bool
+texture_stream_update( struct texture_stream*    stream,
+                       uint64_t                  frame,
+                       struct ft_command_buffer* cmd,
+                       struct ft_image**         images );
+
+void
+texture_stream_get_stats( const struct texture_stream* stream,
+                          struct texture_stream_stats* stats );
@@ -0,0 +1,79 @@
+#include <string.h>
+
+#include "job_system.h"
+#include "timeline.h"
+
+#define TIMELINE_BAR_WIDTH 40
+
+void
+timeline_reset( struct timeline* timeline )
+{
+	memset( timeline, 0, sizeof( *timeline ) );
+	ft_timer_reset( &timeline->timer );
+}
+
+uint32_t
+timeline_add( struct timeline* timeline, const char* name )
+{
+	FT_ASSERT( timeline->phase_count < TIMELINE_MAX_PHASES );
+
+	uint32_t phase                 = timeline->phase_count++;
+	timeline->phases[ phase ].name = name;
+
+	return phase;
+}
+
+void
+timeline_begin( struct timeline* timeline, uint32_t phase )
+{
+	timeline->phases[ phase ].thread = job_system_get_thread_index();
+	timeline->phases[ phase ].begin  = ft_timer_get_ticks( &timeline->timer );
+}
+
+void
+timeline_end( struct timeline* timeline, uint32_t phase )
+{
+	timeline->phases[ phase ].end = ft_timer_get_ticks( &timeline->timer );
+}
+
+void
+timeline_print( const struct timeline* timeline, const char* title )
+{
+	uint64_t total = 0;
+	uint64_t busy  = 0;
+
+	for ( uint32_t i = 0; i < timeline->phase_count; ++i )
+	{
+		const struct timeline_phase* phase = &timeline->phases[ i ];
+		total = FT_MAX( total, phase->end );
+		busy += phase->end - phase->begin;
+	}
+
+	ft_log_info( "%s: %llu ms wall, %llu ms of work",
+	             title,
+	             ( unsigned long long ) total,
+	             ( unsigned long long ) busy );
+
+	for ( uint32_t i = 0; i < timeline->phase_count; ++i )
+	{
+		const struct timeline_phase* phase = &timeline->phases[ i ];
+
+		char     bar[ TIMELINE_BAR_WIDTH + 1 ];
+		uint64_t span  = FT_MAX( total, 1 );
+		uint64_t first = phase->begin * TIMELINE_BAR_WIDTH / span;
+		uint64_t last  = phase->end * TIMELINE_BAR_WIDTH / span;
+
+		for ( uint32_t c = 0; c < TIMELINE_BAR_WIDTH; ++c )
+		{
+			bar[ c ] = ( c >= first && c <= last ) ? '#' : '.';
+		}
+		bar[ TIMELINE_BAR_WIDTH ] = '\0';
+
+		ft_log_info( "  %-16s thread %2u %6llu -> %6llu ms |%s|",
+		             phase->name,
+		             phase->thread,
+		             ( unsigned long long ) phase->begin,
+		             ( unsigned long long ) phase->end,
+		             bar );
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <fluent/fluent.h>
+
+#define TIMELINE_MAX_PHASES 32
+
+// named spans relative to timeline_reset, each phase is written by the one
+// thread that runs it so recording needs no locking
+struct timeline_phase
+{
+	const char* name;
+	uint32_t    thread;
+	uint64_t    begin;
+	uint64_t    end;
+};
+
+struct timeline
+{
+	struct ft_timer       timer;
+	uint32_t              phase_count;
+	struct timeline_phase phases[ TIMELINE_MAX_PHASES ];
+};
+
+void
+timeline_reset( struct timeline* timeline );
+
+// reserves a phase, call before handing it to another thread
+uint32_t
+timeline_add( struct timeline* timeline, const char* name );
+
+void
+timeline_begin( struct timeline* timeline, uint32_t phase );
+
+void
+timeline_end( struct timeline* timeline, uint32_t phase );
+
+// one line per phase with a bar showing where it ran in the total span
+void
+timeline_print( const struct timeline* timeline, const char* title );
@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <fluent/fluent.h>
 #include "ui_pass.h"
+#include "main_pass.h"
+#include "profiler.h"
+#include "gpu_timer.h"
 
 struct ui_pass_data
 {
@@ -9,6 +12,166 @@ struct ui_pass_data
 	struct nk_context* ui;
 } ui_pass_data;
 
+// geometry heap usage and the runtime scene controls. the buttons only
+// queue a request, the main pass carries it out between frames
+static void
+ui_scene_window( struct ui_pass_data* data )
+{
+	static const char* arena_names[ GEOMETRY_ARENA_COUNT ] = {
+	    [GEOMETRY_ARENA_VERTEX]   = "vertex",
+	    [GEOMETRY_ARENA_INDEX_16] = "index 16",
+	    [GEOMETRY_ARENA_INDEX_32] = "index 32",
+	};
+
+	static const char* culling_names[ MAIN_PASS_CULLING_COUNT ] = {
+	    [MAIN_PASS_CULLING_GPU] = "gpu",
+	    [MAIN_PASS_CULLING_CPU] = "cpu",
+	    [MAIN_PASS_CULLING_OFF] = "off",
+	};
+
+	struct main_pass_scene_stats stats;
+	main_pass_get_scene_stats( &stats );
+
+	if ( nk_begin( data->ui,
+	               "Scene",
+	               nk_rect( data->width - 260, 0, 260, 460 ),
+	               NK_WINDOW_BORDER | NK_WINDOW_TITLE |
+	                   NK_WINDOW_NO_SCROLLBAR ) )
+	{
+		char str[ 64 ];
+
+		nk_layout_row_dynamic( data->ui, 18, 1 );
+		snprintf( str,
+		          sizeof( str ),
+		          "models: %u draws: %u",
+		          stats.model_count,
+		          stats.draw_count );
+		nk_label( data->ui, str, NK_TEXT_ALIGN_LEFT );
+
+		snprintf( str, sizeof( str ), "instances: %u", stats.instance_count );
+		nk_label( data->ui, str, NK_TEXT_ALIGN_LEFT );
+
+		snprintf( str,
+		          sizeof( str ),
+		          "visible: %u culled: %u",
+		          stats.visible_count,
+		          stats.culled_count );
+		nk_label( data->ui, str, NK_TEXT_ALIGN_LEFT );
+
+		snprintf( str,
+		          sizeof( str ),
+		          "textures: %u / %u, %.2f of %.2f MB",
+		          stats.texture_count,
+		          stats.texture_slots,
+		          ( double ) stats.texture_bytes / ( 1024.0 * 1024.0 ),
+		          ( double ) stats.texture_full_bytes / ( 1024.0 * 1024.0 ) );
+		nk_label( data->ui, str, NK_TEXT_ALIGN_LEFT );
+
+		snprintf( str,
+		          sizeof( str ),
+		          "  budget %.0f MB, %u pending",
+		          ( double ) stats.streaming.budget / ( 1024.0 * 1024.0 ),
+		          stats.streaming.pending_count );
+		nk_label( data->ui, str, NK_TEXT_ALIGN_LEFT );
+
+		snprintf( str,
+		          sizeof( str ),
+		          "  %u streamed, %u evicted",
+		          stats.streaming.streamed_count,
+		          stats.streaming.evicted_count );
+		nk_label( data->ui, str, NK_TEXT_ALIGN_LEFT );
+
+		for ( uint32_t a = 0; a < GEOMETRY_ARENA_COUNT; ++a )
+		{
+			snprintf( str,
+			          sizeof( str ),
+			          "%s: %.2f / %.2f MB",
+			          arena_names[ a ],
+			          ( double ) stats.geometry.used[ a ] / ( 1024.0 * 1024.0 ),
+			          ( double ) stats.geometry.capacity[ a ] /
+			              ( 1024.0 * 1024.0 ) );
+			nk_label( data->ui, str, NK_TEXT_ALIGN_LEFT );
+
+			snprintf( str,
+			          sizeof( str ),
+			          "  %u free ranges, largest %.2f MB",
+			          stats.geometry.free_ranges[ a ],
+			          ( double ) stats.geometry.largest_free[ a ] /
+			              ( 1024.0 * 1024.0 ) );
+			nk_label( data->ui, str, NK_TEXT_ALIGN_LEFT );
+		}
+
+		nk_layout_row_dynamic( data->ui, 24, 1 );
+		if ( nk_button_label( data->ui, "Unload last model" ) )
+		{
+			main_pass_request( MAIN_PASS_REQUEST_UNLOAD_MODEL );
+		}
+		if ( stats.unloaded_count != 0 &&
+		     nk_button_label( data->ui, "Reload unloaded model" ) )
+		{
+			main_pass_request( MAIN_PASS_REQUEST_RELOAD_MODEL );
+		}
+		if ( nk_button_label( data->ui, "Compact geometry" ) )
+		{
+			main_pass_request( MAIN_PASS_REQUEST_COMPACT_GEOMETRY );
+		}
+		snprintf( str,
+		          sizeof( str ),
+		          "Culling: %s",
+		          culling_names[ stats.culling ] );
+		if ( nk_button_label( data->ui, str ) )
+		{
+			main_pass_set_culling( ( stats.culling + 1 ) %
+			                       MAIN_PASS_CULLING_COUNT );
+		}
+	}
+	nk_end( data->ui );
+}
+
+// the cpu scopes and gpu spans of the last frames, indented by nesting.
+// gpu rows are whole submits, there is no per pass gpu time to show
+static void
+ui_profiler_window( struct ui_pass_data* data )
+{
+	static const char* track_names[ PROFILER_TRACK_COUNT ] = {
+	    [PROFILER_TRACK_CPU] = "cpu",
+	    [PROFILER_TRACK_GPU] = "gpu",
+	};
+
+	if ( !profiler_enabled() )
+	{
+		return;
+	}
+
+	struct profiler_row rows[ PROFILER_MAX_ROWS ];
+	uint32_t row_count = profiler_get_breakdown( rows, PROFILER_MAX_ROWS );
+
+	if ( nk_begin( data->ui,
+	               "Profiler",
+	               nk_rect( data->width - 520, 0, 260, 40 + row_count * 22 ),
+	               NK_WINDOW_BORDER | NK_WINDOW_TITLE |
+	                   NK_WINDOW_NO_SCROLLBAR ) )
+	{
+		char str[ 96 ];
+
+		nk_layout_row_dynamic( data->ui, 18, 1 );
+		for ( uint32_t r = 0; r < row_count; ++r )
+		{
+			snprintf( str,
+			          sizeof( str ),
+			          "%s %*s%s: %.3f ms (max %.3f)",
+			          track_names[ rows[ r ].track ],
+			          ( int ) rows[ r ].depth * 2,
+			          "",
+			          rows[ r ].name,
+			          rows[ r ].average_ms,
+			          rows[ r ].max_ms );
+			nk_label( data->ui, str, NK_TEXT_ALIGN_LEFT );
+		}
+	}
+	nk_end( data->ui );
+}
+
 static void
 ui_pass_execute( const struct ft_device*   device,
                  struct ft_command_buffer* cmd,
@@ -16,6 +179,9 @@ ui_pass_execute( const struct ft_device*   device,
 {
 	struct ui_pass_data* data = user_data;
 
+	profiler_begin( "ui pass" );
+	gpu_timer_begin( cmd, "ui pass" );
+
 	static struct ft_timer fps_timer;
 	static bool            first_time = 1;
 	static uint64_t        frames     = 0;
@@ -41,6 +207,8 @@ ui_pass_execute( const struct ft_device*   device,
 		nk_label( data->ui, fps_str, NK_TEXT_ALIGN_LEFT );
 	}
 	nk_end( data->ui );
+	ui_scene_window( data );
+	ui_profiler_window( data );
 	nk_ft_render( cmd, NK_ANTI_ALIASING_OFF );
 
 	frames++;
@@ -52,18 +220,20 @@ ui_pass_execute( const struct ft_device*   device,
 		frames = 0;
 		ft_timer_reset( &fps_timer );
 	}
+
+	gpu_timer_end( cmd );
+	profiler_end();
 }
 
 void
-register_ui_pass( struct ft_render_graph*    graph,
-                  const struct ft_swapchain* swapchain,
-                  const char*                backbuffer_source_name,
-                  struct nk_context*         ui )
+register_ui_pass( struct ft_render_graph*          graph,
+                  const struct render_target_info* target,
+                  const char*                      backbuffer_source_name,
+                  struct nk_context*               ui )
 {
-	ft_get_swapchain_size( swapchain,
-	                       &ui_pass_data.width,
-	                       &ui_pass_data.height );
-	ui_pass_data.ui = ui;
+	ui_pass_data.width  = target->width;
+	ui_pass_data.height = target->height;
+	ui_pass_data.ui     = ui;
 
 	struct ft_render_pass* pass;
 	ft_rg_add_pass( graph, "ui", &pass );
@@ -73,3 +243,10 @@ register_ui_pass( struct ft_render_graph*    graph,
 	struct ft_image_info back;
 	ft_rg_add_color_output( pass, backbuffer_source_name, &back );
 }
+
+void
+ui_pass_resize( uint32_t width, uint32_t height )
+{
+	ui_pass_data.width  = width;
+	ui_pass_data.height = height;
+}
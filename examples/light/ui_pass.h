@@ -1,10 +1,16 @@
 #pragma once
 
+#include <stdint.h>
+
 struct ft_render_graph;
-struct ft_swapchain;
+struct render_target_info;
+
+void
+register_ui_pass( struct ft_render_graph*          graph,
+                  const struct render_target_info* target,
+                  const char*                      backbuffer_source_name,
+                  struct nk_context*               ui );
 
+// the ui has nothing sized to the target besides its windows
 void
-register_ui_pass( struct ft_render_graph*    graph,
-                  const struct ft_swapchain* swapchain,
-                  const char*                backbuffer_source_name,
-                  struct nk_context*         ui );
+ui_pass_resize( uint32_t width, uint32_t height );
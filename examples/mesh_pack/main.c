@@ -0,0 +1,565 @@
+#include <stdio.h>
+#include <fluent/fluent.h>
+
+#include "file_map.h"
+#include "job_system.h"
+#include "mesh_pack.h"
+#include "texture_cook.h"
+
+#define DEFAULT_ITERATIONS 3
+
+static void
+print_usage( void )
+{
+	printf( "usage: mesh-pack <model.gltf>... [options]\n"
+	        "  --iterations <n>       runs per loader, the best one is "
+	        "reported (default %u)\n"
+	        "  --vertex-format <f>    float or quantized (default float)\n"
+	        "  --texture-format <f>   rgba8 or bc (default rgba8)\n"
+	        "each model is cooked to <name>.pack in the working directory, "
+	        "then loading\nthe gltf is timed against mapping the pack. the "
+	        "quantized format is always\nmeasured against float for size "
+	        "and error, bc textures against rgba8 for\nsize, cook and "
+	        "staging time\n",
+	        DEFAULT_ITERATIONS );
+}
+
+static uint64_t
+gltf_key( const char*              gltf,
+          enum mesh_vertex_format  format,
+          enum mesh_texture_format texture_format )
+{
+	struct file_map file;
+	uint64_t        key = 0;
+
+	if ( file_map_open( gltf, &file ) )
+	{
+		key = mesh_pack_key( file.data, file.size, format, texture_format );
+		file_map_close( &file );
+	}
+
+	return key;
+}
+
+// what light did before the pack, parse with tangent generation and
+// interleave the vertices
+static double
+time_gltf( const char*              gltf,
+           uint64_t                 key,
+           enum mesh_vertex_format  format,
+           enum mesh_texture_format texture_format,
+           void**                   pack,
+           size_t*                  pack_size )
+{
+	struct ft_timer timer;
+	ft_timer_reset( &timer );
+
+	struct ft_model model = ft_load_gltf( gltf, FT_MODEL_GENERATE_TANGENTS );
+
+	if ( model.mesh_count == 0 )
+	{
+		return -1.0;
+	}
+
+	*pack =
+	    mesh_pack_build( &model, key, format, texture_format, pack_size );
+	double ms = ( double ) ft_timer_get_ticks( &timer );
+
+	ft_free_gltf( &model );
+
+	return *pack ? ms : -1.0;
+}
+
+// what light does now, hash the gltf, map and validate the pack and copy
+// every section the way the uploader copies it to staging
+static double
+time_pack( const char*              gltf,
+           const char*              filename,
+           enum mesh_vertex_format  format,
+           enum mesh_texture_format texture_format,
+           uint8_t*                 staging )
+{
+	struct ft_timer timer;
+	ft_timer_reset( &timer );
+
+	uint64_t        key = gltf_key( gltf, format, texture_format );
+	struct file_map file;
+
+	if ( !file_map_open( filename, &file ) )
+	{
+		return -1.0;
+	}
+
+	const struct mesh_pack_header* header =
+	    mesh_pack_open( file.data, file.size, key );
+
+	if ( header == NULL )
+	{
+		file_map_close( &file );
+		return -1.0;
+	}
+
+	uint64_t offset = 0;
+
+	for ( uint32_t s = MESH_PACK_SECTION_VERTICES; s < MESH_PACK_SECTION_COUNT;
+	      ++s )
+	{
+		const struct mesh_pack_range* section = &header->sections[ s ];
+
+		memcpy( staging + offset,
+		        mesh_pack_section_data( header, s ),
+		        ( size_t ) section->size );
+		offset += section->size;
+	}
+
+	double ms = ( double ) ft_timer_get_ticks( &timer );
+
+	file_map_close( &file );
+
+	return ms;
+}
+
+static bool
+bench_model( const char*              gltf,
+             enum mesh_vertex_format  format,
+             enum mesh_texture_format texture_format,
+             uint32_t                 iterations )
+{
+	char filename[ 512 ];
+	mesh_pack_filename( gltf,
+	                    format,
+	                    texture_format,
+	                    filename,
+	                    sizeof( filename ) );
+
+	uint64_t key       = gltf_key( gltf, format, texture_format );
+	void*    pack      = NULL;
+	size_t   pack_size = 0;
+	double   gltf_ms   = 0.0;
+	bool     animated  = false;
+
+	for ( uint32_t i = 0; i < iterations; ++i )
+	{
+		free( pack );
+		pack = NULL;
+
+		double ms =
+		    time_gltf( gltf, key, format, texture_format, &pack, &pack_size );
+
+		if ( ms < 0.0 )
+		{
+			printf( "%-32s failed to load\n", gltf );
+			free( pack );
+			return false;
+		}
+
+		gltf_ms = ( i == 0 || ms < gltf_ms ) ? ms : gltf_ms;
+	}
+
+	// light keeps parsing animated models, the pack is still written so
+	// the two loaders can be compared
+	struct ft_model model = ft_load_gltf( gltf, 0 );
+	animated              = model.animation_count != 0;
+	ft_free_gltf( &model );
+
+	if ( !mesh_pack_save( pack, pack_size, filename ) )
+	{
+		printf( "%-32s failed to write %s\n", gltf, filename );
+		free( pack );
+		return false;
+	}
+
+	free( pack );
+
+	uint8_t* staging = malloc( pack_size );
+	double   pack_ms = 0.0;
+
+	for ( uint32_t i = 0; i < iterations; ++i )
+	{
+		double ms =
+		    time_pack( gltf, filename, format, texture_format, staging );
+
+		if ( ms < 0.0 )
+		{
+			printf( "%-32s failed to open %s\n", gltf, filename );
+			free( staging );
+			return false;
+		}
+
+		pack_ms = ( i == 0 || ms < pack_ms ) ? ms : pack_ms;
+	}
+
+	free( staging );
+
+	printf( "%-32s %9.1f %9.1f %8.1fx %8.1f%s\n",
+	        filename,
+	        gltf_ms,
+	        pack_ms,
+	        gltf_ms / FT_MAX( pack_ms, 0.001 ),
+	        ( double ) pack_size / ( 1024.0 * 1024.0 ),
+	        animated ? "  animated" : "" );
+
+	return true;
+}
+
+static double
+angle_degrees( const float* a, const float* b )
+{
+	double length = sqrt( a[ 0 ] * a[ 0 ] + a[ 1 ] * a[ 1 ] + a[ 2 ] * a[ 2 ] );
+
+	if ( length == 0.0 )
+	{
+		return 0.0;
+	}
+
+	double cosine = ( a[ 0 ] * b[ 0 ] + a[ 1 ] * b[ 1 ] + a[ 2 ] * b[ 2 ] ) /
+	                length;
+
+	return acos( FT_MIN( FT_MAX( cosine, -1.0 ), 1.0 ) ) * 180.0 / M_PI;
+}
+
+// decodes every quantized vertex the way pbr.vert.glsl does and compares
+// it with the float vertex. position error is relative to the mesh extent
+// on that axis, the quantization step is 1 / 65535 of it
+static bool
+report_quantization( const char* gltf )
+{
+	struct ft_model model = ft_load_gltf( gltf, FT_MODEL_GENERATE_TANGENTS );
+
+	if ( model.mesh_count == 0 )
+	{
+		return false;
+	}
+
+	size_t float_size, quantized_size;
+	void*  float_pack     = mesh_pack_build( &model,
+	                                         0,
+	                                         MESH_VERTEX_FORMAT_FLOAT,
+	                                         MESH_TEXTURE_FORMAT_RGBA8,
+	                                         &float_size );
+	void*  quantized_pack = mesh_pack_build( &model,
+	                                         0,
+	                                         MESH_VERTEX_FORMAT_QUANTIZED,
+	                                         MESH_TEXTURE_FORMAT_RGBA8,
+	                                         &quantized_size );
+
+	ft_free_gltf( &model );
+
+	if ( float_pack == NULL || quantized_pack == NULL )
+	{
+		free( float_pack );
+		free( quantized_pack );
+		return false;
+	}
+
+	const struct mesh_pack_header* float_header     = float_pack;
+	const struct mesh_pack_header* quantized_header = quantized_pack;
+
+	const struct mesh_vertex* float_vertices =
+	    mesh_pack_section_data( float_header, MESH_PACK_SECTION_VERTICES );
+	const struct mesh_vertex_quantized* quantized_vertices =
+	    mesh_pack_section_data( quantized_header, MESH_PACK_SECTION_VERTICES );
+	const struct mesh_pack_mesh* meshes = mesh_pack_meshes( quantized_header );
+
+	uint64_t vertex_count    = 0;
+	double   position_error  = 0.0;
+	double   normal_error    = 0.0;
+	double   tangent_error   = 0.0;
+	double   texcoord_error  = 0.0;
+	uint64_t sign_mismatches = 0;
+
+	for ( uint32_t m = 0; m < quantized_header->mesh_count; ++m )
+	{
+		const struct mesh_pack_mesh* mesh = &meshes[ m ];
+
+		for ( uint32_t v = 0; v < mesh->vertex_count; ++v )
+		{
+			uint32_t                  index = mesh->first_vertex + v;
+			const struct mesh_vertex* src   = &float_vertices[ index ];
+			struct mesh_vertex        decoded;
+
+			mesh_vertex_dequantize( &quantized_vertices[ index ],
+			                        mesh,
+			                        &decoded );
+
+			for ( uint32_t i = 0; i < 3; ++i )
+			{
+				if ( mesh->position_scale[ i ] > 0.0f )
+				{
+					double error =
+					    fabs( decoded.position[ i ] - src->position[ i ] ) /
+					    mesh->position_scale[ i ];
+					position_error = FT_MAX( position_error, error );
+				}
+			}
+
+			for ( uint32_t i = 0; i < 2; ++i )
+			{
+				double error =
+				    fabs( decoded.texcoord[ i ] - src->texcoord[ i ] );
+				texcoord_error = FT_MAX( texcoord_error, error );
+			}
+
+			normal_error =
+			    FT_MAX( normal_error,
+			            angle_degrees( src->normal, decoded.normal ) );
+			tangent_error =
+			    FT_MAX( tangent_error,
+			            angle_degrees( src->tangent, decoded.tangent ) );
+			sign_mismatches += ( src->tangent[ 3 ] < 0.0f ) !=
+			                   ( decoded.tangent[ 3 ] < 0.0f );
+		}
+
+		vertex_count += mesh->vertex_count;
+	}
+
+	const double mb = 1024.0 * 1024.0;
+
+	double float_mb =
+	    float_header->sections[ MESH_PACK_SECTION_VERTICES ].size / mb;
+	double quantized_mb =
+	    quantized_header->sections[ MESH_PACK_SECTION_VERTICES ].size / mb;
+
+	printf( "%s\n"
+	        "  %llu vertices, %u -> %u bytes each, %.2f -> %.2f MB of "
+	        "vertex memory and fetch (-%.0f%%)\n"
+	        "  max position error %.2f quantization steps of the mesh "
+	        "extent\n"
+	        "  max normal error %.4f deg, tangent error %.4f deg, %llu "
+	        "tangent sign flips\n"
+	        "  max texcoord error %.6f\n",
+	        gltf,
+	        ( unsigned long long ) vertex_count,
+	        float_header->vertex_stride,
+	        quantized_header->vertex_stride,
+	        float_mb,
+	        quantized_mb,
+	        100.0 * ( 1.0 - quantized_mb / FT_MAX( float_mb, 1e-9 ) ),
+	        position_error * 65535.0,
+	        normal_error,
+	        tangent_error,
+	        ( unsigned long long ) sign_mismatches,
+	        texcoord_error );
+
+	free( float_pack );
+	free( quantized_pack );
+
+	return true;
+}
+
+// copies every level the way load_model_textures hands them to the
+// uploader
+static double
+time_texture_staging( const struct mesh_pack_header* header, uint8_t* staging )
+{
+	struct ft_timer timer;
+	ft_timer_reset( &timer );
+
+	const struct mesh_pack_texture* textures = mesh_pack_textures( header );
+	uint64_t                        offset   = 0;
+
+	for ( uint32_t t = 0; t < header->texture_count; ++t )
+	{
+		for ( uint32_t l = 0; l < textures[ t ].level_count; ++l )
+		{
+			memcpy( staging + offset,
+			        mesh_pack_texels( header, &textures[ t ], l ),
+			        ( size_t ) textures[ t ].levels[ l ].size );
+			offset += textures[ t ].levels[ l ].size;
+		}
+	}
+
+	return ( double ) ft_timer_get_ticks( &timer );
+}
+
+// cooks the textures both ways from one parse. before the packs kept mips,
+// light uploaded rgba8 level 0 and generated the rest on the gpu, which
+// takes as much video memory as the cooked rgba8 chain and staged a
+// quarter less
+static bool
+report_textures( const char* gltf, uint32_t iterations )
+{
+	struct ft_model model = ft_load_gltf( gltf, 0 );
+
+	if ( model.mesh_count == 0 )
+	{
+		return false;
+	}
+
+	void*    packs[ MESH_TEXTURE_FORMAT_COUNT ];
+	double   cook_ms[ MESH_TEXTURE_FORMAT_COUNT ];
+	double   staging_ms[ MESH_TEXTURE_FORMAT_COUNT ];
+	uint64_t bytes[ MESH_TEXTURE_FORMAT_COUNT ];
+	bool     ok = true;
+
+	for ( uint32_t f = 0; f < MESH_TEXTURE_FORMAT_COUNT; ++f )
+	{
+		struct ft_timer timer;
+		ft_timer_reset( &timer );
+
+		size_t size;
+		packs[ f ]   = mesh_pack_build( &model,
+		                                0,
+		                                MESH_VERTEX_FORMAT_FLOAT,
+		                                ( enum mesh_texture_format ) f,
+		                                &size );
+		cook_ms[ f ] = ( double ) ft_timer_get_ticks( &timer );
+		ok           = ok && packs[ f ] != NULL;
+	}
+
+	ft_free_gltf( &model );
+
+	if ( !ok )
+	{
+		free( packs[ MESH_TEXTURE_FORMAT_RGBA8 ] );
+		free( packs[ MESH_TEXTURE_FORMAT_BC ] );
+		return false;
+	}
+
+	const struct mesh_pack_header* rgba8_header =
+	    packs[ MESH_TEXTURE_FORMAT_RGBA8 ];
+	uint8_t* staging =
+	    malloc( rgba8_header->sections[ MESH_PACK_SECTION_TEXELS ].size + 1 );
+	uint32_t codec_counts[ TEXTURE_CODEC_COUNT ] = { 0 };
+
+	for ( uint32_t f = 0; f < MESH_TEXTURE_FORMAT_COUNT; ++f )
+	{
+		const struct mesh_pack_header*  header   = packs[ f ];
+		const struct mesh_pack_texture* textures = mesh_pack_textures( header );
+
+		bytes[ f ] = 0;
+		for ( uint32_t t = 0; t < header->texture_count; ++t )
+		{
+			bytes[ f ] += mesh_pack_texture_size( &textures[ t ] );
+
+			if ( f == MESH_TEXTURE_FORMAT_BC )
+			{
+				codec_counts[ textures[ t ].codec ]++;
+			}
+		}
+
+		for ( uint32_t i = 0; i < iterations; ++i )
+		{
+			double ms = time_texture_staging( header, staging );
+			staging_ms[ f ] =
+			    ( i == 0 || ms < staging_ms[ f ] ) ? ms : staging_ms[ f ];
+		}
+	}
+
+	free( staging );
+
+	const double mb = 1024.0 * 1024.0;
+
+	printf( "%s\n  %u textures:", gltf, rgba8_header->texture_count );
+	for ( uint32_t c = 0; c < TEXTURE_CODEC_COUNT; ++c )
+	{
+		if ( codec_counts[ c ] != 0 )
+		{
+			printf( " %u %s", codec_counts[ c ], texture_codec_name( c ) );
+		}
+	}
+	printf( "\n" );
+
+	for ( uint32_t f = 0; f < MESH_TEXTURE_FORMAT_COUNT; ++f )
+	{
+		printf( "  %-5s %8.2f MB of video memory (-%.0f%%), cooked in "
+		        "%.1f ms, staged in %.2f ms\n",
+		        mesh_texture_format_name( f ),
+		        bytes[ f ] / mb,
+		        100.0 * ( 1.0 - ( double ) bytes[ f ] /
+		                            FT_MAX( bytes[ 0 ], 1 ) ),
+		        cook_ms[ f ],
+		        staging_ms[ f ] );
+	}
+
+	free( packs[ MESH_TEXTURE_FORMAT_RGBA8 ] );
+	free( packs[ MESH_TEXTURE_FORMAT_BC ] );
+
+	return true;
+}
+
+int
+main( int argc, char** argv )
+{
+	uint32_t                 iterations     = DEFAULT_ITERATIONS;
+	enum mesh_vertex_format  format         = MESH_VERTEX_FORMAT_FLOAT;
+	enum mesh_texture_format texture_format = MESH_TEXTURE_FORMAT_RGBA8;
+	int                      model_count    = 0;
+
+	for ( int i = 1; i < argc; ++i )
+	{
+		if ( strcmp( argv[ i ], "--iterations" ) == 0 && i + 1 < argc )
+		{
+			iterations = ( uint32_t ) atoi( argv[ ++i ] );
+			iterations = FT_MAX( iterations, 1u );
+		}
+		else if ( strcmp( argv[ i ], "--vertex-format" ) == 0 && i + 1 < argc )
+		{
+			if ( !mesh_vertex_format_parse( argv[ ++i ], &format ) )
+			{
+				print_usage();
+				return EXIT_FAILURE;
+			}
+		}
+		else if ( strcmp( argv[ i ], "--texture-format" ) == 0 &&
+		          i + 1 < argc )
+		{
+			if ( !mesh_texture_format_parse( argv[ ++i ], &texture_format ) )
+			{
+				print_usage();
+				return EXIT_FAILURE;
+			}
+		}
+		else if ( argv[ i ][ 0 ] == '-' )
+		{
+			print_usage();
+			return EXIT_FAILURE;
+		}
+		else
+		{
+			argv[ model_count++ ] = argv[ i ];
+		}
+	}
+
+	if ( model_count == 0 )
+	{
+		print_usage();
+		return EXIT_FAILURE;
+	}
+
+	// bc textures are encoded a block row per job
+	job_system_init( 0 );
+
+	printf( "%-32s %9s %9s %9s %8s\n",
+	        "pack",
+	        "gltf ms",
+	        "pack ms",
+	        "speedup",
+	        "size MB" );
+
+	bool ok = true;
+
+	for ( int i = 0; i < model_count; ++i )
+	{
+		ok = bench_model( argv[ i ], format, texture_format, iterations ) &&
+		     ok;
+	}
+
+	printf( "\n" );
+
+	for ( int i = 0; i < model_count; ++i )
+	{
+		ok = report_quantization( argv[ i ] ) && ok;
+	}
+
+	printf( "\n" );
+
+	for ( int i = 0; i < model_count; ++i )
+	{
+		ok = report_textures( argv[ i ], iterations ) && ok;
+	}
+
+	job_system_shutdown();
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -25,6 +25,12 @@ project(name)
 	fluent_engine.link()
 end
 
+commons.tool = function(name)
+	commons.example(name)
+	filter {}
+	kind "ConsoleApp"
+end
+
 commons.example("light")
 	files
 	{
@@ -33,17 +39,191 @@ commons.example("light")
 		"light/ui_pass.c",
 		"light/main_pass.h",
 		"light/main_pass.c",
+		"light/file_map.h",
+		"light/file_map.c",
+		"light/job_system.h",
+		"light/job_system.c",
+		"light/hdr_decode.h",
+		"light/hdr_decode.c",
+		"light/timeline.h",
+		"light/timeline.c",
+		"light/pipeline_timer.h",
+		"light/pipeline_timer.c",
+		"light/mesh_pack.h",
+		"light/mesh_pack.c",
+		"light/texture_cook.h",
+		"light/texture_cook.c",
+		"light/texture_stream.h",
+		"light/texture_stream.c",
+		"light/geometry_heap.h",
+		"light/geometry_heap.c",
+		"light/frame_stats.h",
+		"light/frame_stats.c",
+		"light/benchmark.h",
+		"light/benchmark.c",
+		"light/frame_capture.h",
+		"light/frame_capture.c",
+		"light/profiler.h",
+		"light/profiler.c",
+		"light/gpu_timer.h",
+		"light/gpu_timer.c",
+		"light/simd.h",
+		"light/scene_bvh.h",
+		"light/scene_bvh.c",
+		"light/frame_ring.h",
+		"light/frame_ring.c",
+		"light/animation_set.h",
+		"light/animation_set.c",
+		"light/model_animation.h",
+		"light/model_animation.c",
+		"light/ibl_cache.h",
+		"light/ibl_cache.c",
+		"light/ibl_cache_gpu.c",
 		"light/shaders/shader_pbr_vert_spirv.c",
+		"light/shaders/shader_pbr_quantized_vert_spirv.c",
 		"light/shaders/shader_pbr_frag_spirv.c",
+		"light/shaders/shader_pbr_sh_frag_spirv.c",
+		"light/shaders/shader_pbr_feedback_frag_spirv.c",
+		"light/shaders/shader_pbr_sh_feedback_frag_spirv.c",
+		"light/shaders/shader_pbr_per_draw_frag_spirv.c",
+		"light/shaders/shader_pbr_sh_per_draw_frag_spirv.c",
 		"light/shaders/shader_eq_to_cubemap_comp_spirv.c",
 		"light/shaders/shader_skybox_vert_spirv.c",
 		"light/shaders/shader_skybox_frag_spirv.c",
 		"light/shaders/shader_brdf_comp_spirv.c",
 		"light/shaders/shader_irradiance_comp_spirv.c",
 		"light/shaders/shader_specular_comp_spirv.c",
+		"light/shaders/shader_sh_project_comp_spirv.c",
+		"light/shaders/shader_cube_readback_comp_spirv.c",
+		"light/shaders/shader_lut_readback_comp_spirv.c",
+		"light/shaders/shader_eq_to_cubemap_rgba16f_comp_spirv.c",
+		"light/shaders/shader_eq_to_cubemap_r11g11b10f_comp_spirv.c",
+		"light/shaders/shader_irradiance_rgba16f_comp_spirv.c",
+		"light/shaders/shader_irradiance_r11g11b10f_comp_spirv.c",
+		"light/shaders/shader_specular_rgba16f_comp_spirv.c",
+		"light/shaders/shader_specular_r11g11b10f_comp_spirv.c",
+		"light/shaders/shader_brdf_rg16_comp_spirv.c",
+		"light/shaders/shader_brdf_rg16f_comp_spirv.c",
+		"light/shaders/shader_cube_readback_rgba16f_comp_spirv.c",
+		"light/shaders/shader_cube_readback_r11g11b10f_comp_spirv.c",
+		"light/shaders/shader_lut_readback_rg16_comp_spirv.c",
+		"light/shaders/shader_lut_readback_rg16f_comp_spirv.c",
+		"light/shaders/shader_cull_comp_spirv.c",
+		"light/shaders/shader_frame_readback_comp_spirv.c",
 	}
 
 	includedirs 
 	{
 		"light/shaders"
-	}
\ No newline at end of file
+	}
+
+	if _OPTIONS["fluent_features"] ~= nil then
+		for feature in string.gmatch(_OPTIONS["fluent_features"], "[^,]+") do
+			defines { "LIGHT_FLUENT_" .. string.upper(feature) .. "=1" }
+		end
+	end
+
+commons.tool("ibl-baker")
+	files
+	{
+		"ibl_baker/main.c",
+		"light/simd.h",
+		"light/file_map.h",
+		"light/file_map.c",
+		"light/job_system.h",
+		"light/job_system.c",
+		"light/ibl_cache.h",
+		"light/ibl_cache.c",
+		"light/ibl_cpu.h",
+		"light/ibl_cpu.c",
+	}
+
+	includedirs
+	{
+		"light"
+	}
+
+commons.tool("hdr-bench")
+	files
+	{
+		"hdr_bench/main.c",
+		"light/file_map.h",
+		"light/file_map.c",
+		"light/job_system.h",
+		"light/job_system.c",
+		"light/hdr_decode.h",
+		"light/hdr_decode.c",
+	}
+
+	includedirs
+	{
+		"light"
+	}
+
+commons.tool("mesh-pack")
+	files
+	{
+		"mesh_pack/main.c",
+		"light/file_map.h",
+		"light/file_map.c",
+		"light/job_system.h",
+		"light/job_system.c",
+		"light/mesh_pack.h",
+		"light/mesh_pack.c",
+		"light/texture_cook.h",
+		"light/texture_cook.c",
+	}
+
+	includedirs
+	{
+		"light"
+	}
+
+commons.tool("cull-bench")
+	files
+	{
+		"cull_bench/main.c",
+		"light/simd.h",
+		"light/scene_bvh.h",
+		"light/scene_bvh.c",
+		"light/frame_stats.h",
+		"light/frame_stats.c",
+	}
+
+	includedirs
+	{
+		"light"
+	}
+
+commons.tool("frame-ring-check")
+	files
+	{
+		"frame_ring_check/main.c",
+		"light/frame_ring.h",
+		"light/frame_ring.c",
+	}
+
+	includedirs
+	{
+		"light"
+	}
+
+commons.tool("anim-bench")
+	files
+	{
+		"anim_bench/main.c",
+		"light/simd.h",
+		"light/job_system.h",
+		"light/job_system.c",
+		"light/frame_stats.h",
+		"light/frame_stats.c",
+		"light/animation_set.h",
+		"light/animation_set.c",
+		"light/model_animation.h",
+		"light/model_animation.c",
+	}
+
+	includedirs
+	{
+		"light"
+	}
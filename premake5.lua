@@ -6,6 +6,12 @@ workspace "fluent-examples"
 		description = "build directory"
 	}
 	
+	newoption
+	{
+		trigger = "fluent_features",
+		description = "comma separated fluent api the light example may use, see examples/light/fluent_features.h"
+	}
+
 	build_directory = "build/"
 	
 	if _OPTIONS["build_directory"] ~= nil then
@@ -0,0 +1,84 @@
+import sys
+import os
+import argparse
+import subprocess
+
+# runs the light example headless with the khronos validation layer, which
+# the vulkan loader enables from the environment, and fails on any
+# validation message. run it from the directory light runs from, the
+# environment map and the packs are looked up there
+
+arg_parser = argparse.ArgumentParser(description='')
+arg_parser.add_argument('--light', type=str, required=True,
+									help='light executable')
+arg_parser.add_argument('--model', type=str, nargs='?',
+									help='gltf or bare model name, the helmet by default')
+arg_parser.add_argument('--frames', type=int, default=300,
+									help='frames per run')
+arg_parser.add_argument('--budget', type=int, default=8,
+									help='texture budget in MB of the streaming run')
+arg_parser.add_argument('--fluent_features', type=str, default='',
+									help='the --fluent_features light was built with')
+
+VALIDATION_LAYER = 'VK_LAYER_KHRONOS_validation'
+
+# progressive streaming reads back what the texture array sampled, see
+# examples/light/fluent_features.h
+STREAMING_FEATURES = ['descriptor_indexing', 'fragment_atomics']
+
+def pack_filename(model):
+	name = os.path.splitext(os.path.basename(model))[0]
+	return name + '.bc.pack'
+
+def run_light(args, name, options):
+	command = [os.path.abspath(args.light), '--headless', str(args.frames)]
+	command += options
+	if args.model:
+		command += ['--model', args.model]
+
+	env = dict(os.environ)
+	env['VK_INSTANCE_LAYERS'] = VALIDATION_LAYER
+
+	print('== ' + name + ': ' + ' '.join(command[1:]))
+	result = subprocess.run(command, env=env, stdout=subprocess.PIPE,
+							stderr=subprocess.STDOUT, universal_newlines=True)
+	print(result.stdout)
+
+	messages = [line for line in result.stdout.splitlines()
+				if 'VUID-' in line or 'Validation Error' in line]
+
+	print('== %s: exit code %d, %d validation messages\n' %
+		  (name, result.returncode, len(messages)))
+
+	return result.returncode == 0 and len(messages) == 0
+
+if __name__ == "__main__":
+	args = arg_parser.parse_args(sys.argv[1:])
+
+	# the cold start cooks the textures to bc, the warm start maps the pack
+	# the cold start wrote
+	pack = pack_filename(args.model if args.model else 'DamagedHelmet')
+	if os.path.exists(pack):
+		os.remove(pack)
+
+	bc = ['--texture-format', 'bc', '--texture-streaming', 'full']
+
+	ok = run_light(args, 'bc cold start', bc)
+	ok = run_light(args, 'bc warm start', bc) and ok
+
+	# the benchmark camera moves in and out, so under a small budget the
+	# finer levels are evicted and streamed in again. the last lines give
+	# the streamed and evicted counts
+	streaming = ['--texture-format', 'bc',
+				 '--texture-streaming', 'progressive',
+				 '--texture-budget', str(args.budget),
+				 '--benchmark', str(args.frames)]
+
+	features = args.fluent_features.split(',')
+	if all(feature in features for feature in STREAMING_FEATURES):
+		ok = run_light(args, 'streaming under budget', streaming) and ok
+	else:
+		print('== streaming under budget: skipped, light needs ' +
+			  ','.join(STREAMING_FEATURES) + '\n')
+
+	sys.exit(0 if ok else 1)